@@ -0,0 +1,42 @@
+/* Generated by gen/unittest_idhash.cpp, do not edit */
+
+#include "openpilot.h"
+#include "unittest_priv.h"
+
+const uint8_t uavo_id_hash_bits = 7;
+const uint8_t uavo_id_hash_bucket_bits = 5;
+
+const uint8_t uavo_id_hash_disp[32] = {
+    0, 1, 3, 0, 2, 2, 0, 0, 0, 1, 0, 0, 0, 0, 5, 2,
+    5, 0, 0, 1, 3, 2, 1, 0, 0, 0, 2, 3, 0, 0, 1, 1,
+};
+
+const uint8_t uavo_id_hash_index[128] = {
+    0, 0, 0, 35, 31, 0, 54, 38, 51, 18, 0, 26, 60, 0, 64, 12,
+    0, 0, 59, 29, 9, 21, 0, 0, 0, 0, 0, 36, 39, 27, 0, 0,
+    0, 0, 0, 32, 0, 45, 23, 0, 0, 0, 2, 0, 61, 0, 10, 0,
+    0, 0, 0, 0, 63, 62, 55, 52, 0, 0, 37, 0, 34, 30, 0, 0,
+    57, 0, 0, 33, 0, 0, 0, 6, 25, 0, 16, 0, 42, 0, 0, 41,
+    56, 17, 0, 4, 14, 50, 24, 0, 0, 0, 44, 0, 0, 15, 13, 0,
+    0, 28, 20, 0, 0, 5, 53, 0, 0, 0, 48, 22, 0, 46, 40, 19,
+    0, 47, 3, 7, 58, 0, 11, 1, 0, 0, 49, 0, 0, 8, 0, 43,
+};
+
+UAVObjHandle *const uavo_id_hash_handles[UT_NUM_OBJECTS] = {
+    &ut_handles[0], &ut_handles[1], &ut_handles[2], &ut_handles[3],
+    &ut_handles[4], &ut_handles[5], &ut_handles[6], &ut_handles[7],
+    &ut_handles[8], &ut_handles[9], &ut_handles[10], &ut_handles[11],
+    &ut_handles[12], &ut_handles[13], &ut_handles[14], &ut_handles[15],
+    &ut_handles[16], &ut_handles[17], &ut_handles[18], &ut_handles[19],
+    &ut_handles[20], &ut_handles[21], &ut_handles[22], &ut_handles[23],
+    &ut_handles[24], &ut_handles[25], &ut_handles[26], &ut_handles[27],
+    &ut_handles[28], &ut_handles[29], &ut_handles[30], &ut_handles[31],
+    &ut_handles[32], &ut_handles[33], &ut_handles[34], &ut_handles[35],
+    &ut_handles[36], &ut_handles[37], &ut_handles[38], &ut_handles[39],
+    &ut_handles[40], &ut_handles[41], &ut_handles[42], &ut_handles[43],
+    &ut_handles[44], &ut_handles[45], &ut_handles[46], &ut_handles[47],
+    &ut_handles[48], &ut_handles[49], &ut_handles[50], &ut_handles[51],
+    &ut_handles[52], &ut_handles[53], &ut_handles[54], &ut_handles[55],
+    &ut_handles[56], &ut_handles[57], &ut_handles[58], &ut_handles[59],
+    &ut_handles[60], &ut_handles[61], &ut_handles[62], &ut_handles[63],
+};
@@ -52,7 +52,44 @@
  * @}
  */
 
-// Exposed Function Prototypes
+// Nav structure containing current solution
+struct NavStruct {
+    float Pos[3]; // Position in meters and relative to a local NED frame
+    float Vel[3]; // Velocity in meters and in NED
+    float q[4]; // unit quaternion rotation relative to NED
+    float gyro_bias[3];
+    float accel_bias[3];
+};
+
+/**
+ * Complete state of one filter. The functions taking a context only work on
+ * that filter so that several of them can run side by side, e.g. redundant
+ * estimators or log re-filtering on several threads. The caller allocates
+ * INSGPSContextSize() bytes and calls INSGPSInitCtx() first.
+ */
+typedef struct INSGPSContext INSGPSContext;
+
+uint32_t INSGPSContextSize();
+void INSGPSInitCtx(INSGPSContext *ctx);
+void INSStatePredictionCtx(INSGPSContext *ctx, float gyro_data[3], float accel_data[3], float dT);
+void INSCovariancePredictionCtx(INSGPSContext *ctx, float dT);
+void INSCorrectionCtx(INSGPSContext *ctx, float mag_data[3], float Pos[3], float Vel[3], float BaroAlt, uint16_t SensorsUsed);
+const struct NavStruct *INSGetNavCtx(const INSGPSContext *ctx);
+
+void INSResetPCtx(INSGPSContext *ctx, float PDiag[13]);
+void INSGetPCtx(INSGPSContext *ctx, float PDiag[13]);
+void INSSetStateCtx(INSGPSContext *ctx, float pos[3], float vel[3], float q[4], float gyro_bias[3], float accel_bias[3]);
+void INSSetPosVelVarCtx(INSGPSContext *ctx, float PosVar[3], float VelVar[3]);
+void INSSetGyroBiasCtx(INSGPSContext *ctx, float gyro_bias[3]);
+void INSSetAccelVarCtx(INSGPSContext *ctx, float accel_var[3]);
+void INSSetGyroVarCtx(INSGPSContext *ctx, float gyro_var[3]);
+void INSSetGyroBiasVarCtx(INSGPSContext *ctx, float gyro_bias_var[3]);
+void INSSetMagNorthCtx(INSGPSContext *ctx, float B[3]);
+void INSSetMagVarCtx(INSGPSContext *ctx, float scaled_mag_var[3]);
+void INSSetBaroVarCtx(INSGPSContext *ctx, float baro_var);
+void INSPosVelResetCtx(INSGPSContext *ctx, float pos[3], float vel[3]);
+
+// Exposed Function Prototypes, working on the default filter whose solution is Nav
 void INSGPSInit();
 void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT);
 void INSCovariancePrediction(float dT);
@@ -76,19 +113,12 @@ void MagVelBaroCorrection(float mag_data[3], float Vel[3], float BaroAlt);
 void FullCorrection(float mag_data[3], float Pos[3], float Vel[3],
                     float BaroAlt);
 void GpsBaroCorrection(float Pos[3], float Vel[3], float BaroAlt);
-void GpsMagCorrection(float mag_data[3], float Pos[3], float Vel[2]);
+void GpsMagCorrection(float mag_data[3], float Pos[3], float Vel[3]);
 void VelBaroCorrection(float Vel[3], float BaroAlt);
 
 uint16_t ins_get_num_states();
 
-// Nav structure containing current solution
-extern struct NavStruct {
-    float Pos[3]; // Position in meters and relative to a local NED frame
-    float Vel[3]; // Velocity in meters and in NED
-    float q[4]; // unit quaternion rotation relative to NED
-    float gyro_bias[3];
-    float accel_bias[3];
-} Nav;
+extern struct NavStruct Nav;
 
 /**
  * @}
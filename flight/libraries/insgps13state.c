@@ -32,6 +32,7 @@
 #include "insgps.h"
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <pios_math.h>
 
 // constants/macros/typdefs
@@ -84,7 +85,7 @@ static const int8_t GrowMax[NUMX] = { -1, -1, -1, 5, 5, 5, 2, 2, 2, 2, 6, 7, 8 }
 static const int8_t HrowMin[NUMV] = { 0, 1, 2, 3, 4, 5, 6, 6, 6, 2 };
 static const int8_t HrowMax[NUMV] = { 0, 1, 2, 3, 4, 5, 9, 9, 9, 2 };
 
-static struct EKFData {
+struct INSGPSContext {
     // linearized system matrices
     float F[NUMX][NUMX];
     float G[NUMX][NUMW];
@@ -97,7 +98,12 @@ static struct EKFData {
     // input noise and measurement noise variances
     float Q[NUMW];
     float R[NUMV];
-} ekf;
+    // current solution
+    struct NavStruct Nav;
+};
+
+// The filter used by the functions without a context
+static INSGPSContext ekf;
 
 // Global variables
 struct NavStruct Nav;
@@ -110,59 +116,71 @@ uint16_t ins_get_num_states()
     return NUMX;
 }
 
-void INSGPSInit() // pretty much just a place holder for now
+uint32_t INSGPSContextSize()
+{
+    return sizeof(INSGPSContext);
+}
+
+const struct NavStruct *INSGetNavCtx(const INSGPSContext *ctx)
+{
+    return &ctx->Nav;
+}
+
+void INSGPSInitCtx(INSGPSContext *ctx) // pretty much just a place holder for now
 {
-    ekf.Be[0] = 1.0f;
-    ekf.Be[1] = 0.0f;
-    ekf.Be[2] = 0.0f; // local magnetic unit vector
+    ctx->Be[0] = 1.0f;
+    ctx->Be[1] = 0.0f;
+    ctx->Be[2] = 0.0f; // local magnetic unit vector
 
     for (int i = 0; i < NUMX; i++) {
         for (int j = 0; j < NUMX; j++) {
-            ekf.P[i][j] = 0.0f; // zero all terms
-            ekf.F[i][j] = 0.0f;
+            ctx->P[i][j] = 0.0f; // zero all terms
+            ctx->F[i][j] = 0.0f;
         }
 
         for (int j = 0; j < NUMW; j++) {
-            ekf.G[i][j] = 0.0f;
+            ctx->G[i][j] = 0.0f;
         }
 
         for (int j = 0; j < NUMV; j++) {
-            ekf.H[j][i] = 0.0f;
+            ctx->H[j][i] = 0.0f;
         }
 
-        ekf.X[i] = 0.0f;
+        ctx->X[i] = 0.0f;
     }
     for (int i = 0; i < NUMW; i++) {
-        ekf.Q[i] = 0.0f;
+        ctx->Q[i] = 0.0f;
     }
     for (int i = 0; i < NUMV; i++) {
-        ekf.R[i] = 0.0f;
+        ctx->R[i] = 0.0f;
     }
 
 
-    ekf.P[0][0]   = ekf.P[1][1] = ekf.P[2][2] = 25.0f;            // initial position variance (m^2)
-    ekf.P[3][3]   = ekf.P[4][4] = ekf.P[5][5] = 5.0f;             // initial velocity variance (m/s)^2
-    ekf.P[6][6]   = ekf.P[7][7] = ekf.P[8][8] = ekf.P[9][9] = 1e-5f;  // initial quaternion variance
-    ekf.P[10][10] = ekf.P[11][11] = ekf.P[12][12] = 1e-9f; // initial gyro bias variance (rad/s)^2
+    ctx->P[0][0]   = ctx->P[1][1] = ctx->P[2][2] = 25.0f;            // initial position variance (m^2)
+    ctx->P[3][3]   = ctx->P[4][4] = ctx->P[5][5] = 5.0f;             // initial velocity variance (m/s)^2
+    ctx->P[6][6]   = ctx->P[7][7] = ctx->P[8][8] = ctx->P[9][9] = 1e-5f;  // initial quaternion variance
+    ctx->P[10][10] = ctx->P[11][11] = ctx->P[12][12] = 1e-9f; // initial gyro bias variance (rad/s)^2
 
-    ekf.X[0]  = ekf.X[1] = ekf.X[2] = ekf.X[3] = ekf.X[4] = ekf.X[5] = 0.0f; // initial pos and vel (m)
-    ekf.X[6]  = 1.0f;
-    ekf.X[7]  = ekf.X[8] = ekf.X[9] = 0.0f;      // initial quaternion (level and North) (m/s)
-    ekf.X[10] = ekf.X[11] = ekf.X[12] = 0.0f; // initial gyro bias (rad/s)
+    ctx->X[0]  = ctx->X[1] = ctx->X[2] = ctx->X[3] = ctx->X[4] = ctx->X[5] = 0.0f; // initial pos and vel (m)
+    ctx->X[6]  = 1.0f;
+    ctx->X[7]  = ctx->X[8] = ctx->X[9] = 0.0f;      // initial quaternion (level and North) (m/s)
+    ctx->X[10] = ctx->X[11] = ctx->X[12] = 0.0f; // initial gyro bias (rad/s)
 
-    ekf.Q[0]  = ekf.Q[1] = ekf.Q[2] = 50e-4f;        // gyro noise variance (rad/s)^2
-    ekf.Q[3]  = ekf.Q[4] = ekf.Q[5] = 0.00001f;      // accelerometer noise variance (m/s^2)^2
-    ekf.Q[6]  = ekf.Q[7] = ekf.Q[8] = 2e-8f;     // gyro bias random walk variance (rad/s^2)^2
+    ctx->Q[0]  = ctx->Q[1] = ctx->Q[2] = 50e-4f;        // gyro noise variance (rad/s)^2
+    ctx->Q[3]  = ctx->Q[4] = ctx->Q[5] = 0.00001f;      // accelerometer noise variance (m/s^2)^2
+    ctx->Q[6]  = ctx->Q[7] = ctx->Q[8] = 2e-8f;     // gyro bias random walk variance (rad/s^2)^2
 
-    ekf.R[0]  = ekf.R[1] = 0.004f;   // High freq GPS horizontal position noise variance (m^2)
-    ekf.R[2]  = 0.036f;          // High freq GPS vertical position noise variance (m^2)
-    ekf.R[3]  = ekf.R[4] = 0.004f;   // High freq GPS horizontal velocity noise variance (m/s)^2
-    ekf.R[5]  = 100.0f;          // High freq GPS vertical velocity noise variance (m/s)^2
-    ekf.R[6]  = ekf.R[7] = ekf.R[8] = 0.005f;    // magnetometer unit vector noise variance
-    ekf.R[9]  = .25f;                    // High freq altimeter noise variance (m^2)
+    ctx->R[0]  = ctx->R[1] = 0.004f;   // High freq GPS horizontal position noise variance (m^2)
+    ctx->R[2]  = 0.036f;          // High freq GPS vertical position noise variance (m^2)
+    ctx->R[3]  = ctx->R[4] = 0.004f;   // High freq GPS horizontal velocity noise variance (m/s)^2
+    ctx->R[5]  = 100.0f;          // High freq GPS vertical velocity noise variance (m/s)^2
+    ctx->R[6]  = ctx->R[7] = ctx->R[8] = 0.005f;    // magnetometer unit vector noise variance
+    ctx->R[9]  = .25f;                    // High freq altimeter noise variance (m^2)
+
+    memset(&ctx->Nav, 0, sizeof(ctx->Nav));
 }
 
-void INSResetP(float PDiag[NUMX])
+void INSResetPCtx(INSGPSContext *ctx, float PDiag[NUMX])
 {
     uint8_t i, j;
 
@@ -170,123 +188,123 @@ void INSResetP(float PDiag[NUMX])
     for (i = 0; i < NUMX; i++) {
         if (PDiag != 0) {
             for (j = 0; j < NUMX; j++) {
-                ekf.P[i][j] = ekf.P[j][i] = 0.0f;
+                ctx->P[i][j] = ctx->P[j][i] = 0.0f;
             }
-            ekf.P[i][i] = PDiag[i];
+            ctx->P[i][i] = PDiag[i];
         }
     }
 }
 
-void INSGetP(float PDiag[NUMX])
+void INSGetPCtx(INSGPSContext *ctx, float PDiag[NUMX])
 {
     uint8_t i;
 
     // retrieve diagonal elements (aka state variance)
     for (i = 0; i < NUMX; i++) {
         if (PDiag != 0) {
-            PDiag[i] = ekf.P[i][i];
+            PDiag[i] = ctx->P[i][i];
         }
     }
 }
 
-void INSSetState(float pos[3], float vel[3], float q[4], float gyro_bias[3], __attribute__((unused)) float accel_bias[3])
+void INSSetStateCtx(INSGPSContext *ctx, float pos[3], float vel[3], float q[4], float gyro_bias[3], __attribute__((unused)) float accel_bias[3])
 {
     /* Note: accel_bias not used in 13 state INS */
-    ekf.X[0]  = pos[0];
-    ekf.X[1]  = pos[1];
-    ekf.X[2]  = pos[2];
-    ekf.X[3]  = vel[0];
-    ekf.X[4]  = vel[1];
-    ekf.X[5]  = vel[2];
-    ekf.X[6]  = q[0];
-    ekf.X[7]  = q[1];
-    ekf.X[8]  = q[2];
-    ekf.X[9]  = q[3];
-    ekf.X[10] = gyro_bias[0];
-    ekf.X[11] = gyro_bias[1];
-    ekf.X[12] = gyro_bias[2];
+    ctx->X[0]  = pos[0];
+    ctx->X[1]  = pos[1];
+    ctx->X[2]  = pos[2];
+    ctx->X[3]  = vel[0];
+    ctx->X[4]  = vel[1];
+    ctx->X[5]  = vel[2];
+    ctx->X[6]  = q[0];
+    ctx->X[7]  = q[1];
+    ctx->X[8]  = q[2];
+    ctx->X[9]  = q[3];
+    ctx->X[10] = gyro_bias[0];
+    ctx->X[11] = gyro_bias[1];
+    ctx->X[12] = gyro_bias[2];
 }
 
-void INSPosVelReset(float pos[3], float vel[3])
+void INSPosVelResetCtx(INSGPSContext *ctx, float pos[3], float vel[3])
 {
     for (int i = 0; i < 6; i++) {
         for (int j = i; j < NUMX; j++) {
-            ekf.P[i][j] = 0; // zero the first 6 rows and columns
-            ekf.P[j][i] = 0;
+            ctx->P[i][j] = 0; // zero the first 6 rows and columns
+            ctx->P[j][i] = 0;
         }
     }
 
-    ekf.P[0][0] = ekf.P[1][1] = ekf.P[2][2] = 25; // initial position variance (m^2)
-    ekf.P[3][3] = ekf.P[4][4] = ekf.P[5][5] = 5; // initial velocity variance (m/s)^2
+    ctx->P[0][0] = ctx->P[1][1] = ctx->P[2][2] = 25; // initial position variance (m^2)
+    ctx->P[3][3] = ctx->P[4][4] = ctx->P[5][5] = 5; // initial velocity variance (m/s)^2
 
-    ekf.X[0]    = pos[0];
-    ekf.X[1]    = pos[1];
-    ekf.X[2]    = pos[2];
-    ekf.X[3]    = vel[0];
-    ekf.X[4]    = vel[1];
-    ekf.X[5]    = vel[2];
+    ctx->X[0]    = pos[0];
+    ctx->X[1]    = pos[1];
+    ctx->X[2]    = pos[2];
+    ctx->X[3]    = vel[0];
+    ctx->X[4]    = vel[1];
+    ctx->X[5]    = vel[2];
 }
 
-void INSSetPosVelVar(float PosVar[3], float VelVar[3])
+void INSSetPosVelVarCtx(INSGPSContext *ctx, float PosVar[3], float VelVar[3])
 {
-    ekf.R[0] = PosVar[0];
-    ekf.R[1] = PosVar[1];
-    ekf.R[2] = PosVar[2];
-    ekf.R[3] = VelVar[0];
-    ekf.R[4] = VelVar[1];
-    ekf.R[5] = VelVar[2];
+    ctx->R[0] = PosVar[0];
+    ctx->R[1] = PosVar[1];
+    ctx->R[2] = PosVar[2];
+    ctx->R[3] = VelVar[0];
+    ctx->R[4] = VelVar[1];
+    ctx->R[5] = VelVar[2];
 }
 
-void INSSetGyroBias(float gyro_bias[3])
+void INSSetGyroBiasCtx(INSGPSContext *ctx, float gyro_bias[3])
 {
-    ekf.X[10] = gyro_bias[0];
-    ekf.X[11] = gyro_bias[1];
-    ekf.X[12] = gyro_bias[2];
+    ctx->X[10] = gyro_bias[0];
+    ctx->X[11] = gyro_bias[1];
+    ctx->X[12] = gyro_bias[2];
 }
 
-void INSSetAccelVar(float accel_var[3])
+void INSSetAccelVarCtx(INSGPSContext *ctx, float accel_var[3])
 {
-    ekf.Q[3] = accel_var[0];
-    ekf.Q[4] = accel_var[1];
-    ekf.Q[5] = accel_var[2];
+    ctx->Q[3] = accel_var[0];
+    ctx->Q[4] = accel_var[1];
+    ctx->Q[5] = accel_var[2];
 }
 
-void INSSetGyroVar(float gyro_var[3])
+void INSSetGyroVarCtx(INSGPSContext *ctx, float gyro_var[3])
 {
-    ekf.Q[0] = gyro_var[0];
-    ekf.Q[1] = gyro_var[1];
-    ekf.Q[2] = gyro_var[2];
+    ctx->Q[0] = gyro_var[0];
+    ctx->Q[1] = gyro_var[1];
+    ctx->Q[2] = gyro_var[2];
 }
 
-void INSSetGyroBiasVar(float gyro_bias_var[3])
+void INSSetGyroBiasVarCtx(INSGPSContext *ctx, float gyro_bias_var[3])
 {
-    ekf.Q[6] = gyro_bias_var[0];
-    ekf.Q[7] = gyro_bias_var[1];
-    ekf.Q[8] = gyro_bias_var[2];
+    ctx->Q[6] = gyro_bias_var[0];
+    ctx->Q[7] = gyro_bias_var[1];
+    ctx->Q[8] = gyro_bias_var[2];
 }
 
-void INSSetMagVar(float scaled_mag_var[3])
+void INSSetMagVarCtx(INSGPSContext *ctx, float scaled_mag_var[3])
 {
-    ekf.R[6] = scaled_mag_var[0];
-    ekf.R[7] = scaled_mag_var[1];
-    ekf.R[8] = scaled_mag_var[2];
+    ctx->R[6] = scaled_mag_var[0];
+    ctx->R[7] = scaled_mag_var[1];
+    ctx->R[8] = scaled_mag_var[2];
 }
 
-void INSSetBaroVar(float baro_var)
+void INSSetBaroVarCtx(INSGPSContext *ctx, float baro_var)
 {
-    ekf.R[9] = baro_var;
+    ctx->R[9] = baro_var;
 }
 
-void INSSetMagNorth(float B[3])
+void INSSetMagNorthCtx(INSGPSContext *ctx, float B[3])
 {
     float mag = sqrtf(B[0] * B[0] + B[1] * B[1] + B[2] * B[2]);
 
-    ekf.Be[0] = B[0] / mag;
-    ekf.Be[1] = B[1] / mag;
-    ekf.Be[2] = B[2] / mag;
+    ctx->Be[0] = B[0] / mag;
+    ctx->Be[1] = B[1] / mag;
+    ctx->Be[2] = B[2] / mag;
 }
 
-void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT)
+void INSStatePredictionCtx(INSGPSContext *ctx, float gyro_data[3], float accel_data[3], float dT)
 {
     float U[6];
     float qmag;
@@ -302,34 +320,34 @@ void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT)
     U[5] = accel_data[2];
 
     // EKF prediction step
-    LinearizeFG(ekf.X, U, ekf.F, ekf.G);
-    RungeKutta(ekf.X, U, dT);
-    qmag      = sqrtf(ekf.X[6] * ekf.X[6] + ekf.X[7] * ekf.X[7] + ekf.X[8] * ekf.X[8] + ekf.X[9] * ekf.X[9]);
-    ekf.X[6] /= qmag;
-    ekf.X[7] /= qmag;
-    ekf.X[8] /= qmag;
-    ekf.X[9] /= qmag;
-    // CovariancePrediction(ekf.F,ekf.G,ekf.Q,dT,ekf.P);
+    LinearizeFG(ctx->X, U, ctx->F, ctx->G);
+    RungeKutta(ctx->X, U, dT);
+    qmag      = sqrtf(ctx->X[6] * ctx->X[6] + ctx->X[7] * ctx->X[7] + ctx->X[8] * ctx->X[8] + ctx->X[9] * ctx->X[9]);
+    ctx->X[6] /= qmag;
+    ctx->X[7] /= qmag;
+    ctx->X[8] /= qmag;
+    ctx->X[9] /= qmag;
+    // CovariancePrediction(ctx->F,ctx->G,ctx->Q,dT,ctx->P);
 
     // Update Nav solution structure
-    Nav.Pos[0] = ekf.X[0];
-    Nav.Pos[1] = ekf.X[1];
-    Nav.Pos[2] = ekf.X[2];
-    Nav.Vel[0] = ekf.X[3];
-    Nav.Vel[1] = ekf.X[4];
-    Nav.Vel[2] = ekf.X[5];
-    Nav.q[0]   = ekf.X[6];
-    Nav.q[1]   = ekf.X[7];
-    Nav.q[2]   = ekf.X[8];
-    Nav.q[3]   = ekf.X[9];
-    Nav.gyro_bias[0] = ekf.X[10];
-    Nav.gyro_bias[1] = ekf.X[11];
-    Nav.gyro_bias[2] = ekf.X[12];
+    ctx->Nav.Pos[0] = ctx->X[0];
+    ctx->Nav.Pos[1] = ctx->X[1];
+    ctx->Nav.Pos[2] = ctx->X[2];
+    ctx->Nav.Vel[0] = ctx->X[3];
+    ctx->Nav.Vel[1] = ctx->X[4];
+    ctx->Nav.Vel[2] = ctx->X[5];
+    ctx->Nav.q[0]   = ctx->X[6];
+    ctx->Nav.q[1]   = ctx->X[7];
+    ctx->Nav.q[2]   = ctx->X[8];
+    ctx->Nav.q[3]   = ctx->X[9];
+    ctx->Nav.gyro_bias[0] = ctx->X[10];
+    ctx->Nav.gyro_bias[1] = ctx->X[11];
+    ctx->Nav.gyro_bias[2] = ctx->X[12];
 }
 
-void INSCovariancePrediction(float dT)
+void INSCovariancePredictionCtx(INSGPSContext *ctx, float dT)
 {
-    CovariancePrediction(ekf.F, ekf.G, ekf.Q, dT, ekf.P);
+    CovariancePrediction(ctx->F, ctx->G, ctx->Q, dT, ctx->P);
 }
 
 float zeros[3] = { 0, 0, 0 };
@@ -370,7 +388,7 @@ void VelBaroCorrection(float Vel[3], float BaroAlt)
                   HORIZ_SENSORS | VERT_SENSORS | BARO_SENSOR);
 }
 
-void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
+void INSCorrectionCtx(INSGPSContext *ctx, float mag_data[3], float Pos[3], float Vel[3],
                    float BaroAlt, uint16_t SensorsUsed)
 {
     float Z[10], Y[10];
@@ -398,29 +416,115 @@ void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
     Z[9] = BaroAlt;
 
     // EKF correction step
-    LinearizeH(ekf.X, ekf.Be, ekf.H);
-    MeasurementEq(ekf.X, ekf.Be, Y);
-    SerialUpdate(ekf.H, ekf.R, Z, Y, ekf.P, ekf.X, SensorsUsed);
-    qmag       = sqrtf(ekf.X[6] * ekf.X[6] + ekf.X[7] * ekf.X[7] + ekf.X[8] * ekf.X[8] + ekf.X[9] * ekf.X[9]);
-    ekf.X[6]  /= qmag;
-    ekf.X[7]  /= qmag;
-    ekf.X[8]  /= qmag;
-    ekf.X[9]  /= qmag;
+    LinearizeH(ctx->X, ctx->Be, ctx->H);
+    MeasurementEq(ctx->X, ctx->Be, Y);
+    SerialUpdate(ctx->H, ctx->R, Z, Y, ctx->P, ctx->X, SensorsUsed);
+    qmag       = sqrtf(ctx->X[6] * ctx->X[6] + ctx->X[7] * ctx->X[7] + ctx->X[8] * ctx->X[8] + ctx->X[9] * ctx->X[9]);
+    ctx->X[6]  /= qmag;
+    ctx->X[7]  /= qmag;
+    ctx->X[8]  /= qmag;
+    ctx->X[9]  /= qmag;
 
     // Update Nav solution structure
-    Nav.Pos[0] = ekf.X[0];
-    Nav.Pos[1] = ekf.X[1];
-    Nav.Pos[2] = ekf.X[2];
-    Nav.Vel[0] = ekf.X[3];
-    Nav.Vel[1] = ekf.X[4];
-    Nav.Vel[2] = ekf.X[5];
-    Nav.q[0]   = ekf.X[6];
-    Nav.q[1]   = ekf.X[7];
-    Nav.q[2]   = ekf.X[8];
-    Nav.q[3]   = ekf.X[9];
-    Nav.gyro_bias[0] = ekf.X[10];
-    Nav.gyro_bias[1] = ekf.X[11];
-    Nav.gyro_bias[2] = ekf.X[12];
+    ctx->Nav.Pos[0] = ctx->X[0];
+    ctx->Nav.Pos[1] = ctx->X[1];
+    ctx->Nav.Pos[2] = ctx->X[2];
+    ctx->Nav.Vel[0] = ctx->X[3];
+    ctx->Nav.Vel[1] = ctx->X[4];
+    ctx->Nav.Vel[2] = ctx->X[5];
+    ctx->Nav.q[0]   = ctx->X[6];
+    ctx->Nav.q[1]   = ctx->X[7];
+    ctx->Nav.q[2]   = ctx->X[8];
+    ctx->Nav.q[3]   = ctx->X[9];
+    ctx->Nav.gyro_bias[0] = ctx->X[10];
+    ctx->Nav.gyro_bias[1] = ctx->X[11];
+    ctx->Nav.gyro_bias[2] = ctx->X[12];
+}
+
+// *************  Default Filter ****************
+// *************************************************
+
+void INSGPSInit()
+{
+    INSGPSInitCtx(&ekf);
+}
+
+void INSResetP(float PDiag[NUMX])
+{
+    INSResetPCtx(&ekf, PDiag);
+}
+
+void INSGetP(float PDiag[NUMX])
+{
+    INSGetPCtx(&ekf, PDiag);
+}
+
+void INSSetState(float pos[3], float vel[3], float q[4], float gyro_bias[3], float accel_bias[3])
+{
+    INSSetStateCtx(&ekf, pos, vel, q, gyro_bias, accel_bias);
+}
+
+void INSPosVelReset(float pos[3], float vel[3])
+{
+    INSPosVelResetCtx(&ekf, pos, vel);
+}
+
+void INSSetPosVelVar(float PosVar[3], float VelVar[3])
+{
+    INSSetPosVelVarCtx(&ekf, PosVar, VelVar);
+}
+
+void INSSetGyroBias(float gyro_bias[3])
+{
+    INSSetGyroBiasCtx(&ekf, gyro_bias);
+}
+
+void INSSetAccelVar(float accel_var[3])
+{
+    INSSetAccelVarCtx(&ekf, accel_var);
+}
+
+void INSSetGyroVar(float gyro_var[3])
+{
+    INSSetGyroVarCtx(&ekf, gyro_var);
+}
+
+void INSSetGyroBiasVar(float gyro_bias_var[3])
+{
+    INSSetGyroBiasVarCtx(&ekf, gyro_bias_var);
+}
+
+void INSSetMagVar(float scaled_mag_var[3])
+{
+    INSSetMagVarCtx(&ekf, scaled_mag_var);
+}
+
+void INSSetBaroVar(float baro_var)
+{
+    INSSetBaroVarCtx(&ekf, baro_var);
+}
+
+void INSSetMagNorth(float B[3])
+{
+    INSSetMagNorthCtx(&ekf, B);
+}
+
+void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT)
+{
+    INSStatePredictionCtx(&ekf, gyro_data, accel_data, dT);
+    Nav = ekf.Nav;
+}
+
+void INSCovariancePrediction(float dT)
+{
+    INSCovariancePredictionCtx(&ekf, dT);
+}
+
+void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
+                   float BaroAlt, uint16_t SensorsUsed)
+{
+    INSCorrectionCtx(&ekf, mag_data, Pos, Vel, BaroAlt, SensorsUsed);
+    Nav = ekf.Nav;
 }
 
 // *************  CovariancePrediction *************
@@ -430,68 +534,66 @@ void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
 // Q is the discrete time covariance of process noise
 // Q is vector of the diagonal for a square matrix with
 // dimensions equal to the number of disturbance noise variables
-// The General Method is very inefficient,not taking advantage of the sparse F and G
-// The first Method is very specific to this implementation
+// With A = I+F*T and P symmetric, A*P*A' = A*(A*P)', so both products are
+// sums of rows scaled by the few entries of F: unit stride loops the compiler
+// can vectorize, and no divisions. Only the upper triangular of the second
+// product is formed, which keeps the operation count of the element-wise
+// version.
 // ************************************************
 
+// y += a*x over n elements of a row
+__attribute__((optimize("O3")))
+static inline void RowAxpy(float *restrict y, float a, const float *restrict x, int8_t n)
+{
+    int8_t j;
+
+    for (j = 0; j < n; j++) {
+        y[j] += a * x[j];
+    }
+}
+
 __attribute__((optimize("O3")))
 void CovariancePrediction(float F[NUMX][NUMX], float G[NUMX][NUMW],
                           float Q[NUMW], float dT, float P[NUMX][NUMX])
 {
-    // Pnew = (I+F*T)*P*(I+F*T)' + (T^2)*G*Q*G' = (T^2)[(P/T + F*P)*(I/T + F') + G*Q*G')]
-
-    float dT1  = 1.0f / dT; // multiplication is faster than division on fpu.
     float dTsq = dT * dT;
 
-    float Dummy[NUMX][NUMX];
-    int8_t i;
+    float AP[NUMX][NUMX];
+    int8_t i, j, k;
 
-    for (i = 0; i < NUMX; i++) { // Calculate Dummy = (P/T +F*P)
-        float *Firow   = F[i];
-        float *Pirow   = P[i];
-        float *Dirow   = Dummy[i];
-        int8_t Fistart = FrowMin[i];
-        int8_t Fiend   = FrowMax[i];
-        int8_t j;
-        for (j = 0; j < NUMX; j++) {
-            Dirow[j] = Pirow[j] * dT1; // Dummy = P / T ...
-            int8_t k;
-            for (k = Fistart; k <= Fiend; k++) {
-                Dirow[j] += Firow[k] * P[k][j]; // [] + F * P
-            }
+    for (i = 0; i < NUMX; i++) { // Calculate AP = P + T*F*P
+        memcpy(AP[i], P[i], sizeof(AP[i]));
+        for (k = FrowMin[i]; k <= FrowMax[i]; k++) {
+            RowAxpy(AP[i], dT * F[i][k], P[k], NUMX);
         }
     }
-    for (i = 0; i < NUMX; i++) { // Calculate Pnew = (T^2) [Dummy/T + Dummy*F' + G*Qw*G']
-        float *Dirow   = Dummy[i];
+    for (i = 0; i < NUMX; i++) { // Transpose in place, AP' = P*A'
+        for (j = i + 1; j < NUMX; j++) {
+            float tmp = AP[i][j];
+            AP[i][j] = AP[j][i];
+            AP[j][i] = tmp;
+        }
+    }
+    for (i = 0; i < NUMX; i++) { // Calculate Pnew = AP' + T*F*AP', upper triangular only
+        memcpy(&P[i][i], &AP[i][i], (NUMX - i) * sizeof(P[i][i]));
+        for (k = FrowMin[i]; k <= FrowMax[i]; k++) {
+            RowAxpy(&P[i][i], dT * F[i][k], &AP[k][i], NUMX - i);
+        }
+    }
+    for (i = 0; i < NUMX; i++) { // Add (T^2)*G*Q*G' and mirror the upper triangular
         float *Girow   = G[i];
         float *Pirow   = P[i];
         int8_t Gistart = GrowMin[i];
         int8_t Giend   = GrowMax[i];
-        int8_t j;
-        for (j = i; j < NUMX; j++) { // Use symmetry, ie only find upper triangular
-            float Ptmp = Dirow[j] * dT1; // Pnew = Dummy / T ...
-
-            {
-                float *Fjrow   = F[j];
-                int8_t Fjstart = FrowMin[j];
-                int8_t Fjend   = FrowMax[j];
-                int8_t k;
-                for (k = Fjstart; k <= Fjend; k++) {
-                    Ptmp += Dirow[k] * Fjrow[k]; // [] + Dummy*F' ...
-                }
+        for (j = i; j < NUMX; j++) {
+            float *Gjrow   = G[j];
+            int8_t Gjstart = MAX(Gistart, GrowMin[j]);
+            int8_t Gjend   = MIN(Giend, GrowMax[j]);
+            float GQG = 0.0f;
+            for (k = Gjstart; k <= Gjend; k++) {
+                GQG += Q[k] * Girow[k] * Gjrow[k];
             }
-
-            {
-                float *Gjrow   = G[j];
-                int8_t Gjstart = MAX(Gistart, GrowMin[j]);
-                int8_t Gjend   = MIN(Giend, GrowMax[j]);
-                int8_t k;
-                for (k = Gjstart; k <= Gjend; k++) {
-                    Ptmp += Q[k] * Girow[k] * Gjrow[k]; // [] + G*Q*G' ...
-                }
-            }
-
-            P[j][i] = Pirow[j] = Ptmp * dTsq; // [] * (T^2)
+            P[j][i] = Pirow[j] = Pirow[j] + GQG * dTsq;
         }
     }
 }
@@ -506,12 +608,14 @@ void CovariancePrediction(float F[NUMX][NUMX], float G[NUMX][NUMW],
 // i.e. the measurment noises are uncorrelated.
 // It therefore uses a serial update that requires no matrix inversion by
 // processing the measurements one at a time.
+// P is updated a row of its upper triangular at a time, then mirrored.
 // Algorithm - see Grewal and Andrews, "Kalman Filtering,2nd Ed" p.121 & p.253
 // - or see Simon, "Optimal State Estimation," 1st Ed, p.150
 // The SensorsUsed variable is a bitwise mask indicating which sensors
 // should be used in the update.
 // ************************************************
 
+__attribute__((optimize("O3")))
 void SerialUpdate(float H[NUMV][NUMX], float R[NUMV], float Z[NUMV],
                   float Y[NUMV], float P[NUMX][NUMX], float X[NUMX],
                   uint16_t SensorsUsed)
@@ -522,24 +626,25 @@ void SerialUpdate(float H[NUMV][NUMX], float R[NUMV], float Z[NUMV],
 
     for (m = 0; m < NUMV; m++) {
         if (SensorsUsed & (0x01 << m)) { // use this sensor for update
-            for (j = 0; j < NUMX; j++) { // Find Hp = H*P
-                HP[j] = 0;
-                for (k = HrowMin[m]; k <= HrowMax[m]; k++) {
-                    HP[j] += H[m][k] * P[k][j];
-                }
+            memset(HP, 0, sizeof(HP)); // Find Hp = H*P
+            for (k = HrowMin[m]; k <= HrowMax[m]; k++) {
+                RowAxpy(HP, H[m][k], P[k], NUMX);
             }
             HPHR = R[m]; // Find  HPHR = H*P*H' + R
             for (k = HrowMin[m]; k <= HrowMax[m]; k++) {
                 HPHR += HP[k] * H[m][k];
             }
 
+            float HPHR1 = 1.0f / HPHR;
             for (k = 0; k < NUMX; k++) {
-                Km[k] = HP[k] / HPHR; // find K = HP/HPHR
+                Km[k] = HP[k] * HPHR1; // find K = HP/HPHR
+            }
+            for (i = 0; i < NUMX; i++) { // Find P(m)= P(m-1) - K*HP, upper triangular
+                RowAxpy(&P[i][i], -Km[i], &HP[i], NUMX - i);
             }
-            for (i = 0; i < NUMX; i++) { // Find P(m)= P(m-1) + K*HP
-                for (j = i; j < NUMX; j++) {
-                    P[i][j] = P[j][i] =
-                                  P[i][j] - Km[i] * HP[j];
+            for (i = 0; i < NUMX; i++) { // and mirror it
+                for (j = i + 1; j < NUMX; j++) {
+                    P[j][i] = P[i][j];
                 }
             }
 
@@ -32,6 +32,7 @@
 #include "insgps.h"
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 
 // constants/macros/typdefs
 #define NUMX 16 // number of states, X is the state vector
@@ -59,12 +60,19 @@ void MeasurementEq(float X[NUMX], float Be[3], float Y[NUMV]);
 void LinearizeH(float X[NUMX], float Be[3], float H[NUMV][NUMX]);
 
 // Private variables
-float F[NUMX][NUMX], G[NUMX][NUMW], H[NUMV][NUMX]; // linearized system matrices
-// global to init to zero and maintain zero elements
-float Be[3]; // local magnetic unit vector in NED frame
-float P[NUMX][NUMX], X[NUMX]; // covariance matrix and state vector
-float Q[NUMW], R[NUMV]; // input noise and measurement noise variances
-float K[NUMX][NUMV]; // feedback gain matrix
+struct INSGPSContext {
+    float F[NUMX][NUMX], G[NUMX][NUMW], H[NUMV][NUMX]; // linearized system matrices
+    float Be[3]; // local magnetic unit vector in NED frame
+    float P[NUMX][NUMX], X[NUMX]; // covariance matrix and state vector
+    float Q[NUMW], R[NUMV]; // input noise and measurement noise variances
+    struct NavStruct Nav; // current solution
+};
+
+// The filter used by the functions without a context, static to init to zero and maintain zero elements
+static INSGPSContext ekf;
+
+// Global variables
+struct NavStruct Nav;
 
 // *************  Exposed Functions ****************
 // *************************************************
@@ -74,42 +82,54 @@ uint16_t ins_get_num_states()
     return NUMX;
 }
 
-void INSGPSInit() // pretty much just a place holder for now
+uint32_t INSGPSContextSize()
+{
+    return sizeof(INSGPSContext);
+}
+
+const struct NavStruct *INSGetNavCtx(const INSGPSContext *ctx)
 {
-    Be[0] = 1.0f;
-    Be[1] = 0;
-    Be[2] = 0; // local magnetic unit vector
+    return &ctx->Nav;
+}
+
+void INSGPSInitCtx(INSGPSContext *ctx) // pretty much just a place holder for now
+{
+    memset(ctx, 0, sizeof(*ctx)); // zero elements of F, G and H are never set again
+
+    ctx->Be[0] = 1.0f;
+    ctx->Be[1] = 0;
+    ctx->Be[2] = 0; // local magnetic unit vector
 
     for (int i = 0; i < NUMX; i++) {
         for (int j = 0; j < NUMX; j++) {
-            P[i][j] = 0.0f; // zero all terms
+            ctx->P[i][j] = 0.0f; // zero all terms
         }
     }
 
-    P[0][0]   = P[1][1] = P[2][2] = 25.0f;    // initial position variance (m^2)
-    P[3][3]   = P[4][4] = P[5][5] = 5.0f;     // initial velocity variance (m/s)^2
-    P[6][6]   = P[7][7] = P[8][8] = P[9][9] = 1e-5f;  // initial quaternion variance
-    P[10][10] = P[11][11] = P[12][12] = 1e-5f; // initial gyro bias variance (rad/s)^2
-
-    X[0]  = X[1] = X[2] = X[3] = X[4] = X[5] = 0.0f; // initial pos and vel (m)
-    X[6]  = 1.0f;
-    X[7]  = X[8] = X[9] = 0.0f;      // initial quaternion (level and North) (m/s)
-    X[10] = X[11] = X[12] = 0.0f; // initial gyro bias (rad/s)
-
-    Q[0]  = Q[1] = Q[2] = 50e-8f;    // gyro noise variance (rad/s)^2
-    Q[3]  = Q[4] = Q[5] = 0.01f;     // accelerometer noise variance (m/s^2)^2
-    Q[6]  = Q[7] = Q[8] = 2e-9f;     // gyro bias random walk variance (rad/s^2)^2
-    Q[9]  = Q[10] = Q[11] = 2e-20f;  // accel bias random walk variance (m/s^3)^2
-
-    R[0]  = R[1] = 0.004f;   // High freq GPS horizontal position noise variance (m^2)
-    R[2]  = 0.036f;          // High freq GPS vertical position noise variance (m^2)
-    R[3]  = R[4] = 0.004f;   // High freq GPS horizontal velocity noise variance (m/s)^2
-    R[5]  = 100.0f;          // High freq GPS vertical velocity noise variance (m/s)^2
-    R[6]  = R[7] = R[8] = 0.005f;    // magnetometer unit vector noise variance
-    R[9]  = .05f;            // High freq altimeter noise variance (m^2)
+    ctx->P[0][0]   = ctx->P[1][1] = ctx->P[2][2] = 25.0f;    // initial position variance (m^2)
+    ctx->P[3][3]   = ctx->P[4][4] = ctx->P[5][5] = 5.0f;     // initial velocity variance (m/s)^2
+    ctx->P[6][6]   = ctx->P[7][7] = ctx->P[8][8] = ctx->P[9][9] = 1e-5f;  // initial quaternion variance
+    ctx->P[10][10] = ctx->P[11][11] = ctx->P[12][12] = 1e-5f; // initial gyro bias variance (rad/s)^2
+
+    ctx->X[0]  = ctx->X[1] = ctx->X[2] = ctx->X[3] = ctx->X[4] = ctx->X[5] = 0.0f; // initial pos and vel (m)
+    ctx->X[6]  = 1.0f;
+    ctx->X[7]  = ctx->X[8] = ctx->X[9] = 0.0f;      // initial quaternion (level and North) (m/s)
+    ctx->X[10] = ctx->X[11] = ctx->X[12] = 0.0f; // initial gyro bias (rad/s)
+
+    ctx->Q[0]  = ctx->Q[1] = ctx->Q[2] = 50e-8f;    // gyro noise variance (rad/s)^2
+    ctx->Q[3]  = ctx->Q[4] = ctx->Q[5] = 0.01f;     // accelerometer noise variance (m/s^2)^2
+    ctx->Q[6]  = ctx->Q[7] = ctx->Q[8] = 2e-9f;     // gyro bias random walk variance (rad/s^2)^2
+    ctx->Q[9]  = ctx->Q[10] = ctx->Q[11] = 2e-20f;  // accel bias random walk variance (m/s^3)^2
+
+    ctx->R[0]  = ctx->R[1] = 0.004f;   // High freq GPS horizontal position noise variance (m^2)
+    ctx->R[2]  = 0.036f;          // High freq GPS vertical position noise variance (m^2)
+    ctx->R[3]  = ctx->R[4] = 0.004f;   // High freq GPS horizontal velocity noise variance (m/s)^2
+    ctx->R[5]  = 100.0f;          // High freq GPS vertical velocity noise variance (m/s)^2
+    ctx->R[6]  = ctx->R[7] = ctx->R[8] = 0.005f;    // magnetometer unit vector noise variance
+    ctx->R[9]  = .05f;            // High freq altimeter noise variance (m^2)
 }
 
-void INSResetP(float PDiag[NUMX])
+void INSResetPCtx(INSGPSContext *ctx, float PDiag[NUMX])
 {
     uint8_t i, j;
 
@@ -117,99 +137,99 @@ void INSResetP(float PDiag[NUMX])
     for (i = 0; i < NUMX; i++) {
         if (PDiag != 0) {
             for (j = 0; j < NUMX; j++) {
-                P[i][j] = P[j][i] = 0.0f;
+                ctx->P[i][j] = ctx->P[j][i] = 0.0f;
             }
-            P[i][i] = PDiag[i];
+            ctx->P[i][i] = PDiag[i];
         }
     }
 }
 
-void INSSetState(float pos[3], float vel[3], float q[4], float gyro_bias[3], float accel_bias[3])
+void INSSetStateCtx(INSGPSContext *ctx, float pos[3], float vel[3], float q[4], float gyro_bias[3], float accel_bias[3])
 {
-    Nav.Pos[0] = X[0] = pos[0];
-    Nav.Pos[1] = X[1] = pos[1];
-    Nav.Pos[2] = X[2] = pos[2];
-    Nav.Vel[0] = X[3] = vel[0];
-    Nav.Vel[1] = X[4] = vel[1];
-    Nav.Vel[2] = X[5] = vel[2];
-    Nav.q[0]   = X[6] = q[0];
-    Nav.q[1]   = X[7] = q[1];
-    Nav.q[2]   = X[8] = q[2];
-    Nav.q[3]   = X[9] = q[3];
-    Nav.gyro_bias[0]  = X[10] = gyro_bias[0];
-    Nav.gyro_bias[1]  = X[11] = gyro_bias[1];
-    Nav.gyro_bias[2]  = X[12] = gyro_bias[2];
-    Nav.accel_bias[0] = X[13] = accel_bias[0];
-    Nav.accel_bias[1] = X[14] = accel_bias[1];
-    Nav.accel_bias[2] = X[15] = accel_bias[2];
+    ctx->Nav.Pos[0] = ctx->X[0] = pos[0];
+    ctx->Nav.Pos[1] = ctx->X[1] = pos[1];
+    ctx->Nav.Pos[2] = ctx->X[2] = pos[2];
+    ctx->Nav.Vel[0] = ctx->X[3] = vel[0];
+    ctx->Nav.Vel[1] = ctx->X[4] = vel[1];
+    ctx->Nav.Vel[2] = ctx->X[5] = vel[2];
+    ctx->Nav.q[0]   = ctx->X[6] = q[0];
+    ctx->Nav.q[1]   = ctx->X[7] = q[1];
+    ctx->Nav.q[2]   = ctx->X[8] = q[2];
+    ctx->Nav.q[3]   = ctx->X[9] = q[3];
+    ctx->Nav.gyro_bias[0]  = ctx->X[10] = gyro_bias[0];
+    ctx->Nav.gyro_bias[1]  = ctx->X[11] = gyro_bias[1];
+    ctx->Nav.gyro_bias[2]  = ctx->X[12] = gyro_bias[2];
+    ctx->Nav.accel_bias[0] = ctx->X[13] = accel_bias[0];
+    ctx->Nav.accel_bias[1] = ctx->X[14] = accel_bias[1];
+    ctx->Nav.accel_bias[2] = ctx->X[15] = accel_bias[2];
 }
 
-void INSPosVelReset(float pos[3], float vel[3])
+void INSPosVelResetCtx(INSGPSContext *ctx, float pos[3], float vel[3])
 {
     for (int i = 0; i < 6; i++) {
         for (int j = i; j < NUMX; j++) {
-            P[i][j] = 0.0f; // zero the first 6 rows and columns
-            P[j][i] = 0.0f;
+            ctx->P[i][j] = 0.0f; // zero the first 6 rows and columns
+            ctx->P[j][i] = 0.0f;
         }
     }
 
-    P[0][0] = P[1][1] = P[2][2] = 25.0f; // initial position variance (m^2)
-    P[3][3] = P[4][4] = P[5][5] = 5.0f; // initial velocity variance (m/s)^2
+    ctx->P[0][0] = ctx->P[1][1] = ctx->P[2][2] = 25.0f; // initial position variance (m^2)
+    ctx->P[3][3] = ctx->P[4][4] = ctx->P[5][5] = 5.0f; // initial velocity variance (m/s)^2
 
-    X[0]    = pos[0];
-    X[1]    = pos[1];
-    X[2]    = pos[2];
-    X[3]    = vel[0];
-    X[4]    = vel[1];
-    X[5]    = vel[2];
+    ctx->X[0]    = pos[0];
+    ctx->X[1]    = pos[1];
+    ctx->X[2]    = pos[2];
+    ctx->X[3]    = vel[0];
+    ctx->X[4]    = vel[1];
+    ctx->X[5]    = vel[2];
 }
 
-void INSSetPosVelVar(float PosVar, float VelVar)
+void INSSetPosVelVarCtx(INSGPSContext *ctx, float PosVar[3], float VelVar[3])
 {
-    R[0] = PosVar;
-    R[1] = PosVar;
-    R[2] = PosVar;
-    R[3] = VelVar;
-    R[4] = VelVar;
-    R[5] = PosVar; // Don't change vertical velocity, not measured
+    ctx->R[0] = PosVar[0];
+    ctx->R[1] = PosVar[1];
+    ctx->R[2] = PosVar[2];
+    ctx->R[3] = VelVar[0];
+    ctx->R[4] = VelVar[1];
+    ctx->R[5] = VelVar[2];
 }
 
-void INSSetGyroBias(float gyro_bias[3])
+void INSSetGyroBiasCtx(INSGPSContext *ctx, float gyro_bias[3])
 {
-    X[10] = gyro_bias[0];
-    X[11] = gyro_bias[1];
-    X[12] = gyro_bias[2];
+    ctx->X[10] = gyro_bias[0];
+    ctx->X[11] = gyro_bias[1];
+    ctx->X[12] = gyro_bias[2];
 }
 
-void INSSetAccelVar(float accel_var[3])
+void INSSetAccelVarCtx(INSGPSContext *ctx, float accel_var[3])
 {
-    Q[3] = accel_var[0];
-    Q[4] = accel_var[1];
-    Q[5] = accel_var[2];
+    ctx->Q[3] = accel_var[0];
+    ctx->Q[4] = accel_var[1];
+    ctx->Q[5] = accel_var[2];
 }
 
-void INSSetGyroVar(float gyro_var[3])
+void INSSetGyroVarCtx(INSGPSContext *ctx, float gyro_var[3])
 {
-    Q[0] = gyro_var[0];
-    Q[1] = gyro_var[1];
-    Q[2] = gyro_var[2];
+    ctx->Q[0] = gyro_var[0];
+    ctx->Q[1] = gyro_var[1];
+    ctx->Q[2] = gyro_var[2];
 }
 
-void INSSetMagVar(float scaled_mag_var[3])
+void INSSetMagVarCtx(INSGPSContext *ctx, float scaled_mag_var[3])
 {
-    R[6] = scaled_mag_var[0];
-    R[7] = scaled_mag_var[1];
-    R[8] = scaled_mag_var[2];
+    ctx->R[6] = scaled_mag_var[0];
+    ctx->R[7] = scaled_mag_var[1];
+    ctx->R[8] = scaled_mag_var[2];
 }
 
-void INSSetMagNorth(float B[3])
+void INSSetMagNorthCtx(INSGPSContext *ctx, float B[3])
 {
-    Be[0] = B[0];
-    Be[1] = B[1];
-    Be[2] = B[2];
+    ctx->Be[0] = B[0];
+    ctx->Be[1] = B[1];
+    ctx->Be[2] = B[2];
 }
 
-void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT)
+void INSStatePredictionCtx(INSGPSContext *ctx, float gyro_data[3], float accel_data[3], float dT)
 {
     float U[6];
     float qmag;
@@ -225,34 +245,34 @@ void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT)
     U[5] = accel_data[2];
 
     // EKF prediction step
-    LinearizeFG(X, U, F, G);
-    RungeKutta(X, U, dT);
-    qmag  = sqrt(X[6] * X[6] + X[7] * X[7] + X[8] * X[8] + X[9] * X[9]);
-    X[6] /= qmag;
-    X[7] /= qmag;
-    X[8] /= qmag;
-    X[9] /= qmag;
-    // CovariancePrediction(F,G,Q,dT,P);
+    LinearizeFG(ctx->X, U, ctx->F, ctx->G);
+    RungeKutta(ctx->X, U, dT);
+    qmag  = sqrt(ctx->X[6] * ctx->X[6] + ctx->X[7] * ctx->X[7] + ctx->X[8] * ctx->X[8] + ctx->X[9] * ctx->X[9]);
+    ctx->X[6] /= qmag;
+    ctx->X[7] /= qmag;
+    ctx->X[8] /= qmag;
+    ctx->X[9] /= qmag;
+    // CovariancePrediction(ctx->F,ctx->G,ctx->Q,dT,ctx->P);
 
     // Update Nav solution structure
-    Nav.Pos[0] = X[0];
-    Nav.Pos[1] = X[1];
-    Nav.Pos[2] = X[2];
-    Nav.Vel[0] = X[3];
-    Nav.Vel[1] = X[4];
-    Nav.Vel[2] = X[5];
-    Nav.q[0]   = X[6];
-    Nav.q[1]   = X[7];
-    Nav.q[2]   = X[8];
-    Nav.q[3]   = X[9];
-    Nav.gyro_bias[0] = X[10];
-    Nav.gyro_bias[1] = X[11];
-    Nav.gyro_bias[2] = X[12];
+    ctx->Nav.Pos[0] = ctx->X[0];
+    ctx->Nav.Pos[1] = ctx->X[1];
+    ctx->Nav.Pos[2] = ctx->X[2];
+    ctx->Nav.Vel[0] = ctx->X[3];
+    ctx->Nav.Vel[1] = ctx->X[4];
+    ctx->Nav.Vel[2] = ctx->X[5];
+    ctx->Nav.q[0]   = ctx->X[6];
+    ctx->Nav.q[1]   = ctx->X[7];
+    ctx->Nav.q[2]   = ctx->X[8];
+    ctx->Nav.q[3]   = ctx->X[9];
+    ctx->Nav.gyro_bias[0] = ctx->X[10];
+    ctx->Nav.gyro_bias[1] = ctx->X[11];
+    ctx->Nav.gyro_bias[2] = ctx->X[12];
 }
 
-void INSCovariancePrediction(float dT)
+void INSCovariancePredictionCtx(INSGPSContext *ctx, float dT)
 {
-    CovariancePrediction(F, G, Q, dT, P);
+    CovariancePrediction(ctx->F, ctx->G, ctx->Q, dT, ctx->P);
 }
 
 float zeros[3] = { 0.0f, 0.0f, 0.0f };
@@ -293,7 +313,7 @@ void VelBaroCorrection(float Vel[3], float BaroAlt)
                   HORIZ_SENSORS | VERT_SENSORS | BARO_SENSOR);
 }
 
-void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
+void INSCorrectionCtx(INSGPSContext *ctx, float mag_data[3], float Pos[3], float Vel[3],
                    float BaroAlt, uint16_t SensorsUsed)
 {
     float Z[10], Y[10];
@@ -321,32 +341,104 @@ void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
     Z[9] = BaroAlt;
 
     // EKF correction step
-    LinearizeH(X, Be, H);
-    MeasurementEq(X, Be, Y);
-    SerialUpdate(H, R, Z, Y, P, X, SensorsUsed);
-    qmag  = sqrt(X[6] * X[6] + X[7] * X[7] + X[8] * X[8] + X[9] * X[9]);
-    X[6] /= qmag;
-    X[7] /= qmag;
-    X[8] /= qmag;
-    X[9] /= qmag;
+    LinearizeH(ctx->X, ctx->Be, ctx->H);
+    MeasurementEq(ctx->X, ctx->Be, Y);
+    SerialUpdate(ctx->H, ctx->R, Z, Y, ctx->P, ctx->X, SensorsUsed);
+    qmag  = sqrt(ctx->X[6] * ctx->X[6] + ctx->X[7] * ctx->X[7] + ctx->X[8] * ctx->X[8] + ctx->X[9] * ctx->X[9]);
+    ctx->X[6] /= qmag;
+    ctx->X[7] /= qmag;
+    ctx->X[8] /= qmag;
+    ctx->X[9] /= qmag;
 
     // Update Nav solution structure
-    Nav.Pos[0] = X[0];
-    Nav.Pos[1] = X[1];
-    Nav.Pos[2] = X[2];
-    Nav.Vel[0] = X[3];
-    Nav.Vel[1] = X[4];
-    Nav.Vel[2] = X[5];
-    Nav.q[0]   = X[6];
-    Nav.q[1]   = X[7];
-    Nav.q[2]   = X[8];
-    Nav.q[3]   = X[9];
-    Nav.gyro_bias[0]  = X[10];
-    Nav.gyro_bias[1]  = X[11];
-    Nav.gyro_bias[2]  = X[12];
-    Nav.accel_bias[0] = X[13];
-    Nav.accel_bias[1] = X[14];
-    Nav.accel_bias[2] = X[15];
+    ctx->Nav.Pos[0] = ctx->X[0];
+    ctx->Nav.Pos[1] = ctx->X[1];
+    ctx->Nav.Pos[2] = ctx->X[2];
+    ctx->Nav.Vel[0] = ctx->X[3];
+    ctx->Nav.Vel[1] = ctx->X[4];
+    ctx->Nav.Vel[2] = ctx->X[5];
+    ctx->Nav.q[0]   = ctx->X[6];
+    ctx->Nav.q[1]   = ctx->X[7];
+    ctx->Nav.q[2]   = ctx->X[8];
+    ctx->Nav.q[3]   = ctx->X[9];
+    ctx->Nav.gyro_bias[0]  = ctx->X[10];
+    ctx->Nav.gyro_bias[1]  = ctx->X[11];
+    ctx->Nav.gyro_bias[2]  = ctx->X[12];
+    ctx->Nav.accel_bias[0] = ctx->X[13];
+    ctx->Nav.accel_bias[1] = ctx->X[14];
+    ctx->Nav.accel_bias[2] = ctx->X[15];
+}
+
+// *************  Default Filter ****************
+// *************************************************
+
+void INSGPSInit()
+{
+    INSGPSInitCtx(&ekf);
+}
+
+void INSResetP(float PDiag[NUMX])
+{
+    INSResetPCtx(&ekf, PDiag);
+}
+
+void INSSetState(float pos[3], float vel[3], float q[4], float gyro_bias[3], float accel_bias[3])
+{
+    INSSetStateCtx(&ekf, pos, vel, q, gyro_bias, accel_bias);
+    Nav = ekf.Nav;
+}
+
+void INSPosVelReset(float pos[3], float vel[3])
+{
+    INSPosVelResetCtx(&ekf, pos, vel);
+}
+
+void INSSetPosVelVar(float PosVar[3], float VelVar[3])
+{
+    INSSetPosVelVarCtx(&ekf, PosVar, VelVar);
+}
+
+void INSSetGyroBias(float gyro_bias[3])
+{
+    INSSetGyroBiasCtx(&ekf, gyro_bias);
+}
+
+void INSSetAccelVar(float accel_var[3])
+{
+    INSSetAccelVarCtx(&ekf, accel_var);
+}
+
+void INSSetGyroVar(float gyro_var[3])
+{
+    INSSetGyroVarCtx(&ekf, gyro_var);
+}
+
+void INSSetMagVar(float scaled_mag_var[3])
+{
+    INSSetMagVarCtx(&ekf, scaled_mag_var);
+}
+
+void INSSetMagNorth(float B[3])
+{
+    INSSetMagNorthCtx(&ekf, B);
+}
+
+void INSStatePrediction(float gyro_data[3], float accel_data[3], float dT)
+{
+    INSStatePredictionCtx(&ekf, gyro_data, accel_data, dT);
+    Nav = ekf.Nav;
+}
+
+void INSCovariancePrediction(float dT)
+{
+    INSCovariancePredictionCtx(&ekf, dT);
+}
+
+void INSCorrection(float mag_data[3], float Pos[3], float Vel[3],
+                   float BaroAlt, uint16_t SensorsUsed)
+{
+    INSCorrectionCtx(&ekf, mag_data, Pos, Vel, BaroAlt, SensorsUsed);
+    Nav = ekf.Nav;
 }
 
 // *************  CovariancePrediction *************
@@ -575,6 +667,7 @@ void SerialUpdate(float H[NUMV][NUMX], float R[NUMV], float Z[NUMV],
 {
     float HP[NUMX], HPHR, Error;
     uint8_t i, j, k, m;
+    float Km[NUMX];
 
     for (m = 0; m < NUMV; m++) {
         if (SensorsUsed & (0x01 << m)) { // use this sensor for update
@@ -590,18 +683,18 @@ void SerialUpdate(float H[NUMV][NUMX], float R[NUMV], float Z[NUMV],
             }
 
             for (k = 0; k < NUMX; k++) {
-                K[k][m] = HP[k] / HPHR; // find K = HP/HPHR
+                Km[k] = HP[k] / HPHR; // find K = HP/HPHR
             }
             for (i = 0; i < NUMX; i++) { // Find P(m)= P(m-1) + K*HP
                 for (j = i; j < NUMX; j++) {
                     P[i][j] = P[j][i] =
-                                  P[i][j] - K[i][m] * HP[j];
+                                  P[i][j] - Km[i] * HP[j];
                 }
             }
 
             Error = Z[m] - Y[m];
             for (i = 0; i < NUMX; i++) { // Find X(m)= X(m-1) + K*Error
-                X[i] = X[i] + K[i][m] * Error;
+                X[i] = X[i] + Km[i] * Error;
             }
         }
     }
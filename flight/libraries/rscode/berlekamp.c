@@ -237,13 +237,23 @@ void
 Find_Roots (void)
 {
   int sum, r, k;	
+  int terms[RS_ECC_NPARITY+1];
   NErrors = 0;
+
+  /* log of Lambda[k] * a^(k*r), stepped by k for each r; -1 for zero coefficients */
+  for (k = 0; k < RS_ECC_NPARITY+1; k++) {
+    terms[k] = (Lambda[k] != 0) ? glog[Lambda[k]] : -1;
+  }
   
   for (r = 1; r < 256; r++) {
     sum = 0;
     /* evaluate lambda at r */
     for (k = 0; k < RS_ECC_NPARITY+1; k++) {
-      sum ^= gmult(gexp[(k*r)%255], Lambda[k]);
+      if (terms[k] >= 0) {
+	terms[k] += k;
+	if (terms[k] >= 255) terms[k] -= 255;
+	sum ^= gexp[terms[k]];
+      }
     }
     if (sum == 0) 
       { 
@@ -81,6 +81,9 @@ BIT16 crc_ccitt(unsigned char *msg, int len);
 extern const int gexp[];
 extern const int glog[];
 
+/* LFSR feedback of the encoder for each byte value */
+extern const unsigned char rs_lfsr_table[256][RS_ECC_NPARITY];
+
 void init_galois_tables (void);
 int ginv(int elt); 
 int gmult(int a, int b);
@@ -38,11 +38,89 @@ int synBytes[MAXDEG];
 /* generator polynomial */
 int genPoly[MAXDEG*2];
 
+/* LFSR feedback for each byte value d: rs_lfsr_table[d][j] = genPoly[j] * d,
+ * kept in flash as it only depends on the generator polynomial.
+ * genPoly = (x + a^1)(x + a^2)(x + a^3)(x + a^4) = x^4 + 30x^3 + 216x^2 + 231x + 116
+ */
+#if RS_ECC_NPARITY != 4
+#error rs_lfsr_table is only precomputed for RS_ECC_NPARITY 4
+#endif
+
+const unsigned char rs_lfsr_table[256][RS_ECC_NPARITY] = {
+	{  0,   0,   0,   0}, {116, 231, 216,  30}, {232, 211, 173,  60}, {156,  52, 117,  34},
+	{205, 187,  71, 120}, {185,  92, 159, 102}, { 37, 104, 234,  68}, { 81, 143,  50,  90},
+	{135, 107, 142, 240}, {243, 140,  86, 238}, {111, 184,  35, 204}, { 27,  95, 251, 210},
+	{ 74, 208, 201, 136}, { 62,  55,  17, 150}, {162,   3, 100, 180}, {214, 228, 188, 170},
+	{ 19, 214,   1, 253}, {103,  49, 217, 227}, {251,   5, 172, 193}, {143, 226, 116, 223},
+	{222, 109,  70, 133}, {170, 138, 158, 155}, { 54, 190, 235, 185}, { 66,  89,  51, 167},
+	{148, 189, 143,  13}, {224,  90,  87,  19}, {124, 110,  34,  49}, {  8, 137, 250,  47},
+	{ 89,   6, 200, 117}, { 45, 225,  16, 107}, {177, 213, 101,  73}, {197,  50, 189,  87},
+	{ 38, 177,   2, 231}, { 82,  86, 218, 249}, {206,  98, 175, 219}, {186, 133, 119, 197},
+	{235,  10,  69, 159}, {159, 237, 157, 129}, {  3, 217, 232, 163}, {119,  62,  48, 189},
+	{161, 218, 140,  23}, {213,  61,  84,   9}, { 73,   9,  33,  43}, { 61, 238, 249,  53},
+	{108,  97, 203, 111}, { 24, 134,  19, 113}, {132, 178, 102,  83}, {240,  85, 190,  77},
+	{ 53, 103,   3,  26}, { 65, 128, 219,   4}, {221, 180, 174,  38}, {169,  83, 118,  56},
+	{248, 220,  68,  98}, {140,  59, 156, 124}, { 16,  15, 233,  94}, {100, 232,  49,  64},
+	{178,  12, 141, 234}, {198, 235,  85, 244}, { 90, 223,  32, 214}, { 46,  56, 248, 200},
+	{127, 183, 202, 146}, { 11,  80,  18, 140}, {151, 100, 103, 174}, {227, 131, 191, 176},
+	{ 76, 127,   4, 211}, { 56, 152, 220, 205}, {164, 172, 169, 239}, {208,  75, 113, 241},
+	{129, 196,  67, 171}, {245,  35, 155, 181}, {105,  23, 238, 151}, { 29, 240,  54, 137},
+	{203,  20, 138,  35}, {191, 243,  82,  61}, { 35, 199,  39,  31}, { 87,  32, 255,   1},
+	{  6, 175, 205,  91}, {114,  72,  21,  69}, {238, 124,  96, 103}, {154, 155, 184, 121},
+	{ 95, 169,   5,  46}, { 43,  78, 221,  48}, {183, 122, 168,  18}, {195, 157, 112,  12},
+	{146,  18,  66,  86}, {230, 245, 154,  72}, {122, 193, 239, 106}, { 14,  38,  55, 116},
+	{216, 194, 139, 222}, {172,  37,  83, 192}, { 48,  17,  38, 226}, { 68, 246, 254, 252},
+	{ 21, 121, 204, 166}, { 97, 158,  20, 184}, {253, 170,  97, 154}, {137,  77, 185, 132},
+	{106, 206,   6,  52}, { 30,  41, 222,  42}, {130,  29, 171,   8}, {246, 250, 115,  22},
+	{167, 117,  65,  76}, {211, 146, 153,  82}, { 79, 166, 236, 112}, { 59,  65,  52, 110},
+	{237, 165, 136, 196}, {153,  66,  80, 218}, {  5, 118,  37, 248}, {113, 145, 253, 230},
+	{ 32,  30, 207, 188}, { 84, 249,  23, 162}, {200, 205,  98, 128}, {188,  42, 186, 158},
+	{121,  24,   7, 201}, { 13, 255, 223, 215}, {145, 203, 170, 245}, {229,  44, 114, 235},
+	{180, 163,  64, 177}, {192,  68, 152, 175}, { 92, 112, 237, 141}, { 40, 151,  53, 147},
+	{254, 115, 137,  57}, {138, 148,  81,  39}, { 22, 160,  36,   5}, { 98,  71, 252,  27},
+	{ 51, 200, 206,  65}, { 71,  47,  22,  95}, {219,  27,  99, 125}, {175, 252, 187,  99},
+	{152, 254,   8, 187}, {236,  25, 208, 165}, {112,  45, 165, 135}, {  4, 202, 125, 153},
+	{ 85,  69,  79, 195}, { 33, 162, 151, 221}, {189, 150, 226, 255}, {201, 113,  58, 225},
+	{ 31, 149, 134,  75}, {107, 114,  94,  85}, {247,  70,  43, 119}, {131, 161, 243, 105},
+	{210,  46, 193,  51}, {166, 201,  25,  45}, { 58, 253, 108,  15}, { 78,  26, 180,  17},
+	{139,  40,   9,  70}, {255, 207, 209,  88}, { 99, 251, 164, 122}, { 23,  28, 124, 100},
+	{ 70, 147,  78,  62}, { 50, 116, 150,  32}, {174,  64, 227,   2}, {218, 167,  59,  28},
+	{ 12,  67, 135, 182}, {120, 164,  95, 168}, {228, 144,  42, 138}, {144, 119, 242, 148},
+	{193, 248, 192, 206}, {181,  31,  24, 208}, { 41,  43, 109, 242}, { 93, 204, 181, 236},
+	{190,  79,  10,  92}, {202, 168, 210,  66}, { 86, 156, 167,  96}, { 34, 123, 127, 126},
+	{115, 244,  77,  36}, {  7,  19, 149,  58}, {155,  39, 224,  24}, {239, 192,  56,   6},
+	{ 57,  36, 132, 172}, { 77, 195,  92, 178}, {209, 247,  41, 144}, {165,  16, 241, 142},
+	{244, 159, 195, 212}, {128, 120,  27, 202}, { 28,  76, 110, 232}, {104, 171, 182, 246},
+	{173, 153,  11, 161}, {217, 126, 211, 191}, { 69,  74, 166, 157}, { 49, 173, 126, 131},
+	{ 96,  34,  76, 217}, { 20, 197, 148, 199}, {136, 241, 225, 229}, {252,  22,  57, 251},
+	{ 42, 242, 133,  81}, { 94,  21,  93,  79}, {194,  33,  40, 109}, {182, 198, 240, 115},
+	{231,  73, 194,  41}, {147, 174,  26,  55}, { 15, 154, 111,  21}, {123, 125, 183,  11},
+	{212, 129,  12, 104}, {160, 102, 212, 118}, { 60,  82, 161,  84}, { 72, 181, 121,  74},
+	{ 25,  58,  75,  16}, {109, 221, 147,  14}, {241, 233, 230,  44}, {133,  14,  62,  50},
+	{ 83, 234, 130, 152}, { 39,  13,  90, 134}, {187,  57,  47, 164}, {207, 222, 247, 186},
+	{158,  81, 197, 224}, {234, 182,  29, 254}, {118, 130, 104, 220}, {  2, 101, 176, 194},
+	{199,  87,  13, 149}, {179, 176, 213, 139}, { 47, 132, 160, 169}, { 91,  99, 120, 183},
+	{ 10, 236,  74, 237}, {126,  11, 146, 243}, {226,  63, 231, 209}, {150, 216,  63, 207},
+	{ 64,  60, 131, 101}, { 52, 219,  91, 123}, {168, 239,  46,  89}, {220,   8, 246,  71},
+	{141, 135, 196,  29}, {249,  96,  28,   3}, {101,  84, 105,  33}, { 17, 179, 177,  63},
+	{242,  48,  14, 143}, {134, 215, 214, 145}, { 26, 227, 163, 179}, {110,   4, 123, 173},
+	{ 63, 139,  73, 247}, { 75, 108, 145, 233}, {215,  88, 228, 203}, {163, 191,  60, 213},
+	{117,  91, 128, 127}, {  1, 188,  88,  97}, {157, 136,  45,  67}, {233, 111, 245,  93},
+	{184, 224, 199,   7}, {204,   7,  31,  25}, { 80,  51, 106,  59}, { 36, 212, 178,  37},
+	{225, 230,  15, 114}, {149,   1, 215, 108}, {  9,  53, 162,  78}, {125, 210, 122,  80},
+	{ 44,  93,  72,  10}, { 88, 186, 144,  20}, {196, 142, 229,  54}, {176, 105,  61,  40},
+	{102, 141, 129, 130}, { 18, 106,  89, 156}, {142,  94,  44, 190}, {250, 185, 244, 160},
+	{171,  54, 198, 250}, {223, 209,  30, 228}, { 67, 229, 107, 198}, { 55,   2, 179, 216}
+};
+
 //int DEBUG = FALSE;
 
 static void
 compute_genpoly (int nbytes, int genpoly[]);
 
+static void
+compute_remainder (unsigned char data[], int nbytes, unsigned char lfsr[]);
+
 /* Initialize lookup tables, polynomials, etc. */
 void
 initialize_ecc ()
@@ -105,16 +183,34 @@ build_codeword (unsigned char msg[], int nbytes, unsigned char dst[])
  *
  * Computes the syndrome of a codeword. Puts the results
  * into the synBytes[] array.
+ *
+ * The codeword goes through the encoder LFSR, which leaves
+ * R(x) = data(x) * x^NPAR mod genPoly(x). A valid codeword
+ * leaves nothing, so a clean packet costs one table lookup
+ * per byte. Otherwise, as genPoly(a^(j+1)) = 0, the syndromes
+ * are S[j] = data(a^(j+1)) = R(a^(j+1)) / a^((j+1)*NPAR),
+ * found from the NPAR remainder bytes alone.
  */
  
 void
 decode_data(unsigned char data[], int nbytes)
 {
-  int i, j, sum;
+  unsigned char rem[RS_ECC_NPARITY];
+  int j, k, sum, nz = 0;
+
+  compute_remainder(data, nbytes, rem);
+  for (k = 0; k < RS_ECC_NPARITY; k++) nz |= rem[k];
+
+  if (!nz) {
+    for (j = 0; j < RS_ECC_NPARITY; j++) synBytes[j] = 0;
+    return;
+  }
+
   for (j = 0; j < RS_ECC_NPARITY;  j++) {
     sum	= 0;
-    for (i = 0; i < nbytes; i++) {
-      sum = data[i] ^ gmult(gexp[j+1], sum);
+    for (k = 0; k < RS_ECC_NPARITY; k++) {
+      if (rem[k] != 0)
+	sum ^= gexp[glog[rem[k]] + ((j+1)*(255+k-RS_ECC_NPARITY)) % 255];
     }
     synBytes[j]  = sum;
   }
@@ -176,8 +272,29 @@ compute_genpoly (int nbytes, int genpoly[])
   }
 }
 
-/* Simulate a LFSR with generator polynomial for n byte RS code. 
- * Pass in a pointer to the data array, and amount of data. 
+/* Simulate a LFSR with generator polynomial for n byte RS code
+ * over nbytes of data. lfsr[j] is left with the coefficient of x^j
+ * of data(x) * x^NPAR mod genPoly(x).
+ */
+
+static void
+compute_remainder (unsigned char data[], int nbytes, unsigned char lfsr[])
+{
+  int i, j;
+  const unsigned char *row;
+
+  for (j = 0; j < RS_ECC_NPARITY; j++) lfsr[j] = 0;
+
+  for (i = 0; i < nbytes; i++) {
+    row = rs_lfsr_table[data[i] ^ lfsr[RS_ECC_NPARITY-1]];
+    for (j = RS_ECC_NPARITY-1; j > 0; j--) {
+      lfsr[j] = lfsr[j-1] ^ row[j];
+    }
+    lfsr[0] = row[0];
+  }
+}
+
+/* Pass in a pointer to the data array, and amount of data. 
  *
  * The parity bytes are deposited into pBytes[], and the whole message
  * and parity are copied to dest to make a codeword.
@@ -187,17 +304,10 @@ compute_genpoly (int nbytes, int genpoly[])
 void
 encode_data (unsigned char msg[], int nbytes, unsigned char dst[])
 {
-  int i, LFSR[RS_ECC_NPARITY+1],dbyte, j;
-	
-  for(i=0; i < RS_ECC_NPARITY+1; i++) LFSR[i]=0;
+  unsigned char LFSR[RS_ECC_NPARITY];
+  int i;
 
-  for (i = 0; i < nbytes; i++) {
-    dbyte = msg[i] ^ LFSR[RS_ECC_NPARITY-1];
-    for (j = RS_ECC_NPARITY-1; j > 0; j--) {
-      LFSR[j] = LFSR[j-1] ^ gmult(genPoly[j], dbyte);
-    }
-    LFSR[0] = gmult(genPoly[0], dbyte);
-  }
+  compute_remainder(msg, nbytes, LFSR);
 
   for (i = 0; i < RS_ECC_NPARITY; i++) 
     pBytes[i] = LFSR[i];
@@ -37,18 +37,29 @@
 #include "debuglogentry.h"
 #include "flightstatus.h"
 
+// Pace of a batch retrieval if the GCS does not ask for one
+#define BATCH_DEFAULT_INTERVAL_MS 10
+
 // private variables
 static DebugLogSettingsData settings;
 static DebugLogControlData control;
 static DebugLogStatusData status;
 static FlightStatusData flightstatus;
 static DebugLogEntryData *entry; // would be better on stack but event dispatcher stack might be insufficient
+static struct {
+    uint16_t flight;
+    uint16_t entry;
+    uint16_t remaining;
+    uint16_t interval;
+} batch;
 
 // private functions
 static void SettingsUpdatedCb(UAVObjEvent *ev);
 static void ControlUpdatedCb(UAVObjEvent *ev);
 static void StatusUpdatedCb(UAVObjEvent *ev);
 static void FlightStatusUpdatedCb(UAVObjEvent *ev);
+static void BatchSendCb(UAVObjEvent *ev);
+static bool LoadEntry(uint16_t flight, uint16_t inst);
 
 int32_t LoggingInitialize(void)
 {
@@ -83,6 +94,10 @@ int32_t LoggingStart(void)
     // invoke a periodic dispatcher callback - the event struct is a dummy, it could be filled with anything!
     StatusUpdatedCb(&ev);
 
+    // batch retrievals are paced by a second periodic callback, idle (period 0) until a batch is requested
+    ev.obj = DebugLogEntryHandle();
+    EventPeriodicCallbackCreate(&ev, BatchSendCb, 0);
+
     return 0;
 }
 MODULE_INITCALL(LoggingInitialize, LoggingStart);
@@ -90,6 +105,7 @@ MODULE_INITCALL(LoggingInitialize, LoggingStart);
 static void StatusUpdatedCb(__attribute__((unused)) UAVObjEvent *ev)
 {
     PIOS_DEBUGLOG_Info(&status.Flight, &status.Entry, &status.FreeSlots, &status.UsedSlots);
+    PIOS_DEBUGLOG_DropInfo(&status.DroppedEntries, &status.DroppedBuffers);
     DebugLogStatusSet(&status);
 }
 
@@ -125,14 +141,27 @@ static void ControlUpdatedCb(__attribute__((unused)) UAVObjEvent *ev)
 {
     DebugLogControlGet(&control);
     if (control.Operation == DEBUGLOGCONTROL_OPERATION_RETRIEVE) {
-        memset(entry, 0, sizeof(DebugLogEntryData));
-        if (PIOS_DEBUGLOG_Read(entry, control.Flight, control.Entry) != 0) {
-            // reading from log failed, mark as non existent in output
-            entry->Flight = control.Flight;
-            entry->Entry  = control.Entry;
-            entry->Type   = DEBUGLOGENTRY_TYPE_EMPTY;
-        }
+        LoadEntry(control.Flight, control.Entry);
         DebugLogEntrySet(entry);
+    } else if (control.Operation == DEBUGLOGCONTROL_OPERATION_RETRIEVEBATCH) {
+        // a new request replaces any batch still in progress, the GCS re-requests whatever it missed
+        uint16_t interval = control.Interval ? control.Interval : BATCH_DEFAULT_INTERVAL_MS;
+        bool reschedule   = batch.remaining == 0 || batch.interval != interval;
+        batch.flight    = control.Flight;
+        batch.entry     = control.Entry;
+        batch.remaining = control.Count;
+        batch.interval  = interval;
+        // the first entry goes out right away, the rest at the requested pace
+        BatchSendCb(ev);
+        if (batch.remaining > 0 && reschedule) {
+            UAVObjEvent batchEv = {
+                .obj    = DebugLogEntryHandle(),
+                .instId = 0,
+                .event  = EV_UPDATED_PERIODIC,
+                .lowPriority = true,
+            };
+            EventPeriodicCallbackUpdate(&batchEv, BatchSendCb, batch.interval);
+        }
     } else if (control.Operation == DEBUGLOGCONTROL_OPERATION_FORMATFLASH) {
         uint8_t armed;
         FlightStatusArmedGet(&armed);
@@ -143,6 +172,49 @@ static void ControlUpdatedCb(__attribute__((unused)) UAVObjEvent *ev)
     StatusUpdatedCb(ev);
 }
 
+/**
+ * Load a log entry into the local DebugLogEntry buffer
+ * @return true if the entry exists, false if it was marked as Empty
+ */
+static bool LoadEntry(uint16_t flight, uint16_t inst)
+{
+    memset(entry, 0, sizeof(DebugLogEntryData));
+    if (PIOS_DEBUGLOG_Read(entry, flight, inst) != 0) {
+        // reading from log failed, mark as non existent in output
+        entry->Flight = flight;
+        entry->Entry  = inst;
+        entry->Type   = DEBUGLOGENTRY_TYPE_EMPTY;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Push the next entry of a batch retrieval to the GCS.
+ * DebugLogEntry is single instance and packed when telemetry sends it, so an
+ * entry overwritten before it went out is lost, the GCS detects this from the
+ * Entry sequence numbers and re-requests the gap.
+ */
+static void BatchSendCb(UAVObjEvent *ev)
+{
+    if (batch.remaining > 0) {
+        if (LoadEntry(batch.flight, batch.entry)) {
+            batch.entry++;
+            batch.remaining--;
+        } else {
+            // the empty entry tells the GCS where the flight ends
+            batch.remaining = 0;
+        }
+        DebugLogEntrySet(entry);
+        DebugLogEntryUpdated();
+    }
+
+    if (batch.remaining == 0 && ev->obj == DebugLogEntryHandle()) {
+        // called from the periodic dispatcher, nothing left so go idle
+        EventPeriodicCallbackUpdate(ev, BatchSendCb, 0);
+    }
+}
+
 
 /**
  * @}
@@ -109,21 +109,23 @@
 // local macros, ONLY to be used in the middle of StateEstimationCb in section RUNSTATE_SAVE before the check of alarms!
 #define EXPORT_STATE_TO_UAVOBJECT_IF_UPDATED_3_DIMENSIONS(statename, shortname, a1, a2, a3) \
     if (IS_SET(states.updated, SENSORUPDATES_##shortname)) { \
-        statename##Data s; \
-        statename##Get(&s); \
-        s.a1 = states.shortname[0]; \
-        s.a2 = states.shortname[1]; \
-        s.a3 = states.shortname[2]; \
-        statename##Set(&s); \
+        statename##Data *s = statename##BeginUpdate(); \
+        if (s) { \
+            s->a1 = states.shortname[0]; \
+            s->a2 = states.shortname[1]; \
+            s->a3 = states.shortname[2]; \
+            statename##CommitUpdate(); \
+        } \
     }
 
 #define EXPORT_STATE_TO_UAVOBJECT_IF_UPDATED_2_DIMENSIONS(statename, shortname, a1, a2) \
     if (IS_SET(states.updated, SENSORUPDATES_##shortname)) { \
-        statename##Data s; \
-        statename##Get(&s); \
-        s.a1 = states.shortname[0]; \
-        s.a2 = states.shortname[1]; \
-        statename##Set(&s); \
+        statename##Data *s = statename##BeginUpdate(); \
+        if (s) { \
+            s->a1 = states.shortname[0]; \
+            s->a2 = states.shortname[1]; \
+            statename##CommitUpdate(); \
+        } \
     }
 
 
@@ -480,23 +482,24 @@ static void StateEstimationCb(void)
         }
         EXPORT_STATE_TO_UAVOBJECT_IF_UPDATED_3_DIMENSIONS(AccelState, accel, x, y, z);
         if (IS_SET(states.updated, SENSORUPDATES_mag)) {
-            MagStateData s;
-
-            MagStateGet(&s);
-            s.x = states.mag[0];
-            s.y = states.mag[1];
-            s.z = states.mag[2];
-            switch (states.magStatus) {
-            case MAGSTATUS_OK:
-                s.Source = MAGSTATE_SOURCE_ONBOARD;
-                break;
-            case MAGSTATUS_AUX:
-                s.Source = MAGSTATE_SOURCE_AUX;
-                break;
-            default:
-                s.Source = MAGSTATE_SOURCE_INVALID;
+            MagStateData *s = MagStateBeginUpdate();
+
+            if (s) {
+                s->x = states.mag[0];
+                s->y = states.mag[1];
+                s->z = states.mag[2];
+                switch (states.magStatus) {
+                case MAGSTATUS_OK:
+                    s->Source = MAGSTATE_SOURCE_ONBOARD;
+                    break;
+                case MAGSTATUS_AUX:
+                    s->Source = MAGSTATE_SOURCE_AUX;
+                    break;
+                default:
+                    s->Source = MAGSTATE_SOURCE_INVALID;
+                }
+                MagStateCommitUpdate();
             }
-            MagStateSet(&s);
         }
 
         EXPORT_STATE_TO_UAVOBJECT_IF_UPDATED_3_DIMENSIONS(PositionState, pos, North, East, Down);
@@ -504,14 +507,15 @@ static void StateEstimationCb(void)
         EXPORT_STATE_TO_UAVOBJECT_IF_UPDATED_2_DIMENSIONS(AirspeedState, airspeed, CalibratedAirspeed, TrueAirspeed);
         // attitude nees manual conversion from quaternion to euler
         if (IS_SET(states.updated, SENSORUPDATES_attitude)) { \
-            AttitudeStateData s;
-            AttitudeStateGet(&s);
-            s.q1 = states.attitude[0];
-            s.q2 = states.attitude[1];
-            s.q3 = states.attitude[2];
-            s.q4 = states.attitude[3];
-            Quaternion2RPY(&s.q1, &s.Roll);
-            AttitudeStateSet(&s);
+            AttitudeStateData *s = AttitudeStateBeginUpdate();
+            if (s) {
+                s->q1 = states.attitude[0];
+                s->q2 = states.attitude[1];
+                s->q3 = states.attitude[2];
+                s->q4 = states.attitude[3];
+                Quaternion2RPY(&s->q1, &s->Roll);
+                AttitudeStateCommitUpdate();
+            }
         }
 
         // throttle alarms, raise alarm flags immediately
@@ -63,6 +63,20 @@
 #define MAX_RETRIES               2
 #define STATS_UPDATE_PERIOD_MS    4000
 #define CONNECTION_TIMEOUT_MS     8000
+// Updates queued within this window share frames of up to one USB HID report.
+// That saves bytes and transfers on slow links but takes more CPU time per update
+// and delays the first update of a burst by up to the window, 0 turns bundling off.
+#ifdef PIOS_TELEM_BUNDLE_WINDOW_MS
+#define BUNDLE_WINDOW_MS          PIOS_TELEM_BUNDLE_WINDOW_MS
+#else
+#define BUNDLE_WINDOW_MS          2
+#endif
+#define BUNDLE_LENGTH             62
+#ifdef PIOS_TELEM_RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE            PIOS_TELEM_RX_BUFFER_SIZE
+#else
+#define RX_BUFFER_SIZE            32
+#endif
 
 // Private types
 
@@ -105,6 +119,7 @@ static void updateObject(UAVObjHandle obj, int32_t eventType);
 static int32_t setUpdatePeriod(UAVObjHandle obj, int32_t updatePeriodMs);
 static int32_t setLoggingPeriod(UAVObjHandle obj, int32_t updatePeriodMs);
 static void processObjEvent(UAVObjEvent *ev);
+static bool receiveObjEvent(UAVObjEvent *ev, portTickType timeout);
 static void updateTelemetryStats();
 static void gcsTelemetryStatsUpdated();
 static void updateSettings();
@@ -289,6 +304,8 @@ static void updateObject(UAVObjHandle obj, int32_t eventType)
         eventMask |= EV_LOGGING_MANUAL;
         break;
     }
+    // Only the latest data is sent, an update still queued stands for any that follow it
+    eventMask |= EV_MASK_COALESCE;
     // note that all setting objects have implicitly IsPriority=true
     if (UAVObjIsPriority(obj)) {
         UAVObjConnectQueue(obj, priorityQueue, eventMask);
@@ -383,6 +400,30 @@ static void processObjEvent(UAVObjEvent *ev)
     }
 }
 
+/**
+ * Take the next event, the high priority queue is emptied before
+ * any standard priority item is handled. Updates of the object from
+ * now on queue a new event.
+ * \param[out] ev The event
+ * \param[in] timeout Ticks to wait when both queues are empty
+ * \return true if an event was taken
+ */
+static bool receiveObjEvent(UAVObjEvent *ev, portTickType timeout)
+{
+#if defined(PIOS_TELEM_PRIORITY_QUEUE)
+    // check priority queue, then regular queue - non-blocking
+    if (UAVObjQueueReceive(priorityQueue, ev, 0) || UAVObjQueueReceive(queue, ev, 0)) {
+        return true;
+    }
+    // if both queues are empty, wait on priority queue for updates
+    return UAVObjQueueReceive(priorityQueue, ev, timeout);
+
+#else
+    return UAVObjQueueReceive(queue, ev, timeout);
+
+#endif /* if defined(PIOS_TELEM_PRIORITY_QUEUE) */
+}
+
 /**
  * Telemetry transmit task, regular priority
  */
@@ -390,33 +431,33 @@ static void telemetryTxTask(__attribute__((unused)) void *parameters)
 {
     UAVObjEvent ev;
 
+#if BUNDLE_WINDOW_MS > 0
+    portTickType windowStart;
+    portTickType elapsed;
+#endif
+
     // Loop forever
     while (1) {
-        /**
-         * Tries to empty the high priority queue before handling any standard priority item
-         */
-#if defined(PIOS_TELEM_PRIORITY_QUEUE)
-        // empty priority queue, non-blocking
-        while (xQueueReceive(priorityQueue, &ev, 0) == pdTRUE) {
-            // Process event
-            processObjEvent(&ev);
+        // wait for updates (1 tick) then repeat cycle
+        if (!receiveObjEvent(&ev, 1)) {
+            continue;
         }
-        // check regular queue and process update - non-blocking
-        if (xQueueReceive(queue, &ev, 0) == pdTRUE) {
-            // Process event
-            processObjEvent(&ev);
-            // if both queues are empty, wait on priority queue for updates (1 tick) then repeat cycle
-        } else if (xQueueReceive(priorityQueue, &ev, 1) == pdTRUE) {
+
+#if BUNDLE_WINDOW_MS > 0
+        // Objects sent until the window closes are bundled into as few frames as possible
+        UAVTalkBeginBundle(uavTalkCon, BUNDLE_LENGTH);
+        windowStart = xTaskGetTickCount();
+        do {
             // Process event
             processObjEvent(&ev);
-        }
+            elapsed = xTaskGetTickCount() - windowStart;
+        } while (elapsed < BUNDLE_WINDOW_MS / portTICK_RATE_MS &&
+                 receiveObjEvent(&ev, BUNDLE_WINDOW_MS / portTICK_RATE_MS - elapsed));
+        UAVTalkEndBundle(uavTalkCon);
 #else
-        // wait on queue for updates (1 tick) then repeat cycle
-        if (xQueueReceive(queue, &ev, 1) == pdTRUE) {
-            // Process event
-            processObjEvent(&ev);
-        }
-#endif /* if defined(PIOS_TELEM_PRIORITY_QUEUE) */
+        // Process event
+        processObjEvent(&ev);
+#endif
     }
 }
 
@@ -431,16 +472,18 @@ static void telemetryRxTask(__attribute__((unused)) void *parameters)
         uint32_t inputPort = getComPort(true);
 
         if (inputPort) {
-            // Block until data are available
-            uint8_t serial_data[1];
+            // Block until data are available, then drain the port
+            static uint8_t serial_data[RX_BUFFER_SIZE];
             uint16_t bytes_to_process;
+            uint32_t timeout = 500;
 
-            bytes_to_process = PIOS_COM_ReceiveBuffer(inputPort, serial_data, sizeof(serial_data), 500);
-            if (bytes_to_process > 0) {
-                for (uint8_t i = 0; i < bytes_to_process; i++) {
-                    UAVTalkProcessInputStream(uavTalkCon, serial_data[i]);
+            do {
+                bytes_to_process = PIOS_COM_ReceiveBuffer(inputPort, serial_data, sizeof(serial_data), timeout);
+                if (bytes_to_process > 0) {
+                    UAVTalkProcessInputStreamBuffer(uavTalkCon, serial_data, bytes_to_process);
                 }
-            }
+                timeout = 0;
+            } while (bytes_to_process == sizeof(serial_data));
         } else {
             vTaskDelay(5);
         }
@@ -456,16 +499,18 @@ static void radioRxTask(__attribute__((unused)) void *parameters)
     // Task loop
     while (1) {
         if (radioPort) {
-            // Block until data are available
-            uint8_t serial_data[1];
+            // Block until data are available, then drain the port
+            static uint8_t serial_data[RX_BUFFER_SIZE];
             uint16_t bytes_to_process;
+            uint32_t timeout = 500;
 
-            bytes_to_process = PIOS_COM_ReceiveBuffer(radioPort, serial_data, sizeof(serial_data), 500);
-            if (bytes_to_process > 0) {
-                for (uint8_t i = 0; i < bytes_to_process; i++) {
-                    UAVTalkProcessInputStream(radioUavTalkCon, serial_data[i]);
+            do {
+                bytes_to_process = PIOS_COM_ReceiveBuffer(radioPort, serial_data, sizeof(serial_data), timeout);
+                if (bytes_to_process > 0) {
+                    UAVTalkProcessInputStreamBuffer(radioUavTalkCon, serial_data, bytes_to_process);
                 }
-            }
+                timeout = 0;
+            } while (bytes_to_process == sizeof(serial_data));
         } else {
             vTaskDelay(5);
         }
@@ -648,12 +693,16 @@ static void updateTelemetryStats()
         // Wait for connection
         if (gcsStats.Status == GCSTELEMETRYSTATS_STATUS_CONNECTED) {
             flightStats.Status = FLIGHTTELEMETRYSTATS_STATUS_CONNECTED;
+            // Offer delta and bundle packets, a GCS that knows them answers with its own
+            UAVTalkSendCapabilities(uavTalkCon);
         } else if (gcsStats.Status == GCSTELEMETRYSTATS_STATUS_DISCONNECTED) {
             flightStats.Status = FLIGHTTELEMETRYSTATS_STATUS_DISCONNECTED;
         }
     } else if (flightStats.Status == FLIGHTTELEMETRYSTATS_STATUS_CONNECTED) {
         if (gcsStats.Status != GCSTELEMETRYSTATS_STATUS_CONNECTED || connectionTimeout) {
             flightStats.Status = FLIGHTTELEMETRYSTATS_STATUS_DISCONNECTED;
+            // The next GCS may not understand delta packets, it tells when it connects
+            UAVTalkResetCapabilities(uavTalkCon);
         } else {
             forceUpdate = 0;
         }
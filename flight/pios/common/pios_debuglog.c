@@ -34,7 +34,13 @@
 #include "debuglogentry.h"
 
 // global definitions
-
+#ifndef PIOS_DEBUGLOG_NUM_BUFFERS
+#define PIOS_DEBUGLOG_NUM_BUFFERS 4
+#endif
+#ifndef PIOS_DEBUGLOG_WRITER_STACK_SIZE
+#define PIOS_DEBUGLOG_WRITER_STACK_SIZE 1024
+#endif
+#define WRITER_RETRY_MS 100
 
 // Global variables
 extern uintptr_t pios_user_fs_id; // flash filesystem for logging
@@ -48,16 +54,51 @@ static xSemaphoreHandle mutex = 0;
 #define mutexunlock()
 #endif
 
+/*
+ * Log entries are collected in a ring of buffers.  Full buffers are queued for
+ * a low priority writer callback, so logging an object never waits for the
+ * flash.  When every buffer is waiting to be written new entries are dropped.
+ */
+#if defined(PIOS_INCLUDE_CALLBACKSCHEDULER)
+static DelayedCallbackInfo *writer_callback;
+#define schedule_writer() PIOS_CALLBACKSCHEDULER_Dispatch(writer_callback)
+#define schedule_writer_retry() \
+    PIOS_CALLBACKSCHEDULER_Schedule(writer_callback, WRITER_RETRY_MS, CALLBACK_UPDATEMODE_NONE)
+#else
+#define schedule_writer()       write_queued_buffers()
+#define schedule_writer_retry()
+#endif
+
+/*
+ * The writer callback keeps the writer lock for as long as it uses a queued
+ * buffer, so a format cannot hand that buffer out again under it.  It is
+ * always taken before the mutex.  Without the callback scheduler the writer
+ * runs inline with the mutex held and needs no lock of its own.
+ */
+#if defined(PIOS_INCLUDE_FREERTOS) && defined(PIOS_INCLUDE_CALLBACKSCHEDULER)
+static xSemaphoreHandle writer_mutex = 0;
+#define writerlock()   xSemaphoreTake(writer_mutex, portMAX_DELAY)
+#define writerunlock() xSemaphoreGive(writer_mutex)
+#else
+#define writerlock()
+#define writerunlock()
+#endif
+
 static bool logging_enabled = false;
 #define MAX_CONSECUTIVE_FAILS_COUNT 10
 static bool log_is_full     = false;
 static uint8_t fails_count  = 0;
 static uint16_t flightnum   = 0;
 static uint16_t lognum = 0;
-static DebugLogEntryData *buffer = 0;
+static DebugLogEntryData *buffers = 0;
 #if !defined(PIOS_INCLUDE_FREERTOS)
-static DebugLogEntryData staticbuffer;
+static DebugLogEntryData staticbuffers[PIOS_DEBUGLOG_NUM_BUFFERS];
 #endif
+static DebugLogEntryData *buffer = 0; // buffer being filled, valid while used_buffer_space > 0
+static uint8_t write_index = 0; // oldest buffer waiting for the writer
+static uint8_t num_queued  = 0; // buffers waiting for the writer
+static uint32_t dropped_entries = 0;
+static uint32_t dropped_buffers = 0;
 
 #define LOG_ENTRY_MAX_DATA_SIZE (sizeof(((DebugLogEntryData *)0)->Data))
 #define LOG_ENTRY_HEADER_SIZE   (sizeof(DebugLogEntryData) - LOG_ENTRY_MAX_DATA_SIZE)
@@ -68,7 +109,10 @@ static uint32_t used_buffer_space = 0;
 
 /* Private Function Prototypes */
 static void enqueue_data(uint32_t objid, uint16_t instid, size_t size, uint8_t *data);
-static bool write_current_buffer();
+static DebugLogEntryData *start_buffer();
+static void queue_buffer();
+static void write_queued_buffers();
+static void reset_buffers();
 /**
  * @brief Initialize the log facility
  */
@@ -76,25 +120,35 @@ void PIOS_DEBUGLOG_Initialize()
 {
 #if defined(PIOS_INCLUDE_FREERTOS)
     if (!mutex) {
-        mutex  = xSemaphoreCreateRecursiveMutex();
-        buffer = pios_malloc(sizeof(DebugLogEntryData));
+        mutex   = xSemaphoreCreateRecursiveMutex();
+        buffers = pios_malloc(PIOS_DEBUGLOG_NUM_BUFFERS * sizeof(DebugLogEntryData));
+#if defined(PIOS_INCLUDE_CALLBACKSCHEDULER)
+        writer_mutex    = xSemaphoreCreateMutex();
+        writer_callback = PIOS_CALLBACKSCHEDULER_Create(&write_queued_buffers, CALLBACK_PRIORITY_LOW, CALLBACK_TASK_AUXILIARY, -1, PIOS_DEBUGLOG_WRITER_STACK_SIZE);
+        if (!writer_callback && buffers) {
+            pios_free(buffers);
+            buffers = 0;
+        }
+#endif
     }
 #else
-    buffer = &staticbuffer;
+    buffers = staticbuffers;
 #endif
-    if (!buffer) {
+    if (!buffers) {
         return;
     }
+    writerlock();
     mutexlock();
     lognum      = 0;
     flightnum   = 0;
     fails_count = 0;
-    used_buffer_space = 0;
     log_is_full = false;
-    while (PIOS_FLASHFS_ObjLoad(pios_user_fs_id, LOG_GET_FLIGHT_OBJID(flightnum), lognum, (uint8_t *)buffer, sizeof(DebugLogEntryData)) == 0) {
+    reset_buffers();
+    while (PIOS_FLASHFS_ObjLoad(pios_user_fs_id, LOG_GET_FLIGHT_OBJID(flightnum), lognum, (uint8_t *)&buffers[0], sizeof(DebugLogEntryData)) == 0) {
         flightnum++;
     }
     mutexunlock();
+    writerunlock();
 }
 
 
@@ -104,12 +158,21 @@ void PIOS_DEBUGLOG_Initialize()
  */
 void PIOS_DEBUGLOG_Enable(uint8_t enabled)
 {
+    if (!buffers) {
+        return;
+    }
+    mutexlock();
     // increase the flight num as soon as logging is disabled
     if (logging_enabled && !enabled) {
+        // hand what has been collected of this flight to the writer
+        if (used_buffer_space) {
+            queue_buffer();
+        }
         flightnum++;
         lognum = 0;
     }
     logging_enabled = enabled;
+    mutexunlock();
 }
 
 /**
@@ -122,7 +185,7 @@ void PIOS_DEBUGLOG_Enable(uint8_t enabled)
  */
 void PIOS_DEBUGLOG_UAVObject(uint32_t objid, uint16_t instid, size_t size, uint8_t *data)
 {
-    if (!logging_enabled || !buffer || log_is_full) {
+    if (!logging_enabled || !buffers || log_is_full) {
         return;
     }
     mutexlock();
@@ -139,7 +202,7 @@ void PIOS_DEBUGLOG_UAVObject(uint32_t objid, uint16_t instid, size_t size, uint8
  */
 void PIOS_DEBUGLOG_Printf(char *format, ...)
 {
-    if (!logging_enabled || !buffer || log_is_full) {
+    if (!logging_enabled || !buffers || log_is_full) {
         return;
     }
 
@@ -148,24 +211,22 @@ void PIOS_DEBUGLOG_Printf(char *format, ...)
     mutexlock();
     // flush any pending buffer before writing debug text
     if (used_buffer_space) {
-        write_current_buffer();
+        queue_buffer();
     }
-    memset(buffer->Data, 0xff, sizeof(buffer->Data));
-    vsnprintf((char *)buffer->Data, sizeof(buffer->Data), (char *)format, args);
-    buffer->Flight     = flightnum;
-
-    buffer->FlightTime = PIOS_DELAY_GetuS();
-
-    buffer->Entry      = lognum;
-    buffer->Type       = DEBUGLOGENTRY_TYPE_TEXT;
-    buffer->ObjectID   = 0;
-    buffer->InstanceID = 0;
-    buffer->Size       = strlen((const char *)buffer->Data);
-
-    if (PIOS_FLASHFS_ObjSave(pios_user_fs_id, LOG_GET_FLIGHT_OBJID(flightnum), lognum, (uint8_t *)buffer, sizeof(DebugLogEntryData)) == 0) {
-        lognum++;
+    DebugLogEntryData *text = start_buffer();
+    if (text) {
+        vsnprintf((char *)text->Data, sizeof(text->Data), (char *)format, args);
+        text->FlightTime = PIOS_DELAY_GetuS();
+        text->Type       = DEBUGLOGENTRY_TYPE_TEXT;
+        text->ObjectID   = 0;
+        text->InstanceID = 0;
+        text->Size       = strlen((const char *)text->Data);
+        queue_buffer();
+    } else {
+        dropped_entries++;
     }
     mutexunlock();
+    va_end(args);
 }
 
 
@@ -202,7 +263,7 @@ void PIOS_DEBUGLOG_Info(uint16_t *flight, uint16_t *entry, uint16_t *free, uint1
     if (entry) {
         *entry = lognum;
     }
-    struct PIOS_FLASHFS_Stats stats = { 0, 0 };
+    struct PIOS_FLASHFS_Stats stats = { 0 };
     PIOS_FLASHFS_GetStats(pios_user_fs_id, &stats);
     if (free) {
         *free = stats.num_free_slots;
@@ -212,19 +273,37 @@ void PIOS_DEBUGLOG_Info(uint16_t *flight, uint16_t *entry, uint16_t *free, uint1
     }
 }
 
+/**
+ * @brief Retrieve how much has been lost instead of stalling the caller
+ * @param[out] entries dropped because every log buffer was waiting to be written
+ * @param[out] lost_buffers dropped because they could not be written to flash
+ */
+void PIOS_DEBUGLOG_DropInfo(uint32_t *entries, uint32_t *lost_buffers)
+{
+    if (entries) {
+        *entries = dropped_entries;
+    }
+    if (lost_buffers) {
+        *lost_buffers = dropped_buffers;
+    }
+}
+
 /**
  * @brief Format entire flash memory!!!
  */
 void PIOS_DEBUGLOG_Format(void)
 {
+    // wait for a write in flight, its buffer is about to be handed out again
+    writerlock();
     mutexlock();
     PIOS_FLASHFS_Format(pios_user_fs_id);
     lognum      = 0;
     flightnum   = 0;
     log_is_full = false;
     fails_count = 0;
-    used_buffer_space = 0;
+    reset_buffers();
     mutexunlock();
+    writerunlock();
 }
 
 void enqueue_data(uint32_t objid, uint16_t instid, size_t size, uint8_t *data)
@@ -233,29 +312,35 @@ void enqueue_data(uint32_t objid, uint16_t instid, size_t size, uint8_t *data)
 
     // start a new block
     if (!used_buffer_space) {
-        entry = buffer;
-        memset(buffer->Data, 0xff, sizeof(buffer->Data));
+        entry = start_buffer();
+        if (!entry) {
+            dropped_entries++;
+            return;
+        }
+        entry->Type = DEBUGLOGENTRY_TYPE_UAVOBJECT;
         used_buffer_space += size;
     } else {
         // if an instance is being filled and there is enough space, does enqueues new data.
         if (used_buffer_space + size + LOG_ENTRY_HEADER_SIZE > LOG_ENTRY_MAX_DATA_SIZE) {
-            buffer->Type = DEBUGLOGENTRY_TYPE_MULTIPLEUAVOBJECTS;
-            if (!write_current_buffer()) {
+            queue_buffer();
+            entry = start_buffer();
+            if (!entry) {
+                dropped_entries++;
                 return;
             }
-            entry = buffer;
-            memset(buffer->Data, 0xff, sizeof(buffer->Data));
+            entry->Type = DEBUGLOGENTRY_TYPE_UAVOBJECT;
             used_buffer_space += size;
         } else {
+            buffer->Type = DEBUGLOGENTRY_TYPE_MULTIPLEUAVOBJECTS;
             entry = (DebugLogEntryData *)&buffer->Data[used_buffer_space];
+            entry->Type = DEBUGLOGENTRY_TYPE_UAVOBJECT;
             used_buffer_space += size + LOG_ENTRY_HEADER_SIZE;
         }
     }
 
     entry->Flight     = flightnum;
     entry->FlightTime = PIOS_DELAY_GetuS();
-    entry->Entry = lognum;
-    entry->Type = DEBUGLOGENTRY_TYPE_UAVOBJECT;
+    entry->Entry = buffer->Entry;
     entry->ObjectID   = objid;
     entry->InstanceID = instid;
     if (size > sizeof(buffer->Data)) {
@@ -266,20 +351,77 @@ void enqueue_data(uint32_t objid, uint16_t instid, size_t size, uint8_t *data)
     memcpy(entry->Data, data, size);
 }
 
-bool write_current_buffer()
+/**
+ * @brief Claim the next free buffer of the ring and number it as the next log entry
+ * @return the buffer, or NULL if all of them are waiting for the writer
+ * @note Must be called with the mutex held
+ */
+static DebugLogEntryData *start_buffer()
 {
-    // not enough space, write the block and start a new one
-    if (PIOS_FLASHFS_ObjSave(pios_user_fs_id, LOG_GET_FLIGHT_OBJID(flightnum), lognum, (uint8_t *)buffer, sizeof(DebugLogEntryData)) == 0) {
-        lognum++;
-        fails_count = 0;
-        used_buffer_space = 0;
-    } else {
-        if (fails_count++ > MAX_CONSECUTIVE_FAILS_COUNT) {
-            log_is_full = true;
+    if (num_queued >= PIOS_DEBUGLOG_NUM_BUFFERS) {
+        return 0;
+    }
+    buffer = &buffers[(write_index + num_queued) % PIOS_DEBUGLOG_NUM_BUFFERS];
+    memset(buffer->Data, 0xff, sizeof(buffer->Data));
+    buffer->Flight = flightnum;
+    buffer->Entry  = lognum++;
+    return buffer;
+}
+
+/**
+ * @brief Hand the buffer being filled to the writer
+ * @note Must be called with the mutex held
+ */
+static void queue_buffer()
+{
+    num_queued++;
+    used_buffer_space = 0;
+    schedule_writer();
+}
+
+/**
+ * @brief Drop everything that has not been written yet
+ * @note Must be called with the writer lock and the mutex held
+ */
+static void reset_buffers()
+{
+    write_index = 0;
+    num_queued  = 0;
+    used_buffer_space = 0;
+}
+
+/**
+ * @brief Write the queued buffers to flash, runs as a low priority callback
+ */
+static void write_queued_buffers()
+{
+    writerlock();
+    mutexlock();
+    while (num_queued && !log_is_full) {
+        DebugLogEntryData *pending = &buffers[write_index];
+
+        // producers never touch a queued buffer and a format waits for the
+        // writer lock, so the flash write can run without the mutex
+        mutexunlock();
+        bool written = PIOS_FLASHFS_ObjSave(pios_user_fs_id, LOG_GET_FLIGHT_OBJID(pending->Flight), pending->Entry,
+                                            (uint8_t *)pending, sizeof(DebugLogEntryData)) == 0;
+        mutexlock();
+
+        if (written) {
+            write_index = (write_index + 1) % PIOS_DEBUGLOG_NUM_BUFFERS;
+            num_queued--;
+            fails_count = 0;
+        } else if (fails_count++ > MAX_CONSECUTIVE_FAILS_COUNT) {
+            log_is_full      = true;
+            dropped_buffers += num_queued;
+            reset_buffers();
+        } else {
+            schedule_writer_retry();
+            break;
         }
-        return false;
     }
-    return true;
+    mutexunlock();
+    writerunlock();
 }
 /**
  * @}
@@ -35,10 +35,52 @@
 #include <pios_wdg.h>
 #include "pios_flashfs_logfs_priv.h"
 
+/*
+ * The RAM slot index needs a heap, builds without FreeRTOS always scan the flash.
+ * Boards that are short on RAM can opt out with PIOS_FLASHFS_LOGFS_NO_INDEX.
+ */
+#if defined(PIOS_INCLUDE_FREERTOS) && !defined(PIOS_FLASHFS_LOGFS_NO_INDEX)
+#define LOGFS_INDEX
+#define LOGFS_INDEX_MIN_SIZE 32
+#endif
+
+/*
+ * Garbage collection can also run a few slots at a time from a low priority
+ * callback, which keeps saves from stalling on a full collection.  Boards opt
+ * in with PIOS_FLASHFS_LOGFS_BACKGROUND_GC: the callback runs in the auxiliary
+ * callback task, spawned on first use with its own stack.
+ */
+#if defined(PIOS_INCLUDE_CALLBACKSCHEDULER) && defined(PIOS_FLASHFS_LOGFS_BACKGROUND_GC)
+#define LOGFS_BACKGROUND_GC
+#include <utlist.h>
+#endif
+
+#ifndef PIOS_FLASHFS_LOGFS_GC_STEP_SLOTS
+#define PIOS_FLASHFS_LOGFS_GC_STEP_SLOTS 8
+#endif
+#ifndef PIOS_FLASHFS_LOGFS_GC_STEP_PERIOD_MS
+#define PIOS_FLASHFS_LOGFS_GC_STEP_PERIOD_MS 5
+#endif
+#ifndef PIOS_FLASHFS_LOGFS_GC_STACK_SIZE
+#define PIOS_FLASHFS_LOGFS_GC_STACK_SIZE 512
+#endif
+
 /*
  * Filesystem state data tracked in RAM
  */
 
+#ifdef LOGFS_INDEX
+/*
+ * One bucket of the slot index, an open addressed hash table of the active
+ * slots.  Only a 16 bit hash of (obj_id, obj_inst_id) is kept, a hit is
+ * confirmed by reading the slot header from flash.
+ */
+struct logfs_index_entry {
+    uint16_t hash;
+    uint16_t slot_id; /* 0 for an empty bucket, slot 0 holds the arena header */
+};
+#endif
+
 enum pios_flashfs_logfs_dev_magic {
     PIOS_FLASHFS_LOGFS_DEV_MAGIC = 0x94938201,
 };
@@ -56,11 +98,39 @@ struct logfs_state {
     uint16_t num_free_slots; /* slots in free state */
     uint16_t num_active_slots; /* slots in active state */
 
+#ifdef LOGFS_INDEX
+    struct logfs_index_entry *index;
+    uint16_t index_size; /* number of buckets, a power of 2 */
+    uint16_t index_count; /* buckets in use */
+    bool     index_valid; /* index covers every active slot, otherwise scan the flash */
+    bool     index_duplicates; /* more than one active slot was found for some object */
+#endif
+
+    /* Garbage collection into gc_dst_arena_id, may be spread over several steps */
+    bool     gc_active;
+    uint8_t  gc_dst_arena_id;
+    uint8_t  gc_erased_sectors; /* sectors of the destination arena erased so far */
+    uint16_t gc_src_slot_id; /* next slot of the active arena to migrate */
+    uint16_t gc_dst_slot_id; /* next slot to fill in the destination arena */
+    uint16_t gc_count; /* completed collections */
+    uint32_t gc_max_pause_us; /* longest time a collection held the flash in one go */
+#ifdef LOGFS_INDEX
+    uint32_t *gc_migrated; /* one bit per source slot copied so far, NULL to scan the destination instead */
+#endif
+#ifdef LOGFS_BACKGROUND_GC
+    struct logfs_state *next;
+#endif
+
     /* Underlying flash driver glue */
     const struct pios_flash_driver *driver;
     uintptr_t flash_id;
 };
 
+#ifdef LOGFS_BACKGROUND_GC
+/* All filesystem instances, walked by the background garbage collection callback */
+static struct logfs_state *logfs_gc_instances;
+#endif
+
 /*
  * Internal Utility functions
  */
@@ -111,24 +181,31 @@ struct arena_header {
 ****************************************/
 
 /**
- * @brief Erases all sectors within the given arena and sets arena to erased state.
+ * @brief Erases one sector of the given arena.
  * @return 0 if success, < 0 on failure
  * @note Must be called while holding the flash transaction lock
  */
-static int32_t logfs_erase_arena(const struct logfs_state *logfs, uint8_t arena_id)
+static int32_t logfs_erase_arena_sector(const struct logfs_state *logfs, uint8_t arena_id, uint8_t sector_id)
 {
     uintptr_t arena_addr = logfs_get_addr(logfs, arena_id, 0);
 
-    /* Erase all of the sectors in the arena */
-    for (uint8_t sector_id = 0;
-         sector_id < (logfs->cfg->arena_size / logfs->cfg->sector_size);
-         sector_id++) {
-        if (logfs->driver->erase_sector(logfs->flash_id,
-                                        arena_addr + (sector_id * logfs->cfg->sector_size))) {
-            return -1;
-        }
+    if (logfs->driver->erase_sector(logfs->flash_id,
+                                    arena_addr + (sector_id * logfs->cfg->sector_size))) {
+        return -1;
     }
 
+    return 0;
+}
+
+/**
+ * @brief Sets an arena whose sectors have all been erased to erased state.
+ * @return 0 if success, < 0 on failure
+ * @note Must be called while holding the flash transaction lock
+ */
+static int32_t logfs_mark_arena_erased(const struct logfs_state *logfs, uint8_t arena_id)
+{
+    uintptr_t arena_addr = logfs_get_addr(logfs, arena_id, 0);
+
     /* Mark this arena as fully erased */
     struct arena_header arena_hdr = {
         .magic = logfs->cfg->fs_magic,
@@ -139,6 +216,29 @@ static int32_t logfs_erase_arena(const struct logfs_state *logfs, uint8_t arena_
                                   arena_addr,
                                   (uint8_t *)&arena_hdr,
                                   sizeof(arena_hdr)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Erases all sectors within the given arena and sets arena to erased state.
+ * @return 0 if success, < 0 on failure
+ * @note Must be called while holding the flash transaction lock
+ */
+static int32_t logfs_erase_arena(const struct logfs_state *logfs, uint8_t arena_id)
+{
+    /* Erase all of the sectors in the arena */
+    for (uint8_t sector_id = 0;
+         sector_id < (logfs->cfg->arena_size / logfs->cfg->sector_size);
+         sector_id++) {
+        if (logfs_erase_arena_sector(logfs, arena_id, sector_id) != 0) {
+            return -1;
+        }
+    }
+
+    if (logfs_mark_arena_erased(logfs, arena_id) != 0) {
         return -2;
     }
 
@@ -356,18 +456,13 @@ struct slot_header {
 /* NOTE: Must be called while holding the flash transaction lock */
 static int32_t logfs_raw_copy_bytes(const struct logfs_state *logfs, uintptr_t src_addr, uint16_t src_size, uintptr_t dst_addr)
 {
-#define RAW_COPY_BLOCK_SIZE 16
+#define RAW_COPY_BLOCK_SIZE 64
     uint8_t data_block[RAW_COPY_BLOCK_SIZE];
 
     while (src_size) {
-        uint16_t blk_size;
-        if (src_size >= RAW_COPY_BLOCK_SIZE) {
-            /* Copy a full block */
-            blk_size = RAW_COPY_BLOCK_SIZE;
-        } else {
-            /* Copy the remainder */
-            blk_size = src_size;
-        }
+        /* Copy a full block or the remainder, individual writes must fit within a single page buffer */
+        uint16_t page_remaining = logfs->cfg->page_size - (dst_addr % logfs->cfg->page_size);
+        uint16_t blk_size = MIN(MIN(src_size, RAW_COPY_BLOCK_SIZE), page_remaining);
 
         /* Read a block of data from source */
         if (logfs->driver->read_data(logfs->flash_id,
@@ -416,6 +511,192 @@ static bool logfs_log_is_full(const struct logfs_state *logfs)
     return logfs->num_free_slots == 0;
 }
 
+#ifdef LOGFS_INDEX
+/****************************************
+* RAM slot index
+****************************************/
+
+static uint16_t logfs_index_hash(uint32_t obj_id, uint16_t obj_inst_id)
+{
+    return (uint16_t)(((obj_id ^ ((uint32_t)obj_inst_id << 16 | obj_inst_id)) * 0x9E3779B1) >> 16);
+}
+
+/**
+ * @brief Drop all entries from the index, it is valid again once the log has been rescanned
+ */
+static void logfs_index_clear(struct logfs_state *logfs)
+{
+    if (logfs->index) {
+        memset(logfs->index, 0, logfs->index_size * sizeof(*logfs->index));
+    }
+    logfs->index_count = 0;
+    logfs->index_valid = true;
+    logfs->index_duplicates = false;
+}
+
+/**
+ * @brief Give up on the index until the next mount, lookups fall back to scanning the flash
+ */
+static void logfs_index_disable(struct logfs_state *logfs)
+{
+    if (logfs->index) {
+        pios_free(logfs->index);
+    }
+    logfs->index       = NULL;
+    logfs->index_size  = 0;
+    logfs->index_count = 0;
+    logfs->index_valid = false;
+}
+
+/**
+ * @brief Store a slot in the first free bucket of its probe sequence
+ */
+static void logfs_index_put(struct logfs_state *logfs, uint16_t hash, uint16_t slot_id)
+{
+    uint16_t mask   = logfs->index_size - 1;
+    uint16_t bucket = hash & mask;
+
+    while (logfs->index[bucket].slot_id != 0) {
+        bucket = (bucket + 1) & mask;
+    }
+    logfs->index[bucket].hash    = hash;
+    logfs->index[bucket].slot_id = slot_id;
+    logfs->index_count++;
+}
+
+/**
+ * @brief Make room for one more entry, the index is kept at most 3/4 full
+ * @return 0 if success, -1 if the index is unavailable
+ */
+static int32_t logfs_index_reserve(struct logfs_state *logfs)
+{
+    if (logfs->index && (logfs->index_count + 1) * 4 <= logfs->index_size * 3) {
+        return 0;
+    }
+
+    uint32_t new_size = logfs->index_size ? logfs->index_size * 2 : LOGFS_INDEX_MIN_SIZE;
+    if (new_size > 0x8000) {
+        logfs_index_disable(logfs);
+        return -1;
+    }
+
+    struct logfs_index_entry *new_index = (struct logfs_index_entry *)pios_malloc(new_size * sizeof(*new_index));
+    if (!new_index) {
+        logfs_index_disable(logfs);
+        return -1;
+    }
+    memset(new_index, 0, new_size * sizeof(*new_index));
+
+    /* Rehash, the stored hash is all that is needed to place an entry */
+    struct logfs_index_entry *old_index = logfs->index;
+    uint16_t old_size = logfs->index_size;
+    logfs->index       = new_index;
+    logfs->index_size  = new_size;
+    logfs->index_count = 0;
+    for (uint16_t bucket = 0; bucket < old_size; bucket++) {
+        if (old_index[bucket].slot_id != 0) {
+            logfs_index_put(logfs, old_index[bucket].hash, old_index[bucket].slot_id);
+        }
+    }
+    if (old_index) {
+        pios_free(old_index);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Look up the active slot holding an object
+ * @param[out] slot_hdr header of the slot that was found
+ * @param[out] bucket index bucket of the slot that was found
+ * @return 0 if found, -1 if not found, -2 if reading a slot header failed
+ * @note Must be called while holding the flash transaction lock
+ */
+static int16_t logfs_index_find(const struct logfs_state *logfs, struct slot_header *slot_hdr, uint16_t *bucket, uint32_t obj_id, uint16_t obj_inst_id)
+{
+    uint16_t hash = logfs_index_hash(obj_id, obj_inst_id);
+    uint16_t mask = logfs->index_size - 1;
+
+    if (logfs->index_count == 0) {
+        return -1;
+    }
+
+    for (uint16_t b = hash & mask; logfs->index[b].slot_id != 0; b = (b + 1) & mask) {
+        if (logfs->index[b].hash != hash) {
+            continue;
+        }
+
+        /* Hash matches, confirm against the slot header */
+        uintptr_t slot_addr = logfs_get_addr(logfs, logfs->active_arena_id, logfs->index[b].slot_id);
+        if (logfs->driver->read_data(logfs->flash_id,
+                                     slot_addr,
+                                     (uint8_t *)slot_hdr,
+                                     sizeof(*slot_hdr)) != 0) {
+            return -2;
+        }
+        if (slot_hdr->state == SLOT_STATE_ACTIVE &&
+            slot_hdr->obj_id == obj_id &&
+            slot_hdr->obj_inst_id == obj_inst_id) {
+            *bucket = b;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Add an active slot to the index
+ * @note Must be called while holding the flash transaction lock
+ */
+static void logfs_index_add(struct logfs_state *logfs, uint16_t slot_id, uint32_t obj_id, uint16_t obj_inst_id)
+{
+    if (!logfs->index_valid || logfs_index_reserve(logfs) != 0) {
+        return;
+    }
+    logfs_index_put(logfs, logfs_index_hash(obj_id, obj_inst_id), slot_id);
+}
+
+/**
+ * @brief Remove a bucket from the index, later entries of the cluster are moved back into the gap
+ */
+static void logfs_index_remove(struct logfs_state *logfs, uint16_t bucket)
+{
+    uint16_t mask = logfs->index_size - 1;
+    uint16_t next = bucket;
+
+    logfs->index[bucket].slot_id = 0;
+    logfs->index_count--;
+
+    while (true) {
+        next = (next + 1) & mask;
+        if (logfs->index[next].slot_id == 0) {
+            break;
+        }
+        /* Move the entry back unless its home bucket lies cyclically within (bucket, next] */
+        uint16_t home = logfs->index[next].hash & mask;
+        if (((next - home) & mask) >= ((next - bucket) & mask)) {
+            logfs->index[bucket] = logfs->index[next];
+            logfs->index[next].slot_id = 0;
+            bucket = next;
+        }
+    }
+}
+
+/**
+ * @brief Remove a slot from the index, if it is there
+ */
+static void logfs_index_remove_slot(struct logfs_state *logfs, uint16_t slot_id)
+{
+    for (uint16_t bucket = 0; bucket < logfs->index_size; bucket++) {
+        if (logfs->index[bucket].slot_id == slot_id) {
+            logfs_index_remove(logfs, bucket);
+            return;
+        }
+    }
+}
+#endif /* LOGFS_INDEX */
+
 static int32_t logfs_unmount_log(struct logfs_state *logfs)
 {
     PIOS_Assert(logfs->mounted);
@@ -423,6 +704,9 @@ static int32_t logfs_unmount_log(struct logfs_state *logfs)
     logfs->num_active_slots = 0;
     logfs->num_free_slots   = 0;
     logfs->mounted = false;
+#ifdef LOGFS_INDEX
+    logfs_index_clear(logfs);
+#endif
 
     return 0;
 }
@@ -434,6 +718,9 @@ static int32_t logfs_mount_log(struct logfs_state *logfs, uint8_t arena_id)
     logfs->num_active_slots = 0;
     logfs->num_free_slots   = 0;
     logfs->active_arena_id  = arena_id;
+#ifdef LOGFS_INDEX
+    logfs_index_clear(logfs);
+#endif
 
     /* Scan the log to find out how full it is */
     for (uint16_t slot_id = 1;
@@ -461,6 +748,23 @@ static int32_t logfs_mount_log(struct logfs_state *logfs, uint8_t arena_id)
             break;
         case SLOT_STATE_ACTIVE:
             logfs->num_active_slots++;
+#ifdef LOGFS_INDEX
+            if (logfs->index_valid) {
+                /* Like the flash scan, the first active copy of an object wins */
+                struct slot_header dup_hdr;
+                uint16_t bucket;
+                switch (logfs_index_find(logfs, &dup_hdr, &bucket, slot_hdr.obj_id, slot_hdr.obj_inst_id)) {
+                case 0:
+                    logfs->index_duplicates = true;
+                    break;
+                case -1:
+                    logfs_index_add(logfs, slot_id, slot_hdr.obj_id, slot_hdr.obj_inst_id);
+                    break;
+                default:
+                    return -1;
+                }
+            }
+#endif
             break;
         case SLOT_STATE_RESERVED:
         case SLOT_STATE_OBSOLETE:
@@ -497,6 +801,12 @@ static void PIOS_FLASHFS_Logfs_free(struct logfs_state *logfs)
 {
     /* Invalidate the magic */
     logfs->magic = ~PIOS_FLASHFS_LOGFS_DEV_MAGIC;
+#ifdef LOGFS_INDEX
+    logfs_index_disable(logfs);
+    if (logfs->gc_migrated) {
+        pios_free(logfs->gc_migrated);
+    }
+#endif
     vPortFree(logfs);
 }
 #else
@@ -559,6 +869,14 @@ int32_t PIOS_FLASHFS_Logfs_Init(uintptr_t *fs_id, const struct flashfs_logfs_cfg
     logfs->driver   = driver; /* lower-level flash driver */
     logfs->flash_id = flash_id; /* lower-level flash device id */
     logfs->mounted  = false;
+#ifdef LOGFS_INDEX
+    logfs->index      = NULL;
+    logfs->index_size = 0;
+    logfs->gc_migrated = NULL;
+#endif
+    logfs->gc_active  = false;
+    logfs->gc_count   = 0;
+    logfs->gc_max_pause_us = 0;
 
     if (logfs->driver->start_transaction(logfs->flash_id) != 0) {
         rc = -1;
@@ -602,6 +920,9 @@ int32_t PIOS_FLASHFS_Logfs_Init(uintptr_t *fs_id, const struct flashfs_logfs_cfg
     rc     = 0;
 
     *fs_id = (uintptr_t)logfs;
+#ifdef LOGFS_BACKGROUND_GC
+    LL_APPEND(logfs_gc_instances, logfs);
+#endif
 
 out_end_trans:
     logfs->driver->end_transaction(logfs->flash_id);
@@ -621,6 +942,9 @@ int32_t PIOS_FLASHFS_Logfs_Destroy(uintptr_t fs_id)
         goto out_exit;
     }
 
+#ifdef LOGFS_BACKGROUND_GC
+    LL_DELETE(logfs_gc_instances, logfs);
+#endif
     PIOS_FLASHFS_Logfs_free(logfs);
     rc = 0;
 
@@ -628,59 +952,159 @@ out_exit:
     return rc;
 }
 
+/****************************************
+* Garbage collection
+****************************************/
+
+/*
+ * A collection copies the active slots of the active arena into the next arena
+ * and then makes that one active.  It either runs to completion when the log is
+ * full, or is spread over bounded steps while the active arena keeps taking
+ * writes.  Slots that are obsoleted after they have been migrated are
+ * obsoleted again in the destination arena, see logfs_gc_slot_obsoleted().
+ */
+
+/*
+ * Is a collection worthwhile yet?
+ * true = the log is three quarters full and a collection would at least double the free space
+ */
+static bool logfs_gc_wanted(const struct logfs_state *logfs)
+{
+    uint16_t num_slots    = (logfs->cfg->arena_size / logfs->cfg->slot_size) - 1;
+    uint16_t num_obsolete = num_slots - logfs->num_free_slots - logfs->num_active_slots;
+
+    return (logfs->num_free_slots < num_slots / 4) &&
+           (num_obsolete > 0) &&
+           (num_obsolete >= logfs->num_free_slots);
+}
+
+static uint32_t logfs_gc_timer_start(void)
+{
+#ifdef PIOS_INCLUDE_DELAY
+    return PIOS_DELAY_GetRaw();
+#else
+    return 0;
+#endif
+}
+
+static void logfs_gc_timer_stop(struct logfs_state *logfs, __attribute__((unused)) uint32_t raw_start)
+{
+#ifdef PIOS_INCLUDE_DELAY
+    uint32_t pause_us = PIOS_DELAY_DiffuS(raw_start);
+    if (pause_us > logfs->gc_max_pause_us) {
+        logfs->gc_max_pause_us = pause_us;
+    }
+#endif
+}
+
+#ifdef LOGFS_INDEX
+static uint16_t logfs_gc_migrated_words(const struct logfs_state *logfs)
+{
+    return (logfs->cfg->arena_size / logfs->cfg->slot_size + 31) / 32;
+}
+#endif
+
 /* NOTE: Must be called while holding the flash transaction lock */
-static int32_t logfs_garbage_collect(struct logfs_state *logfs)
+static void logfs_gc_begin(struct logfs_state *logfs)
 {
     PIOS_Assert(logfs->mounted);
+    PIOS_Assert(!logfs->gc_active);
 
-    /* Source arena is the active arena */
-    uint8_t src_arena_id = logfs->active_arena_id;
-
-    /* Compute destination arena */
-    uint8_t dst_arena_id = (logfs->active_arena_id + 1) % (logfs->cfg->total_fs_size / logfs->cfg->arena_size);
+    logfs->gc_dst_arena_id   = (logfs->active_arena_id + 1) % (logfs->cfg->total_fs_size / logfs->cfg->arena_size);
+    logfs->gc_erased_sectors = 0;
+    logfs->gc_src_slot_id    = 1;
+    logfs->gc_dst_slot_id    = 1;
+    logfs->gc_active = true;
 
-    /* Erase destination arena */
-    if (logfs_erase_arena(logfs, dst_arena_id) != 0) {
-        return -1;
+#ifdef LOGFS_INDEX
+    if (logfs->gc_migrated) {
+        memset(logfs->gc_migrated, 0, logfs_gc_migrated_words(logfs) * sizeof(uint32_t));
     }
+#endif
+}
 
-    /* Reserve the destination arena so we can start filling it */
-    if (logfs_reserve_arena(logfs, dst_arena_id) != 0) {
-        /* Unable to reserve the arena */
-        return -2;
+/**
+ * @brief Perform a bounded amount of the collection in progress
+ * @param[in] max_slots Maximum number of source slots to migrate
+ * @return 1 if the collection needs more steps, 0 once it has completed, < 0 on failure
+ * @note Each step erases at most one sector of the destination arena
+ * @note A failed collection is abandoned, the next one starts over
+ * @note Must be called while holding the flash transaction lock
+ */
+static int32_t logfs_gc_step(struct logfs_state *logfs, uint16_t max_slots)
+{
+    PIOS_Assert(logfs->gc_active);
+
+    int32_t rc;
+    uint8_t src_arena_id = logfs->active_arena_id;
+    uint8_t dst_arena_id = logfs->gc_dst_arena_id;
+    uint8_t num_sectors  = logfs->cfg->arena_size / logfs->cfg->sector_size;
+    uint16_t num_slots   = logfs->cfg->arena_size / logfs->cfg->slot_size;
+
+    /* Erase the destination arena first, one sector at a time */
+    if (logfs->gc_erased_sectors < num_sectors) {
+        if (logfs_erase_arena_sector(logfs, dst_arena_id, logfs->gc_erased_sectors) != 0) {
+            rc = -1;
+            goto out_abort;
+        }
+        if (++logfs->gc_erased_sectors < num_sectors) {
+            return 1;
+        }
+
+        /* Reserve the destination arena so we can start filling it */
+        if (logfs_mark_arena_erased(logfs, dst_arena_id) != 0 ||
+            logfs_reserve_arena(logfs, dst_arena_id) != 0) {
+            rc = -2;
+            goto out_abort;
+        }
+        return 1;
     }
 
-    /* Copy active slots from active arena to destination arena */
-    uint16_t dst_slot_id = 1;
-    for (uint16_t src_slot_id = 1;
-         src_slot_id < (logfs->cfg->arena_size / logfs->cfg->slot_size);
-         src_slot_id++) {
+    /* Copy active slots from active arena to destination arena, up to the end of the log */
+    uint16_t log_end = num_slots - logfs->num_free_slots;
+    while (max_slots > 0 && logfs->gc_src_slot_id < log_end) {
         struct slot_header slot_hdr;
-        uintptr_t src_addr = logfs_get_addr(logfs, src_arena_id, src_slot_id);
+        uintptr_t src_addr = logfs_get_addr(logfs, src_arena_id, logfs->gc_src_slot_id);
         if (logfs->driver->read_data(logfs->flash_id,
                                      src_addr,
                                      (uint8_t *)&slot_hdr,
                                      sizeof(slot_hdr)) != 0) {
-            return -3;
+            rc = -3;
+            goto out_abort;
         }
 
         if (slot_hdr.state == SLOT_STATE_ACTIVE) {
-            uintptr_t dst_addr = logfs_get_addr(logfs, dst_arena_id, dst_slot_id);
+            /* Every source slot is copied at most once, so the destination can't overflow */
+            PIOS_Assert(logfs->gc_dst_slot_id < num_slots);
+            uintptr_t dst_addr = logfs_get_addr(logfs, dst_arena_id, logfs->gc_dst_slot_id);
             if (logfs_raw_copy_bytes(logfs,
                                      src_addr,
                                      sizeof(slot_hdr) + slot_hdr.obj_size,
                                      dst_addr) != 0) {
                 /* Failed to copy all bytes */
-                return -4;
+                rc = -4;
+                goto out_abort;
+            }
+            logfs->gc_dst_slot_id++;
+#ifdef LOGFS_INDEX
+            if (logfs->gc_migrated) {
+                logfs->gc_migrated[logfs->gc_src_slot_id / 32] |= 1u << (logfs->gc_src_slot_id % 32);
             }
-            dst_slot_id++;
+#endif
         }
+        logfs->gc_src_slot_id++;
+        max_slots--;
 #ifdef PIOS_INCLUDE_WDG
         PIOS_WDG_Clear();
 #endif
     }
 
-    /* Activate the destination arena */
+    if (logfs->gc_src_slot_id < log_end) {
+        return 1;
+    }
+
+    /* Caught up with the log, activate the destination arena */
+    logfs->gc_active = false;
     if (logfs_activate_arena(logfs, dst_arena_id) != 0) {
         return -5;
     }
@@ -700,9 +1124,153 @@ static int32_t logfs_garbage_collect(struct logfs_state *logfs)
         return -8;
     }
 
+    logfs->gc_count++;
+    return 0;
+
+out_abort:
+    logfs->gc_active = false;
+    return rc;
+}
+
+/**
+ * @brief Obsolete a slot of the destination arena if it still holds the given object
+ * @return 1 if it did, 0 if the slot holds something else, < 0 on failure
+ * @note Must be called while holding the flash transaction lock
+ */
+static int32_t logfs_gc_obsolete_dst_slot(struct logfs_state *logfs, uint16_t dst_slot_id, uint32_t obj_id, uint16_t obj_inst_id)
+{
+    struct slot_header slot_hdr;
+    uintptr_t slot_addr = logfs_get_addr(logfs, logfs->gc_dst_arena_id, dst_slot_id);
+
+    if (logfs->driver->read_data(logfs->flash_id,
+                                 slot_addr,
+                                 (uint8_t *)&slot_hdr,
+                                 sizeof(slot_hdr)) != 0) {
+        return -1;
+    }
+    if (slot_hdr.state != SLOT_STATE_ACTIVE ||
+        slot_hdr.obj_id != obj_id ||
+        slot_hdr.obj_inst_id != obj_inst_id) {
+        return 0;
+    }
+    slot_hdr.state = SLOT_STATE_OBSOLETE;
+    if (logfs->driver->write_data(logfs->flash_id,
+                                  slot_addr,
+                                  (uint8_t *)&slot_hdr,
+                                  sizeof(slot_hdr)) != 0) {
+        return -2;
+    }
+    return 1;
+}
+
+/**
+ * @brief Keep the destination arena in step when a slot of the active arena is obsoleted
+ * @return 0 if success, < 0 on failure
+ * @note Must be called while holding the flash transaction lock
+ */
+static int32_t logfs_gc_slot_obsoleted(struct logfs_state *logfs, uint16_t slot_id, uint32_t obj_id, uint16_t obj_inst_id)
+{
+    if (!logfs->gc_active || slot_id >= logfs->gc_src_slot_id) {
+        /* Not migrated (yet), nothing to do */
+        return 0;
+    }
+
+#ifdef LOGFS_INDEX
+    if (logfs->gc_migrated) {
+        /* Slots are copied in order, the copy follows the ones of all lower migrated slots */
+        if (!(logfs->gc_migrated[slot_id / 32] & (1u << (slot_id % 32)))) {
+            return 0;
+        }
+        uint16_t dst_slot_id = 1 + __builtin_popcount(logfs->gc_migrated[slot_id / 32] & ((1u << (slot_id % 32)) - 1));
+        for (uint16_t word = 0; word < slot_id / 32; word++) {
+            dst_slot_id += __builtin_popcount(logfs->gc_migrated[word]);
+        }
+        int32_t rc = logfs_gc_obsolete_dst_slot(logfs, dst_slot_id, obj_id, obj_inst_id);
+        return (rc < 0) ? rc : 0;
+    }
+#endif
+
+    for (uint16_t dst_slot_id = 1; dst_slot_id < logfs->gc_dst_slot_id; dst_slot_id++) {
+        if (logfs_gc_obsolete_dst_slot(logfs, dst_slot_id, obj_id, obj_inst_id) < 0) {
+            return -1;
+        }
+    }
+
     return 0;
 }
 
+/**
+ * @brief Run a complete collection, finishing the one in progress if there is one
+ * @return 0 if success, < 0 on failure
+ * @note Must be called while holding the flash transaction lock
+ */
+static int32_t logfs_garbage_collect(struct logfs_state *logfs)
+{
+    PIOS_Assert(logfs->mounted);
+
+    int32_t rc;
+    uint32_t raw_start = logfs_gc_timer_start();
+    bool resumed = logfs->gc_active;
+
+    if (!resumed) {
+        logfs_gc_begin(logfs);
+    }
+    while ((rc = logfs_gc_step(logfs, UINT16_MAX)) > 0) {
+        ;
+    }
+
+    if (rc == 0 && resumed && logfs_log_is_full(logfs)) {
+        /* Too much of what was migrated got obsoleted meanwhile, start over */
+        logfs_gc_begin(logfs);
+        while ((rc = logfs_gc_step(logfs, UINT16_MAX)) > 0) {
+            ;
+        }
+    }
+
+    logfs_gc_timer_stop(logfs, raw_start);
+    return rc;
+}
+
+#ifdef LOGFS_BACKGROUND_GC
+static DelayedCallbackInfo *logfs_gc_callback;
+
+static void logfs_gc_callback_run(void)
+{
+    bool more = false;
+    struct logfs_state *logfs;
+
+    LL_FOREACH(logfs_gc_instances, logfs) {
+        if (PIOS_FLASHFS_Logfs_GarbageCollectStep((uintptr_t)logfs, PIOS_FLASHFS_LOGFS_GC_STEP_SLOTS) > 0) {
+            more = true;
+        }
+    }
+
+    if (more) {
+        PIOS_CALLBACKSCHEDULER_Schedule(logfs_gc_callback, PIOS_FLASHFS_LOGFS_GC_STEP_PERIOD_MS, CALLBACK_UPDATEMODE_NONE);
+    }
+}
+
+/**
+ * @brief Have the background callback collect the log before it fills up
+ * @note Must be called while holding the flash transaction lock, which also guards creating the callback
+ */
+static void logfs_gc_schedule(struct logfs_state *logfs)
+{
+    if (!logfs->gc_active && !logfs_gc_wanted(logfs)) {
+        return;
+    }
+
+    /* Created on first use, the callback scheduler is initialised after the filesystems */
+    if (!logfs_gc_callback) {
+        logfs_gc_callback = PIOS_CALLBACKSCHEDULER_Create(&logfs_gc_callback_run, CALLBACK_PRIORITY_LOW, CALLBACK_TASK_AUXILIARY, -1, PIOS_FLASHFS_LOGFS_GC_STACK_SIZE);
+        if (!logfs_gc_callback) {
+            return;
+        }
+    }
+    PIOS_CALLBACKSCHEDULER_Schedule(logfs_gc_callback, PIOS_FLASHFS_LOGFS_GC_STEP_PERIOD_MS, CALLBACK_UPDATEMODE_NONE);
+}
+#endif /* LOGFS_BACKGROUND_GC */
+
 /* NOTE: Must be called while holding the flash transaction lock */
 static int16_t logfs_object_find_next(const struct logfs_state *logfs, struct slot_header *slot_hdr, uint16_t *curr_slot, uint32_t obj_id, uint16_t obj_inst_id)
 {
@@ -746,7 +1314,6 @@ static int16_t logfs_object_find_next(const struct logfs_state *logfs, struct sl
 }
 
 /* NOTE: Must be called while holding the flash transaction lock */
-/* OPTIMIZE: could trust that there is at most one active version of every object and terminate the search when we find one */
 static int8_t logfs_delete_object(struct logfs_state *logfs, uint32_t obj_id, uint16_t obj_inst_id)
 {
     int8_t rc;
@@ -754,6 +1321,39 @@ static int8_t logfs_delete_object(struct logfs_state *logfs, uint32_t obj_id, ui
     bool more = true;
     uint16_t curr_slot_id = 0;
 
+#ifdef LOGFS_INDEX
+    if (logfs->index_valid && !logfs->index_duplicates) {
+        /* There is at most one active version of the object, the index knows where */
+        struct slot_header slot_hdr;
+        uint16_t bucket;
+        switch (logfs_index_find(logfs, &slot_hdr, &bucket, obj_id, obj_inst_id)) {
+        case 0:
+            curr_slot_id   = logfs->index[bucket].slot_id;
+            slot_hdr.state = SLOT_STATE_OBSOLETE;
+            uintptr_t slot_addr = logfs_get_addr(logfs, logfs->active_arena_id, curr_slot_id);
+
+            if (logfs->driver->write_data(logfs->flash_id,
+                                          slot_addr,
+                                          (uint8_t *)&slot_hdr,
+                                          sizeof(slot_hdr)) != 0) {
+                return -2;
+            }
+            logfs->num_active_slots--;
+            logfs_index_remove(logfs, bucket);
+            if (logfs_gc_slot_obsoleted(logfs, curr_slot_id, obj_id, obj_inst_id) != 0) {
+                return -3;
+            }
+            return 0;
+
+        case -1:
+            return 0;
+
+        default:
+            return -1;
+        }
+    }
+#endif /* LOGFS_INDEX */
+
     do {
         struct slot_header slot_hdr;
         switch (logfs_object_find_next(logfs, &slot_hdr, &curr_slot_id, obj_id, obj_inst_id)) {
@@ -771,6 +1371,15 @@ static int8_t logfs_delete_object(struct logfs_state *logfs, uint32_t obj_id, ui
             }
             /* Object has been successfully obsoleted and is no longer active */
             logfs->num_active_slots--;
+#ifdef LOGFS_INDEX
+            if (logfs->index_valid) {
+                logfs_index_remove_slot(logfs, curr_slot_id);
+            }
+#endif
+            if (logfs_gc_slot_obsoleted(logfs, curr_slot_id, obj_id, obj_inst_id) != 0) {
+                rc = -3;
+                goto out_exit;
+            }
             break;
         case -1:
             /* Search completed, object not found */
@@ -891,6 +1500,9 @@ static int8_t logfs_append_to_log(struct logfs_state *logfs, uint32_t obj_id, ui
 
     /* Object has been successfully written to the slot */
     logfs->num_active_slots++;
+#ifdef LOGFS_INDEX
+    logfs_index_add(logfs, free_slot_id, obj_id, obj_inst_id);
+#endif
     return 0;
 }
 
@@ -983,6 +1595,10 @@ int32_t PIOS_FLASHFS_ObjSave(uintptr_t fs_id, uint32_t obj_id, uint16_t obj_inst
     /* Object successfully written to the log */
     rc = 0;
 
+#ifdef LOGFS_BACKGROUND_GC
+    logfs_gc_schedule(logfs);
+#endif
+
 out_end_trans:
     logfs->driver->end_transaction(logfs->flash_id);
 
@@ -1025,6 +1641,17 @@ int32_t PIOS_FLASHFS_ObjLoad(uintptr_t fs_id, uint32_t obj_id, uint16_t obj_inst
     /* Find the object in the log */
     uint16_t slot_id = 0;
     struct slot_header slot_hdr;
+#ifdef LOGFS_INDEX
+    if (logfs->index_valid) {
+        uint16_t bucket;
+        if (logfs_index_find(logfs, &slot_hdr, &bucket, obj_id, obj_inst_id) != 0) {
+            /* Object does not exist in fs */
+            rc = -3;
+            goto out_end_trans;
+        }
+        slot_id = logfs->index[bucket].slot_id;
+    } else
+#endif
     if (logfs_object_find_next(logfs, &slot_hdr, &slot_id, obj_id, obj_inst_id) != 0) {
         /* Object does not exist in fs */
         rc = -3;
@@ -1126,6 +1753,7 @@ int32_t PIOS_FLASHFS_Format(uintptr_t fs_id)
     if (logfs->mounted) {
         logfs_unmount_log(logfs);
     }
+    logfs->gc_active = false;
 
     if (logfs->driver->start_transaction(logfs->flash_id) != 0) {
         rc = -2;
@@ -1174,8 +1802,69 @@ int32_t PIOS_FLASHFS_GetStats(uintptr_t fs_id, struct PIOS_FLASHFS_Stats *stats)
     }
     stats->num_active_slots = logfs->num_active_slots;
     stats->num_free_slots   = logfs->num_free_slots;
+    stats->gc_max_pause_us  = logfs->gc_max_pause_us;
+    stats->gc_count = logfs->gc_count;
+    if (logfs->gc_active) {
+        stats->gc_progress = 1 + (98 * logfs->gc_src_slot_id) / (logfs->cfg->arena_size / logfs->cfg->slot_size);
+    } else {
+        stats->gc_progress = 0;
+    }
     return 0;
 }
+
+/**
+ * @brief Run one bounded step of the incremental garbage collection
+ * @param[in] fs_id The filesystem to use for this action
+ * @param[in] max_slots Maximum number of slots to migrate in this step
+ * @return 1 if the collection needs more steps, 0 if there is nothing to do, or error code
+ * @retval -1 if fs_id is not a valid filesystem instance
+ * @retval -2 if failed to start transaction
+ * @retval -3 if garbage collection failed
+ * @note A collection is only started once the log is filling up with obsolete slots
+ */
+int32_t PIOS_FLASHFS_Logfs_GarbageCollectStep(uintptr_t fs_id, uint16_t max_slots)
+{
+    int32_t rc;
+
+    struct logfs_state *logfs = (struct logfs_state *)fs_id;
+
+    if (!PIOS_FLASHFS_Logfs_validate(logfs)) {
+        rc = -1;
+        goto out_exit;
+    }
+
+    if (logfs->driver->start_transaction(logfs->flash_id) != 0) {
+        rc = -2;
+        goto out_exit;
+    }
+
+    if (!logfs->gc_active) {
+        if (!logfs->mounted || !logfs_gc_wanted(logfs)) {
+            rc = 0;
+            goto out_end_trans;
+        }
+#ifdef LOGFS_INDEX
+        /* Only needed when saves and deletes can happen between the steps */
+        if (!logfs->gc_migrated) {
+            logfs->gc_migrated = (uint32_t *)pios_malloc(logfs_gc_migrated_words(logfs) * sizeof(uint32_t));
+        }
+#endif
+        logfs_gc_begin(logfs);
+    }
+
+    uint32_t raw_start = logfs_gc_timer_start();
+    rc = logfs_gc_step(logfs, max_slots);
+    logfs_gc_timer_stop(logfs, raw_start);
+    if (rc < 0) {
+        rc = -3;
+    }
+
+out_end_trans:
+    logfs->driver->end_transaction(logfs->flash_id);
+
+out_exit:
+    return rc;
+}
 #endif /* PIOS_INCLUDE_FLASH */
 
 /**
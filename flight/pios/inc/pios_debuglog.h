@@ -84,6 +84,13 @@ int32_t PIOS_DEBUGLOG_Read(void *buffer, uint16_t flight, uint16_t inst);
  */
 void PIOS_DEBUGLOG_Info(uint16_t *flight, uint16_t *entry, uint16_t *free, uint16_t *used);
 
+/**
+ * @brief Retrieve how much has been lost instead of stalling the caller
+ * @param[out] entries dropped because every log buffer was waiting to be written
+ * @param[out] lost_buffers dropped because they could not be written to flash
+ */
+void PIOS_DEBUGLOG_DropInfo(uint32_t *entries, uint32_t *lost_buffers);
+
 /**
  * @brief Format entire flash memory!!!
  */
@@ -32,6 +32,9 @@
 struct PIOS_FLASHFS_Stats {
     uint16_t num_free_slots; /* slots in free state */
     uint16_t num_active_slots; /* slots in active state */
+    uint32_t gc_max_pause_us; /* longest time garbage collection held the flash in one go */
+    uint16_t gc_count; /* garbage collections completed */
+    uint8_t  gc_progress; /* percent done of the garbage collection in progress, 0 if none */
 };
 
 int32_t PIOS_FLASHFS_Format(uintptr_t fs_id);
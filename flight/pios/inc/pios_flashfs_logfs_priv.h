@@ -45,4 +45,6 @@ int32_t PIOS_FLASHFS_Logfs_Init(uintptr_t *fs_id, const struct flashfs_logfs_cfg
 
 int32_t PIOS_FLASHFS_Logfs_Destroy(uintptr_t fs_id);
 
+int32_t PIOS_FLASHFS_Logfs_GarbageCollectStep(uintptr_t fs_id, uint16_t max_slots);
+
 #endif /* PIOS_FLASHFS_LOGFS_PRIV_H */
@@ -140,6 +140,8 @@
 /* #define PIOS_INCLUDE_COM_FLEXI */
 /* #define PIOS_INCLUDE_COM_AUX */
 /* #define PIOS_TELEM_PRIORITY_QUEUE */
+#define UAVTALK_DELTA_SLOTS             0 /* Receive delta packets but always send in full, to save RAM */
+/* #define PIOS_TELEM_BUNDLE_WINDOW_MS     0 */ /* Send every update in its own frame, as soon as it is queued */
 #define PIOS_INCLUDE_GPS
 #define PIOS_GPS_MINIMAL
 #define PIOS_INCLUDE_GPS_NMEA_PARSER
@@ -114,6 +114,7 @@
 #define PIOS_INCLUDE_FLASH
 #define PIOS_INCLUDE_FLASH_INTERNAL
 #define PIOS_INCLUDE_FLASH_LOGFS_SETTINGS
+#define PIOS_FLASHFS_LOGFS_BACKGROUND_GC
 /* #define FLASH_FREERTOS */
 /* #define PIOS_INCLUDE_FLASH_EEPROM */
 
@@ -121,6 +121,7 @@
 #define PIOS_INCLUDE_FLASH
 #define PIOS_INCLUDE_FLASH_INTERNAL
 #define PIOS_INCLUDE_FLASH_LOGFS_SETTINGS
+#define PIOS_FLASHFS_LOGFS_BACKGROUND_GC
 #define FLASH_FREERTOS
 /* #define PIOS_INCLUDE_FLASH_EEPROM */
 
@@ -143,6 +144,7 @@
 #define PIOS_INCLUDE_COM_FLEXI
 /* #define PIOS_INCLUDE_COM_AUX */
 #define PIOS_TELEM_PRIORITY_QUEUE
+/* #define PIOS_TELEM_BUNDLE_WINDOW_MS     0 */ /* Send every update in its own frame, as soon as it is queued */
 #define PIOS_INCLUDE_GPS
 /* #define PIOS_GPS_MINIMAL */
 #define PIOS_INCLUDE_GPS_NMEA_PARSER
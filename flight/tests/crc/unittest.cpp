@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h> /* printf */
+#include <string.h> /* memset */
+#include <time.h>
+
+extern "C" {
+#include "pios.h"
+}
+
+#define PATTERN_LEN  1024
+#define BENCH_LEN    4096
+#define BENCH_PASSES 20000
+
+/* Bit at a time reference, CRC-8 with polynomial 0x07 as used by UAVTalk */
+static uint8_t crc8_bitwise(uint8_t crc, const uint8_t *data, int32_t length)
+{
+    while (length-- > 0) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* The byte at a time loop that PIOS_CRC_updateCRC() used before */
+static uint8_t crc8_bytewise(uint8_t crc, const uint8_t *data, int32_t length)
+{
+    while (length-- > 0) {
+        crc = PIOS_CRC_updateByte(crc, *data++);
+    }
+    return crc;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// To use a test fixture, derive a class from testing::Test.
+class CrcTest : public testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        for (uint32_t i = 0; i < sizeof(pattern); i++) {
+            pattern[i] = i * 167 + 13;
+        }
+    }
+
+    virtual void TearDown()
+    {}
+
+    uint8_t pattern[PATTERN_LEN];
+};
+
+/* Golden values, any change here breaks compatibility with existing ground stations and logs */
+TEST_F(CrcTest, GoldenVectors) {
+    static const struct {
+        int32_t length;
+        uint8_t seed;
+        uint8_t crc;
+    } vectors[] = {
+        { 0,    0x5a, 0x5a },
+        { 1,    0x00, 0x23 },
+        { 3,    0x11, 0xc5 },
+        { 4,    0x00, 0x2a },
+        { 5,    0xff, 0xb9 },
+        { 7,    0x80, 0xfb },
+        { 8,    0x00, 0x83 },
+        { 13,   0x3c, 0x3d },
+        { 64,   0x00, 0x20 },
+        { 255,  0x01, 0x0e },
+        { 256,  0x00, 0x0a },
+        { 1024, 0xa5, 0x87 },
+    };
+
+    /* Standard CRC-8 check value */
+    EXPECT_EQ(0xf4, PIOS_CRC_updateCRC(0, (const uint8_t *)"123456789", 9));
+
+    for (uint32_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        EXPECT_EQ(vectors[i].crc, PIOS_CRC_updateCRC(vectors[i].seed, pattern, vectors[i].length)) << "length " << vectors[i].length;
+        EXPECT_EQ(vectors[i].crc, crc8_bitwise(vectors[i].seed, pattern, vectors[i].length)) << "length " << vectors[i].length;
+    }
+}
+
+TEST_F(CrcTest, TableMatchesBitwise) {
+    for (int crc = 0; crc < 256; crc++) {
+        for (int data = 0; data < 256; data++) {
+            uint8_t byte = data;
+            ASSERT_EQ(crc8_bitwise(crc, &byte, 1), PIOS_CRC_updateByte(crc, byte));
+        }
+    }
+}
+
+/* Every length and alignment, so the sliced loop and its tail are both covered */
+TEST_F(CrcTest, BufferMatchesBytewise) {
+    for (int32_t offset = 0; offset < 8; offset++) {
+        for (int32_t length = 0; length < 300; length++) {
+            uint8_t seed = offset * 31 + length;
+            ASSERT_EQ(crc8_bytewise(seed, &pattern[offset], length), PIOS_CRC_updateCRC(seed, &pattern[offset], length))
+                << "offset " << offset << " length " << length;
+        }
+    }
+}
+
+/* Splitting a buffer must not change the result, UAVTalk checksums headers and payload separately */
+TEST_F(CrcTest, Incremental) {
+    uint8_t whole = PIOS_CRC_updateCRC(0, pattern, PATTERN_LEN);
+
+    for (int32_t split = 0; split <= PATTERN_LEN; split += 7) {
+        uint8_t crc = PIOS_CRC_updateCRC(0, pattern, split);
+        EXPECT_EQ(whole, PIOS_CRC_updateCRC(crc, &pattern[split], PATTERN_LEN - split));
+    }
+}
+
+TEST_F(CrcTest, Benchmark) {
+    static uint8_t buffer[BENCH_LEN];
+    volatile uint8_t sink = 0;
+
+    for (uint32_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = i * 7 + 3;
+    }
+
+    double start = now_s();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        sink = crc8_bytewise(sink, buffer, sizeof(buffer));
+    }
+    double bytewise = now_s() - start;
+
+    start = now_s();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        sink = PIOS_CRC_updateCRC(sink, buffer, sizeof(buffer));
+    }
+    double sliced = now_s() - start;
+
+    double total = (double)BENCH_LEN * BENCH_PASSES / 1e6;
+    printf("byte at a time: %7.1f MB/s\n", total / bytewise);
+    printf("slice by 4:     %7.1f MB/s\n", total / sliced);
+}
@@ -0,0 +1,320 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h> /* printf */
+#include <string.h> /* memset */
+#include <time.h>
+
+extern "C" {
+#include "openpilot.h"
+#include "unittest_priv.h"
+}
+
+#define NUM_ENTRIES 500
+#define RUN_TIME_MS 10000
+
+/* The dispatcher task keeps its wakeup time across re-initialisation, so time never goes backwards */
+#define MAX_UPDATE_PERIOD_MS 1000
+static portTickType now_ms;
+
+static uint32_t calls[NUM_ENTRIES];
+static portTickType lastCall[NUM_ENTRIES];
+static uint32_t badIntervals;
+static uint16_t periods[NUM_ENTRIES];
+
+static void periodicCallback(UAVObjEvent *ev)
+{
+    uint16_t i = ev->instId;
+
+    /* The first call is due at once and the second realigns to the randomised phase */
+    if (calls[i] > 1 && now_ms - lastCall[i] != periods[i]) {
+        badIntervals++;
+    }
+    calls[i]++;
+    lastCall[i] = now_ms;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// To use a test fixture, derive a class from testing::Test.
+class EventDispatcherTest : public testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        now_ms += MAX_UPDATE_PERIOD_MS;
+        ut_set_tick_count(now_ms);
+        ASSERT_EQ(0, EventDispatcherInitialize());
+        ASSERT_TRUE(ut_event_task != NULL);
+        nextRun = now_ms;
+
+        memset(calls, 0, sizeof(calls));
+        memset(lastCall, 0, sizeof(lastCall));
+        badIntervals = 0;
+    }
+
+    virtual void TearDown()
+    {}
+
+    /* Advance the clock one ms at a time, running the dispatcher whenever the scheduler would */
+    void run(uint32_t durationMs)
+    {
+        portTickType end = now_ms + durationMs;
+
+        while (now_ms < end) {
+            if (now_ms >= nextRun) {
+                ut_event_task();
+                nextRun = now_ms + ut_event_task_delay_ms;
+            }
+            ut_set_tick_count(++now_ms);
+        }
+    }
+
+    void createEntry(uint16_t i, uint16_t periodMs)
+    {
+        UAVObjEvent ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.obj    = (UAVObjHandle)(uintptr_t)(0x1000 + i);
+        ev.instId = i;
+        ev.event  = EV_UPDATED_PERIODIC;
+        periods[i] = periodMs;
+        ASSERT_EQ(0, EventPeriodicCallbackCreate(&ev, periodicCallback, periodMs));
+    }
+
+    int32_t updateEntry(uint16_t i, uint16_t periodMs)
+    {
+        UAVObjEvent ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.obj    = (UAVObjHandle)(uintptr_t)(0x1000 + i);
+        ev.instId = i;
+        ev.event  = EV_UPDATED_PERIODIC;
+        periods[i] = periodMs;
+        return EventPeriodicCallbackUpdate(&ev, periodicCallback, periodMs);
+    }
+
+    portTickType nextRun;
+};
+
+TEST_F(EventDispatcherTest, PeriodsAreHonoured) {
+    for (uint16_t i = 0; i < NUM_ENTRIES; i++) {
+        createEntry(i, 10 + (i * 37) % 991);
+    }
+
+    run(RUN_TIME_MS);
+
+    EXPECT_EQ(0u, badIntervals);
+    for (uint16_t i = 0; i < NUM_ENTRIES; i++) {
+        uint32_t expected = RUN_TIME_MS / periods[i];
+        EXPECT_GE(calls[i], expected) << "entry " << i << " period " << periods[i];
+        EXPECT_LE(calls[i], expected + 2) << "entry " << i << " period " << periods[i];
+    }
+}
+
+TEST_F(EventDispatcherTest, DuplicateCreate) {
+    createEntry(0, 100);
+
+    UAVObjEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.obj    = (UAVObjHandle)(uintptr_t)0x1000;
+    ev.instId = 0;
+    ev.event  = EV_UPDATED_PERIODIC;
+    EXPECT_EQ(-1, EventPeriodicCallbackCreate(&ev, periodicCallback, 50));
+
+    /* Unknown entries cannot be updated */
+    EXPECT_EQ(-1, updateEntry(1, 50));
+}
+
+TEST_F(EventDispatcherTest, UpdateReschedules) {
+    for (uint16_t i = 0; i < 8; i++) {
+        createEntry(i, 100);
+    }
+    run(1000);
+    EXPECT_EQ(0u, badIntervals);
+    EXPECT_GE(calls[3], 10u);
+
+    /* Faster */
+    EXPECT_EQ(0, updateEntry(3, 10));
+    memset(calls, 0, sizeof(calls));
+    run(1000);
+    EXPECT_GE(calls[3], 100u);
+    EXPECT_LE(calls[3], 102u);
+
+    /* Disabled */
+    EXPECT_EQ(0, updateEntry(3, 0));
+    memset(calls, 0, sizeof(calls));
+    run(1000);
+    EXPECT_EQ(0u, calls[3]);
+    for (uint16_t i = 0; i < 8; i++) {
+        if (i != 3) {
+            EXPECT_GE(calls[i], 10u);
+            EXPECT_LE(calls[i], 12u);
+        }
+    }
+
+    /* Enabled again */
+    EXPECT_EQ(0, updateEntry(3, 50));
+    memset(calls, 0, sizeof(calls));
+    run(1000);
+    EXPECT_GE(calls[3], 20u);
+    EXPECT_LE(calls[3], 22u);
+}
+
+TEST_F(EventDispatcherTest, WorkPerWakeup) {
+    EventStats stats;
+    uint32_t total = 0;
+
+    for (uint16_t i = 0; i < NUM_ENTRIES; i++) {
+        createEntry(i, 10 + (i * 37) % 991);
+    }
+
+    /* All entries start out due, skip the first pass */
+    run(1);
+    EventClearStats();
+    memset(calls, 0, sizeof(calls));
+
+    double start = now_s();
+    run(RUN_TIME_MS);
+    double elapsed = now_s() - start;
+
+    EventGetStats(&stats);
+    for (uint16_t i = 0; i < NUM_ENTRIES; i++) {
+        total += calls[i];
+    }
+
+    /* Each pass only touches the entries that are due */
+    EXPECT_EQ(total, stats.periodicDispatched);
+    EXPECT_GT(stats.periodicWakeups, 0u);
+    EXPECT_LT(stats.maxPeriodicDispatched, NUM_ENTRIES / 4u);
+    EXPECT_EQ(0u, stats.eventErrors);
+
+    printf("%d entries, %u passes, %.2f events/pass (max %u), %.0f ns/pass\n",
+           NUM_ENTRIES, stats.periodicWakeups, (double)stats.periodicDispatched / stats.periodicWakeups,
+           stats.maxPeriodicDispatched, elapsed * 1e9 / stats.periodicWakeups);
+}
+
+/* The dispatcher holds this many callback events, as configured by default */
+#define PENDING_CALLBACKS 20
+
+static uint32_t updates;
+static bool redispatch;
+
+static void updatedCallback(UAVObjEvent *ev)
+{
+    updates++;
+    /* An update while the callback runs is a new one, it must not be merged into this call */
+    if (redispatch) {
+        redispatch = false;
+        EventCallbackDispatchCoalesced(ev, updatedCallback);
+    }
+}
+
+static UAVObjEvent updatedEvent(uint16_t instId)
+{
+    UAVObjEvent ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.obj    = (UAVObjHandle)(uintptr_t)0x2000;
+    ev.instId = instId;
+    ev.event  = EV_UPDATED;
+    return ev;
+}
+
+TEST_F(EventDispatcherTest, CoalescedCallbacks) {
+    EventStats stats;
+    UAVObjEvent ev = updatedEvent(0);
+    UAVObjEvent other = updatedEvent(1);
+
+    updates    = 0;
+    redispatch = false;
+    EventClearStats();
+
+    /* Ten updates before the task runs are one call, another instance is a call of its own */
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(pdTRUE, EventCallbackDispatchCoalesced(&ev, updatedCallback));
+    }
+    EXPECT_EQ(pdTRUE, EventCallbackDispatchCoalesced(&other, updatedCallback));
+    ut_event_task();
+    EXPECT_EQ(2u, updates);
+
+    /* Without coalescing every event is a call */
+    updates = 0;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(pdTRUE, EventCallbackDispatch(&ev, updatedCallback));
+    }
+    ut_event_task();
+    EXPECT_EQ(10u, updates);
+
+    /* Dispatched from the callback, the event waits for the next batch */
+    updates    = 0;
+    redispatch = true;
+    EventCallbackDispatchCoalesced(&ev, updatedCallback);
+    ut_event_task();
+    EXPECT_EQ(1u, updates);
+    ut_event_task();
+    EXPECT_EQ(2u, updates);
+
+    EventGetStats(&stats);
+    EXPECT_EQ(9u, stats.callbacksCoalesced);
+    EXPECT_EQ(0u, stats.callbacksDropped);
+    EXPECT_EQ(10u, stats.maxCallbackBatch);
+}
+
+TEST_F(EventDispatcherTest, DroppedCallbacks) {
+    EventStats stats;
+
+    updates = 0;
+    EventClearStats();
+    for (uint16_t i = 0; i < PENDING_CALLBACKS + 5; i++) {
+        UAVObjEvent ev = updatedEvent(i);
+        EXPECT_EQ(i < PENDING_CALLBACKS ? pdTRUE : pdFALSE, EventCallbackDispatch(&ev, updatedCallback));
+    }
+    ut_event_task();
+    EXPECT_EQ((uint32_t)PENDING_CALLBACKS, updates);
+
+    EventGetStats(&stats);
+    EXPECT_EQ(5u, stats.callbacksDropped);
+    EXPECT_EQ((uint32_t)PENDING_CALLBACKS, stats.maxCallbackBatch);
+}
+
+#define FLOOD_EVENTS 1000000
+
+/* A high rate object updated faster than its listener runs, a drain every 100 updates */
+TEST_F(EventDispatcherTest, CoalescingBenchmark) {
+    EventStats stats;
+    UAVObjEvent ev = updatedEvent(0);
+
+    for (int coalesce = 0; coalesce < 2; coalesce++) {
+        updates    = 0;
+        redispatch = false;
+        EventClearStats();
+
+        double start = now_s();
+        for (uint32_t i = 0; i < FLOOD_EVENTS; i++) {
+            if (coalesce) {
+                EventCallbackDispatchCoalesced(&ev, updatedCallback);
+            } else {
+                EventCallbackDispatch(&ev, updatedCallback);
+            }
+            if (i % 100 == 99) {
+                ut_event_task();
+            }
+        }
+        double elapsed = now_s() - start;
+
+        EventGetStats(&stats);
+        printf("%-9s %.0f ns/event, %u calls, %u coalesced, %u dropped\n", coalesce ? "coalesced" : "plain",
+               elapsed * 1e9 / FLOOD_EVENTS, updates, stats.callbacksCoalesced, stats.callbacksDropped);
+        if (coalesce) {
+            EXPECT_EQ(0u, stats.callbacksDropped);
+            EXPECT_EQ((uint32_t)FLOOD_EVENTS, updates + stats.callbacksCoalesced);
+        } else {
+            EXPECT_EQ((uint32_t)FLOOD_EVENTS, updates + stats.callbacksDropped);
+        }
+    }
+}
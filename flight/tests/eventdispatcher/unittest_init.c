@@ -0,0 +1,42 @@
+/*
+ * Stand-ins for the callback scheduler and object manager functions used by the event dispatcher
+ */
+
+#include "openpilot.h"
+#include "unittest_priv.h"
+
+DelayedCallback ut_event_task;
+int32_t ut_event_task_delay_ms;
+
+static DelayedCallbackInfo *ut_event_task_info = (DelayedCallbackInfo *)&ut_event_task;
+
+DelayedCallbackInfo *PIOS_CALLBACKSCHEDULER_Create(
+    DelayedCallback cb,
+    __attribute__((unused)) DelayedCallbackPriority priority,
+    __attribute__((unused)) DelayedCallbackPriorityTask priorityTask,
+    __attribute__((unused)) int16_t callbackID,
+    __attribute__((unused)) uint32_t stacksize)
+{
+    ut_event_task = cb;
+    return ut_event_task_info;
+}
+
+int32_t PIOS_CALLBACKSCHEDULER_Schedule(
+    __attribute__((unused)) DelayedCallbackInfo *cbinfo,
+    int32_t milliseconds,
+    __attribute__((unused)) DelayedCallbackUpdateMode updatemode)
+{
+    ut_event_task_delay_ms = milliseconds;
+    return 1;
+}
+
+int32_t PIOS_CALLBACKSCHEDULER_Dispatch(__attribute__((unused)) DelayedCallbackInfo *cbinfo)
+{
+    ut_event_task_delay_ms = 0;
+    return 1;
+}
+
+uint32_t UAVObjGetID(UAVObjHandle obj_handle)
+{
+    return (uint32_t)(uintptr_t)obj_handle;
+}
@@ -0,0 +1,10 @@
+#ifndef UNITTEST_PRIV_H
+#define UNITTEST_PRIV_H
+
+#include <stdint.h>
+
+/* Callback scheduler stand-in, the test runs the dispatcher callback by hand */
+extern DelayedCallback ut_event_task;
+extern int32_t ut_event_task_delay_ms;
+
+#endif /* UNITTEST_PRIV_H */
@@ -0,0 +1,442 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h> /* printf */
+#include <stdlib.h> /* malloc */
+#include <string.h> /* memcmp */
+#include <math.h> /* fabsf */
+#include <pthread.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h> /* __rdtsc */
+#endif
+
+extern "C" {
+#include "insgps.h"
+
+#define NUMX 13
+#define NUMW 9
+#define NUMV 10
+#define NUMU 6
+
+// Kernels of insgps13state.c without a public prototype
+void CovariancePrediction(float F[NUMX][NUMX], float G[NUMX][NUMW],
+                          float Q[NUMW], float dT, float P[NUMX][NUMX]);
+void SerialUpdate(float H[NUMV][NUMX], float R[NUMV], float Z[NUMV],
+                  float Y[NUMV], float P[NUMX][NUMX], float X[NUMX],
+                  uint16_t SensorsUsed);
+void LinearizeFG(float X[NUMX], float U[NUMU], float F[NUMX][NUMX],
+                 float G[NUMX][NUMW]);
+void LinearizeH(float X[NUMX], float Be[3], float H[NUMV][NUMX]);
+}
+
+#define NUM_STEPS      2000
+#define NUM_FILTERS    4
+#define BENCH_STEPS    20000
+// One GPS and baro correction every so many steps, a mag correction on the others
+#define GPS_INTERVAL   20
+#define DT             0.002f
+#define KERNEL_TRIALS  200
+#define KERNEL_CALLS   100000
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Deterministic noise, so that filters fed the same seed see the same sensors */
+static float noise(uint32_t *seed, float amplitude)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return amplitude * ((float)(*seed >> 8) / (float)(1 << 24) - 0.5f);
+}
+
+/* Sensors of a vehicle sitting level at the origin, facing North */
+struct Sensors {
+    float gyro[3];
+    float accel[3];
+    float mag[3];
+    float pos[3];
+    float vel[3];
+    float baro;
+};
+
+static void read_sensors(uint32_t *seed, struct Sensors *s)
+{
+    for (int i = 0; i < 3; i++) {
+        s->gyro[i]  = 0.01f + noise(seed, 0.02f);
+        s->accel[i] = noise(seed, 0.2f);
+        s->mag[i]   = noise(seed, 0.05f);
+        s->pos[i]   = noise(seed, 1.0f);
+        s->vel[i]   = noise(seed, 0.2f);
+    }
+    s->accel[2] -= 9.81f;
+    s->mag[0]   += 1.0f;
+    s->baro = noise(seed, 0.5f);
+}
+
+/* Run a filter through steps updates, the default one when ctx is NULL */
+static void run_filter(INSGPSContext *ctx, uint32_t seed, int steps)
+{
+    struct Sensors s;
+
+    for (int step = 0; step < steps; step++) {
+        read_sensors(&seed, &s);
+        if (ctx) {
+            INSStatePredictionCtx(ctx, s.gyro, s.accel, DT);
+            INSCovariancePredictionCtx(ctx, DT);
+            INSCorrectionCtx(ctx, s.mag, s.pos, s.vel, s.baro, step % GPS_INTERVAL ? MAG_SENSORS : FULL_SENSORS);
+        } else {
+            INSStatePrediction(s.gyro, s.accel, DT);
+            INSCovariancePrediction(DT);
+            INSCorrection(s.mag, s.pos, s.vel, s.baro, step % GPS_INTERVAL ? MAG_SENSORS : FULL_SENSORS);
+        }
+    }
+}
+
+static INSGPSContext *new_filter()
+{
+    INSGPSContext *ctx = (INSGPSContext *)malloc(INSGPSContextSize());
+
+    INSGPSInitCtx(ctx);
+    return ctx;
+}
+
+struct FilterRun {
+    INSGPSContext *ctx;
+    uint32_t seed;
+    int steps;
+};
+
+static void *filter_thread(void *arg)
+{
+    struct FilterRun *run = (struct FilterRun *)arg;
+
+    run_filter(run->ctx, run->seed, run->steps);
+    return NULL;
+}
+
+/*
+ * The scalar kernels the filter used before they worked on rows, kept
+ * as the reference the current ones must agree with.
+ */
+static const int8_t FrowMin[NUMX] = { 3, 4, 5, 6, 6, 6, 7, 6, 6, 6, 13, 13, 13 };
+static const int8_t FrowMax[NUMX] = { 3, 4, 5, 9, 9, 9, 12, 12, 12, 12, -1, -1, -1 };
+static const int8_t GrowMin[NUMX] = { 9, 9, 9, 3, 3, 3, 0, 0, 0, 0, 6, 7, 8 };
+static const int8_t GrowMax[NUMX] = { -1, -1, -1, 5, 5, 5, 2, 2, 2, 2, 6, 7, 8 };
+static const int8_t HrowMin[NUMV] = { 0, 1, 2, 3, 4, 5, 6, 6, 6, 2 };
+static const int8_t HrowMax[NUMV] = { 0, 1, 2, 3, 4, 5, 9, 9, 9, 2 };
+
+__attribute__((optimize("O3")))
+static void RefCovariancePrediction(float F[NUMX][NUMX], float G[NUMX][NUMW],
+                                    float Q[NUMW], float dT, float P[NUMX][NUMX])
+{
+    float dT1  = 1.0f / dT;
+    float dTsq = dT * dT;
+    float Dummy[NUMX][NUMX];
+
+    for (int i = 0; i < NUMX; i++) {
+        for (int j = 0; j < NUMX; j++) {
+            Dummy[i][j] = P[i][j] * dT1;
+            for (int k = FrowMin[i]; k <= FrowMax[i]; k++) {
+                Dummy[i][j] += F[i][k] * P[k][j];
+            }
+        }
+    }
+    for (int i = 0; i < NUMX; i++) {
+        for (int j = i; j < NUMX; j++) {
+            float Ptmp = Dummy[i][j] * dT1;
+            for (int k = FrowMin[j]; k <= FrowMax[j]; k++) {
+                Ptmp += Dummy[i][k] * F[j][k];
+            }
+            int kstart = GrowMin[i] > GrowMin[j] ? GrowMin[i] : GrowMin[j];
+            int kend   = GrowMax[i] < GrowMax[j] ? GrowMax[i] : GrowMax[j];
+            for (int k = kstart; k <= kend; k++) {
+                Ptmp += Q[k] * G[i][k] * G[j][k];
+            }
+            P[j][i] = P[i][j] = Ptmp * dTsq;
+        }
+    }
+}
+
+__attribute__((optimize("O3")))
+static void RefSerialUpdate(float H[NUMV][NUMX], float R[NUMV], float Z[NUMV],
+                            float Y[NUMV], float P[NUMX][NUMX], float X[NUMX],
+                            uint16_t SensorsUsed)
+{
+    float HP[NUMX], HPHR, Km[NUMX];
+
+    for (int m = 0; m < NUMV; m++) {
+        if (SensorsUsed & (0x01 << m)) {
+            for (int j = 0; j < NUMX; j++) {
+                HP[j] = 0;
+                for (int k = HrowMin[m]; k <= HrowMax[m]; k++) {
+                    HP[j] += H[m][k] * P[k][j];
+                }
+            }
+            HPHR = R[m];
+            for (int k = HrowMin[m]; k <= HrowMax[m]; k++) {
+                HPHR += HP[k] * H[m][k];
+            }
+            for (int k = 0; k < NUMX; k++) {
+                Km[k] = HP[k] / HPHR;
+            }
+            for (int i = 0; i < NUMX; i++) {
+                for (int j = i; j < NUMX; j++) {
+                    P[i][j] = P[j][i] = P[i][j] - Km[i] * HP[j];
+                }
+            }
+            float Error = Z[m] - Y[m];
+            for (int i = 0; i < NUMX; i++) {
+                X[i] = X[i] + Km[i] * Error;
+            }
+        }
+    }
+}
+
+/* Linearized system and a covariance of a filter in a random attitude */
+struct KernelInput {
+    float X[NUMX];
+    float F[NUMX][NUMX];
+    float G[NUMX][NUMW];
+    float H[NUMV][NUMX];
+    float P[NUMX][NUMX];
+    float Q[NUMW];
+    float R[NUMV];
+    float Z[NUMV];
+    float Y[NUMV];
+};
+
+static void random_kernel_input(uint32_t *seed, struct KernelInput *in)
+{
+    float U[NUMU], Be[3] = { 0.6f, 0.1f, 0.8f };
+    float L[NUMX][NUMX];
+
+    memset(in, 0, sizeof(*in));
+    for (int i = 0; i < NUMX; i++) {
+        in->X[i] = noise(seed, 2.0f);
+    }
+    float qnorm = sqrtf(in->X[6] * in->X[6] + in->X[7] * in->X[7] + in->X[8] * in->X[8] + in->X[9] * in->X[9]);
+    for (int i = 6; i < 10; i++) {
+        in->X[i] /= qnorm;
+    }
+    for (int i = 0; i < NUMU; i++) {
+        U[i] = noise(seed, 1.0f);
+    }
+    U[5] -= 9.81f;
+    LinearizeFG(in->X, U, in->F, in->G);
+    LinearizeH(in->X, Be, in->H);
+
+    // P = L*L' + I/10, symmetric positive definite
+    for (int i = 0; i < NUMX; i++) {
+        for (int j = 0; j < NUMX; j++) {
+            L[i][j] = noise(seed, 1.0f);
+        }
+    }
+    for (int i = 0; i < NUMX; i++) {
+        for (int j = 0; j < NUMX; j++) {
+            float sum = (i == j) ? 0.1f : 0.0f;
+            for (int k = 0; k < NUMX; k++) {
+                sum += L[i][k] * L[j][k];
+            }
+            in->P[i][j] = sum;
+        }
+    }
+    for (int i = 0; i < NUMW; i++) {
+        in->Q[i] = 1e-3f + noise(seed, 1e-3f);
+    }
+    for (int i = 0; i < NUMV; i++) {
+        in->R[i] = 0.5f + noise(seed, 0.5f);
+        in->Z[i] = noise(seed, 1.0f);
+        in->Y[i] = noise(seed, 1.0f);
+    }
+}
+
+/* Largest difference relative to the largest element of the reference */
+static float relative_error(const float *value, const float *reference, int count)
+{
+    float error = 0, scale = 0;
+
+    for (int i = 0; i < count; i++) {
+        error = fmaxf(error, fabsf(value[i] - reference[i]));
+        scale = fmaxf(scale, fabsf(reference[i]));
+    }
+    return error / scale;
+}
+
+static bool symmetric(float P[NUMX][NUMX])
+{
+    for (int i = 0; i < NUMX; i++) {
+        for (int j = i + 1; j < NUMX; j++) {
+            if (P[i][j] != P[j][i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static uint64_t now_cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// To use a test fixture, derive a class from testing::Test.
+class INSGPSTest : public testing::Test {};
+
+TEST_F(INSGPSTest, ContextMatchesDefault) {
+    INSGPSContext *ctx = new_filter();
+
+    INSGPSInit();
+    run_filter(NULL, 1, NUM_STEPS);
+    run_filter(ctx, 1, NUM_STEPS);
+
+    // Same code, same inputs: the solutions are bit for bit identical
+    EXPECT_EQ(0, memcmp(&Nav, INSGetNavCtx(ctx), sizeof(Nav)));
+    EXPECT_NEAR(1.0f, Nav.q[0], 0.01f);
+    free(ctx);
+}
+
+TEST_F(INSGPSTest, ParallelFiltersMatchSerial) {
+    struct NavStruct serial[NUM_FILTERS];
+    struct FilterRun runs[NUM_FILTERS];
+    pthread_t threads[NUM_FILTERS];
+
+    for (int i = 0; i < NUM_FILTERS; i++) {
+        INSGPSContext *ctx = new_filter();
+        run_filter(ctx, i + 1, NUM_STEPS);
+        serial[i] = *INSGetNavCtx(ctx);
+        free(ctx);
+    }
+    // Filters fed different sensors end up in different states
+    EXPECT_NE(0, memcmp(&serial[0], &serial[1], sizeof(serial[0])));
+
+    for (int i = 0; i < NUM_FILTERS; i++) {
+        runs[i].ctx   = new_filter();
+        runs[i].seed  = i + 1;
+        runs[i].steps = NUM_STEPS;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, filter_thread, &runs[i]));
+    }
+    for (int i = 0; i < NUM_FILTERS; i++) {
+        pthread_join(threads[i], NULL);
+        EXPECT_EQ(0, memcmp(&serial[i], INSGetNavCtx(runs[i].ctx), sizeof(serial[i])));
+        free(runs[i].ctx);
+    }
+}
+
+TEST_F(INSGPSTest, BenchmarkSteps) {
+    INSGPSContext *ctx = new_filter();
+    struct Sensors s;
+    uint32_t seed      = 1;
+    double prediction  = 0, covariance = 0, correction = 0;
+
+    for (int step = 0; step < BENCH_STEPS; step++) {
+        read_sensors(&seed, &s);
+        double start = now_s();
+        INSStatePredictionCtx(ctx, s.gyro, s.accel, DT);
+        double predicted = now_s();
+        INSCovariancePredictionCtx(ctx, DT);
+        double covariated = now_s();
+        INSCorrectionCtx(ctx, s.mag, s.pos, s.vel, s.baro, step % GPS_INTERVAL ? MAG_SENSORS : FULL_SENSORS);
+        double corrected = now_s();
+
+        prediction += predicted - start;
+        covariance += covariated - predicted;
+        correction += corrected - covariated;
+    }
+    EXPECT_NEAR(1.0f, INSGetNavCtx(ctx)->q[0], 0.01f);
+    free(ctx);
+
+    printf("INSStatePrediction:      %.2f us/step\n", prediction * 1e6 / BENCH_STEPS);
+    printf("INSCovariancePrediction: %.2f us/step\n", covariance * 1e6 / BENCH_STEPS);
+    printf("INSCorrection:           %.2f us/step (GPS and baro every %d steps)\n",
+           correction * 1e6 / BENCH_STEPS, GPS_INTERVAL);
+}
+
+TEST_F(INSGPSTest, BenchmarkParallelFilters) {
+    struct FilterRun runs[NUM_FILTERS];
+    pthread_t threads[NUM_FILTERS];
+
+    double start = now_s();
+
+    for (int i = 0; i < NUM_FILTERS; i++) {
+        runs[i].ctx   = new_filter();
+        runs[i].seed  = i + 1;
+        runs[i].steps = BENCH_STEPS;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, filter_thread, &runs[i]));
+    }
+    for (int i = 0; i < NUM_FILTERS; i++) {
+        pthread_join(threads[i], NULL);
+        free(runs[i].ctx);
+    }
+    double elapsed = now_s() - start;
+
+    printf("%d filters on %d threads: %.0f steps/s\n", NUM_FILTERS, NUM_FILTERS, NUM_FILTERS * BENCH_STEPS / elapsed);
+}
+
+TEST_F(INSGPSTest, CovariancePredictionMatchesReference) {
+    uint32_t seed = 1;
+    struct KernelInput in;
+    float P[NUMX][NUMX];
+
+    for (int trial = 0; trial < KERNEL_TRIALS; trial++) {
+        random_kernel_input(&seed, &in);
+        memcpy(P, in.P, sizeof(P));
+        RefCovariancePrediction(in.F, in.G, in.Q, DT, in.P);
+        CovariancePrediction(in.F, in.G, in.Q, DT, P);
+
+        EXPECT_LT(relative_error(&P[0][0], &in.P[0][0], NUMX * NUMX), 1e-6f);
+        EXPECT_TRUE(symmetric(P));
+    }
+}
+
+TEST_F(INSGPSTest, SerialUpdateMatchesReference) {
+    uint32_t seed = 2;
+    struct KernelInput in;
+    float P[NUMX][NUMX], X[NUMX];
+
+    for (int trial = 0; trial < KERNEL_TRIALS; trial++) {
+        random_kernel_input(&seed, &in);
+        memcpy(P, in.P, sizeof(P));
+        memcpy(X, in.X, sizeof(X));
+        RefSerialUpdate(in.H, in.R, in.Z, in.Y, in.P, in.X, FULL_SENSORS);
+        SerialUpdate(in.H, in.R, in.Z, in.Y, P, X, FULL_SENSORS);
+
+        EXPECT_LT(relative_error(&P[0][0], &in.P[0][0], NUMX * NUMX), 1e-5f);
+        EXPECT_LT(relative_error(X, in.X, NUMX), 1e-5f);
+        EXPECT_TRUE(symmetric(P));
+    }
+}
+
+/* Time a kernel over the same input each call, copying it in is part of the time of both */
+#define TIME_KERNEL(name, call) \
+    do { \
+        double start    = now_s(); \
+        uint64_t cycles = now_cycles(); \
+        for (int i = 0; i < KERNEL_CALLS; i++) { \
+            memcpy(P, in.P, sizeof(P)); \
+            memcpy(X, in.X, sizeof(X)); \
+            call; \
+        } \
+        printf("%-32s %6.0f ns, %6.0f cycles/call\n", name, \
+               (now_s() - start) * 1e9 / KERNEL_CALLS, (double)(now_cycles() - cycles) / KERNEL_CALLS); \
+    } while (0)
+
+TEST_F(INSGPSTest, BenchmarkKernels) {
+    uint32_t seed = 3;
+    struct KernelInput in;
+    float P[NUMX][NUMX], X[NUMX];
+
+    random_kernel_input(&seed, &in);
+
+    TIME_KERNEL("CovariancePrediction reference", RefCovariancePrediction(in.F, in.G, in.Q, DT, P));
+    TIME_KERNEL("CovariancePrediction", CovariancePrediction(in.F, in.G, in.Q, DT, P));
+    TIME_KERNEL("SerialUpdate reference", RefSerialUpdate(in.H, in.R, in.Z, in.Y, P, X, FULL_SENSORS));
+    TIME_KERNEL("SerialUpdate", SerialUpdate(in.H, in.R, in.Z, in.Y, P, X, FULL_SENSORS));
+}
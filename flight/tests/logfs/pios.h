@@ -4,11 +4,18 @@
 /* PIOS Feature Selection */
 #include "pios_config.h"
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #ifdef PIOS_INCLUDE_FREERTOS
 /* FreeRTOS Includes */
 #include "FreeRTOS.h"
 #endif
 #include "pios_mem.h"
+#ifdef PIOS_INCLUDE_DELAY
+#include <pios_delay.h>
+#endif
 #ifdef PIOS_INCLUDE_FLASH
 #include <pios_flash.h>
 #include <pios_flashfs.h>
@@ -5,5 +5,6 @@
 #define PIOS_INCLUDE_FLASH
 // #define PIOS_FLASHFS_LOGFS_MAX_DEVS 5
 #define PIOS_INCLUDE_FREERTOS
+#define PIOS_INCLUDE_DELAY
 
 #endif /* PIOS_CONFIG_H */
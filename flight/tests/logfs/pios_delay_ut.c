@@ -0,0 +1,22 @@
+/*
+ * Host implementation of the raw timer, enough for the filesystem to time its
+ * garbage collection.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include "pios_delay.h"
+
+uint32_t PIOS_DELAY_GetRaw()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+uint32_t PIOS_DELAY_DiffuS(uint32_t raw)
+{
+    return PIOS_DELAY_GetRaw() - raw;
+}
@@ -75,6 +75,9 @@ int32_t PIOS_Flash_UT_Destroy(uintptr_t flash_id)
 }
 
 
+/* Number of read_data calls, lets the tests see how much flash a lookup touches */
+uint32_t pios_flash_ut_reads;
+
 /**********************************
  *
  * Provide a PIOS flash driver API
@@ -156,6 +159,8 @@ static int32_t PIOS_Flash_UT_ReadData(uintptr_t flash_id, uint32_t addr, uint8_t
 
     assert(flash_dev->transaction_in_progress);
 
+    pios_flash_ut_reads++;
+
     if (fseek(flash_dev->flash_file, addr, SEEK_SET) != 0) {
         assert(0);
     }
@@ -9,6 +9,7 @@ int32_t PIOS_Flash_UT_Init(uintptr_t *flash_id, const struct pios_flash_ut_cfg *
 
 int32_t PIOS_Flash_UT_Destroy(uintptr_t flash_id);
 extern const struct pios_flash_driver pios_ut_flash_driver;
+extern uint32_t pios_flash_ut_reads;
 
 #if !defined(FLASH_IMAGE_FILE)
 #define FLASH_IMAGE_FILE "theflash.bin"
@@ -297,6 +297,221 @@ TEST_F(LogfsTestCooked, WriteManyVerify) {
     EXPECT_EQ(0, memcmp(obj3, obj3_check, sizeof(obj3)));
 }
 
+#define MANY_OBJ_COUNT 150
+#define MANY_OBJ_SIZE  32
+#define GC_STEP_SLOTS  8
+
+/* A distinct pattern for every object, instance and revision */
+static void fill_many(uint8_t *data, uint16_t i, uint8_t rev)
+{
+    for (uint32_t j = 0; j < MANY_OBJ_SIZE; j++) {
+        data[j] = i * 7 + j + rev * 101;
+    }
+}
+
+#define MANY_OBJ_ID(i)   (0x50000000 + ((i) / 3) * 0x1111)
+#define MANY_OBJ_INST(i) ((i) % 3)
+
+class LogfsTestMany : public LogfsTestCooked {
+protected:
+    void saveMany(uint8_t rev, uint16_t first, uint16_t count)
+    {
+        uint8_t data[MANY_OBJ_SIZE];
+
+        for (uint16_t i = first; i < first + count; i++) {
+            fill_many(data, i, rev);
+            ASSERT_EQ(0, PIOS_FLASHFS_ObjSave(fs_id, MANY_OBJ_ID(i), MANY_OBJ_INST(i), data, sizeof(data)));
+            revs[i] = rev;
+        }
+    }
+
+    /* Load every object that has been saved, returns the number of flash reads it took */
+    uint32_t verifyMany(void)
+    {
+        uint8_t expected[MANY_OBJ_SIZE];
+        uint8_t check[MANY_OBJ_SIZE];
+        uint32_t reads = pios_flash_ut_reads;
+
+        for (uint16_t i = 0; i < MANY_OBJ_COUNT; i++) {
+            memset(check, 0, sizeof(check));
+            if (revs[i] == 0) {
+                EXPECT_EQ(-3, PIOS_FLASHFS_ObjLoad(fs_id, MANY_OBJ_ID(i), MANY_OBJ_INST(i), check, sizeof(check))) << "object " << i;
+            } else {
+                fill_many(expected, i, revs[i]);
+                EXPECT_EQ(0, PIOS_FLASHFS_ObjLoad(fs_id, MANY_OBJ_ID(i), MANY_OBJ_INST(i), check, sizeof(check))) << "object " << i;
+                EXPECT_EQ(0, memcmp(expected, check, sizeof(check))) << "object " << i;
+            }
+        }
+        return pios_flash_ut_reads - reads;
+    }
+
+    uint8_t revs[MANY_OBJ_COUNT];
+};
+
+TEST_F(LogfsTestMany, IndexedLoadReadCount) {
+    memset(revs, 0, sizeof(revs));
+    saveMany(1, 0, MANY_OBJ_COUNT);
+    saveMany(2, 0, MANY_OBJ_COUNT / 3);
+
+    /* One header read to confirm the index hit and one to fetch the data */
+    uint32_t reads = verifyMany();
+    EXPECT_LE(reads, 3u * MANY_OBJ_COUNT);
+
+    /* Lookups for missing objects should not walk the log either */
+    uint8_t check[MANY_OBJ_SIZE];
+    uint32_t before = pios_flash_ut_reads;
+    EXPECT_EQ(-3, PIOS_FLASHFS_ObjLoad(fs_id, OBJ2_ID, 0, check, sizeof(check)));
+    EXPECT_LE(pios_flash_ut_reads - before, 2u);
+
+    printf("%d loads from %d slots: %u flash reads (%.2f per load)\n",
+           MANY_OBJ_COUNT, MANY_OBJ_COUNT + MANY_OBJ_COUNT / 3, reads, (double)reads / MANY_OBJ_COUNT);
+}
+
+TEST_F(LogfsTestMany, IndexDeleteAndOverwrite) {
+    memset(revs, 0, sizeof(revs));
+    saveMany(1, 0, MANY_OBJ_COUNT);
+
+    for (uint16_t i = 0; i < MANY_OBJ_COUNT; i += 4) {
+        EXPECT_EQ(0, PIOS_FLASHFS_ObjDelete(fs_id, MANY_OBJ_ID(i), MANY_OBJ_INST(i)));
+        revs[i] = 0;
+    }
+    /* Deleting something that is already gone is not an error */
+    EXPECT_EQ(0, PIOS_FLASHFS_ObjDelete(fs_id, MANY_OBJ_ID(0), MANY_OBJ_INST(0)));
+    verifyMany();
+
+    /* Bring some of the deleted objects back and overwrite some of the survivors */
+    for (uint16_t i = 0; i < MANY_OBJ_COUNT; i += 8) {
+        saveMany(3, i, 1);
+        saveMany(4, i + 1, 1);
+    }
+    verifyMany();
+}
+
+TEST_F(LogfsTestMany, IndexRebuiltOnMount) {
+    memset(revs, 0, sizeof(revs));
+    saveMany(1, 0, MANY_OBJ_COUNT);
+    saveMany(2, MANY_OBJ_COUNT / 2, MANY_OBJ_COUNT / 2);
+
+    PIOS_FLASHFS_Logfs_Destroy(fs_id);
+    EXPECT_EQ(0, PIOS_FLASHFS_Logfs_Init(&fs_id, &flashfs_config_partition_a, &pios_ut_flash_driver, flash_id));
+
+    uint32_t reads = verifyMany();
+    EXPECT_LE(reads, 3u * MANY_OBJ_COUNT);
+}
+
+TEST_F(LogfsTestMany, IndexAcrossGarbageCollect) {
+    memset(revs, 0, sizeof(revs));
+
+    /* Enough revisions to wrap the arena several times */
+    for (uint8_t rev = 1; rev <= 8; rev++) {
+        saveMany(rev, 0, MANY_OBJ_COUNT);
+        verifyMany();
+    }
+
+    uint32_t reads = verifyMany();
+    EXPECT_LE(reads, 3u * MANY_OBJ_COUNT);
+}
+
+TEST_F(LogfsTestMany, IncrementalGarbageCollect) {
+    struct PIOS_FLASHFS_Stats stats;
+    uint8_t rev = 1;
+    int32_t rc;
+
+    memset(revs, 0, sizeof(revs));
+    saveMany(rev++, 0, MANY_OBJ_COUNT);
+
+    /* Nothing to collect yet */
+    EXPECT_EQ(0, PIOS_FLASHFS_Logfs_GarbageCollectStep(fs_id, 4));
+
+    /* Keep rewriting a few objects until a collection is worthwhile */
+    while ((rc = PIOS_FLASHFS_Logfs_GarbageCollectStep(fs_id, 4)) == 0) {
+        saveMany(rev++, 0, 10);
+        ASSERT_LT(rev, 20);
+    }
+    ASSERT_EQ(1, rc);
+
+    EXPECT_EQ(0, PIOS_FLASHFS_GetStats(fs_id, &stats));
+    uint16_t free_before = stats.num_free_slots;
+
+    /* Saves and deletes carry on while the collection makes progress */
+    uint32_t steps = 1;
+    for (uint16_t i = 0; rc > 0; i++) {
+        EXPECT_EQ(0, PIOS_FLASHFS_GetStats(fs_id, &stats));
+        EXPECT_GT(stats.gc_progress, 0);
+        EXPECT_EQ(0u, stats.gc_count);
+
+        /* Obsoleting a migrated slot finds its copy without walking the destination arena */
+        uint32_t reads = pios_flash_ut_reads;
+        saveMany(rev, (i * 7) % MANY_OBJ_COUNT, 1);
+        EXPECT_EQ(0, PIOS_FLASHFS_GetStats(fs_id, &stats));
+        if (stats.gc_count == 0) {
+            /* Unless the log filled up and the save had to finish the collection */
+            EXPECT_LE(pios_flash_ut_reads - reads, 4u);
+        }
+        if (i % 5 == 0) {
+            uint16_t victim = (i * 13 + 1) % MANY_OBJ_COUNT;
+            reads = pios_flash_ut_reads;
+            EXPECT_EQ(0, PIOS_FLASHFS_ObjDelete(fs_id, MANY_OBJ_ID(victim), MANY_OBJ_INST(victim)));
+            EXPECT_LE(pios_flash_ut_reads - reads, 3u);
+            revs[victim] = 0;
+        }
+        if (i % 10 == 0) {
+            verifyMany();
+        }
+
+        rc = PIOS_FLASHFS_Logfs_GarbageCollectStep(fs_id, 4);
+        steps++;
+        ASSERT_LT(steps, 1000u);
+    }
+    EXPECT_EQ(0, rc);
+
+    EXPECT_EQ(0, PIOS_FLASHFS_GetStats(fs_id, &stats));
+    EXPECT_EQ(1u, stats.gc_count);
+    EXPECT_EQ(0, stats.gc_progress);
+    EXPECT_GT(stats.num_free_slots, free_before);
+    verifyMany();
+
+    /* What was collected must also survive a remount */
+    PIOS_FLASHFS_Logfs_Destroy(fs_id);
+    EXPECT_EQ(0, PIOS_FLASHFS_Logfs_Init(&fs_id, &flashfs_config_partition_a, &pios_ut_flash_driver, flash_id));
+    verifyMany();
+}
+
+TEST_F(LogfsTestMany, GarbageCollectPauses) {
+    struct PIOS_FLASHFS_Stats stats;
+    uint8_t rev = 1;
+
+    /* Let the log fill up so that a save has to collect it in one go */
+    memset(revs, 0, sizeof(revs));
+    do {
+        saveMany(rev++, 0, MANY_OBJ_COUNT / 2);
+        EXPECT_EQ(0, PIOS_FLASHFS_GetStats(fs_id, &stats));
+    } while (stats.gc_count == 0);
+    uint32_t full_pause_us = stats.gc_max_pause_us;
+    verifyMany();
+
+    /* Same workload on a fresh filesystem, collected in steps between the saves */
+    EXPECT_EQ(0, PIOS_FLASHFS_Format(fs_id));
+    PIOS_FLASHFS_Logfs_Destroy(fs_id);
+    EXPECT_EQ(0, PIOS_FLASHFS_Logfs_Init(&fs_id, &flashfs_config_partition_a, &pios_ut_flash_driver, flash_id));
+
+    rev = 1;
+    memset(revs, 0, sizeof(revs));
+    do {
+        for (uint16_t i = 0; i < MANY_OBJ_COUNT / 2; i++) {
+            saveMany(rev, i, 1);
+            PIOS_FLASHFS_Logfs_GarbageCollectStep(fs_id, GC_STEP_SLOTS);
+        }
+        rev++;
+        EXPECT_EQ(0, PIOS_FLASHFS_GetStats(fs_id, &stats));
+    } while (stats.gc_count == 0);
+    uint32_t step_pause_us = stats.gc_max_pause_us;
+    verifyMany();
+
+    printf("worst garbage collection pause: %u us in one go, %u us in steps of %d slots\n",
+           full_pause_us, step_pause_us, GC_STEP_SLOTS);
+}
+
 class LogfsTestCookedMultiPart : public LogfsTestRaw {
 protected:
     virtual void SetUp()
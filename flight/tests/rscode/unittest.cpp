@@ -0,0 +1,210 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h> /* printf */
+#include <stdlib.h> /* rand */
+#include <string.h> /* memcpy */
+#include <time.h>
+
+extern "C" {
+#include "ecc.h"
+
+extern int genPoly[MAXDEG * 2];
+}
+
+#define PACKET_LEN   64 /* RFM22B_MAX_PACKET_LEN */
+#define DATA_LEN     (PACKET_LEN - RS_ECC_NPARITY)
+#define NUM_PACKETS  10000
+#define BENCH_PASSES 20000
+
+/* The byte at a time LFSR that encode_data() used before */
+static void encode_reference(const uint8_t *msg, int nbytes, uint8_t *parity)
+{
+    int lfsr[RS_ECC_NPARITY] = { 0 };
+
+    for (int i = 0; i < nbytes; i++) {
+        int dbyte = msg[i] ^ lfsr[RS_ECC_NPARITY - 1];
+        for (int j = RS_ECC_NPARITY - 1; j > 0; j--) {
+            lfsr[j] = lfsr[j - 1] ^ gmult(genPoly[j], dbyte);
+        }
+        lfsr[0] = gmult(genPoly[0], dbyte);
+    }
+    for (int i = 0; i < RS_ECC_NPARITY; i++) {
+        parity[i] = lfsr[RS_ECC_NPARITY - 1 - i];
+    }
+}
+
+/* The syndromes as decode_data() computed them before, evaluating the whole codeword */
+static void syndromes_reference(const uint8_t *data, int nbytes, int *syndromes)
+{
+    for (int j = 0; j < RS_ECC_NPARITY; j++) {
+        int sum = 0;
+        for (int i = 0; i < nbytes; i++) {
+            sum = data[i] ^ gmult(gexp[j + 1], sum);
+        }
+        syndromes[j] = sum;
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// To use a test fixture, derive a class from testing::Test.
+class RsCodeTest : public testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        initialize_ecc();
+        srand(42);
+    }
+
+    virtual void TearDown()
+    {}
+
+    /* A random codeword of the given length, parity included */
+    void randomCodeword(uint8_t *codeword, int length)
+    {
+        for (int i = 0; i < length - RS_ECC_NPARITY; i++) {
+            codeword[i] = rand();
+        }
+        encode_data(codeword, length - RS_ECC_NPARITY, codeword);
+    }
+
+    /* Flip count distinct bytes to another value */
+    void corrupt(uint8_t *codeword, int length, int count)
+    {
+        bool hit[255] = { false };
+
+        while (count > 0) {
+            int pos = rand() % length;
+            if (!hit[pos]) {
+                hit[pos] = true;
+                codeword[pos] ^= 1 + rand() % 255;
+                count--;
+            }
+        }
+    }
+};
+
+TEST_F(RsCodeTest, LfsrTableMatchesGeneratorPolynomial) {
+    for (int d = 0; d < 256; d++) {
+        for (int j = 0; j < RS_ECC_NPARITY; j++) {
+            ASSERT_EQ(gmult(genPoly[j], d), rs_lfsr_table[d][j]) << "byte " << d << " coefficient " << j;
+        }
+    }
+}
+
+TEST_F(RsCodeTest, EncoderMatchesReference) {
+    uint8_t msg[255];
+    uint8_t codeword[255];
+    uint8_t parity[RS_ECC_NPARITY];
+
+    for (int length = 1; length <= 255 - RS_ECC_NPARITY; length++) {
+        for (int i = 0; i < length; i++) {
+            msg[i] = rand();
+        }
+        encode_data(msg, length, codeword);
+        encode_reference(msg, length, parity);
+        ASSERT_EQ(0, memcmp(msg, codeword, length)) << "length " << length;
+        ASSERT_EQ(0, memcmp(parity, &codeword[length], RS_ECC_NPARITY)) << "length " << length;
+    }
+}
+
+TEST_F(RsCodeTest, SyndromesMatchReference) {
+    uint8_t codeword[255];
+    int syndromes[RS_ECC_NPARITY];
+
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        int length = RS_ECC_NPARITY * 2 + rand() % (256 - RS_ECC_NPARITY * 2);
+        int errors = rand() % (RS_ECC_NPARITY * 2 + 1);
+
+        randomCodeword(codeword, length);
+        corrupt(codeword, length, errors);
+        decode_data(codeword, length);
+        syndromes_reference(codeword, length, syndromes);
+        for (int j = 0; j < RS_ECC_NPARITY; j++) {
+            ASSERT_EQ(syndromes[j], synBytes[j]) << "packet " << i << " syndrome " << j;
+        }
+        ASSERT_EQ(errors != 0, check_syndrome() != 0) << "packet " << i;
+    }
+}
+
+TEST_F(RsCodeTest, CorrectsUpToHalfTheParity) {
+    uint8_t codeword[PACKET_LEN];
+    uint8_t sent[PACKET_LEN];
+
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        int errors = 1 + rand() % (RS_ECC_NPARITY / 2);
+
+        randomCodeword(sent, PACKET_LEN);
+        memcpy(codeword, sent, PACKET_LEN);
+        corrupt(codeword, PACKET_LEN, errors);
+
+        decode_data(codeword, PACKET_LEN);
+        ASSERT_NE(0, check_syndrome());
+        ASSERT_EQ(1, correct_errors_erasures(codeword, PACKET_LEN, 0, 0)) << "packet " << i;
+        ASSERT_EQ(0, memcmp(sent, codeword, PACKET_LEN)) << "packet " << i;
+    }
+}
+
+TEST_F(RsCodeTest, TooManyErrorsAreNotMistakenForClean) {
+    uint8_t codeword[PACKET_LEN];
+    int rejected = 0;
+
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        randomCodeword(codeword, PACKET_LEN);
+        corrupt(codeword, PACKET_LEN, RS_ECC_NPARITY / 2 + 1 + rand() % RS_ECC_NPARITY);
+
+        decode_data(codeword, PACKET_LEN);
+        ASSERT_NE(0, check_syndrome()) << "packet " << i;
+        // The odd one is miscorrected, a CRC higher up has to catch it
+        if (!correct_errors_erasures(codeword, PACKET_LEN, 0, 0)) {
+            rejected++;
+        }
+    }
+    EXPECT_GT(rejected, NUM_PACKETS / 2);
+}
+
+TEST_F(RsCodeTest, Benchmark) {
+    uint8_t codeword[PACKET_LEN];
+    uint8_t parity[RS_ECC_NPARITY];
+    int syndromes[RS_ECC_NPARITY];
+    volatile int sink = 0;
+
+    randomCodeword(codeword, PACKET_LEN);
+
+    double start = now_s();
+    for (int i = 0; i < BENCH_PASSES; i++) {
+        encode_reference(codeword, DATA_LEN, parity);
+        syndromes_reference(codeword, PACKET_LEN, syndromes);
+        sink += parity[0] + syndromes[0];
+    }
+    double referenceTime = now_s() - start;
+
+    start = now_s();
+    for (int i = 0; i < BENCH_PASSES; i++) {
+        encode_data(codeword, DATA_LEN, codeword);
+        decode_data(codeword, PACKET_LEN);
+        sink += check_syndrome();
+    }
+    double tableTime = now_s() - start;
+
+    uint8_t corrupted[PACKET_LEN];
+    start = now_s();
+    for (int i = 0; i < BENCH_PASSES; i++) {
+        memcpy(corrupted, codeword, PACKET_LEN);
+        corrupted[i % PACKET_LEN] ^= 0x5A;
+        decode_data(corrupted, PACKET_LEN);
+        sink += check_syndrome() && correct_errors_erasures(corrupted, PACKET_LEN, 0, 0);
+    }
+    double correctTime = now_s() - start;
+
+    printf("%d byte packets, %d parity bytes, encode and check a clean packet\n", PACKET_LEN, RS_ECC_NPARITY);
+    printf("reference: %6.2f us per packet\n", referenceTime / BENCH_PASSES * 1e6);
+    printf("table:     %6.2f us per packet\n", tableTime / BENCH_PASSES * 1e6);
+    printf("correcting a single byte error: %6.2f us per packet\n", correctTime / BENCH_PASSES * 1e6);
+}
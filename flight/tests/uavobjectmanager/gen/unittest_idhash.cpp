@@ -0,0 +1,29 @@
+/*
+ * Emits the object ID hash tables of the test objects with the code the
+ * UAVObjGenerator uses for uavobjectsinit.c, the handle of each object is
+ * read from the ut_handles table.
+ */
+
+#include "uavobjectidhash.h"
+#include "unittest_ids.h"
+
+int main()
+{
+    const uint32_t ids[UT_NUM_OBJECTS] = { UT_OBJECT_IDS };
+    UAVObjectIdHash hash;
+
+    if (!uavo_id_hash_build(std::vector<uint32_t>(ids, ids + UT_NUM_OBJECTS), &hash)) {
+        fprintf(stderr, "Could not generate the object ID hash\n");
+        return 1;
+    }
+
+    printf("/* Generated by gen/unittest_idhash.cpp, do not edit */\n\n");
+    printf("#include \"openpilot.h\"\n#include \"unittest_priv.h\"\n\n");
+    printf("%s", uavo_id_hash_tables(hash).c_str());
+    printf("UAVObjHandle *const uavo_id_hash_handles[UT_NUM_OBJECTS] = {");
+    for (int n = 0; n < UT_NUM_OBJECTS; n++) {
+        printf("%s&ut_handles[%d],", (n % 4) ? " " : "\n    ", n);
+    }
+    printf("\n};\n");
+    return 0;
+}
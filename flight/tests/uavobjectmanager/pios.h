@@ -0,0 +1,23 @@
+#ifndef PIOS_H
+#define PIOS_H
+
+/* PIOS Feature Selection */
+#include "pios_config.h"
+
+#ifdef PIOS_INCLUDE_FREERTOS
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#endif
+#include "pios_mem.h"
+#include <pios_crc.h>
+#include <pios_flashfs.h>
+
+#define PIOS_Assert(x) \
+    if (!(x)) { abort(); \
+    }
+#define PIOS_DEBUG_Assert(x)     PIOS_Assert(x)
+#define PIOS_STATIC_ASSERT(test) ((void)sizeof(int[1 - 2 * !(test)]))
+
+void PIOS_DEBUGLOG_UAVObject(uint32_t objid, uint16_t instid, size_t size, uint8_t *data);
+
+#endif /* PIOS_H */
@@ -0,0 +1,7 @@
+#ifndef PIOS_CONFIG_H
+#define PIOS_CONFIG_H
+
+/* Enable/Disable PiOS modules */
+#define PIOS_INCLUDE_FREERTOS
+
+#endif /* PIOS_CONFIG_H */
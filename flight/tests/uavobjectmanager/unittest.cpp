@@ -0,0 +1,696 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h> /* printf */
+#include <stdlib.h> /* malloc */
+#include <string.h> /* memset */
+#include <pthread.h>
+#include <time.h>
+
+extern "C" {
+#include "openpilot.h"
+#include "unittest_priv.h"
+}
+
+#include "uavobjectidhash.h"
+
+#define SINGLE_OBJ_ID ut_object_ids[0]
+#define MULTI_OBJ_ID  ut_object_ids[1]
+
+#define OBJ_NUM_WORDS 16
+
+/* Every word holds the same value, a reader seeing a mix caught a torn update */
+typedef struct {
+    uint32_t words[OBJ_NUM_WORDS];
+} __attribute__((packed)) TestObjData;
+
+#define BENCH_OPS_PER_THREAD 200000
+
+// To use a test fixture, derive a class from testing::Test.
+class UAVObjManagerTest : public testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        ASSERT_EQ(0, UAVObjInitialize());
+
+        single = UAVObjRegister(SINGLE_OBJ_ID, true, false, false, sizeof(TestObjData), NULL);
+        ASSERT_TRUE(single != NULL);
+        ut_handles[0] = single;
+
+        multi  = UAVObjRegister(MULTI_OBJ_ID, false, false, false, sizeof(TestObjData), NULL);
+        ASSERT_TRUE(multi != NULL);
+        ut_handles[1] = multi;
+
+        ut_lock_stats_clear();
+    }
+
+    virtual void TearDown()
+    {}
+
+    UAVObjHandle single;
+    UAVObjHandle multi;
+};
+
+static void fill(TestObjData *data, uint32_t value)
+{
+    for (uint32_t i = 0; i < OBJ_NUM_WORDS; i++) {
+        data->words[i] = value;
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool consistent(const TestObjData *data)
+{
+    for (uint32_t i = 1; i < OBJ_NUM_WORDS; i++) {
+        if (data->words[i] != data->words[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_F(UAVObjManagerTest, SingleInstanceSetGet) {
+    TestObjData in, out;
+
+    fill(&in, 0x12345678);
+    EXPECT_EQ(0, UAVObjSetData(single, &in));
+    memset(&out, 0, sizeof(out));
+    EXPECT_EQ(0, UAVObjGetData(single, &out));
+    EXPECT_EQ(0, memcmp(&in, &out, sizeof(in)));
+
+    /* Only instance 0 exists */
+    EXPECT_EQ(-1, UAVObjGetInstanceData(single, 1, &out));
+}
+
+/* Reads of a new object must not depend on what the allocator handed out */
+TEST_F(UAVObjManagerTest, SingleInstanceReadLockFree) {
+    TestObjData out;
+
+    for (size_t size = 16; size <= 512; size += 8) {
+        void *dirty = malloc(size);
+        memset(dirty, 0xFF, size);
+        free(dirty);
+    }
+    for (uint32_t n = 0; n < 8; n++) {
+        UAVObjHandle obj = UAVObjRegister(ut_object_ids[2 + n], true, false, false, sizeof(TestObjData) - n, NULL);
+        ASSERT_TRUE(obj != NULL);
+
+        ut_lock_stats_clear();
+        EXPECT_EQ(0, UAVObjGetData(obj, &out));
+        EXPECT_EQ(0u, ut_lock_stats.takes);
+    }
+}
+
+TEST_F(UAVObjManagerTest, SingleInstanceFieldSetGet) {
+    uint32_t value = 0xCAFEBABE;
+    uint32_t out   = 0;
+
+    EXPECT_EQ(0, UAVObjSetDataField(single, &value, 4 * sizeof(uint32_t), sizeof(value)));
+    EXPECT_EQ(0, UAVObjGetDataField(single, &out, 4 * sizeof(uint32_t), sizeof(out)));
+    EXPECT_EQ(value, out);
+
+    /* Overrun must be refused */
+    EXPECT_EQ(-1, UAVObjGetDataField(single, &out, sizeof(TestObjData) - 2, sizeof(out)));
+}
+
+TEST_F(UAVObjManagerTest, SingleInstancePack) {
+    TestObjData in;
+    uint8_t packed[sizeof(TestObjData)];
+
+    fill(&in, 0xA5A5A5A5);
+    EXPECT_EQ(0, UAVObjSetData(single, &in));
+    EXPECT_EQ(0, UAVObjPack(single, 0, packed));
+    EXPECT_EQ(0, memcmp(&in, packed, sizeof(in)));
+}
+
+TEST_F(UAVObjManagerTest, MultiInstanceSetGet) {
+    TestObjData in, out;
+
+    EXPECT_EQ(1, UAVObjCreateInstance(multi, NULL));
+    EXPECT_EQ(2, UAVObjGetNumInstances(multi));
+
+    fill(&in, 0x11111111);
+    EXPECT_EQ(0, UAVObjSetInstanceData(multi, 1, &in));
+    EXPECT_EQ(0, UAVObjGetInstanceData(multi, 1, &out));
+    EXPECT_EQ(0, memcmp(&in, &out, sizeof(in)));
+    EXPECT_EQ(-1, UAVObjGetInstanceData(multi, 2, &out));
+}
+
+TEST_F(UAVObjManagerTest, MultiInstanceMany) {
+    TestObjData in, out;
+    const uint16_t num_instances = 300;
+
+    /* Unpacking beyond the last instance creates all instances up to it */
+    fill(&in, num_instances - 1);
+    EXPECT_EQ(0, UAVObjUnpack(multi, num_instances - 1, (const uint8_t *)&in));
+    EXPECT_EQ(num_instances, UAVObjGetNumInstances(multi));
+
+    for (uint16_t i = 0; i < num_instances - 1; i++) {
+        EXPECT_EQ(0, UAVObjGetInstanceData(multi, i, &out));
+        fill(&in, 0);
+        EXPECT_EQ(0, memcmp(&in, &out, sizeof(in)));
+        fill(&in, i);
+        EXPECT_EQ(0, UAVObjSetInstanceData(multi, i, &in));
+    }
+    for (uint16_t i = 0; i < num_instances; i++) {
+        EXPECT_EQ(0, UAVObjGetInstanceData(multi, i, &out));
+        fill(&in, i);
+        EXPECT_EQ(0, memcmp(&in, &out, sizeof(in)));
+    }
+
+    /* Instance IDs are limited */
+    EXPECT_EQ(-1, UAVObjUnpack(multi, UAVOBJ_MAX_INSTANCES, (const uint8_t *)&in));
+}
+
+/* Upload and read back of all instances, as done for waypoints and path actions */
+TEST_F(UAVObjManagerTest, MultiInstanceBenchmark) {
+    TestObjData data;
+    const uint16_t num_instances = UAVOBJ_MAX_INSTANCES - 1;
+
+    double start = now_s();
+    for (uint16_t i = 0; i < num_instances; i++) {
+        fill(&data, i);
+        UAVObjUnpack(multi, i, (const uint8_t *)&data);
+    }
+    double upload = now_s() - start;
+
+    start = now_s();
+    for (uint16_t i = 0; i < num_instances; i++) {
+        UAVObjGetInstanceData(multi, i, &data);
+        EXPECT_TRUE(data.words[0] == i);
+    }
+    double read = now_s() - start;
+
+    printf("%u instances: upload %.1f us, read back %.1f us\n", num_instances, upload * 1e6, read * 1e6);
+}
+
+TEST_F(UAVObjManagerTest, InPlaceUpdate) {
+    xQueueHandle queue = xQueueCreate(8, sizeof(UAVObjEvent));
+    UAVObjEvent ev;
+    TestObjData out;
+
+    ASSERT_EQ(0, UAVObjConnectQueue(single, queue, EV_MASK_ALL_UPDATES));
+    ut_lock_stats_clear();
+
+    TestObjData *data = (TestObjData *)UAVObjBeginUpdate(single);
+    ASSERT_TRUE(data != NULL);
+    data->words[0] = 1;
+    data->words[7] = 2;
+    data->words[OBJ_NUM_WORDS - 1] = 3;
+    UAVObjCommitUpdate(single);
+
+    /* One lock hold and one event for all the fields */
+    EXPECT_EQ(1u, ut_lock_stats.takes);
+    EXPECT_EQ(1u, uxQueueMessagesWaiting(queue));
+    ASSERT_EQ(pdTRUE, xQueueReceive(queue, &ev, 0));
+    EXPECT_EQ(EV_UPDATED, ev.event);
+    EXPECT_EQ(single, ev.obj);
+
+    EXPECT_EQ(0, UAVObjGetData(single, &out));
+    EXPECT_EQ(1u, out.words[0]);
+    EXPECT_EQ(2u, out.words[7]);
+    EXPECT_EQ(3u, out.words[OBJ_NUM_WORDS - 1]);
+
+    /* Missing instances are refused without keeping the lock */
+    EXPECT_TRUE(UAVObjBeginInstanceUpdate(multi, 1) == NULL);
+    EXPECT_EQ(1, UAVObjCreateInstance(multi, NULL));
+    data = (TestObjData *)UAVObjBeginInstanceUpdate(multi, 1);
+    ASSERT_TRUE(data != NULL);
+    fill(data, 0x55);
+    UAVObjCommitInstanceUpdate(multi, 1);
+    EXPECT_EQ(0, UAVObjGetInstanceData(multi, 1, &out));
+    EXPECT_TRUE(consistent(&out) && out.words[0] == 0x55);
+}
+
+TEST_F(UAVObjManagerTest, CoalescedQueue) {
+    xQueueHandle coalesced = xQueueCreate(4, sizeof(UAVObjEvent));
+    xQueueHandle plain     = xQueueCreate(4, sizeof(UAVObjEvent));
+    UAVObjStats stats;
+    UAVObjEvent ev;
+    TestObjData data;
+
+    fill(&data, 0);
+    ASSERT_EQ(0, UAVObjConnectQueue(single, coalesced, EV_UPDATED | EV_MASK_COALESCE));
+    ASSERT_EQ(0, UAVObjConnectQueue(single, plain, EV_UPDATED));
+    UAVObjClearStats();
+
+    /* Until it is received the first update stands for all that follow */
+    for (int i = 0; i < 10; i++) {
+        UAVObjSetData(single, &data);
+    }
+    EXPECT_EQ(1u, uxQueueMessagesWaiting(coalesced));
+    EXPECT_EQ(4u, uxQueueMessagesWaiting(plain));
+
+    UAVObjGetStats(&stats);
+    EXPECT_EQ(9u, stats.eventsCoalesced);
+    EXPECT_EQ(6u, stats.eventQueueErrors);
+
+    ASSERT_TRUE(UAVObjQueueReceive(coalesced, &ev, 0));
+    UAVObjSetData(single, &data);
+    EXPECT_EQ(1u, uxQueueMessagesWaiting(coalesced));
+
+    /* Instances other than the pending one queue as usual */
+    ASSERT_TRUE(UAVObjQueueReceive(coalesced, &ev, 0));
+    EXPECT_EQ(1, UAVObjCreateInstance(multi, NULL));
+    ASSERT_EQ(0, UAVObjConnectQueue(multi, coalesced, EV_UPDATED | EV_MASK_COALESCE));
+    UAVObjSetInstanceData(multi, 0, &data);
+    UAVObjSetInstanceData(multi, 1, &data);
+    UAVObjSetInstanceData(multi, 0, &data);
+    EXPECT_EQ(2u, uxQueueMessagesWaiting(coalesced));
+}
+
+/* One object worth of fake settings flash, enough for the persistence tests */
+static struct {
+    bool     valid;
+    uint32_t obj_id;
+    uint16_t inst_id;
+    uint8_t  data[sizeof(TestObjData)];
+    int32_t  held_while_loading;
+} ut_flash;
+
+extern "C" {
+uintptr_t pios_uavo_settings_fs_id;
+
+int32_t PIOS_FLASHFS_ObjSave(__attribute__((unused)) uintptr_t fs_id, uint32_t obj_id, uint16_t obj_inst_id, uint8_t *obj_data, uint16_t obj_size)
+{
+    if (obj_size > sizeof(ut_flash.data)) {
+        return -1;
+    }
+    ut_flash.valid   = true;
+    ut_flash.obj_id  = obj_id;
+    ut_flash.inst_id = obj_inst_id;
+    memcpy(ut_flash.data, obj_data, obj_size);
+    return 0;
+}
+
+int32_t PIOS_FLASHFS_ObjLoad(__attribute__((unused)) uintptr_t fs_id, uint32_t obj_id, uint16_t obj_inst_id, uint8_t *obj_data, uint16_t obj_size)
+{
+    ut_flash.held_while_loading = ut_lock_stats.held;
+    if (!ut_flash.valid || ut_flash.obj_id != obj_id || ut_flash.inst_id != obj_inst_id) {
+        /* A failing load may have scribbled over the buffer already */
+        memset(obj_data, 0xA5, obj_size);
+        return -1;
+    }
+    memcpy(obj_data, ut_flash.data, obj_size);
+    return 0;
+}
+
+int32_t PIOS_FLASHFS_ObjDelete(__attribute__((unused)) uintptr_t fs_id, __attribute__((unused)) uint32_t obj_id, __attribute__((unused)) uint16_t obj_inst_id)
+{
+    ut_flash.valid = false;
+    return 0;
+}
+}
+
+TEST_F(UAVObjManagerTest, LoadOutsideLock) {
+    xQueueHandle queue = xQueueCreate(4, sizeof(UAVObjEvent));
+    UAVObjEvent ev;
+    TestObjData data;
+
+    fill(&data, 7);
+    UAVObjSetData(single, &data);
+    EXPECT_EQ(0, UAVObjSave(single, 0));
+    fill(&data, 8);
+    UAVObjSetData(single, &data);
+    ASSERT_EQ(0, UAVObjConnectQueue(single, queue, EV_UNPACKED));
+
+    /* The flash is read without holding the object manager lock */
+    ut_lock_stats_clear();
+    ut_flash.held_while_loading = -1;
+    EXPECT_EQ(0, UAVObjLoad(single, 0));
+    EXPECT_EQ(0, ut_flash.held_while_loading);
+    EXPECT_EQ(1u, ut_lock_stats.takes);
+    EXPECT_EQ(0, UAVObjGetData(single, &data));
+    EXPECT_TRUE(consistent(&data) && data.words[0] == 7);
+    ASSERT_EQ(pdTRUE, xQueueReceive(queue, &ev, 0));
+    EXPECT_EQ(EV_UNPACKED, ev.event);
+
+    /* A failed load leaves the instance alone and sends no event */
+    EXPECT_EQ(0, UAVObjDelete(single, 0));
+    EXPECT_EQ(-1, UAVObjLoad(single, 0));
+    EXPECT_EQ(0, UAVObjGetData(single, &data));
+    EXPECT_TRUE(consistent(&data) && data.words[0] == 7);
+    EXPECT_EQ(0u, uxQueueMessagesWaiting(queue));
+}
+
+#define UPDATE_ROUNDS 200000
+
+/* Writing three fields of an object: per field setters, a full copy, in place */
+TEST_F(UAVObjManagerTest, InPlaceUpdateBenchmark) {
+    UAVObjHandle objs[] = { single, multi };
+    const char *names[] = { "single", "multi" };
+
+    for (uint32_t o = 0; o < 2; o++) {
+        UAVObjHandle obj = objs[o];
+        TestObjData data;
+
+        ut_lock_stats_clear();
+        double start = now_s();
+        for (uint32_t n = 0; n < UPDATE_ROUNDS; n++) {
+            UAVObjSetInstanceDataField(obj, 0, &n, 0, sizeof(n));
+            UAVObjSetInstanceDataField(obj, 0, &n, 4, sizeof(n));
+            UAVObjSetInstanceDataField(obj, 0, &n, 8, sizeof(n));
+        }
+        double fields = (now_s() - start) / UPDATE_ROUNDS;
+        uint64_t fieldTakes = ut_lock_stats.takes;
+
+        ut_lock_stats_clear();
+        start = now_s();
+        for (uint32_t n = 0; n < UPDATE_ROUNDS; n++) {
+            UAVObjGetInstanceData(obj, 0, &data);
+            data.words[0] = data.words[1] = data.words[2] = n;
+            UAVObjSetInstanceData(obj, 0, &data);
+        }
+        double copy = (now_s() - start) / UPDATE_ROUNDS;
+        uint64_t copyTakes = ut_lock_stats.takes;
+
+        ut_lock_stats_clear();
+        start = now_s();
+        for (uint32_t n = 0; n < UPDATE_ROUNDS; n++) {
+            TestObjData *inplace = (TestObjData *)UAVObjBeginInstanceUpdate(obj, 0);
+            inplace->words[0] = inplace->words[1] = inplace->words[2] = n;
+            UAVObjCommitInstanceUpdate(obj, 0);
+        }
+        double update = (now_s() - start) / UPDATE_ROUNDS;
+        uint64_t updateTakes = ut_lock_stats.takes;
+
+        EXPECT_EQ((uint64_t)UPDATE_ROUNDS, updateTakes);
+        printf("%-6s 3 field sets %.0f ns (%.1f locks), get+set %.0f ns (%.1f locks), in place %.0f ns (%.1f locks)\n",
+               names[o], fields * 1e9, (double)fieldTakes / UPDATE_ROUNDS,
+               copy * 1e9, (double)copyTakes / UPDATE_ROUNDS,
+               update * 1e9, (double)updateTakes / UPDATE_ROUNDS);
+    }
+}
+
+/* The objects StateEstimation exports every cycle, laid out as the generator does */
+typedef struct {
+    float x;
+    float y;
+    float z;
+} __attribute__((packed)) UTVectorStateData;
+
+typedef struct {
+    float x;
+    float y;
+    float z;
+    uint8_t Source;
+} __attribute__((packed)) UTMagStateData;
+
+typedef struct {
+    float CalibratedAirspeed;
+    float TrueAirspeed;
+} __attribute__((packed)) UTAirspeedStateData;
+
+typedef struct {
+    float q1;
+    float q2;
+    float q3;
+    float q4;
+    float Roll;
+    float Pitch;
+    float Yaw;
+} __attribute__((packed)) UTAttitudeStateData;
+
+enum { UT_ACCEL, UT_MAG, UT_POSITION, UT_VELOCITY, UT_AIRSPEED, UT_ATTITUDE, UT_NUM_STATES };
+
+#define EXPORT_VECTOR_COPY(obj, v) \
+    { \
+        UTVectorStateData s; \
+        UAVObjGetData(obj, &s); \
+        s.x = (v)[0]; \
+        s.y = (v)[1]; \
+        s.z = (v)[2]; \
+        UAVObjSetData(obj, &s); \
+    }
+
+#define EXPORT_VECTOR_IN_PLACE(obj, v) \
+    { \
+        UTVectorStateData *s = (UTVectorStateData *)UAVObjBeginUpdate(obj); \
+        if (s) { \
+            s->x = (v)[0]; \
+            s->y = (v)[1]; \
+            s->z = (v)[2]; \
+            UAVObjCommitUpdate(obj); \
+        } \
+    }
+
+/*
+ * The RUNSTATE_SAVE step of StateEstimation with all states updated, with
+ * telemetry listening to each of them on a coalescing queue: Get/modify/Set
+ * as before against the in place update, the quaternion to Euler conversion
+ * left out as it is the same for both.
+ */
+TEST_F(UAVObjManagerTest, StateEstimationExportBenchmark) {
+    static const uint16_t sizes[UT_NUM_STATES] = {
+        sizeof(UTVectorStateData), sizeof(UTMagStateData),      sizeof(UTVectorStateData),
+        sizeof(UTVectorStateData), sizeof(UTAirspeedStateData), sizeof(UTAttitudeStateData)
+    };
+    UAVObjHandle states[UT_NUM_STATES];
+    xQueueHandle telemetry = xQueueCreate(UT_NUM_STATES, sizeof(UAVObjEvent));
+    float vector[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    UAVObjEvent ev;
+
+    for (uint32_t n = 0; n < UT_NUM_STATES; n++) {
+        states[n] = UAVObjRegister(ut_object_ids[2 + n], true, false, false, sizes[n], NULL);
+        ASSERT_TRUE(states[n] != NULL);
+        ASSERT_EQ(0, UAVObjConnectQueue(states[n], telemetry, EV_UPDATED | EV_MASK_COALESCE));
+    }
+
+    for (uint32_t variant = 0; variant < 2; variant++) {
+        uint32_t events = 0;
+
+        ut_lock_stats_clear();
+        double start = now_s();
+        for (uint32_t n = 0; n < UPDATE_ROUNDS; n++) {
+            vector[0] = (float)n;
+            if (variant == 0) {
+                EXPORT_VECTOR_COPY(states[UT_ACCEL], vector);
+                {
+                    UTMagStateData s;
+                    UAVObjGetData(states[UT_MAG], &s);
+                    s.x      = vector[0];
+                    s.y      = vector[1];
+                    s.z      = vector[2];
+                    s.Source = 1;
+                    UAVObjSetData(states[UT_MAG], &s);
+                }
+                EXPORT_VECTOR_COPY(states[UT_POSITION], vector);
+                EXPORT_VECTOR_COPY(states[UT_VELOCITY], vector);
+                {
+                    UTAirspeedStateData s;
+                    UAVObjGetData(states[UT_AIRSPEED], &s);
+                    s.CalibratedAirspeed = vector[0];
+                    s.TrueAirspeed       = vector[1];
+                    UAVObjSetData(states[UT_AIRSPEED], &s);
+                }
+                {
+                    UTAttitudeStateData s;
+                    UAVObjGetData(states[UT_ATTITUDE], &s);
+                    memcpy(&s.q1, vector, sizeof(vector));
+                    UAVObjSetData(states[UT_ATTITUDE], &s);
+                }
+            } else {
+                EXPORT_VECTOR_IN_PLACE(states[UT_ACCEL], vector);
+                {
+                    UTMagStateData *s = (UTMagStateData *)UAVObjBeginUpdate(states[UT_MAG]);
+                    if (s) {
+                        s->x      = vector[0];
+                        s->y      = vector[1];
+                        s->z      = vector[2];
+                        s->Source = 1;
+                        UAVObjCommitUpdate(states[UT_MAG]);
+                    }
+                }
+                EXPORT_VECTOR_IN_PLACE(states[UT_POSITION], vector);
+                EXPORT_VECTOR_IN_PLACE(states[UT_VELOCITY], vector);
+                {
+                    UTAirspeedStateData *s = (UTAirspeedStateData *)UAVObjBeginUpdate(states[UT_AIRSPEED]);
+                    if (s) {
+                        s->CalibratedAirspeed = vector[0];
+                        s->TrueAirspeed       = vector[1];
+                        UAVObjCommitUpdate(states[UT_AIRSPEED]);
+                    }
+                }
+                {
+                    UTAttitudeStateData *s = (UTAttitudeStateData *)UAVObjBeginUpdate(states[UT_ATTITUDE]);
+                    if (s) {
+                        memcpy(&s->q1, vector, sizeof(vector));
+                        UAVObjCommitUpdate(states[UT_ATTITUDE]);
+                    }
+                }
+            }
+            /* Telemetry takes the updates before the next cycle */
+            while (UAVObjQueueReceive(telemetry, &ev, 0)) {
+                events++;
+            }
+        }
+        double cycle = (now_s() - start) / UPDATE_ROUNDS;
+
+        EXPECT_EQ((uint32_t)UPDATE_ROUNDS * UT_NUM_STATES, events);
+        printf("StateEstimation export, %-8s %.0f ns per cycle, %.1f locks\n",
+               variant ? "in place" : "get+set", cycle * 1e9, (double)ut_lock_stats.takes / UPDATE_ROUNDS);
+    }
+}
+
+struct bench_args {
+    UAVObjHandle obj;
+    bool writer;
+    uint32_t torn;
+};
+
+static void *bench_thread(void *arg)
+{
+    struct bench_args *args = (struct bench_args *)arg;
+    TestObjData data;
+
+    for (uint32_t n = 0; n < BENCH_OPS_PER_THREAD; n++) {
+        if (args->writer) {
+            fill(&data, n);
+            UAVObjSetInstanceData(args->obj, 0, &data);
+        } else {
+            UAVObjGetInstanceData(args->obj, 0, &data);
+            if (!consistent(&data)) {
+                args->torn++;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* One writer and (num_threads - 1) readers hammering the same instance */
+static uint32_t run_bench(const char *name, UAVObjHandle obj, uint32_t num_threads)
+{
+    pthread_t threads[num_threads];
+    struct bench_args args[num_threads];
+    uint32_t torn = 0;
+
+    ut_lock_stats_clear();
+    double start = now_s();
+    for (uint32_t i = 0; i < num_threads; i++) {
+        args[i].obj    = obj;
+        args[i].writer = (i == 0);
+        args[i].torn   = 0;
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+    for (uint32_t i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+        torn += args[i].torn;
+    }
+    double elapsed = now_s() - start;
+
+    printf("%-8s tasks=%u  %8.2f Mops/s  mutex takes=%llu contended=%llu wait=%.2f ms\n",
+           name, num_threads,
+           (num_threads * (double)BENCH_OPS_PER_THREAD) / elapsed / 1e6,
+           (unsigned long long)ut_lock_stats.takes,
+           (unsigned long long)ut_lock_stats.contended,
+           ut_lock_stats.wait_ns / 1e6);
+    return torn;
+}
+
+/*
+ * Readers of single instance objects take the lock free sequence counter path,
+ * multi instance objects still go through the mutex and serve as the reference.
+ */
+TEST_F(UAVObjManagerTest, ConcurrentGetSetBenchmark) {
+    for (uint32_t num_threads = 2; num_threads <= 8; num_threads *= 2) {
+        EXPECT_EQ(0u, run_bench("single", single, num_threads));
+        EXPECT_EQ(0u, run_bench("multi", multi, num_threads));
+    }
+}
+
+#define LOOKUP_ROUNDS 20000
+
+class UAVObjLookupTest : public testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        ASSERT_EQ(0, UAVObjInitialize());
+
+        for (uint32_t i = 0; i < UT_NUM_OBJECTS; i++) {
+            ut_handles[i] = UAVObjRegister(ut_object_ids[i], true, false, false, sizeof(TestObjData), NULL);
+            ASSERT_TRUE(ut_handles[i] != NULL);
+        }
+    }
+
+    virtual void TearDown()
+    {}
+};
+
+TEST_F(UAVObjLookupTest, AllRegisteredIds) {
+    for (uint32_t i = 0; i < UT_NUM_OBJECTS; i++) {
+        EXPECT_EQ(ut_handles[i], UAVObjGetByID(ut_object_ids[i]));
+        EXPECT_EQ(UAVObjGetLinkedObj(ut_handles[i]), UAVObjGetByID(MetaObjectId(ut_object_ids[i])));
+    }
+}
+
+TEST_F(UAVObjLookupTest, UnknownIds) {
+    EXPECT_TRUE(UAVObjGetByID(0) == NULL);
+    EXPECT_TRUE(UAVObjGetByID(0x1002) == NULL);
+    EXPECT_TRUE(UAVObjGetByID(0xDEADBEEF) == NULL);
+}
+
+TEST_F(UAVObjLookupTest, DuplicateRegistration) {
+    EXPECT_TRUE(UAVObjRegister(ut_object_ids[5], true, false, false, sizeof(TestObjData), NULL) == NULL);
+}
+
+/* The generator refuses object sets the byte wide hash index can not address */
+TEST(UAVObjIdHashTest, ObjectLimit) {
+    std::vector<uint32_t> ids;
+    UAVObjectIdHash hash;
+    uint32_t id = 0x12345678;
+
+    for (int n = 0; n < UAVO_ID_HASH_MAX_OBJECTS; n++) {
+        id = id * 1664525 + 1013904223;
+        ids.push_back(id & ~1u);
+    }
+    ASSERT_TRUE(uavo_id_hash_build(ids, &hash));
+    EXPECT_LE(hash.slotBits, 9);
+    for (int n = 0; n < UAVO_ID_HASH_MAX_OBJECTS; n++) {
+        EXPECT_EQ(n + 1, uavo_id_hash_lookup(hash, ids[n]));
+    }
+
+    ids.push_back(0x2000);
+    EXPECT_FALSE(uavo_id_hash_build(ids, &hash));
+}
+
+static uint32_t linear_find_id;
+static UAVObjHandle linear_found;
+
+static void linear_find(UAVObjHandle obj)
+{
+    if (UAVObjGetID(obj) == linear_find_id) {
+        linear_found = obj;
+    }
+}
+
+/* Reference is the full object list walk UAVObjGetByID used to do */
+TEST_F(UAVObjLookupTest, LookupBenchmark) {
+    double start = now_s();
+
+    for (uint32_t n = 0; n < LOOKUP_ROUNDS; n++) {
+        for (uint32_t i = 0; i < UT_NUM_OBJECTS; i++) {
+            EXPECT_TRUE(UAVObjGetByID(ut_object_ids[i]) != NULL);
+        }
+    }
+    double hashed = (now_s() - start) / (LOOKUP_ROUNDS * UT_NUM_OBJECTS);
+
+    start = now_s();
+    for (uint32_t n = 0; n < LOOKUP_ROUNDS / 100; n++) {
+        for (uint32_t i = 0; i < UT_NUM_OBJECTS; i++) {
+            linear_find_id = ut_object_ids[i];
+            linear_found   = NULL;
+            UAVObjIterate(&linear_find);
+            EXPECT_TRUE(linear_found != NULL);
+        }
+    }
+    double linear = (now_s() - start) / (LOOKUP_ROUNDS / 100 * UT_NUM_OBJECTS);
+
+    printf("lookup of %u registered ids: hashed %.1f ns/lookup, linear scan %.1f ns/lookup\n",
+           UT_NUM_OBJECTS, hashed * 1e9, linear * 1e9);
+}
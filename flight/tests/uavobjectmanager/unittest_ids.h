@@ -0,0 +1,28 @@
+/*
+ * IDs of the test objects, shared with the tool emitting their ID hash tables
+ */
+
+#ifndef UNITTEST_IDS_H
+#define UNITTEST_IDS_H
+
+#define UT_NUM_OBJECTS 64
+
+#define UT_OBJECT_IDS \
+    0x00001000, 0x00002000, 0xA3B1799C, 0x1C80317E, \
+    0x06671AD0, 0xBDD640FA, 0x46685256, 0x3EB13B90, \
+    0x392456DE, 0x23B8C1E8, 0xBC8960A8, 0x1A3D1FA6, \
+    0xAD3C2D6C, 0xBD9C66B2, 0xE465E150, 0x8B9D2434, \
+    0x16419F82, 0x972A8468, 0x6C031198, 0x0822E8F2, \
+    0x07A0CA6E, 0x17FC695A, 0x37F8A88A, 0x3B8FAA18, \
+    0x815EF6D0, 0x9A1DE644, 0x06CB0FB2, 0x8FADC1A6, \
+    0x32E70628, 0xB74D0FB0, 0xA65ED388, 0xB38A088C, \
+    0x8B8148F6, 0x6B65A6A4, 0x386ECBE0, 0x72FF5D2A, \
+    0x96DA1DAC, 0x47378190, 0xCF36D58A, 0xDE8A774A, \
+    0x01A9E71E, 0xC241330A, 0xCE4A2BBC, 0x28DF6EC4, \
+    0xB2B9437A, 0x6C307510, 0x571AA876, 0x47229388, \
+    0x27CD8130, 0x371ECD7A, 0xF50BEA62, 0xC37459EE, \
+    0x562B0F78, 0x1A2A73EC, 0x17BE3110, 0x6142EA7C, \
+    0x18C26796, 0x5BE6128E, 0xD8F56412, 0x580D7B70, \
+    0x9A8DCA02, 0x43B7A3A6, 0xCE9FF57E, 0x0B1F9162
+
+#endif /* UNITTEST_IDS_H */
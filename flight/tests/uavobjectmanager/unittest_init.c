@@ -0,0 +1,30 @@
+/*
+ * These need to be defined in a .c file so that the handles end up in the
+ * same linker section as the generated UAVObject code would put them.
+ */
+
+#include "openpilot.h"
+#include "unittest_priv.h"
+
+UAVObjHandle ut_handles[UT_NUM_OBJECTS] __attribute__((section("_uavo_handles")));
+
+/* Callbacks are invoked straight away instead of from the event dispatcher task */
+int32_t EventCallbackDispatch(UAVObjEvent *ev, UAVObjEventCallback cb)
+{
+    cb(ev);
+    return pdTRUE;
+}
+
+int32_t EventCallbackDispatchCoalesced(UAVObjEvent *ev, UAVObjEventCallback cb)
+{
+    cb(ev);
+    return pdTRUE;
+}
+
+void PIOS_DEBUGLOG_UAVObject(__attribute__((unused)) uint32_t objid, __attribute__((unused)) uint16_t instid,
+                             __attribute__((unused)) size_t size, __attribute__((unused)) uint8_t *data)
+{}
+
+const uint32_t ut_object_ids[UT_NUM_OBJECTS] = { UT_OBJECT_IDS };
+
+/* The ID hash tables are emitted into unittest_idhash.c at build time, see gen/ */
@@ -0,0 +1,9 @@
+#ifndef UNITTEST_PRIV_H
+#define UNITTEST_PRIV_H
+
+#include "unittest_ids.h"
+
+extern UAVObjHandle ut_handles[UT_NUM_OBJECTS];
+extern const uint32_t ut_object_ids[UT_NUM_OBJECTS];
+
+#endif /* UNITTEST_PRIV_H */
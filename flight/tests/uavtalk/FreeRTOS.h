@@ -0,0 +1,50 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+/*
+ * Minimal host (pthreads) stand-in for the FreeRTOS API used by UAVTalk and the object manager.
+ * Mutex takes are instrumented so that tests can report lock contention.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define pvPortMalloc(xSize) (malloc(xSize))
+#define vPortFree(pv)       (free(pv))
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define portMAX_DELAY       0xffffffff
+#define portTICK_RATE_MS    1
+
+typedef int32_t portBASE_TYPE;
+typedef uint32_t portTickType;
+typedef void *xSemaphoreHandle;
+typedef struct ut_queue *xQueueHandle;
+
+struct ut_lock_stats {
+    uint64_t takes;      /* number of mutex takes */
+    uint64_t contended;  /* takes that had to wait for another thread */
+    uint64_t wait_ns;    /* total time spent waiting for the mutex */
+};
+extern struct ut_lock_stats ut_lock_stats;
+void ut_lock_stats_clear(void);
+
+xSemaphoreHandle xSemaphoreCreateRecursiveMutex(void);
+xSemaphoreHandle xSemaphoreCreateBinary(void);
+#define vSemaphoreCreateBinary(sem) ((sem) = xSemaphoreCreateBinary())
+portBASE_TYPE xSemaphoreTake(xSemaphoreHandle sem, portTickType timeout);
+portBASE_TYPE xSemaphoreGive(xSemaphoreHandle sem);
+portBASE_TYPE xSemaphoreTakeRecursive(xSemaphoreHandle sem, portTickType timeout);
+portBASE_TYPE xSemaphoreGiveRecursive(xSemaphoreHandle sem);
+
+xQueueHandle xQueueCreate(uint32_t length, uint32_t item_size);
+portBASE_TYPE xQueueSend(xQueueHandle queue, const void *item, portTickType timeout);
+portBASE_TYPE xQueueReceive(xQueueHandle queue, void *item, portTickType timeout);
+uint32_t uxQueueMessagesWaiting(xQueueHandle queue);
+
+portTickType xTaskGetTickCount(void);
+void ut_set_tick_count(portTickType ticks);
+
+#endif /* FREERTOS_H */
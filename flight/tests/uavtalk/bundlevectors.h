@@ -0,0 +1,125 @@
+/**
+ ******************************************************************************
+ *
+ * @file       bundlevectors.h
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      UAVTalk bundles as the flight code sends them
+ *
+ *             The flight unit test checks that its encoder still produces
+ *             these bytes, the GCS test (tst_uavtalk) decodes them.
+ *
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef BUNDLEVECTORS_H
+#define BUNDLEVECTORS_H
+
+#include <stdint.h>
+
+// A single instance object of 3 fields and one of 4 instances of 10 fields,
+// fields of 4 bytes, all zero to begin with
+#define BUNDLE_VECTORS_SMALL_OBJID  0x1000
+#define BUNDLE_VECTORS_SMALL_FIELDS 3
+#define BUNDLE_VECTORS_MULTI_OBJID  0x3000
+#define BUNDLE_VECTORS_MULTI_FIELDS 10
+#define BUNDLE_VECTORS_INSTANCES    4
+#define BUNDLE_VECTORS_FIELD_LENGTH 4
+
+// Sends per burst, each burst is one bundle in frames of up to this length
+#define BUNDLE_VECTORS_BURST        4
+#define BUNDLE_VECTORS_SENDS        24
+#define BUNDLE_VECTORS_FRAME_LENGTH 62
+
+/**
+ * The object instance of send number send, every third one is the small object.
+ * The multi instance object goes out as deltas once an instance was sent in full.
+ */
+static inline void bundlevectors_instance(int send, uint32_t *objId, uint16_t *instId)
+{
+    *objId  = (send % 3 == 0) ? BUNDLE_VECTORS_SMALL_OBJID : BUNDLE_VECTORS_MULTI_OBJID;
+    *instId = (send % 3 == 0) ? 0 : send % BUNDLE_VECTORS_INSTANCES;
+}
+
+/**
+ * Change a single field of the instance data, as send number send does
+ */
+static inline void bundlevectors_update(uint8_t *data, int numFields, int send)
+{
+    int field = send % numFields;
+
+    for (int n = 0; n < BUNDLE_VECTORS_FIELD_LENGTH; n++) {
+        data[field * BUNDLE_VECTORS_FIELD_LENGTH + n] = (uint8_t)(send * 13 + n);
+    }
+}
+
+// The frames sent for the bursts once the receiver offered bundles and deltas
+static const uint8_t bundlevectors_stream[] = {
+    0x3c, 0x20, 0x16, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x02, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd6, 0x3c,
+    0x20, 0x32, 0x00, 0x00, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x0d, 0x0e, 0x0f, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x84, 0x3c, 0x20, 0x32, 0x00, 0x00, 0x30, 0x00, 0x00, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x34, 0x3c, 0x20, 0x16, 0x00, 0x00, 0x10, 0x00,
+    0x00, 0x00, 0x00, 0x27, 0x28, 0x29, 0x2a, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xba, 0x3c, 0x20, 0x32, 0x00, 0x00, 0x30, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x35, 0x36, 0x37, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x65, 0x3c, 0x27, 0x2a, 0x00, 0xfd,
+    0xff, 0xff, 0xff, 0x02, 0x00, 0xa5, 0x00, 0x30, 0x00, 0x00, 0x01, 0x00,
+    0x06, 0x20, 0x00, 0x41, 0x42, 0x43, 0x44, 0x20, 0x00, 0x10, 0x00, 0x00,
+    0x0c, 0x4e, 0x4f, 0x50, 0x51, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0xd8, 0x3c, 0x20, 0x32, 0x00, 0x00, 0x30, 0x00, 0x00, 0x03, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x5b, 0x5c, 0x5d, 0x5e, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x1a, 0x3c, 0x27, 0x36, 0x00, 0xfd, 0xff, 0xff,
+    0xff, 0x03, 0x00, 0x25, 0x00, 0x30, 0x00, 0x00, 0x06, 0x00, 0x01, 0x68,
+    0x69, 0x6a, 0x6b, 0x20, 0x00, 0x10, 0x00, 0x00, 0x0c, 0x75, 0x76, 0x77,
+    0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x00, 0x30,
+    0x00, 0x00, 0x02, 0x00, 0x06, 0x01, 0x00, 0x82, 0x83, 0x84, 0x85, 0x7f,
+    0x3c, 0x25, 0x10, 0x00, 0x00, 0x30, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x8f, 0x90, 0x91, 0x92, 0x9f, 0x3c, 0x27, 0x38, 0x00, 0xfd, 0xff, 0xff,
+    0xff, 0x03, 0x00, 0x20, 0x00, 0x10, 0x00, 0x00, 0x0c, 0x9c, 0x9d, 0x9e,
+    0x9f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x00, 0x30,
+    0x00, 0x00, 0x01, 0x00, 0x06, 0x08, 0x00, 0xa9, 0xaa, 0xab, 0xac, 0xa5,
+    0x00, 0x30, 0x00, 0x00, 0x02, 0x00, 0x06, 0x10, 0x00, 0xb6, 0xb7, 0xb8,
+    0xb9, 0x89, 0x3c, 0x20, 0x16, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0xc3, 0xc4, 0xc5, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x24, 0x3c, 0x27, 0x36, 0x00, 0xfd, 0xff, 0xff, 0xff, 0x03, 0x00, 0x25,
+    0x00, 0x30, 0x00, 0x00, 0x06, 0x40, 0x00, 0xd0, 0xd1, 0xd2, 0xd3, 0xa5,
+    0x00, 0x30, 0x00, 0x00, 0x01, 0x00, 0x06, 0x80, 0x00, 0xdd, 0xde, 0xdf,
+    0xe0, 0x20, 0x00, 0x10, 0x00, 0x00, 0x0c, 0xea, 0xeb, 0xec, 0xed, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4f, 0x3c, 0x25, 0x10, 0x00,
+    0x00, 0x30, 0x00, 0x00, 0x03, 0x00, 0x00, 0x02, 0xf7, 0xf8, 0xf9, 0xfa,
+    0x5d, 0x3c, 0x27, 0x36, 0x00, 0xfd, 0xff, 0xff, 0xff, 0x03, 0x00, 0x25,
+    0x00, 0x30, 0x00, 0x00, 0x06, 0x01, 0x00, 0x04, 0x05, 0x06, 0x07, 0x20,
+    0x00, 0x10, 0x00, 0x00, 0x0c, 0x11, 0x12, 0x13, 0x14, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x00, 0x30, 0x00, 0x00, 0x02, 0x00,
+    0x06, 0x04, 0x00, 0x1e, 0x1f, 0x20, 0x21, 0x42, 0x3c, 0x25, 0x10, 0x00,
+    0x00, 0x30, 0x00, 0x00, 0x03, 0x00, 0x08, 0x00, 0x2b, 0x2c, 0x2d, 0x2e,
+    0xbb,
+};
+
+#endif // BUNDLEVECTORS_H
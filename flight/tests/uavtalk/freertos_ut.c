@@ -0,0 +1,167 @@
+/*
+ * Host implementation of the FreeRTOS stand-in declared in FreeRTOS.h
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+struct ut_lock_stats ut_lock_stats;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void ut_lock_stats_clear(void)
+{
+    pthread_mutex_lock(&stats_lock);
+    memset(&ut_lock_stats, 0, sizeof(ut_lock_stats));
+    pthread_mutex_unlock(&stats_lock);
+}
+
+xSemaphoreHandle xSemaphoreCreateRecursiveMutex(void)
+{
+    pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return mutex;
+}
+
+portBASE_TYPE xSemaphoreTakeRecursive(xSemaphoreHandle sem, __attribute__((unused)) portTickType timeout)
+{
+    pthread_mutex_t *mutex = (pthread_mutex_t *)sem;
+    uint64_t waited = 0;
+
+    if (pthread_mutex_trylock(mutex) != 0) {
+        uint64_t start = now_ns();
+        pthread_mutex_lock(mutex);
+        waited = now_ns() - start;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    ut_lock_stats.takes++;
+    if (waited) {
+        ut_lock_stats.contended++;
+        ut_lock_stats.wait_ns += waited;
+    }
+    pthread_mutex_unlock(&stats_lock);
+    return pdTRUE;
+}
+
+portBASE_TYPE xSemaphoreGiveRecursive(xSemaphoreHandle sem)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)sem);
+    return pdTRUE;
+}
+
+/* Binary semaphores never block, the tests are single threaded */
+xSemaphoreHandle xSemaphoreCreateBinary(void)
+{
+    uint32_t *count = malloc(sizeof(uint32_t));
+
+    *count = 1;
+    return count;
+}
+
+portBASE_TYPE xSemaphoreTake(xSemaphoreHandle sem, __attribute__((unused)) portTickType timeout)
+{
+    uint32_t *count = (uint32_t *)sem;
+
+    if (*count == 0) {
+        return pdFALSE;
+    }
+    *count = 0;
+    return pdTRUE;
+}
+
+portBASE_TYPE xSemaphoreGive(xSemaphoreHandle sem)
+{
+    *(uint32_t *)sem = 1;
+    return pdTRUE;
+}
+
+struct ut_queue {
+    pthread_mutex_t lock;
+    uint32_t length;
+    uint32_t item_size;
+    uint32_t head;
+    uint32_t count;
+    uint8_t  *items;
+};
+
+xQueueHandle xQueueCreate(uint32_t length, uint32_t item_size)
+{
+    struct ut_queue *queue = malloc(sizeof(struct ut_queue));
+
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->length    = length;
+    queue->item_size = item_size;
+    queue->head  = 0;
+    queue->count = 0;
+    queue->items = malloc(length * item_size);
+    return queue;
+}
+
+portBASE_TYPE xQueueSend(xQueueHandle queue, const void *item, __attribute__((unused)) portTickType timeout)
+{
+    portBASE_TYPE rc = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count < queue->length) {
+        uint32_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+        queue->count++;
+        rc = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return rc;
+}
+
+portBASE_TYPE xQueueReceive(xQueueHandle queue, void *item, __attribute__((unused)) portTickType timeout)
+{
+    portBASE_TYPE rc = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0) {
+        memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        rc = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return rc;
+}
+
+uint32_t uxQueueMessagesWaiting(xQueueHandle queue)
+{
+    uint32_t count;
+
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+static portTickType tick_count;
+
+portTickType xTaskGetTickCount(void)
+{
+    return tick_count;
+}
+
+void ut_set_tick_count(portTickType ticks)
+{
+    tick_count = ticks;
+}
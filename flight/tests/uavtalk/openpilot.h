@@ -0,0 +1,16 @@
+#ifndef OPENPILOT_H
+#define OPENPILOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "pios.h"
+
+#include <utlist.h>
+#include <uavobjectmanager.h>
+#include <eventdispatcher.h>
+#include <uavtalk.h>
+
+#endif /* OPENPILOT_H */
@@ -0,0 +1,7 @@
+#ifndef UAVOBJECTSINIT_H
+#define UAVOBJECTSINIT_H
+
+/* Stands in for the generated header, sized for the test objects */
+#define UAVOBJECTS_LARGEST 256
+
+#endif /* UAVOBJECTSINIT_H */
@@ -0,0 +1,635 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h> /* printf */
+#include <string.h> /* memset */
+#include <stdlib.h> /* rand */
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "openpilot.h"
+#include "unittest_priv.h"
+}
+
+#include "deltavectors.h"
+#include "bundlevectors.h"
+
+#define SMALL_OBJ_ID  0x1000
+#define LARGE_OBJ_ID  0x2000
+#define MULTI_OBJ_ID  0x3000
+
+#define SMALL_OBJ_LEN 12
+#define LARGE_OBJ_LEN 200
+#define MULTI_OBJ_LEN 40
+#define MULTI_OBJ_NUM 4
+
+#define NUM_PACKETS   2000
+#define BENCH_PASSES  20
+
+static std::vector<uint8_t> txStream;
+static uint32_t txCalls;
+
+static int32_t captureOutput(uint8_t *data, int32_t length)
+{
+    txStream.insert(txStream.end(), data, data + length);
+    txCalls++;
+    return length;
+}
+
+static std::vector<uint8_t> replyStream;
+
+static int32_t captureReply(uint8_t *data, int32_t length)
+{
+    replyStream.insert(replyStream.end(), data, data + length);
+    return length;
+}
+
+static int32_t discardOutput(__attribute__((unused)) uint8_t *data, int32_t length)
+{
+    return length;
+}
+
+/* Every unpacked object, with a checksum of the data it was unpacked with */
+struct UnpackRecord {
+    uint32_t objId;
+    uint16_t instId;
+    uint8_t  crc;
+    bool operator==(const UnpackRecord &other) const
+    {
+        return objId == other.objId && instId == other.instId && crc == other.crc;
+    }
+};
+static std::vector<UnpackRecord> unpacked;
+
+static void unpackedCallback(UAVObjEvent *ev)
+{
+    uint8_t data[LARGE_OBJ_LEN];
+    UnpackRecord record;
+
+    UAVObjGetInstanceData(ev->obj, ev->instId, data);
+    record.objId  = UAVObjGetID(ev->obj);
+    record.instId = ev->instId;
+    record.crc    = PIOS_CRC_updateCRC(0, data, UAVObjGetNumBytes(ev->obj));
+    unpacked.push_back(record);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// To use a test fixture, derive a class from testing::Test.
+class UAVTalkRxTest : public testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        ASSERT_EQ(0, UAVObjInitialize());
+
+        ut_handles[0] = UAVObjRegister(SMALL_OBJ_ID, true, false, false, SMALL_OBJ_LEN, NULL);
+        ut_handles[1] = UAVObjRegister(LARGE_OBJ_ID, true, false, false, LARGE_OBJ_LEN, NULL);
+        ut_handles[2] = UAVObjRegister(MULTI_OBJ_ID, false, false, false, MULTI_OBJ_LEN, NULL);
+        for (int i = 0; i < UT_NUM_OBJECTS; i++) {
+            ASSERT_TRUE(ut_handles[i] != NULL);
+            ASSERT_EQ(0, UAVObjConnectCallback(ut_handles[i], unpackedCallback, EV_UNPACKED));
+        }
+        for (uint16_t i = 1; i < MULTI_OBJ_NUM; i++) {
+            ASSERT_EQ(i, UAVObjCreateInstance(ut_handles[2], NULL));
+        }
+
+        tx = UAVTalkInitialize(captureOutput);
+        ASSERT_TRUE(tx != NULL);
+        txStream.clear();
+        unpacked.clear();
+    }
+
+    virtual void TearDown()
+    {}
+
+    /* Append one object packet, optionally timestamped and with a corrupted byte */
+    void sendPacket(bool timestamped, bool corrupt)
+    {
+        uint8_t data[LARGE_OBJ_LEN];
+        int which = rand() % UT_NUM_OBJECTS;
+        uint16_t instId = (which == 2) ? rand() % MULTI_OBJ_NUM : 0;
+
+        for (uint32_t i = 0; i < sizeof(data); i++) {
+            data[i] = rand();
+        }
+        UAVObjSetInstanceData(ut_handles[which], instId, data);
+
+        size_t start = txStream.size();
+        if (timestamped) {
+            ASSERT_EQ(0, UAVTalkSendObjectTimestamped(tx, ut_handles[which], instId, 0, 0));
+        } else {
+            ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[which], instId, 0, 0));
+        }
+        if (corrupt) {
+            size_t pos = start + 1 + rand() % (txStream.size() - start - 1);
+            txStream[pos] ^= 1 << (rand() % 8);
+        }
+    }
+
+    /* Valid packets mixed with line noise and corrupted packets */
+    void buildStream(int numPackets, bool noisy)
+    {
+        srand(42);
+        for (int i = 0; i < numPackets; i++) {
+            if (noisy && rand() % 8 == 0) {
+                int noise = rand() % 20;
+                for (int n = 0; n < noise; n++) {
+                    txStream.push_back((rand() % 4 == 0) ? 0x3C : rand());
+                }
+            }
+            sendPacket(rand() % 2, noisy && rand() % 10 == 0);
+        }
+    }
+
+    /* Feed the stream to a fresh connection, chunk == 0 feeds one byte at a time */
+    std::vector<UnpackRecord> receive(const std::vector<uint8_t> &stream, size_t chunk, UAVTalkStats *stats, bool randomChunks = false)
+    {
+        UAVTalkConnection rx = UAVTalkInitialize(discardOutput);
+
+        unpacked.clear();
+        if (chunk == 0) {
+            for (size_t i = 0; i < stream.size(); i++) {
+                UAVTalkProcessInputStream(rx, stream[i]);
+            }
+        } else {
+            size_t pos = 0;
+            while (pos < stream.size()) {
+                size_t len = randomChunks ? 1 + rand() % chunk : chunk;
+                if (len > stream.size() - pos) {
+                    len = stream.size() - pos;
+                }
+                UAVTalkProcessInputStreamBuffer(rx, &stream[pos], len);
+                pos += len;
+            }
+        }
+        UAVTalkGetStats(rx, stats, false);
+        return unpacked;
+    }
+
+    UAVTalkConnection tx;
+};
+
+static void expectSameRxStats(const UAVTalkStats &a, const UAVTalkStats &b)
+{
+    EXPECT_EQ(a.rxBytes, b.rxBytes);
+    EXPECT_EQ(a.rxObjectBytes, b.rxObjectBytes);
+    EXPECT_EQ(a.rxObjects, b.rxObjects);
+    EXPECT_EQ(a.rxErrors, b.rxErrors);
+    EXPECT_EQ(a.rxSyncErrors, b.rxSyncErrors);
+    EXPECT_EQ(a.rxCrcErrors, b.rxCrcErrors);
+}
+
+TEST_F(UAVTalkRxTest, CleanStream) {
+    UAVTalkStats byteStats, bufStats;
+
+    buildStream(NUM_PACKETS, false);
+
+    std::vector<UnpackRecord> byByte = receive(txStream, 0, &byteStats);
+    std::vector<UnpackRecord> byBuf  = receive(txStream, 4096, &bufStats);
+
+    EXPECT_EQ((uint32_t)NUM_PACKETS, byteStats.rxObjects);
+    EXPECT_EQ(0u, byteStats.rxErrors);
+    EXPECT_EQ(0u, byteStats.rxSyncErrors);
+    EXPECT_EQ(txStream.size(), byteStats.rxBytes);
+    expectSameRxStats(byteStats, bufStats);
+    EXPECT_TRUE(byByte == byBuf);
+}
+
+TEST_F(UAVTalkRxTest, NoisyStreamMatchesBytewise) {
+    UAVTalkStats byteStats, bufStats, chunkStats;
+
+    buildStream(NUM_PACKETS, true);
+
+    std::vector<UnpackRecord> byByte = receive(txStream, 0, &byteStats);
+    std::vector<UnpackRecord> byBuf  = receive(txStream, 4096, &bufStats);
+    std::vector<UnpackRecord> byChunk = receive(txStream, 64, &chunkStats, true);
+
+    EXPECT_GT(byteStats.rxCrcErrors, 0u);
+    EXPECT_GT(byteStats.rxSyncErrors, 0u);
+    EXPECT_LT(byteStats.rxObjects, (uint32_t)NUM_PACKETS);
+    expectSameRxStats(byteStats, bufStats);
+    expectSameRxStats(byteStats, chunkStats);
+    EXPECT_TRUE(byByte == byBuf);
+    EXPECT_TRUE(byByte == byChunk);
+}
+
+TEST_F(UAVTalkRxTest, Benchmark) {
+    UAVTalkStats stats;
+    const size_t chunks[] = { 0, 1, 32, 512 };
+
+    buildStream(NUM_PACKETS, false);
+
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        double start = now_s();
+        for (int pass = 0; pass < BENCH_PASSES; pass++) {
+            receive(txStream, chunks[c], &stats);
+        }
+        double elapsed = now_s() - start;
+        EXPECT_EQ((uint32_t)NUM_PACKETS, stats.rxObjects);
+        if (chunks[c]) {
+            printf("%4zu byte blocks:   %7.1f MB/s\n", chunks[c], txStream.size() * BENCH_PASSES / elapsed / 1e6);
+        } else {
+            printf("byte at a time:    %7.1f MB/s\n", txStream.size() * BENCH_PASSES / elapsed / 1e6);
+        }
+    }
+}
+
+/* Packets go from tx to rx, which has its own view of the object data */
+class UAVTalkDeltaTest : public UAVTalkRxTest {
+protected:
+    virtual void SetUp()
+    {
+        UAVTalkRxTest::SetUp();
+        rx = UAVTalkInitialize(captureReply);
+        ASSERT_TRUE(rx != NULL);
+        replyStream.clear();
+    }
+
+    /* rx offers to receive deltas, tx answers */
+    void negotiate()
+    {
+        ASSERT_EQ(0, UAVTalkSendCapabilities(rx));
+        UAVTalkProcessInputStreamBuffer(tx, &replyStream[0], replyStream.size());
+        ASSERT_FALSE(txStream.empty());
+        UAVTalkProcessInputStreamBuffer(rx, &txStream[0], txStream.size());
+        txStream.clear();
+        replyStream.clear();
+    }
+
+    /* Change a few fields of an instance, send it and let rx apply the packet to its own view */
+    void update(int which, uint16_t instId, int fieldSize, bool lost)
+    {
+        std::vector<uint8_t> &truth  = sent[which][instId];
+        std::vector<uint8_t> &mirror = received[which][instId];
+        uint32_t length = UAVObjGetNumBytes(ut_handles[which]);
+
+        truth.resize(length);
+        mirror.resize(length);
+        for (int changes = 1 + rand() % 3; changes > 0; changes--) {
+            int offset = (rand() % (length / fieldSize)) * fieldSize;
+            for (int n = 0; n < fieldSize; n++) {
+                truth[offset + n] = rand();
+            }
+        }
+
+        UAVObjSetInstanceData(ut_handles[which], instId, &truth[0]);
+        txStream.clear();
+        ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[which], instId, 0, 0));
+        lastType = txStream[1];
+
+        UAVObjSetInstanceData(ut_handles[which], instId, &mirror[0]);
+        if (!lost) {
+            UAVTalkProcessInputStreamBuffer(rx, &txStream[0], txStream.size());
+        }
+        UAVObjGetInstanceData(ut_handles[which], instId, &mirror[0]);
+    }
+
+    UAVTalkConnection rx;
+    std::vector<uint8_t> sent[UT_NUM_OBJECTS][MULTI_OBJ_NUM];
+    std::vector<uint8_t> received[UT_NUM_OBJECTS][MULTI_OBJ_NUM];
+    uint8_t lastType;
+};
+
+TEST_F(UAVTalkDeltaTest, NotSentUnlessNegotiated) {
+    UAVTalkStats stats;
+
+    for (int i = 0; i < 100; i++) {
+        update(1, 0, 10, false);
+        EXPECT_EQ(0x20, lastType);
+    }
+    UAVTalkGetStats(tx, &stats, false);
+    EXPECT_EQ(0u, stats.txDeltas);
+
+    // Not after the link was lost either
+    negotiate();
+    UAVTalkResetCapabilities(tx);
+    for (int i = 0; i < 100; i++) {
+        update(1, 0, 10, false);
+        EXPECT_EQ(0x20, lastType);
+    }
+}
+
+TEST_F(UAVTalkDeltaTest, ReceiverMatchesSender) {
+    UAVTalkStats txStats, rxStats;
+
+    negotiate();
+    srand(42);
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        int which = rand() % UT_NUM_OBJECTS;
+        uint16_t instId = (which == 2) ? rand() % MULTI_OBJ_NUM : 0;
+        update(which, instId, (which == 1) ? 10 : 4, false);
+        ASSERT_TRUE(sent[which][instId] == received[which][instId]) << "packet " << i;
+    }
+
+    UAVTalkGetStats(tx, &txStats, false);
+    UAVTalkGetStats(rx, &rxStats, false);
+    EXPECT_GT(txStats.txDeltas, (uint32_t)NUM_PACKETS / 2);
+    EXPECT_EQ(0u, rxStats.rxErrors);
+    EXPECT_EQ(txStats.txObjects, rxStats.rxObjects);
+}
+
+TEST_F(UAVTalkDeltaTest, LostPacketsRecoverAtKeyframe) {
+    negotiate();
+    srand(7);
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        update(1, 0, 10, rand() % 5 == 0);
+    }
+    EXPECT_FALSE(sent[1][0] == received[1][0]);
+
+    // Deltas of a lost update never carry the fields it changed, the next keyframe does
+    bool keyframe = false;
+    for (int i = 0; i < 20 && !keyframe; i++) {
+        update(1, 0, 10, false);
+        keyframe = (lastType == 0x20);
+    }
+    EXPECT_TRUE(keyframe);
+    EXPECT_TRUE(sent[1][0] == received[1][0]);
+}
+
+// The GCS decodes these bytes, see deltavectors.h
+TEST_F(UAVTalkDeltaTest, MatchesVectors) {
+    uint8_t data[DELTA_VECTORS_LENGTH];
+
+    ASSERT_EQ((uint32_t)DELTA_VECTORS_OBJID, UAVObjGetID(ut_handles[1]));
+    ASSERT_EQ((uint32_t)DELTA_VECTORS_LENGTH, UAVObjGetNumBytes(ut_handles[1]));
+
+    negotiate();
+    memset(data, 0, sizeof(data));
+    for (int i = 0; i < DELTA_VECTORS_UPDATES; i++) {
+        deltavectors_update(data, i);
+        UAVObjSetInstanceData(ut_handles[1], 0, data);
+        ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[1], 0, 0, 0));
+    }
+
+    std::vector<uint8_t> expected(deltavectors_stream, deltavectors_stream + sizeof(deltavectors_stream));
+    EXPECT_TRUE(txStream == expected);
+}
+
+TEST_F(UAVTalkDeltaTest, Benchmark) {
+    UAVTalkStats stats;
+    uint32_t fullBytes;
+
+    srand(42);
+    double start = now_s();
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        update(1, 0, 10, false);
+    }
+    double fullTime = now_s() - start;
+    UAVTalkGetStats(tx, &stats, true);
+    fullBytes = stats.txBytes;
+
+    negotiate();
+    UAVTalkResetStats(tx);
+    start = now_s();
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        update(1, 0, 10, false);
+    }
+    double deltaTime = now_s() - start;
+    UAVTalkGetStats(tx, &stats, false);
+
+    EXPECT_LT(stats.txBytes, fullBytes / 2);
+    printf("%d updates of 1-3 fields of a %d byte object\n", NUM_PACKETS, LARGE_OBJ_LEN);
+    printf("full:  %6u bytes, %5.2f us per update\n", fullBytes, fullTime / NUM_PACKETS * 1e6);
+    printf("delta: %6u bytes, %5.2f us per update, %u of %u sent as deltas\n",
+           stats.txBytes, deltaTime / NUM_PACKETS * 1e6, stats.txDeltas, stats.txObjects);
+}
+
+#define BUNDLE_LENGTH 62
+
+/* Several updates at a time, bundled when both ends agree */
+class UAVTalkBundleTest : public UAVTalkDeltaTest {
+protected:
+    /* Send distinct instances of the small and multi instance objects, then let rx receive all of it */
+    void burst(int count, std::vector<UnpackRecord> *expected)
+    {
+        int order[1 + MULTI_OBJ_NUM];
+
+        for (int i = 0; i < 1 + MULTI_OBJ_NUM; i++) {
+            order[i] = i;
+        }
+        std::random_shuffle(order, order + 1 + MULTI_OBJ_NUM);
+
+        txStream.clear();
+        UAVTalkBeginBundle(tx, BUNDLE_LENGTH);
+        for (int i = 0; i < count; i++) {
+            int which = (order[i] == 0) ? 0 : 2;
+            uint16_t instId = (which == 2) ? order[i] - 1 : 0;
+            uint8_t data[MULTI_OBJ_LEN];
+            uint32_t length = UAVObjGetNumBytes(ut_handles[which]);
+
+            UAVObjGetInstanceData(ut_handles[which], instId, data);
+            data[(rand() % (length / 4)) * 4] = rand();
+            UAVObjSetInstanceData(ut_handles[which], instId, data);
+            ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[which], instId, 0, 0));
+
+            UnpackRecord record = { UAVObjGetID(ut_handles[which]), instId, PIOS_CRC_updateCRC(0, data, length) };
+            expected->push_back(record);
+        }
+        ASSERT_EQ(0, UAVTalkEndBundle(tx));
+        UAVTalkProcessInputStreamBuffer(rx, &txStream[0], txStream.size());
+    }
+
+    /* The type of each frame in txStream */
+    std::vector<uint8_t> frameTypes()
+    {
+        std::vector<uint8_t> types;
+
+        for (size_t pos = 0; pos + 4 <= txStream.size(); pos += txStream[pos + 2] + (txStream[pos + 3] << 8) + 1) {
+            types.push_back(txStream[pos + 1]);
+            EXPECT_LE(txStream[pos + 2] + (txStream[pos + 3] << 8) + 1, BUNDLE_LENGTH);
+        }
+        return types;
+    }
+};
+
+TEST_F(UAVTalkBundleTest, NotBundledUnlessNegotiated) {
+    std::vector<UnpackRecord> expected;
+
+    srand(42);
+    burst(1 + MULTI_OBJ_NUM, &expected);
+    std::vector<uint8_t> types = frameTypes();
+    EXPECT_EQ((size_t)1 + MULTI_OBJ_NUM, types.size());
+    for (size_t i = 0; i < types.size(); i++) {
+        EXPECT_EQ(0x20, types[i]);
+    }
+}
+
+TEST_F(UAVTalkBundleTest, ReceiverMatchesSender) {
+    std::vector<UnpackRecord> expected;
+    UAVTalkStats txStats, rxStats;
+    size_t frames = 0;
+
+    negotiate();
+    UAVTalkResetStats(tx);
+    UAVTalkResetStats(rx);
+    unpacked.clear();
+    srand(42);
+    for (int i = 0; i < NUM_PACKETS / MULTI_OBJ_NUM; i++) {
+        burst(1 + rand() % (1 + MULTI_OBJ_NUM), &expected);
+        frames += frameTypes().size();
+    }
+
+    ASSERT_EQ(expected.size(), unpacked.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_TRUE(expected[i] == unpacked[i]) << "object " << i;
+    }
+    UAVTalkGetStats(tx, &txStats, false);
+    UAVTalkGetStats(rx, &rxStats, false);
+    EXPECT_EQ(0u, rxStats.rxErrors);
+    EXPECT_EQ(txStats.txObjects, rxStats.rxObjects);
+    EXPECT_EQ(txStats.txBytes, rxStats.rxBytes);
+    EXPECT_LT(frames, expected.size() * 2 / 3);
+}
+
+TEST_F(UAVTalkBundleTest, OtherPacketsKeepTheirOrder) {
+    negotiate();
+    txStream.clear();
+    UAVTalkBeginBundle(tx, BUNDLE_LENGTH);
+    ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[0], 0, 0, 0));
+    ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[0], 0, 0, 0));
+    // No answer comes, the request is sent anyway
+    UAVTalkSendObjectRequest(tx, ut_handles[1], 0, 0);
+    ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[0], 0, 0, 0));
+    ASSERT_EQ(0, UAVTalkEndBundle(tx));
+
+    // A bundle of two, then the request, and a lone object as the packet it was
+    std::vector<uint8_t> types = frameTypes();
+    ASSERT_EQ(3u, types.size());
+    EXPECT_EQ(0x27, types[0]);
+    EXPECT_EQ(0x21, types[1]);
+    EXPECT_EQ(0x20, types[2]);
+
+    unpacked.clear();
+    UAVTalkProcessInputStreamBuffer(rx, &txStream[0], txStream.size());
+    EXPECT_EQ(3u, unpacked.size());
+}
+
+// Both ends offer their capabilities once the link is up, as the flight and GCS telemetry do
+TEST_F(UAVTalkBundleTest, BothEndsNegotiate) {
+    UAVTalkConnection ends[2] = { tx, rx };
+    std::vector<uint8_t> *streams[2] = { &txStream, &replyStream };
+    int rounds;
+
+    ASSERT_EQ(0, UAVTalkSendCapabilities(tx));
+    ASSERT_EQ(0, UAVTalkSendCapabilities(rx));
+    // Each offer is answered once, the answers are not
+    for (rounds = 0; rounds < 4 && !(txStream.empty() && replyStream.empty()); rounds++) {
+        std::vector<uint8_t> toRx, toTx;
+        toRx.swap(txStream);
+        toTx.swap(replyStream);
+        if (!toRx.empty()) {
+            UAVTalkProcessInputStreamBuffer(rx, &toRx[0], toRx.size());
+        }
+        if (!toTx.empty()) {
+            UAVTalkProcessInputStreamBuffer(tx, &toTx[0], toTx.size());
+        }
+    }
+    EXPECT_EQ(2, rounds);
+
+    // Either end now sends deltas and bundles to the other
+    for (int from = 0; from < 2; from++) {
+        UAVTalkConnection to = ends[1 - from];
+        std::vector<uint8_t> &stream = *streams[from];
+        uint8_t data[LARGE_OBJ_LEN];
+
+        memset(data, from, sizeof(data));
+        UAVObjSetInstanceData(ut_handles[1], 0, data);
+        stream.clear();
+        ASSERT_EQ(0, UAVTalkSendObject(ends[from], ut_handles[1], 0, 0, 0));
+        EXPECT_EQ(0x20, stream[1]) << "from " << from;
+        data[0]++;
+        UAVObjSetInstanceData(ut_handles[1], 0, data);
+        stream.clear();
+        ASSERT_EQ(0, UAVTalkSendObject(ends[from], ut_handles[1], 0, 0, 0));
+        EXPECT_EQ(0x25, stream[1]) << "from " << from;
+        UAVTalkProcessInputStreamBuffer(to, &stream[0], stream.size());
+
+        stream.clear();
+        unpacked.clear();
+        UAVTalkBeginBundle(ends[from], BUNDLE_LENGTH);
+        ASSERT_EQ(0, UAVTalkSendObject(ends[from], ut_handles[0], 0, 0, 0));
+        ASSERT_EQ(0, UAVTalkSendObject(ends[from], ut_handles[0], 0, 0, 0));
+        ASSERT_EQ(0, UAVTalkEndBundle(ends[from]));
+        EXPECT_EQ(0x27, stream[1]) << "from " << from;
+        EXPECT_EQ(stream[2] + (stream[3] << 8) + 1u, stream.size()) << "from " << from;
+        UAVTalkProcessInputStreamBuffer(to, &stream[0], stream.size());
+        EXPECT_EQ(2u, unpacked.size()) << "from " << from;
+    }
+}
+
+// The GCS decodes these bytes, see bundlevectors.h
+TEST_F(UAVTalkBundleTest, MatchesVectors) {
+    uint8_t data[UT_NUM_OBJECTS][MULTI_OBJ_NUM][MULTI_OBJ_LEN];
+
+    ASSERT_EQ((uint32_t)BUNDLE_VECTORS_SMALL_OBJID, UAVObjGetID(ut_handles[0]));
+    ASSERT_EQ((uint32_t)BUNDLE_VECTORS_MULTI_OBJID, UAVObjGetID(ut_handles[2]));
+    ASSERT_EQ(BUNDLE_VECTORS_INSTANCES, MULTI_OBJ_NUM);
+    ASSERT_EQ(BUNDLE_VECTORS_FRAME_LENGTH, BUNDLE_LENGTH);
+
+    negotiate();
+    memset(data, 0, sizeof(data));
+    for (int send = 0; send < BUNDLE_VECTORS_SENDS; send++) {
+        uint32_t objId;
+        uint16_t instId;
+        bundlevectors_instance(send, &objId, &instId);
+        int which = (objId == BUNDLE_VECTORS_SMALL_OBJID) ? 0 : 2;
+        int numFields = (which == 0) ? BUNDLE_VECTORS_SMALL_FIELDS : BUNDLE_VECTORS_MULTI_FIELDS;
+
+        if (send % BUNDLE_VECTORS_BURST == 0) {
+            UAVTalkBeginBundle(tx, BUNDLE_LENGTH);
+        }
+        bundlevectors_update(data[which][instId], numFields, send);
+        UAVObjSetInstanceData(ut_handles[which], instId, data[which][instId]);
+        ASSERT_EQ(0, UAVTalkSendObject(tx, ut_handles[which], instId, 0, 0));
+        if (send % BUNDLE_VECTORS_BURST == BUNDLE_VECTORS_BURST - 1) {
+            ASSERT_EQ(0, UAVTalkEndBundle(tx));
+        }
+    }
+
+    // Bundles of plain and delta records, and lone packets
+    std::vector<uint8_t> types = frameTypes();
+    EXPECT_NE(types.end(), std::find(types.begin(), types.end(), 0x27));
+    EXPECT_NE(types.end(), std::find(types.begin(), types.end(), 0x20));
+    std::vector<uint8_t> expected(bundlevectors_stream, bundlevectors_stream + sizeof(bundlevectors_stream));
+    EXPECT_TRUE(txStream == expected);
+}
+
+TEST_F(UAVTalkBundleTest, Benchmark) {
+    std::vector<UnpackRecord> expected;
+    UAVTalkStats stats;
+    uint32_t plainBytes, plainCalls;
+
+    srand(42);
+    txCalls = 0;
+    double start = now_s();
+    for (int i = 0; i < NUM_PACKETS / MULTI_OBJ_NUM; i++) {
+        burst(1 + MULTI_OBJ_NUM, &expected);
+    }
+    double plainTime = now_s() - start;
+    UAVTalkGetStats(tx, &stats, true);
+    plainBytes = stats.txBytes;
+    plainCalls = txCalls;
+
+    negotiate();
+    UAVTalkResetStats(tx);
+    txCalls = 0;
+    start   = now_s();
+    for (int i = 0; i < NUM_PACKETS / MULTI_OBJ_NUM; i++) {
+        burst(1 + MULTI_OBJ_NUM, &expected);
+    }
+    double bundleTime = now_s() - start;
+    UAVTalkGetStats(tx, &stats, false);
+
+    EXPECT_LT(stats.txBytes, plainBytes);
+    EXPECT_LT(txCalls, plainCalls / 2);
+    printf("%d bursts of %d small objects, frames up to %d bytes\n", NUM_PACKETS / MULTI_OBJ_NUM, 1 + MULTI_OBJ_NUM, BUNDLE_LENGTH);
+    printf("plain:   %6u bytes, %5u writes, %5.2f us per burst\n", plainBytes, plainCalls, plainTime / (NUM_PACKETS / MULTI_OBJ_NUM) * 1e6);
+    printf("bundled: %6u bytes, %5u writes, %5.2f us per burst\n", stats.txBytes, txCalls, bundleTime / (NUM_PACKETS / MULTI_OBJ_NUM) * 1e6);
+}
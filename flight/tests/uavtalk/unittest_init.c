@@ -0,0 +1,48 @@
+/*
+ * These need to be defined in a .c file so that the handles end up in the
+ * same linker section as the generated UAVObject code would put them.
+ */
+
+#include "openpilot.h"
+#include "unittest_priv.h"
+
+UAVObjHandle ut_handles[UT_NUM_OBJECTS] __attribute__((section("_uavo_handles")));
+
+/* Callbacks are invoked straight away instead of from the event dispatcher task */
+int32_t EventCallbackDispatch(UAVObjEvent *ev, UAVObjEventCallback cb)
+{
+    cb(ev);
+    return pdTRUE;
+}
+
+int32_t EventCallbackDispatchCoalesced(UAVObjEvent *ev, UAVObjEventCallback cb)
+{
+    cb(ev);
+    return pdTRUE;
+}
+
+void PIOS_DEBUGLOG_UAVObject(__attribute__((unused)) uint32_t objid, __attribute__((unused)) uint16_t instid,
+                             __attribute__((unused)) size_t size, __attribute__((unused)) uint8_t *data)
+{}
+
+/* Object ID hash of the test objects, as uavobjectsinit.c would have it */
+const uint8_t uavo_id_hash_bits = 2;
+const uint8_t uavo_id_hash_bucket_bits = 1;
+
+const uint8_t uavo_id_hash_disp[2] = {
+    0, 0,
+};
+
+const uint8_t uavo_id_hash_index[4] = {
+    1, 2, 3, 0,
+};
+
+UAVObjHandle *const uavo_id_hash_handles[UT_NUM_OBJECTS] = {
+    &ut_handles[0], &ut_handles[1], &ut_handles[2],
+};
+
+const uint16_t *const uavo_id_hash_fields[UT_NUM_OBJECTS] = {
+    (const uint16_t[]) { 3, 0, 4, 8, 12 },
+    (const uint16_t[]) { 20, 0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150, 160, 170, 180, 190, 200 },
+    (const uint16_t[]) { 10, 0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40 },
+};
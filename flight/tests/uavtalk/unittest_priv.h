@@ -0,0 +1,8 @@
+#ifndef UNITTEST_PRIV_H
+#define UNITTEST_PRIV_H
+
+#define UT_NUM_OBJECTS 3
+
+extern UAVObjHandle ut_handles[UT_NUM_OBJECTS];
+
+#endif /* UNITTEST_PRIV_H */
@@ -44,6 +44,14 @@
 #define CALLBACK_PRIORITY    CALLBACK_PRIORITY_CRITICAL
 #define TASK_PRIORITY        CALLBACK_TASK_FLIGHTCONTROL
 #define MAX_UPDATE_PERIOD_MS 1000
+#define INITIAL_HEAP_SIZE    16
+
+// Callbacks are only dispatched from task context, the active exception number tells
+#if defined(__CORTEX_M)
+#define IN_ISR()             (__get_IPSR() != 0)
+#else
+#define IN_ISR()             false
+#endif
 
 // Private types
 
@@ -65,23 +73,39 @@ struct PeriodicObjectListStruct {
     EventCallbackInfo evInfo; /** Event callback information */
     uint16_t updatePeriodMs; /** Update period in ms or 0 if no periodic updates are needed */
     int32_t  timeToNextUpdateMs; /** Time delay to the next update */
+    int16_t  heapIndex; /** Position in the schedule heap or -1 if not scheduled */
     struct PeriodicObjectListStruct *next; /** Needed by linked list library (utlist.h) */
 };
 typedef struct PeriodicObjectListStruct PeriodicObjectList;
 
 // Private variables
 static PeriodicObjectList *mObjList;
-static xQueueHandle mQueue;
+// Binary min-heap of the scheduled entries, ordered by timeToNextUpdateMs
+static PeriodicObjectList **mHeap;
+static uint16_t mHeapSize;
+static uint16_t mHeapCount;
+// Callback events waiting for the event task, a ring in arrival order. The first
+// mInflight are being invoked by the task and no longer absorb new events.
+static EventCallbackInfo mPending[MAX_QUEUE_SIZE];
+static uint16_t mPendingHead;
+static uint16_t mPendingCount;
+static uint16_t mInflight;
+static xSemaphoreHandle mPendingMutex;
 static DelayedCallbackInfo *eventSchedulerCallback;
 static xSemaphoreHandle mMutex;
 static EventStats mStats;
 
 // Private functions
 static int32_t processPeriodicUpdates();
+static int32_t callbackDispatch(UAVObjEvent *ev, UAVObjEventCallback cb, bool coalesce);
 static void eventTask();
 static int32_t eventPeriodicCreate(UAVObjEvent *ev, UAVObjEventCallback cb, xQueueHandle queue, uint16_t periodMs);
 static int32_t eventPeriodicUpdate(UAVObjEvent *ev, UAVObjEventCallback cb, xQueueHandle queue, uint16_t periodMs);
 static uint16_t randomizePeriod(uint16_t periodMs);
+static int32_t heapInsert(PeriodicObjectList *objEntry);
+static void heapRemove(PeriodicObjectList *objEntry);
+static void heapSiftUp(uint16_t index);
+static void heapSiftDown(uint16_t index);
 
 
 /**
@@ -91,7 +115,13 @@ static uint16_t randomizePeriod(uint16_t periodMs);
 int32_t EventDispatcherInitialize()
 {
     // Initialize variables
-    mObjList = NULL;
+    mObjList   = NULL;
+    mHeap      = NULL;
+    mHeapSize  = 0;
+    mHeapCount = 0;
+    mPendingHead  = 0;
+    mPendingCount = 0;
+    mInflight     = 0;
     memset(&mStats, 0, sizeof(EventStats));
 
     // Create mMutex
@@ -100,8 +130,12 @@ int32_t EventDispatcherInitialize()
         return -1;
     }
 
-    // Create event queue
-    mQueue = xQueueCreate(MAX_QUEUE_SIZE, sizeof(EventCallbackInfo));
+    // Never held while taking another lock, so any task can dispatch callbacks
+    // while holding its own locks. It can block, so not from interrupts.
+    mPendingMutex = xSemaphoreCreateRecursiveMutex();
+    if (mPendingMutex == NULL) {
+        return -1;
+    }
 
     // Create callback
     eventSchedulerCallback = PIOS_CALLBACKSCHEDULER_Create(&eventTask, CALLBACK_PRIORITY, TASK_PRIORITY, CALLBACKINFO_RUNNING_EVENTDISPATCHER, STACK_SIZE * 4);
@@ -118,7 +152,9 @@ int32_t EventDispatcherInitialize()
 void EventGetStats(EventStats *statsOut)
 {
     xSemaphoreTakeRecursive(mMutex, portMAX_DELAY);
+    xSemaphoreTakeRecursive(mPendingMutex, portMAX_DELAY);
     memcpy(statsOut, &mStats, sizeof(EventStats));
+    xSemaphoreGiveRecursive(mPendingMutex);
     xSemaphoreGiveRecursive(mMutex);
 }
 
@@ -128,27 +164,78 @@ void EventGetStats(EventStats *statsOut)
 void EventClearStats()
 {
     xSemaphoreTakeRecursive(mMutex, portMAX_DELAY);
+    xSemaphoreTakeRecursive(mPendingMutex, portMAX_DELAY);
     memset(&mStats, 0, sizeof(EventStats));
+    xSemaphoreGiveRecursive(mPendingMutex);
     xSemaphoreGiveRecursive(mMutex);
 }
 
 /**
  * Dispatch an event by invoking the supplied callback. The function
  * returns imidiatelly, the callback is invoked from the event task.
+ * Takes a mutex, so it must only be called from task context: not from
+ * interrupt handlers nor while the scheduler is suspended. Interrupts have
+ * to defer the event to a task first.
  * \param[in] ev The event to be dispatched
  * \param[in] cb The callback function
  * \return Success (0), failure (-1)
  */
 int32_t EventCallbackDispatch(UAVObjEvent *ev, UAVObjEventCallback cb)
 {
-    EventCallbackInfo evInfo;
-
-    // Initialize event callback information
-    memcpy(&evInfo.ev, ev, sizeof(UAVObjEvent));
-    evInfo.cb    = cb;
-    evInfo.queue = 0;
-    // Push to queue
-    int32_t result = xQueueSend(mQueue, &evInfo, 0); // will not block if queue is full
+    return callbackDispatch(ev, cb, false);
+}
+
+/**
+ * Dispatch an event by invoking the supplied callback, unless the same event
+ * for the same object instance is still waiting for that callback.
+ * Same calling contexts as EventCallbackDispatch().
+ * \param[in] ev The event to be dispatched
+ * \param[in] cb The callback function
+ * \return Success (0), failure (-1)
+ */
+int32_t EventCallbackDispatchCoalesced(UAVObjEvent *ev, UAVObjEventCallback cb)
+{
+    return callbackDispatch(ev, cb, true);
+}
+
+static int32_t callbackDispatch(UAVObjEvent *ev, UAVObjEventCallback cb, bool coalesce)
+{
+    int32_t result = pdTRUE;
+    uint16_t n;
+
+    PIOS_Assert(!IN_ISR());
+
+    xSemaphoreTakeRecursive(mPendingMutex, portMAX_DELAY);
+
+    if (coalesce) {
+        // Only the events the task has not started on yet can absorb this one
+        for (n = mInflight; n < mPendingCount; n++) {
+            EventCallbackInfo *evInfo = &mPending[(mPendingHead + n) % MAX_QUEUE_SIZE];
+            if (evInfo->cb == cb &&
+                evInfo->ev.obj == ev->obj &&
+                evInfo->ev.instId == ev->instId &&
+                evInfo->ev.event == ev->event) {
+                ++mStats.callbacksCoalesced;
+                xSemaphoreGiveRecursive(mPendingMutex);
+                return pdTRUE;
+            }
+        }
+    }
+
+    if (mPendingCount < MAX_QUEUE_SIZE) {
+        // Initialize event callback information
+        EventCallbackInfo *evInfo = &mPending[(mPendingHead + mPendingCount) % MAX_QUEUE_SIZE];
+        memcpy(&evInfo->ev, ev, sizeof(UAVObjEvent));
+        evInfo->cb    = cb;
+        evInfo->queue = 0;
+        ++mPendingCount;
+    } else {
+        // will not block if all slots are taken
+        ++mStats.callbacksDropped;
+        result = pdFALSE;
+    }
+
+    xSemaphoreGiveRecursive(mPendingMutex);
     PIOS_CALLBACKSCHEDULER_Dispatch(eventSchedulerCallback);
     return result;
 }
@@ -230,6 +317,7 @@ static int32_t eventPeriodicCreate(UAVObjEvent *ev, UAVObjEventCallback cb, xQue
     // Create handle
     objEntry = (PeriodicObjectList *)pios_malloc(sizeof(PeriodicObjectList));
     if (objEntry == NULL) {
+        xSemaphoreGiveRecursive(mMutex);
         return -1;
     }
     objEntry->evInfo.ev.obj      = ev->obj;
@@ -239,6 +327,13 @@ static int32_t eventPeriodicCreate(UAVObjEvent *ev, UAVObjEventCallback cb, xQue
     objEntry->evInfo.queue       = queue;
     objEntry->updatePeriodMs     = periodMs;
     objEntry->timeToNextUpdateMs = randomizePeriod(periodMs); // avoid bunching of updates
+    objEntry->heapIndex = -1;
+    // Schedule it
+    if (periodMs > 0 && heapInsert(objEntry) != 0) {
+        pios_free(objEntry);
+        xSemaphoreGiveRecursive(mMutex);
+        return -1;
+    }
     // Add to list
     LL_APPEND(mObjList, objEntry);
     // Release lock
@@ -270,9 +365,15 @@ static int32_t eventPeriodicUpdate(UAVObjEvent *ev, UAVObjEventCallback cb, xQue
             // Object found, update period
             objEntry->updatePeriodMs     = periodMs;
             objEntry->timeToNextUpdateMs = randomizePeriod(periodMs); // avoid bunching of updates
+            // Reschedule
+            heapRemove(objEntry);
+            int32_t rc = 0;
+            if (periodMs > 0) {
+                rc = heapInsert(objEntry);
+            }
             // Release lock
             xSemaphoreGiveRecursive(mMutex);
-            return 0;
+            return rc;
         }
     }
     // If this point is reached the object was not found
@@ -286,22 +387,33 @@ static int32_t eventPeriodicUpdate(UAVObjEvent *ev, UAVObjEventCallback cb, xQue
 static void eventTask()
 {
     static uint32_t timeToNextUpdateMs = 0;
-    EventCallbackInfo evInfo;
-
-    // Wait for queue message
-    int limit = MAX_QUEUE_SIZE;
+    uint16_t batch;
+    uint16_t n;
+
+    // Take all the events pending now as one batch, they stay in place while the
+    // callbacks run, events dispatched meanwhile (even by the callbacks) wait for the next run
+    xSemaphoreTakeRecursive(mPendingMutex, portMAX_DELAY);
+    batch     = mPendingCount;
+    mInflight = batch;
+    if (batch > mStats.maxCallbackBatch) {
+        mStats.maxCallbackBatch = batch;
+    }
+    xSemaphoreGiveRecursive(mPendingMutex);
 
-    while (xQueueReceive(mQueue, &evInfo, 0) == pdTRUE) {
+    for (n = 0; n < batch; n++) {
+        EventCallbackInfo *evInfo = &mPending[(mPendingHead + n) % MAX_QUEUE_SIZE];
         // Invoke callback, if any
-        if (evInfo.cb != 0) {
-            evInfo.cb(&evInfo.ev); // the function is expected to copy the event information
-        }
-        // limit loop to max queue size to slightly reduce the impact of recursive events
-        if (!--limit) {
-            break;
+        if (evInfo->cb != 0) {
+            evInfo->cb(&evInfo->ev); // the function is expected to copy the event information
         }
     }
 
+    xSemaphoreTakeRecursive(mPendingMutex, portMAX_DELAY);
+    mPendingHead   = (mPendingHead + batch) % MAX_QUEUE_SIZE;
+    mPendingCount -= batch;
+    mInflight      = 0;
+    xSemaphoreGiveRecursive(mPendingMutex);
+
     // Process periodic updates
     if ((xTaskGetTickCount() * portTICK_RATE_MS) >= timeToNextUpdateMs) {
         timeToNextUpdateMs = processPeriodicUpdates();
@@ -311,7 +423,7 @@ static void eventTask()
 }
 
 /**
- * Handle periodic updates for all objects.
+ * Handle periodic updates for all due objects.
  * \return The system time until the next update (in ms) or -1 if failed
  */
 static int32_t processPeriodicUpdates()
@@ -320,48 +432,147 @@ static int32_t processPeriodicUpdates()
     int32_t timeNow;
     int32_t timeToNextUpdate;
     int32_t offset;
+    uint16_t dispatched = 0;
 
     // Get lock
     xSemaphoreTakeRecursive(mMutex, portMAX_DELAY);
 
-    // Iterate through each object and update its timer, if zero then transmit object.
-    // Also calculate smallest delay to next update.
-    timeToNextUpdate = xTaskGetTickCount() * portTICK_RATE_MS + MAX_UPDATE_PERIOD_MS;
-    LL_FOREACH(mObjList, objEntry) {
-        // If object is configured for periodic updates
-        if (objEntry->updatePeriodMs > 0) {
-            // Check if time for the next update
-            timeNow = xTaskGetTickCount() * portTICK_RATE_MS;
-            if (objEntry->timeToNextUpdateMs <= timeNow) {
-                // Reset timer
-                offset = (timeNow - objEntry->timeToNextUpdateMs) % objEntry->updatePeriodMs;
-                objEntry->timeToNextUpdateMs = timeNow + objEntry->updatePeriodMs - offset;
-                // Invoke callback, if one
-                if (objEntry->evInfo.cb != 0) {
-                    objEntry->evInfo.cb(&objEntry->evInfo.ev); // the function is expected to copy the event information
-                }
-                // Push event to queue, if one
-                if (objEntry->evInfo.queue != 0) {
-                    if (xQueueSend(objEntry->evInfo.queue, &objEntry->evInfo.ev, 0) != pdTRUE && !objEntry->evInfo.ev.lowPriority) { // do not block if queue is full
-                        if (objEntry->evInfo.ev.obj != NULL) {
-                            mStats.lastErrorID = UAVObjGetID(objEntry->evInfo.ev.obj);
-                        }
-                        ++mStats.eventErrors;
-                    }
+    timeNow = xTaskGetTickCount() * portTICK_RATE_MS;
+
+    // Only the entries at the top of the heap are due, reschedule and dispatch them in order
+    while (mHeapCount > 0 && mHeap[0]->timeToNextUpdateMs <= timeNow) {
+        objEntry = mHeap[0];
+        // Reset timer
+        offset = (timeNow - objEntry->timeToNextUpdateMs) % objEntry->updatePeriodMs;
+        objEntry->timeToNextUpdateMs = timeNow + objEntry->updatePeriodMs - offset;
+        heapSiftDown(0);
+        ++dispatched;
+        // Invoke callback, if one
+        if (objEntry->evInfo.cb != 0) {
+            objEntry->evInfo.cb(&objEntry->evInfo.ev); // the function is expected to copy the event information
+        }
+        // Push event to queue, if one
+        if (objEntry->evInfo.queue != 0) {
+            if (xQueueSend(objEntry->evInfo.queue, &objEntry->evInfo.ev, 0) != pdTRUE && !objEntry->evInfo.ev.lowPriority) { // do not block if queue is full
+                if (objEntry->evInfo.ev.obj != NULL) {
+                    mStats.lastErrorID = UAVObjGetID(objEntry->evInfo.ev.obj);
                 }
-            }
-            // Update minimum delay
-            if (objEntry->timeToNextUpdateMs < timeToNextUpdate) {
-                timeToNextUpdate = objEntry->timeToNextUpdateMs;
+                ++mStats.eventErrors;
             }
         }
     }
 
+    // Update statistics
+    ++mStats.periodicWakeups;
+    mStats.periodicDispatched += dispatched;
+    if (dispatched > mStats.maxPeriodicDispatched) {
+        mStats.maxPeriodicDispatched = dispatched;
+    }
+
+    // Calculate smallest delay to next update
+    timeToNextUpdate = timeNow + MAX_UPDATE_PERIOD_MS;
+    if (mHeapCount > 0 && mHeap[0]->timeToNextUpdateMs < timeToNextUpdate) {
+        timeToNextUpdate = mHeap[0]->timeToNextUpdateMs;
+    }
+
     // Done
     xSemaphoreGiveRecursive(mMutex);
     return timeToNextUpdate;
 }
 
+/**
+ * Add an entry to the schedule heap, growing the heap if needed.
+ * \return Success (0), failure (-1)
+ */
+static int32_t heapInsert(PeriodicObjectList *objEntry)
+{
+    if (mHeapCount == mHeapSize) {
+        uint16_t newSize = mHeapSize ? mHeapSize * 2 : INITIAL_HEAP_SIZE;
+        PeriodicObjectList **newHeap = (PeriodicObjectList **)pios_malloc(newSize * sizeof(PeriodicObjectList *));
+        if (newHeap == NULL) {
+            return -1;
+        }
+        if (mHeap) {
+            memcpy(newHeap, mHeap, mHeapCount * sizeof(PeriodicObjectList *));
+            pios_free(mHeap);
+        }
+        mHeap     = newHeap;
+        mHeapSize = newSize;
+    }
+
+    objEntry->heapIndex = mHeapCount;
+    mHeap[mHeapCount++] = objEntry;
+    heapSiftUp(objEntry->heapIndex);
+    return 0;
+}
+
+/**
+ * Remove an entry from the schedule heap, if it is scheduled.
+ */
+static void heapRemove(PeriodicObjectList *objEntry)
+{
+    int16_t index = objEntry->heapIndex;
+
+    if (index < 0) {
+        return;
+    }
+    objEntry->heapIndex = -1;
+
+    // Move the last entry into the hole and restore the heap order
+    if (index != --mHeapCount) {
+        mHeap[index] = mHeap[mHeapCount];
+        mHeap[index]->heapIndex = index;
+        heapSiftUp(index);
+        heapSiftDown(mHeap[index]->heapIndex);
+    }
+}
+
+/**
+ * Move a heap entry up until its parent is due earlier.
+ */
+static void heapSiftUp(uint16_t index)
+{
+    PeriodicObjectList *objEntry = mHeap[index];
+
+    while (index > 0) {
+        uint16_t parent = (index - 1) / 2;
+        if (mHeap[parent]->timeToNextUpdateMs <= objEntry->timeToNextUpdateMs) {
+            break;
+        }
+        mHeap[index] = mHeap[parent];
+        mHeap[index]->heapIndex = index;
+        index = parent;
+    }
+    mHeap[index] = objEntry;
+    objEntry->heapIndex = index;
+}
+
+/**
+ * Move a heap entry down until its children are due later.
+ */
+static void heapSiftDown(uint16_t index)
+{
+    PeriodicObjectList *objEntry = mHeap[index];
+
+    while (true) {
+        uint16_t child = 2 * index + 1;
+        if (child >= mHeapCount) {
+            break;
+        }
+        if (child + 1 < mHeapCount && mHeap[child + 1]->timeToNextUpdateMs < mHeap[child]->timeToNextUpdateMs) {
+            ++child;
+        }
+        if (objEntry->timeToNextUpdateMs <= mHeap[child]->timeToNextUpdateMs) {
+            break;
+        }
+        mHeap[index] = mHeap[child];
+        mHeap[index]->heapIndex = index;
+        index = child;
+    }
+    mHeap[index] = objEntry;
+    objEntry->heapIndex = index;
+}
+
 /**
  * Return a psedorandom integer from 0 to periodMs
  * Based on the Park-Miller-Carta Pseudo-Random Number Generator
@@ -33,6 +33,12 @@
 typedef struct {
     uint32_t lastErrorID;
     uint32_t eventErrors;
+    uint32_t periodicWakeups; /** Number of periodic update passes */
+    uint32_t periodicDispatched; /** Number of periodic events dispatched by these passes */
+    uint32_t maxPeriodicDispatched; /** Largest number of periodic events dispatched in a single pass */
+    uint32_t callbacksCoalesced; /** Callback events merged into one still pending */
+    uint32_t callbacksDropped; /** Callback events lost because all slots were pending */
+    uint32_t maxCallbackBatch; /** Largest number of callbacks invoked from a single drain */
 } EventStats;
 
 // Public functions
@@ -40,6 +46,7 @@ int32_t EventDispatcherInitialize();
 void EventGetStats(EventStats *statsOut);
 void EventClearStats();
 int32_t EventCallbackDispatch(UAVObjEvent *ev, UAVObjEventCallback cb);
+int32_t EventCallbackDispatchCoalesced(UAVObjEvent *ev, UAVObjEventCallback cb);
 int32_t EventPeriodicCallbackCreate(UAVObjEvent *ev, UAVObjEventCallback cb, uint16_t periodMs);
 int32_t EventPeriodicCallbackUpdate(UAVObjEvent *ev, UAVObjEventCallback cb, uint16_t periodMs);
 int32_t EventPeriodicQueueCreate(UAVObjEvent *ev, xQueueHandle queue, uint16_t periodMs);
@@ -141,6 +141,8 @@ typedef enum {
  */
 #define EV_MASK_ALL         0
 #define EV_MASK_ALL_UPDATES (EV_UNPACKED | EV_UPDATED | EV_UPDATED_MANUAL | EV_UPDATED_PERIODIC | EV_LOGGING_MANUAL | EV_LOGGING_PERIODIC)
+/* Added to an event mask: an event still pending for the queue or callback absorbs the same one for the same instance */
+#define EV_MASK_COALESCE    0x80
 
 /**
  * Access types
@@ -180,6 +182,7 @@ typedef struct {
     uint32_t eventCallbackErrors;
     uint32_t lastCallbackErrorID;
     uint32_t lastQueueErrorID;
+    uint32_t eventsCoalesced; /** Events merged into one still pending for a queue */
 } UAVObjStats;
 
 int32_t UAVObjInitialize();
@@ -194,6 +197,7 @@ UAVObjHandle UAVObjGetLinkedObj(UAVObjHandle obj);
 uint16_t UAVObjCreateInstance(UAVObjHandle obj_handle, UAVObjInitializeCallback initCb);
 bool UAVObjIsSingleInstance(UAVObjHandle obj);
 bool UAVObjIsMetaobject(UAVObjHandle obj);
+const uint16_t *UAVObjGetFieldLayout(UAVObjHandle obj);
 bool UAVObjIsSettings(UAVObjHandle obj);
 bool UAVObjIsPriority(UAVObjHandle obj);
 int32_t UAVObjUnpack(UAVObjHandle obj_handle, uint16_t instId, const uint8_t *dataIn);
@@ -220,6 +224,10 @@ int32_t UAVObjSetInstanceData(UAVObjHandle obj_handle, uint16_t instId, const vo
 int32_t UAVObjSetInstanceDataField(UAVObjHandle obj_handle, uint16_t instId, const void *dataIn, uint32_t offset, uint32_t size);
 int32_t UAVObjGetInstanceData(UAVObjHandle obj_handle, uint16_t instId, void *dataOut);
 int32_t UAVObjGetInstanceDataField(UAVObjHandle obj_handle, uint16_t instId, void *dataOut, uint32_t offset, uint32_t size);
+void *UAVObjBeginUpdate(UAVObjHandle obj_handle);
+void UAVObjCommitUpdate(UAVObjHandle obj_handle);
+void *UAVObjBeginInstanceUpdate(UAVObjHandle obj_handle, uint16_t instId);
+void UAVObjCommitInstanceUpdate(UAVObjHandle obj_handle, uint16_t instId);
 int32_t UAVObjSetMetadata(UAVObjHandle obj_handle, const UAVObjMetadata *dataIn);
 int32_t UAVObjGetMetadata(UAVObjHandle obj_handle, UAVObjMetadata *dataOut);
 uint8_t UAVObjGetMetadataAccess(const UAVObjMetadata *dataOut);
@@ -240,6 +248,7 @@ void UAVObjSetLoggingUpdateMode(UAVObjMetadata *dataOut, UAVObjUpdateMode val);
 int8_t UAVObjReadOnly(UAVObjHandle obj);
 int32_t UAVObjConnectQueue(UAVObjHandle obj_handle, xQueueHandle queue, uint8_t eventMask);
 int32_t UAVObjDisconnectQueue(UAVObjHandle obj_handle, xQueueHandle queue);
+bool UAVObjQueueReceive(xQueueHandle queue, UAVObjEvent *ev, portTickType timeout);
 int32_t UAVObjConnectCallback(UAVObjHandle obj_handle, UAVObjEventCallback cb, uint8_t eventMask);
 int32_t UAVObjDisconnectCallback(UAVObjHandle obj_handle, UAVObjEventCallback cb);
 void UAVObjRequestUpdate(UAVObjHandle obj);
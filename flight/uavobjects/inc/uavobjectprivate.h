@@ -61,6 +61,21 @@ extern struct UAVOData *__stop__uavo_handles[] __attribute__((weak));
         struct UAVOData *_item = *_uavo_slot; \
         if (_item == NULL) { continue; }
 
+/*
+ * Perfect hash of the data object IDs, the tables are emitted into uavobjectsinit.c
+ * by the UAVObjGenerator which uses the same constants:
+ *   bucket = (id * UAVO_ID_HASH_BUCKET_MULT) >> (32 - uavo_id_hash_bucket_bits)
+ *   slot   = ((id ^ (uavo_id_hash_disp[bucket] * UAVO_ID_HASH_DISP_MULT)) * UAVO_ID_HASH_SLOT_MULT) >> (32 - uavo_id_hash_bits)
+ * uavo_id_hash_index[slot] is 0 for an empty slot or one plus the index into
+ * uavo_id_hash_handles, which points at the handle of each object or is NULL for
+ * objects not linked into the firmware.
+ * uavo_id_hash_fields has the field layout of each object at the same index:
+ * the number of fields, the offset of each field in the packed data and the packed size.
+ */
+#define UAVO_ID_HASH_BUCKET_MULT 0x9E3779B1
+#define UAVO_ID_HASH_DISP_MULT   0x85EBCA6B
+#define UAVO_ID_HASH_SLOT_MULT   0xC2B2AE35
+
 /**
  * List of event queues and the eventmask associated with the queue.
  */
@@ -73,16 +88,22 @@ struct ObjectEventEntry {
     xQueueHandle queue;
     UAVObjEventCallback     cb;
     uint8_t eventMask;
+    /* Connected with EV_MASK_COALESCE */
+    bool    coalesce;
+    /* Events already queued and not yet received, all for pendingInstId */
+    uint8_t pendingEvents;
+    uint16_t pendingInstId;
 };
 
 /*
    MetaInstance   == [UAVOBase [UAVObjMetadata]]
    SingleInstance == [UAVOBase [UAVOData [InstanceData]]]
-   MultiInstance  == [UAVOBase [UAVOData [NumInstances [InstanceData0 [next]]]]
-                                                  ____________________/
-   \-->[InstanceData1 [next]]
-                                                  _________...________/
-   \-->[InstanceDataN [next]]
+   MultiInstance  == [UAVOBase [UAVOData [Chunks[0..N] [NumInstances [InstanceData0]]]]]
+                                               |
+                                               \-->[InstanceData1]
+                                               \-->[InstanceData2 InstanceData3]
+                                               \-->[InstanceData4 ... InstanceData7]
+                                               \-->[...]
  */
 
 /*
@@ -119,6 +140,11 @@ struct UAVOData {
      */
     struct UAVOMeta metaObj;
     uint16_t instance_size;
+    /*
+     * Sequence counter for the instance data of single instance objects.
+     * Odd while a writer is modifying the data, see UAVO_SEQ_WRITE_BEGIN/END.
+     */
+    volatile uint16_t seq;
 } __attribute__((packed, aligned(4)));
 
 /* Augmented type for Single Instance Data UAVO */
@@ -132,21 +158,19 @@ struct UAVOSingle {
      */
 } __attribute__((packed));
 
-/* Part of a linked list of instances chained off of a multi instance UAVO. */
-struct UAVOMultiInst {
-    struct UAVOMultiInst *next;
-    uint8_t instance[];
-    /*
-     * Additional space will be malloc'd here to hold the
-     * the data for this instance.
-     */
-} __attribute__((packed));
+/*
+ * Instances 1..N of a multi instance UAVO live in chunks of doubling size,
+ * chunk n holds instances 2^n to 2^(n+1)-1 and is allocated in one go when
+ * the first of them is created. Instances are never moved once created.
+ */
+#define UAVO_MULTI_NUM_CHUNKS 10
 
 /* Augmented type for Multi Instance Data UAVO */
 struct UAVOMulti {
     struct UAVOData uavo;
+    uint8_t  *chunks[UAVO_MULTI_NUM_CHUNKS];
     uint16_t num_instances;
-    struct UAVOMultiInst instance0 __attribute__((aligned(4)));
+    uint8_t  instance0[] __attribute__((aligned(4)));
     /*
      * Additional space will be malloc'd here to hold the
      * the data for instance 0.
@@ -162,11 +186,35 @@ struct UAVOMulti {
 
 /** all information about instances are dependant on object type **/
 #define ObjSingleInstanceDataOffset(obj) ((void *)(&(((struct UAVOSingle *)obj)->instance0)))
-#define InstanceDataOffset(inst)         ((void *)&(((struct UAVOMultiInst *)inst)->instance))
+/* Instances inside a chunk are kept 4 byte aligned */
+#define MultiInstanceStride(obj)         (((obj)->instance_size + 3) & ~3)
 #define InstanceData(instance)           ((void *)instance)
 
+/**
+ * Writers of single instance data (always holding the object manager mutex)
+ * bracket the update with these so that readers can copy the data without
+ * taking the mutex and detect a concurrent update by a changed counter.
+ */
+#define UAVO_SEQ_BARRIER() __sync_synchronize()
+#define UAVO_SEQ_WRITE_BEGIN(obj) \
+    do { \
+        if ((obj)->base.flags.isSingle) { \
+            (obj)->seq++; \
+            UAVO_SEQ_BARRIER(); \
+        } \
+    } while (0)
+#define UAVO_SEQ_WRITE_END(obj) \
+    do { \
+        if ((obj)->base.flags.isSingle) { \
+            UAVO_SEQ_BARRIER(); \
+            (obj)->seq++; \
+        } \
+    } while (0)
+
 // Private functions
 int32_t sendEvent(struct UAVOBase *obj, uint16_t instId, UAVObjEventType event);
 InstanceHandle getInstance(struct UAVOData *obj, uint16_t instId);
+void lockObjectManager(void);
+void unlockObjectManager(void);
 
 #endif /* UAVOBJECTPRIVATE_H_ */
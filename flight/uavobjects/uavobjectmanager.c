@@ -40,6 +40,18 @@ static InstanceHandle createInstance(struct UAVOData *obj, uint16_t instId);
 static int32_t connectObj(UAVObjHandle obj_handle, xQueueHandle queue, UAVObjEventCallback cb, uint8_t eventMask);
 static int32_t disconnectObj(UAVObjHandle obj_handle, xQueueHandle queue, UAVObjEventCallback cb);
 static void instanceAutoUpdated(UAVObjHandle obj_handle, uint16_t instId);
+static void eventReceived(const UAVObjEvent *ev, xQueueHandle queue);
+static bool readSingleInstanceLockFree(struct UAVOData *obj, void *dataOut, uint32_t offset, uint32_t size);
+static uint8_t lookupIndex(uint32_t id);
+static struct UAVOData *lookupDataObject(uint32_t id);
+
+// Object ID perfect hash tables generated into uavobjectsinit.c, absent in builds without them
+extern const uint8_t uavo_id_hash_bits __attribute__((weak));
+extern const uint8_t uavo_id_hash_bucket_bits __attribute__((weak));
+extern const uint8_t uavo_id_hash_disp[] __attribute__((weak));
+extern const uint8_t uavo_id_hash_index[] __attribute__((weak));
+extern UAVObjHandle *const uavo_id_hash_handles[] __attribute__((weak));
+extern const uint16_t *const uavo_id_hash_fields[] __attribute__((weak));
 
 
 int32_t UAVObjPers_stub(__attribute__((unused)) UAVObjHandle obj_handle, __attribute__((unused))  uint16_t instId)
@@ -51,6 +63,10 @@ int32_t UAVObjLoad(UAVObjHandle obj_handle, uint16_t instId) __attribute__((weak
 int32_t UAVObjDelete(UAVObjHandle obj_handle, uint16_t instId) __attribute__((weak, alias("UAVObjPers_stub")));
 
 
+// Private constants
+// Number of lock free read attempts on single instance objects before falling back to the mutex
+#define SEQ_READ_MAX_ATTEMPTS 3
+
 // Private variables
 static xSemaphoreHandle mutex;
 static const UAVObjMetadata defMetadata = {
@@ -187,8 +203,11 @@ static struct UAVOData *UAVObjAllocMulti(uint32_t num_bytes)
     /* Set up the type-specific part of the UAVO */
     uavo_multi->num_instances = 1;
 
+    /* Further instances are allocated on demand */
+    memset(uavo_multi->chunks, 0, sizeof(uavo_multi->chunks));
+
     /* Clear the multi instance data carried in the UAVO */
-    memset(&(uavo_multi->instance0), 0, sizeof(struct UAVOMultiInst) + num_bytes);
+    memset(&(uavo_multi->instance0), 0, num_bytes);
 
     /* Give back the generic UAVO part */
     return &(uavo_multi->uavo);
@@ -236,6 +255,7 @@ UAVObjHandle UAVObjRegister(uint32_t id,
     /* Fill in the details about this UAVO */
     uavo_data->id = id;
     uavo_data->instance_size = num_bytes;
+    uavo_data->seq = 0;
     if (isSettings) {
         uavo_data->base.flags.isSettings = true;
         // settings defaults to being sent with priority
@@ -277,6 +297,20 @@ UAVObjHandle UAVObjGetByID(uint32_t id)
 {
     UAVObjHandle *found_obj = (UAVObjHandle *)NULL;
 
+    // Constant time lookup through the generated hash, no lock needed since
+    // handles and IDs never change once registered
+    if (uavo_id_hash_index) {
+        struct UAVOData *obj = lookupDataObject(id);
+        if (obj) {
+            return (UAVObjHandle)obj;
+        }
+        obj = lookupDataObject(id - 1);
+        if (obj && MetaObjectId(obj->id) == id) {
+            return (UAVObjHandle)&(obj->metaObj);
+        }
+        return NULL;
+    }
+
     // Get lock
     xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
 
@@ -463,6 +497,29 @@ bool UAVObjIsMetaobject(UAVObjHandle obj_handle)
     return uavo_base->flags.isMeta;
 }
 
+/**
+ * Get the generated field layout of an object: the number of fields, the offset
+ * of each field in the packed data and the packed size, so field n is
+ * layout[n + 2] - layout[n + 1] bytes long.
+ * \param[in] obj The object handle
+ * \return The layout or NULL for metaobjects and builds without the generated tables
+ */
+const uint16_t *UAVObjGetFieldLayout(UAVObjHandle obj_handle)
+{
+    PIOS_Assert(obj_handle);
+
+    if (!uavo_id_hash_index || !uavo_id_hash_fields || UAVObjIsMetaobject(obj_handle)) {
+        return NULL;
+    }
+
+    uint32_t id   = UAVObjGetID(obj_handle);
+    uint8_t index = lookupIndex(id);
+    if (index == 0 || lookupDataObject(id) != (struct UAVOData *)obj_handle) {
+        return NULL;
+    }
+    return uavo_id_hash_fields[index - 1];
+}
+
 /**
  * Is this a settings object?
  * \param[in] obj The object handle
@@ -533,7 +590,9 @@ int32_t UAVObjUnpack(UAVObjHandle obj_handle, uint16_t instId, const uint8_t *da
             }
         }
         // Set the data
+        UAVO_SEQ_WRITE_BEGIN(obj);
         memcpy(InstanceData(instEntry), dataIn, obj->instance_size);
+        UAVO_SEQ_WRITE_END(obj);
     }
 
     // Fire event
@@ -556,6 +615,18 @@ int32_t UAVObjPack(UAVObjHandle obj_handle, uint16_t instId, uint8_t *dataOut)
 {
     PIOS_Assert(obj_handle);
 
+    // Single instance data objects can be read without taking the mutex
+    if (!UAVObjIsMetaobject(obj_handle) && UAVObjIsSingleInstance(obj_handle)) {
+        struct UAVOData *obj = (struct UAVOData *)obj_handle;
+
+        if (instId != 0) {
+            return -1;
+        }
+        if (readSingleInstanceLockFree(obj, dataOut, 0, obj->instance_size)) {
+            return 0;
+        }
+    }
+
     // Lock
     xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
 
@@ -920,7 +991,9 @@ int32_t UAVObjSetInstanceData(UAVObjHandle obj_handle, uint16_t instId,
             goto unlock_exit;
         }
         // Set data
+        UAVO_SEQ_WRITE_BEGIN(obj);
         memcpy(InstanceData(instEntry), dataIn, obj->instance_size);
+        UAVO_SEQ_WRITE_END(obj);
     }
 
     // Fire event
@@ -985,7 +1058,9 @@ int32_t UAVObjSetInstanceDataField(UAVObjHandle obj_handle, uint16_t instId, con
         }
 
         // Set data
+        UAVO_SEQ_WRITE_BEGIN(obj);
         memcpy(InstanceData(instEntry) + offset, dataIn, size);
+        UAVO_SEQ_WRITE_END(obj);
     }
 
 
@@ -998,6 +1073,84 @@ unlock_exit:
     return rc;
 }
 
+/**
+ * Start an in-place update of the data of an object (instance 0)
+ * \param[in] obj The object handle
+ * \return pointer to the object's data, or NULL if failure
+ */
+void *UAVObjBeginUpdate(UAVObjHandle obj_handle)
+{
+    return UAVObjBeginInstanceUpdate(obj_handle, 0);
+}
+
+/**
+ * Complete an update started with UAVObjBeginUpdate()
+ * \param[in] obj The object handle
+ */
+void UAVObjCommitUpdate(UAVObjHandle obj_handle)
+{
+    UAVObjCommitInstanceUpdate(obj_handle, 0);
+}
+
+/**
+ * Start an in-place update of the data of a specific object instance.
+ * Any number of fields are then written through the returned pointer, and
+ * UAVObjCommitInstanceUpdate() must follow as soon as they are. The object
+ * manager stays locked in between, so the update must not block.
+ * \param[in] obj The object handle
+ * \param[in] instId The object instance ID
+ * \return pointer to the instance data, or NULL if failure (nothing to commit)
+ */
+void *UAVObjBeginInstanceUpdate(UAVObjHandle obj_handle, uint16_t instId)
+{
+    PIOS_Assert(obj_handle);
+
+    // Lock, until the commit
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+
+    if (UAVObjIsMetaobject(obj_handle)) {
+        if (instId == 0) {
+            return MetaDataPtr((struct UAVOMeta *)obj_handle);
+        }
+    } else {
+        struct UAVOData *obj;
+        InstanceHandle instEntry;
+
+        // Cast to object info
+        obj = (struct UAVOData *)obj_handle;
+
+        // Check access level and get instance information
+        if (!UAVObjReadOnly(obj_handle) && (instEntry = getInstance(obj, instId)) != NULL) {
+            // Lock free readers retry until the commit
+            UAVO_SEQ_WRITE_BEGIN(obj);
+            return InstanceData(instEntry);
+        }
+    }
+
+    xSemaphoreGiveRecursive(mutex);
+    return NULL;
+}
+
+/**
+ * Complete an update started with UAVObjBeginInstanceUpdate(), firing a single
+ * EV_UPDATED for all the fields written.
+ * \param[in] obj The object handle
+ * \param[in] instId The object instance ID
+ */
+void UAVObjCommitInstanceUpdate(UAVObjHandle obj_handle, uint16_t instId)
+{
+    PIOS_Assert(obj_handle);
+
+    if (!UAVObjIsMetaobject(obj_handle)) {
+        UAVO_SEQ_WRITE_END((struct UAVOData *)obj_handle);
+    }
+
+    // Fire event
+    sendEvent((struct UAVOBase *)obj_handle, instId, EV_UPDATED);
+
+    xSemaphoreGiveRecursive(mutex);
+}
+
 /**
  * Get the data of a specific object instance
  * \param[in] obj The object handle
@@ -1010,6 +1163,18 @@ int32_t UAVObjGetInstanceData(UAVObjHandle obj_handle, uint16_t instId,
 {
     PIOS_Assert(obj_handle);
 
+    // Single instance data objects can be read without taking the mutex
+    if (!UAVObjIsMetaobject(obj_handle) && UAVObjIsSingleInstance(obj_handle)) {
+        struct UAVOData *obj = (struct UAVOData *)obj_handle;
+
+        if (instId != 0) {
+            return -1;
+        }
+        if (readSingleInstanceLockFree(obj, dataOut, 0, obj->instance_size)) {
+            return 0;
+        }
+    }
+
     // Lock
     xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
 
@@ -1056,6 +1221,18 @@ int32_t UAVObjGetInstanceDataField(UAVObjHandle obj_handle, uint16_t instId, voi
 {
     PIOS_Assert(obj_handle);
 
+    // Single instance data objects can be read without taking the mutex
+    if (!UAVObjIsMetaobject(obj_handle) && UAVObjIsSingleInstance(obj_handle)) {
+        struct UAVOData *obj = (struct UAVOData *)obj_handle;
+
+        if (instId != 0 || (size + offset) > obj->instance_size) {
+            return -1;
+        }
+        if (readSingleInstanceLockFree(obj, dataOut, offset, size)) {
+            return 0;
+        }
+    }
+
     // Lock
     xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
 
@@ -1331,6 +1508,8 @@ int8_t UAVObjReadOnly(UAVObjHandle obj_handle)
 /**
  * Connect an event queue to the object, if the queue is already connected then the event mask is only updated.
  * All events matching the event mask will be pushed to the event queue.
+ * With EV_MASK_COALESCE in the mask an event the queue already holds for the same
+ * instance is not queued again, the receiver then takes events with UAVObjQueueReceive().
  * \param[in] obj The object handle
  * \param[in] queue The event queue
  * \param[in] eventMask The event mask, if EV_MASK_ALL then all events are enabled (e.g. EV_UPDATED | EV_UPDATED_MANUAL)
@@ -1365,9 +1544,53 @@ int32_t UAVObjDisconnectQueue(UAVObjHandle obj_handle, xQueueHandle queue)
     return res;
 }
 
+/**
+ * Take the next event out of an object event queue. For a queue connected with
+ * EV_MASK_COALESCE the next event of that kind is then queued again instead of
+ * merged, before the receiver acts on this one so that no update is missed.
+ * \param[in] queue The event queue
+ * \param[out] ev The event received
+ * \param[in] timeout Ticks to wait for an event
+ * \return true if an event was received
+ */
+bool UAVObjQueueReceive(xQueueHandle queue, UAVObjEvent *ev, portTickType timeout)
+{
+    if (xQueueReceive(queue, ev, timeout) != pdTRUE) {
+        return false;
+    }
+    eventReceived(ev, queue);
+    return true;
+}
+
+/**
+ * Clear the pending state of an event taken out of a coalescing queue
+ * \param[in] ev The event received
+ * \param[in] queue The event queue it was received from
+ */
+static void eventReceived(const UAVObjEvent *ev, xQueueHandle queue)
+{
+    struct ObjectEventEntry *event;
+
+    // Events not sent by an object (e.g. periodic statistics) have nothing pending
+    if (ev->obj == NULL) {
+        return;
+    }
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    LL_FOREACH(((struct UAVOBase *)ev->obj)->next_event, event) {
+        if (event->queue == queue) {
+            if (event->pendingInstId == ev->instId) {
+                event->pendingEvents &= ~ev->event;
+            }
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(mutex);
+}
+
 /**
  * Connect an event callback to the object, if the callback is already connected then the event mask is only updated.
  * The supplied callback will be invoked on all events matching the event mask.
+ * With EV_MASK_COALESCE in the mask events already waiting for the callback are not dispatched again.
  * \param[in] obj The object handle
  * \param[in] cb The event callback
  * \param[in] eventMask The event mask, if EV_MASK_ALL then all events are enabled (e.g. EV_UPDATED | EV_UPDATED_MANUAL)
@@ -1523,17 +1746,23 @@ int32_t sendEvent(struct UAVOBase *obj, uint16_t instId, UAVObjEventType trigger
         if (event->eventMask == 0 || (event->eventMask & triggered_event) != 0) {
             // Send to queue if a valid queue is registered
             if (event->queue) {
-                // will not block
-                if (xQueueSend(event->queue, &msg, 0) != pdTRUE) {
+                if (event->coalesce && (event->pendingEvents & triggered_event) && event->pendingInstId == instId) {
+                    // The receiver has not seen the previous one yet, it will read the latest data anyway
+                    ++stats.eventsCoalesced;
+                } else if (xQueueSend(event->queue, &msg, 0) != pdTRUE) { // will not block
                     ++stats.eventQueueErrors;
                     stats.lastQueueErrorID = UAVObjGetID(obj);
+                } else if (event->coalesce && (event->pendingEvents == 0 || event->pendingInstId == instId)) {
+                    // Pending until UAVObjQueueReceive(), other instances queue as usual meanwhile
+                    event->pendingEvents |= triggered_event;
+                    event->pendingInstId  = instId;
                 }
             }
 
             // Invoke callback (from event task) if a valid one is registered
             if (event->cb) {
                 // invoke callback from the event task, will not block
-                if (EventCallbackDispatch(&msg, event->cb) != pdTRUE) {
+                if ((event->coalesce ? EventCallbackDispatchCoalesced(&msg, event->cb) : EventCallbackDispatch(&msg, event->cb)) != pdTRUE) {
                     ++stats.eventCallbackErrors;
                     stats.lastCallbackErrorID = UAVObjGetID(obj);
                 }
@@ -1549,7 +1778,7 @@ int32_t sendEvent(struct UAVOBase *obj, uint16_t instId, UAVObjEventType trigger
  */
 static InstanceHandle createInstance(struct UAVOData *obj, uint16_t instId)
 {
-    struct UAVOMultiInst *instEntry;
+    PIOS_STATIC_ASSERT((1 << UAVO_MULTI_NUM_CHUNKS) >= UAVOBJ_MAX_INSTANCES);
 
     /* Don't allow more than one instance for single instance objects */
     if (UAVObjIsSingleInstance(&(obj->base))) {
@@ -1574,22 +1803,101 @@ static InstanceHandle createInstance(struct UAVOData *obj, uint16_t instId)
         }
     }
 
-    /* Create the actual instance */
-    uint32_t size = sizeof(struct UAVOMultiInst) + obj->instance_size;
-    instEntry = (struct UAVOMultiInst *)pios_malloc(size);
-    if (!instEntry) {
-        return NULL;
+    /* Allocate the chunk holding this instance when it is the first one in there */
+    struct UAVOMulti *uavo_multi = (struct UAVOMulti *)obj;
+    uint8_t chunk = 31 - __builtin_clz(instId);
+    if (uavo_multi->chunks[chunk] == NULL) {
+        uint32_t size = (1 << chunk) * MultiInstanceStride(obj);
+        uint8_t *instances = (uint8_t *)pios_malloc(size);
+        if (!instances) {
+            return NULL;
+        }
+        memset(instances, 0, size);
+        uavo_multi->chunks[chunk] = instances;
     }
-    memset(instEntry, 0, size);
-    LL_APPEND(((struct UAVOMulti *)obj)->instance0.next, instEntry);
 
-    ((struct UAVOMulti *)obj)->num_instances++;
+    uavo_multi->num_instances++;
 
     // Fire event
     instanceAutoUpdated((UAVObjHandle)obj, instId);
 
     // Done
-    return InstanceDataOffset(instEntry);
+    return getInstance(obj, instId);
+}
+
+/**
+ * Find the generated tables entry of an object ID
+ * \return One plus the index into the tables or 0 if the ID is not in the hash
+ */
+static uint8_t lookupIndex(uint32_t id)
+{
+    uint32_t bucket = (id * UAVO_ID_HASH_BUCKET_MULT) >> (32 - uavo_id_hash_bucket_bits);
+    uint32_t slot   = ((id ^ (uavo_id_hash_disp[bucket] * UAVO_ID_HASH_DISP_MULT)) * UAVO_ID_HASH_SLOT_MULT) >> (32 - uavo_id_hash_bits);
+
+    return uavo_id_hash_index[slot];
+}
+
+/**
+ * Find a registered data object through the generated object ID hash
+ * \return The object or NULL if no object with this ID is registered
+ */
+static struct UAVOData *lookupDataObject(uint32_t id)
+{
+    uint8_t index = lookupIndex(id);
+
+    if (index == 0 || uavo_id_hash_handles[index - 1] == NULL) {
+        return NULL;
+    }
+
+    struct UAVOData *obj = (struct UAVOData *)*uavo_id_hash_handles[index - 1];
+    if (obj == NULL || obj->id != id) {
+        return NULL;
+    }
+    return obj;
+}
+
+/**
+ * Take the object manager mutex, for use by the persistence handler
+ */
+void lockObjectManager(void)
+{
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+}
+
+/**
+ * Release the object manager mutex
+ */
+void unlockObjectManager(void)
+{
+    xSemaphoreGiveRecursive(mutex);
+}
+
+/**
+ * Copy (part of) the data of a single instance object without taking the mutex.
+ * Writers bump the object sequence counter before and after modifying the data,
+ * so the copy is only valid if the counter was even and did not change meanwhile.
+ * Gives up after a few attempts so that a reader preempting a writer falls back
+ * to the mutex (and lets the writer finish through priority inheritance).
+ * \return true if dataOut holds a consistent copy
+ */
+static bool readSingleInstanceLockFree(struct UAVOData *obj, void *dataOut, uint32_t offset, uint32_t size)
+{
+    struct UAVOSingle *uavo_single = (struct UAVOSingle *)obj;
+
+    for (uint8_t attempt = 0; attempt < SEQ_READ_MAX_ATTEMPTS; attempt++) {
+        uint16_t seq = obj->seq;
+        if (seq & 1) {
+            // Writer in progress
+            continue;
+        }
+        UAVO_SEQ_BARRIER();
+        memcpy(dataOut, &(uavo_single->instance0[offset]), size);
+        UAVO_SEQ_BARRIER();
+        if (obj->seq == seq) {
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
@@ -1625,17 +1933,13 @@ InstanceHandle getInstance(struct UAVOData *obj, uint16_t instId)
             return NULL;
         }
 
-        // Look for specified instance ID
-        uint16_t instance = 0;
-        struct UAVOMultiInst *instEntry;
-        LL_FOREACH(&(uavo_multi->instance0), instEntry) {
-            if (instance++ == instId) {
-                /* Found it */
-                return &(instEntry->instance);
-            }
+        if (instId == 0) {
+            return &(uavo_multi->instance0);
         }
-        /* Instance was not found */
-        return NULL;
+
+        /* Instance n lives in chunk log2(n) */
+        uint8_t chunk = 31 - __builtin_clz(instId);
+        return &(uavo_multi->chunks[chunk][(instId - (1 << chunk)) * MultiInstanceStride(obj)]);
     }
 }
 
@@ -1658,7 +1962,11 @@ static int32_t connectObj(UAVObjHandle obj_handle, xQueueHandle queue,
     LL_FOREACH(obj->next_event, event) {
         if (event->queue == queue && event->cb == cb) {
             // Already connected, update event mask and return
-            event->eventMask = eventMask;
+            event->eventMask = eventMask & ~EV_MASK_COALESCE;
+            event->coalesce  = (eventMask & EV_MASK_COALESCE) != 0;
+            if (!event->coalesce) {
+                event->pendingEvents = 0;
+            }
             return 0;
         }
     }
@@ -1670,7 +1978,10 @@ static int32_t connectObj(UAVObjHandle obj_handle, xQueueHandle queue,
     }
     event->queue     = queue;
     event->cb        = cb;
-    event->eventMask = eventMask;
+    event->eventMask = eventMask & ~EV_MASK_COALESCE;
+    event->coalesce  = (eventMask & EV_MASK_COALESCE) != 0;
+    event->pendingEvents = 0;
+    event->pendingInstId = 0;
     LL_APPEND(obj->next_event, event);
 
     // Done
@@ -82,32 +82,49 @@ int32_t UAVObjLoad(UAVObjHandle obj_handle, uint16_t instId)
 {
     PIOS_Assert(obj_handle);
 
+    void *dest;
     if (UAVObjIsMetaobject(obj_handle)) {
         if (instId != 0) {
             return -1;
         }
-
-        // Fire event on success
-        if (PIOS_FLASHFS_ObjLoad(pios_uavo_settings_fs_id, UAVObjGetID(obj_handle), instId, (uint8_t *)MetaDataPtr((struct UAVOMeta *)obj_handle), UAVObjGetNumBytes(obj_handle)) == 0) {
-            sendEvent((struct UAVOBase *)obj_handle, instId, EV_UNPACKED);
-        } else {
-            return -1;
-        }
+        dest = MetaDataPtr((struct UAVOMeta *)obj_handle);
     } else {
         InstanceHandle instEntry = getInstance((struct UAVOData *)obj_handle, instId);
 
         if (instEntry == NULL) {
             return -1;
         }
+        dest = InstanceData(instEntry);
+    }
 
-        // Fire event on success
-        if (PIOS_FLASHFS_ObjLoad(pios_uavo_settings_fs_id, UAVObjGetID(obj_handle), instId, InstanceData(instEntry), UAVObjGetNumBytes(obj_handle)) == 0) {
-            sendEvent((struct UAVOBase *)obj_handle, instId, EV_UNPACKED);
-        } else {
-            return -1;
-        }
+    // Load into a scratch buffer first, the flash transaction lock may be held
+    // for a whole garbage collection and must not be waited for with the
+    // object manager locked. A failed load leaves the object untouched.
+    uint16_t numBytes = UAVObjGetNumBytes(obj_handle);
+    uint8_t *buffer   = (uint8_t *)pios_malloc(numBytes);
+    if (buffer == NULL) {
+        return -1;
+    }
+    if (PIOS_FLASHFS_ObjLoad(pios_uavo_settings_fs_id, UAVObjGetID(obj_handle), instId, buffer, numBytes) != 0) {
+        pios_free(buffer);
+        return -1;
+    }
+
+    lockObjectManager();
+    if (UAVObjIsMetaobject(obj_handle)) {
+        memcpy(dest, buffer, numBytes);
+    } else {
+        // Lock free readers must see the copy as an update
+        struct UAVOData *obj = (struct UAVOData *)obj_handle;
+        UAVO_SEQ_WRITE_BEGIN(obj);
+        memcpy(dest, buffer, numBytes);
+        UAVO_SEQ_WRITE_END(obj);
     }
+    unlockObjectManager();
+    pios_free(buffer);
 
+    // Fire event on success
+    sendEvent((struct UAVOBase *)obj_handle, instId, EV_UNPACKED);
 
     return 0;
 }
@@ -37,6 +37,7 @@ typedef struct {
     uint32_t txObjectBytes;
     uint32_t txObjects;
     uint32_t txErrors;
+    uint32_t txDeltas;
 
     uint32_t rxBytes;
     uint32_t rxObjectBytes;
@@ -59,6 +60,7 @@ int32_t UAVTalkSendObjectTimestamped(UAVTalkConnection connectionHandle, UAVObjH
 int32_t UAVTalkSendObjectRequest(UAVTalkConnection connection, UAVObjHandle obj, uint16_t instId, int32_t timeoutMs);
 UAVTalkRxState UAVTalkProcessInputStream(UAVTalkConnection connection, uint8_t rxbyte);
 UAVTalkRxState UAVTalkProcessInputStreamQuiet(UAVTalkConnection connection, uint8_t rxbyte);
+UAVTalkRxState UAVTalkProcessInputStreamBuffer(UAVTalkConnection connection, const uint8_t *rxbuffer, uint16_t length);
 int32_t UAVTalkRelayPacket(UAVTalkConnection inConnectionHandle, UAVTalkConnection outConnectionHandle);
 int32_t UAVTalkReceiveObject(UAVTalkConnection connectionHandle);
 void UAVTalkGetStats(UAVTalkConnection connection, UAVTalkStats *stats, bool reset);
@@ -66,6 +68,10 @@ void UAVTalkAddStats(UAVTalkConnection connection, UAVTalkStats *stats, bool res
 void UAVTalkResetStats(UAVTalkConnection connection);
 void UAVTalkGetLastTimestamp(UAVTalkConnection connection, uint16_t *timestamp);
 uint32_t UAVTalkGetPacketObjId(UAVTalkConnection connection);
+int32_t UAVTalkSendCapabilities(UAVTalkConnection connection);
+void UAVTalkResetCapabilities(UAVTalkConnection connection);
+void UAVTalkBeginBundle(UAVTalkConnection connection, uint16_t maxLength);
+int32_t UAVTalkEndBundle(UAVTalkConnection connection);
 
 #endif // UAVTALK_H
 /**
@@ -46,6 +46,28 @@
 #define UAVTALK_MIN_PACKET_LENGTH  UAVTALK_MAX_HEADER_LENGTH + UAVTALK_CHECKSUM_LENGTH
 #define UAVTALK_MAX_PACKET_LENGTH  UAVTALK_MIN_PACKET_LENGTH + UAVTALK_MAX_PAYLOAD_LENGTH
 
+// Delta packets: the last data sent of this many object instances is kept once the peer accepts them
+#ifndef UAVTALK_DELTA_SLOTS
+#define UAVTALK_DELTA_SLOTS        8
+#endif
+
+// After this many deltas an instance is sent in full again, to recover from lost packets
+#define UAVTALK_DELTA_KEYFRAME     16
+
+// Smaller objects are always sent in full
+#define UAVTALK_DELTA_MIN_LENGTH   16
+
+// Objects with more fields are always sent in full
+#define UAVTALK_DELTA_MAX_FIELDS   128
+
+// Largest bundle frame, checksum included: the payload of a 64-byte USB HID report
+#ifndef UAVTALK_BUNDLE_MAX_LENGTH
+#define UAVTALK_BUNDLE_MAX_LENGTH  62
+#endif
+
+// bundle record header : type(1), object ID(4), instance ID(2) if not zero, length(1)
+#define UAVTALK_BUNDLE_RECORD_LENGTH 6
+
 typedef struct {
     uint8_t  type;
     uint16_t packet_size;
@@ -60,6 +82,14 @@ typedef struct {
     uint16_t rxPacketLength;
 } UAVTalkInputProcessor;
 
+typedef struct {
+    uint32_t objId;
+    uint16_t instId;
+    uint8_t  valid;
+    uint8_t  deltas; // sent since the data was last sent in full
+    uint8_t  *data;
+} UAVTalkDeltaBase;
+
 typedef struct {
     uint8_t canari;
     UAVTalkOutputStream outStream;
@@ -73,6 +103,14 @@ typedef struct {
     UAVTalkInputProcessor iproc;
     uint8_t      *rxBuffer;
     uint8_t      *txBuffer;
+    uint16_t     peerCaps;
+    uint8_t      deltaSlots;
+    uint8_t      deltaNext;
+    UAVTalkDeltaBase *deltaBases;
+    uint8_t      *bundleBuffer;
+    uint16_t     bundleLength; // frame length limit while a bundle is open, zero otherwise
+    uint16_t     bundleFill;
+    uint8_t      bundleCount;
 } UAVTalkConnectionData;
 
 #define UAVTALK_CANARI          0xCA
@@ -86,9 +124,25 @@ typedef struct {
 #define UAVTALK_TYPE_OBJ_ACK    (UAVTALK_TYPE_VER | 0x02)
 #define UAVTALK_TYPE_ACK        (UAVTALK_TYPE_VER | 0x03)
 #define UAVTALK_TYPE_NACK       (UAVTALK_TYPE_VER | 0x04)
+#define UAVTALK_TYPE_OBJ_DELTA  (UAVTALK_TYPE_VER | 0x05)
+#define UAVTALK_TYPE_OBJ_ACK_DELTA (UAVTALK_TYPE_VER | 0x06)
+#define UAVTALK_TYPE_BUNDLE     (UAVTALK_TYPE_VER | 0x07)
 #define UAVTALK_TYPE_OBJ_TS     (UAVTALK_TIMESTAMPED | UAVTALK_TYPE_OBJ)
 #define UAVTALK_TYPE_OBJ_ACK_TS (UAVTALK_TIMESTAMPED | UAVTALK_TYPE_OBJ_ACK)
 
+// Capabilities are exchanged as a request of this reserved object ID with the
+// flags as instance ID, peers without them answer with a NACK
+#define UAVTALK_CAPS_OBJID      0xFFFFFFFE
+#define UAVTALK_CAP_DELTA       0x0001 // OBJ_DELTA and OBJ_ACK_DELTA packets are understood
+#define UAVTALK_CAP_BUNDLE      0x0002 // BUNDLE packets are understood
+#define UAVTALK_CAP_REPLY       0x8000 // answer to the capabilities of the peer
+#define UAVTALK_CAPS            (UAVTALK_CAP_DELTA | UAVTALK_CAP_BUNDLE)
+
+// A bundle carries several OBJ or OBJ_DELTA packets of this reserved object ID
+// as records, with the number of records as instance ID
+#define UAVTALK_BUNDLE_OBJID    0xFFFFFFFD
+#define UAVTALK_BUNDLE_INSTID   0x80 // record type flag, the instance ID follows the object ID
+
 // macros
 #define CHECKCONHANDLE(handle, variable, failcommand) \
     variable = (UAVTalkConnectionData *)handle; \
@@ -51,8 +51,18 @@
 static int32_t objectTransaction(UAVTalkConnectionData *connection, uint8_t type, UAVObjHandle obj, uint16_t instId, int32_t timeout);
 static int32_t sendObject(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, UAVObjHandle obj);
 static int32_t sendSingleObject(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, UAVObjHandle obj);
-static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, uint8_t *data);
+static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, uint8_t *data, int32_t length);
 static void updateAck(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId);
+static UAVTalkRxState processInputByte(UAVTalkConnectionData *connection, uint8_t rxbyte);
+static void receiveCapabilities(UAVTalkConnectionData *connection, uint16_t caps);
+static UAVTalkDeltaBase *findDeltaBase(UAVTalkConnectionData *connection, uint32_t objId, uint16_t instId);
+static void forgetDeltaBase(UAVTalkConnectionData *connection, uint32_t objId, uint16_t instId);
+static void forgetDeltaBases(UAVTalkConnectionData *connection);
+static int32_t packDelta(UAVTalkDeltaBase *base, const uint16_t *layout, uint8_t *data, int32_t length);
+static int32_t unpackDelta(UAVTalkConnectionData *connection, UAVObjHandle obj, uint16_t instId, const uint8_t *data, int32_t length);
+static int32_t appendBundle(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, const uint8_t *data, int32_t length);
+static int32_t flushBundle(UAVTalkConnectionData *connection);
+static int32_t receiveBundle(UAVTalkConnectionData *connection, uint8_t *data, int32_t length);
 
 /**
  * Initialize the UAVTalk library
@@ -73,6 +83,14 @@ UAVTalkConnection UAVTalkInitialize(UAVTalkOutputStream outputStream)
     connection->iproc.rxPacketLength = 0;
     connection->iproc.state = UAVTALK_STATE_SYNC;
     connection->outStream   = outputStream;
+    connection->peerCaps    = 0;
+    connection->deltaSlots  = 0;
+    connection->deltaNext   = 0;
+    connection->deltaBases  = NULL;
+    connection->bundleBuffer = NULL;
+    connection->bundleLength = 0;
+    connection->bundleFill  = UAVTALK_MIN_HEADER_LENGTH;
+    connection->bundleCount = 0;
     connection->lock = xSemaphoreCreateRecursiveMutex();
     connection->transLock   = xSemaphoreCreateRecursiveMutex();
     // allocate buffers
@@ -173,6 +191,7 @@ void UAVTalkAddStats(UAVTalkConnection connectionHandle, UAVTalkStats *statsOut,
     statsOut->txObjectBytes += connection->stats.txObjectBytes;
     statsOut->txObjects     += connection->stats.txObjects;
     statsOut->txErrors      += connection->stats.txErrors;
+    statsOut->txDeltas      += connection->stats.txDeltas;
     statsOut->rxBytes       += connection->stats.rxBytes;
     statsOut->rxObjectBytes += connection->stats.rxObjectBytes;
     statsOut->rxObjects     += connection->stats.rxObjects;
@@ -335,6 +354,8 @@ static int32_t objectTransaction(UAVTalkConnectionData *connection, uint8_t type
             // non blocking call to make sure the value is reset to zero (binary sema)
             xSemaphoreTake(connection->respSema, 0);
             connection->respObjId = 0;
+            // The peer may not have the data a retry would be a delta of
+            forgetDeltaBase(connection, UAVObjGetID(obj), instId);
             xSemaphoreGiveRecursive(connection->lock);
             xSemaphoreGiveRecursive(connection->transLock);
             return -1;
@@ -359,6 +380,17 @@ UAVTalkRxState UAVTalkProcessInputStreamQuiet(UAVTalkConnection connectionHandle
 
     CHECKCONHANDLE(connectionHandle, connection, return -1);
 
+    return processInputByte(connection, rxbyte);
+}
+
+/**
+ * Process an byte from the telemetry stream.
+ * \param[in] connection UAVTalkConnectionData to be used
+ * \param[in] rxbyte Received byte
+ * \return UAVTalkRxState
+ */
+static UAVTalkRxState processInputByte(UAVTalkConnectionData *connection, uint8_t rxbyte)
+{
     UAVTalkInputProcessor *iproc = &connection->iproc;
 
     ++connection->stats.rxBytes;
@@ -466,7 +498,7 @@ UAVTalkRxState UAVTalkProcessInputStreamQuiet(UAVTalkConnection connectionHandle
             iproc->timestampLength = 0;
         } else {
             iproc->timestampLength = (iproc->type & UAVTALK_TIMESTAMPED) ? 2 : 0;
-            if (obj) {
+            if (obj && iproc->type != UAVTALK_TYPE_OBJ_DELTA && iproc->type != UAVTALK_TYPE_OBJ_ACK_DELTA) {
                 iproc->length = UAVObjGetNumBytes(obj);
             } else {
                 iproc->length = iproc->packet_size - iproc->rxPacketLength - iproc->timestampLength;
@@ -589,6 +621,72 @@ UAVTalkRxState UAVTalkProcessInputStream(UAVTalkConnection connectionHandle, uin
     return state;
 }
 
+/**
+ * Process a block of bytes from the telemetry stream.
+ * Sync search and payload bytes are handled a span at a time,
+ * every completed object is received as it is found.
+ * \param[in] connectionHandle UAVTalkConnection to be used
+ * \param[in] rxbuffer Received bytes
+ * \param[in] length Number of bytes in rxbuffer
+ * \return UAVTalkRxState after the last byte
+ */
+UAVTalkRxState UAVTalkProcessInputStreamBuffer(UAVTalkConnection connectionHandle, const uint8_t *rxbuffer, uint16_t length)
+{
+    UAVTalkConnectionData *connection;
+
+    CHECKCONHANDLE(connectionHandle, connection, return -1);
+
+    UAVTalkInputProcessor *iproc = &connection->iproc;
+    const uint8_t *end = rxbuffer + length;
+
+    while (rxbuffer < end) {
+        uint16_t available = end - rxbuffer;
+
+        if (iproc->state == UAVTALK_STATE_ERROR || iproc->state == UAVTALK_STATE_COMPLETE) {
+            iproc->state = UAVTALK_STATE_SYNC;
+        }
+
+        if (iproc->state == UAVTALK_STATE_SYNC) {
+            // Skip everything up to the next sync byte at once
+            const uint8_t *sync = memchr(rxbuffer, UAVTALK_SYNC_VAL, available);
+            uint16_t skipped    = (sync ? sync : end) - rxbuffer;
+
+            connection->stats.rxBytes      += skipped;
+            connection->stats.rxSyncErrors += skipped;
+            rxbuffer += skipped;
+            if (!sync) {
+                break;
+            }
+        } else if (iproc->state == UAVTALK_STATE_DATA) {
+            // Copy as much of the payload as is available and checksum it in one go
+            uint16_t count = iproc->length - iproc->rxCount;
+            if (count > available) {
+                count = available;
+            }
+
+            memcpy(&connection->rxBuffer[iproc->rxCount], rxbuffer, count);
+            iproc->cs = PIOS_CRC_updateCRC(iproc->cs, rxbuffer, count);
+            connection->stats.rxBytes += count;
+            iproc->rxPacketLength = (iproc->rxPacketLength + count < 0xffff) ? iproc->rxPacketLength + count : 0xffff;
+            iproc->rxCount += count;
+            rxbuffer += count;
+
+            if (iproc->rxCount == iproc->length) {
+                iproc->rxCount = 0;
+                iproc->state   = UAVTALK_STATE_CS;
+            }
+            continue;
+        }
+
+        // Headers and checksum go through the byte state machine
+        if (processInputByte(connection, *rxbuffer++) == UAVTALK_STATE_COMPLETE) {
+            UAVTalkReceiveObject(connectionHandle);
+        }
+    }
+
+    return iproc->state;
+}
+
 /**
  * Send a parsed packet received on one connection handle out on a different connection handle.
  * The packet must be in a complete state, meaning it is completed parsing.
@@ -696,7 +794,7 @@ int32_t UAVTalkReceiveObject(UAVTalkConnection connectionHandle)
         return -1;
     }
 
-    return receiveObject(connection, iproc->type, iproc->objId, iproc->instId, connection->rxBuffer);
+    return receiveObject(connection, iproc->type, iproc->objId, iproc->instId, connection->rxBuffer, iproc->length);
 }
 
 /**
@@ -723,7 +821,8 @@ uint32_t UAVTalkGetPacketObjId(UAVTalkConnection connectionHandle)
  * In that case we want to nack as there is no point in the sender retrying to send invalid objects.
  *
  * \param[in] connection UAVTalkConnection to be used
- * \param[in] type Type of received message (UAVTALK_TYPE_OBJ, UAVTALK_TYPE_OBJ_REQ, UAVTALK_TYPE_OBJ_ACK, UAVTALK_TYPE_ACK, UAVTALK_TYPE_NACK)
+ * \param[in] type Type of received message (UAVTALK_TYPE_OBJ, UAVTALK_TYPE_OBJ_REQ, UAVTALK_TYPE_OBJ_ACK, UAVTALK_TYPE_ACK, UAVTALK_TYPE_NACK,
+ *            UAVTALK_TYPE_OBJ_DELTA, UAVTALK_TYPE_OBJ_ACK_DELTA, UAVTALK_TYPE_BUNDLE)
  * \param[in] objId ID of the object to work on
  * \param[in] instId The instance ID of UAVOBJ_ALL_INSTANCES for all instances.
  * \param[in] data Data buffer
@@ -731,7 +830,7 @@ uint32_t UAVTalkGetPacketObjId(UAVTalkConnection connectionHandle)
  * \return 0 Success
  * \return -1 Failure
  */
-static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, uint8_t *data)
+static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, uint8_t *data, int32_t length)
 {
     UAVObjHandle obj;
     int32_t ret = 0;
@@ -746,6 +845,11 @@ static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, ui
     // TODO the above should be fixed as it is cumbersome and error prone
     obj = UAVObjGetByID(objId);
 
+    // The data the peer has is now its own, deltas against what was last sent to it would miss changes
+    if (type != UAVTALK_TYPE_OBJ_REQ && type != UAVTALK_TYPE_ACK && type != UAVTALK_TYPE_NACK && type != UAVTALK_TYPE_BUNDLE) {
+        forgetDeltaBase(connection, objId, instId);
+    }
+
     // Process message type
     switch (type) {
     case UAVTALK_TYPE_OBJ:
@@ -766,13 +870,40 @@ static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, ui
         }
         break;
 
+    case UAVTALK_TYPE_OBJ_DELTA:
+        // Deltas only apply to instances that exist
+        if (obj && (instId != UAVOBJ_ALL_INSTANCES)) {
+            if (unpackDelta(connection, obj, instId, data, length) == 0) {
+                updateAck(connection, UAVTALK_TYPE_OBJ, objId, instId);
+            } else {
+                ret = -1;
+            }
+        } else {
+            ret = -1;
+        }
+        break;
+
+    case UAVTALK_TYPE_BUNDLE:
+        if (objId == UAVTALK_BUNDLE_OBJID) {
+            ret = receiveBundle(connection, data, length);
+        } else {
+            ret = -1;
+        }
+        break;
+
     case UAVTALK_TYPE_OBJ_ACK:
     case UAVTALK_TYPE_OBJ_ACK_TS:
+    case UAVTALK_TYPE_OBJ_ACK_DELTA:
         UAVT_DEBUGLOG_CPRINTF(objId, "OBJ_ACK %X %d", objId, instId);
         // All instances not allowed for OBJ_ACK messages
         if (obj && (instId != UAVOBJ_ALL_INSTANCES)) {
             // Unpack object, if the instance does not exist it will be created!
-            if (UAVObjUnpack(obj, instId, data) == 0) {
+            if (type == UAVTALK_TYPE_OBJ_ACK_DELTA) {
+                ret = unpackDelta(connection, obj, instId, data, length);
+            } else {
+                ret = UAVObjUnpack(obj, instId, data);
+            }
+            if (ret == 0) {
                 UAVT_DEBUGLOG_CPRINTF(objId, "OBJ ACK %X %d", objId, instId);
                 // Object updated or created, transmit ACK
                 sendObject(connection, UAVTALK_TYPE_ACK, objId, instId, NULL);
@@ -790,11 +921,16 @@ static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, ui
         break;
 
     case UAVTALK_TYPE_OBJ_REQ:
+        if (objId == UAVTALK_CAPS_OBJID) {
+            receiveCapabilities(connection, instId);
+            break;
+        }
         // Check if requested object exists
         UAVT_DEBUGLOG_CPRINTF(objId, "REQ %X %d", objId, instId);
         if (obj) {
-            // Object found, transmit it
+            // Object found, transmit it in full
             // The sent object will ack the object request on the receiver side
+            forgetDeltaBase(connection, objId, instId);
             ret = sendObject(connection, UAVTALK_TYPE_OBJ, objId, instId, obj);
         } else {
             ret = -1;
@@ -807,6 +943,8 @@ static int32_t receiveObject(UAVTalkConnectionData *connection, uint8_t type, ui
         break;
 
     case UAVTALK_TYPE_NACK:
+        // What is sent next must not depend on the refused data
+        forgetDeltaBase(connection, objId, instId);
         // Do nothing on flight side, let it time out.
         // TODO:
         // The transaction takes the result code of the "semaphore taking operation" into account to determine success.
@@ -966,13 +1104,43 @@ static int32_t sendSingleObject(UAVTalkConnectionData *connection, uint8_t type,
     }
 
     // Copy data (if any)
+    bool delta = false;
     if (length > 0) {
         if (UAVObjPack(obj, instId, &connection->txBuffer[headerLength]) == -1) {
             connection->stats.txErrors++;
             return -1;
         }
+
+        // Instances the peer already has are sent as the fields that changed since
+        const uint16_t *layout = NULL;
+        if ((type == UAVTALK_TYPE_OBJ || type == UAVTALK_TYPE_OBJ_ACK) && (connection->peerCaps & UAVTALK_CAP_DELTA) &&
+            connection->deltaBases && length >= UAVTALK_DELTA_MIN_LENGTH) {
+            layout = UAVObjGetFieldLayout(obj);
+        }
+        if (layout && layout[0] <= UAVTALK_DELTA_MAX_FIELDS && layout[layout[0] + 1] == length) {
+            int32_t deltaLength = packDelta(findDeltaBase(connection, objId, instId), layout, &connection->txBuffer[headerLength], length);
+            if (deltaLength < length) {
+                connection->txBuffer[1] = (type == UAVTALK_TYPE_OBJ) ? UAVTALK_TYPE_OBJ_DELTA : UAVTALK_TYPE_OBJ_ACK_DELTA;
+                length = deltaLength;
+                delta  = true;
+            }
+        } else {
+            forgetDeltaBase(connection, objId, instId);
+        }
+    }
+
+    // Objects that need no answer share the frame of an open bundle when they fit
+    if (type == UAVTALK_TYPE_OBJ && connection->bundleLength &&
+        appendBundle(connection, connection->txBuffer[1], objId, instId, &connection->txBuffer[headerLength], length) == 0) {
+        ++connection->stats.txObjects;
+        connection->stats.txDeltas += delta ? 1 : 0;
+        connection->stats.txObjectBytes += length;
+        return 0;
     }
 
+    // Anything else goes out behind what is already bundled
+    flushBundle(connection);
+
     // Store the packet length
     connection->txBuffer[2] = (uint8_t)((headerLength + length) & 0xFF);
     connection->txBuffer[3] = (uint8_t)(((headerLength + length) >> 8) & 0xFF);
@@ -987,6 +1155,7 @@ static int32_t sendSingleObject(UAVTalkConnectionData *connection, uint8_t type,
     // Update stats
     if (rc == tx_msg_len) {
         ++connection->stats.txObjects;
+        connection->stats.txDeltas += delta ? 1 : 0;
         connection->stats.txObjectBytes += length;
         connection->stats.txBytes += tx_msg_len;
     } else {
@@ -1000,6 +1169,451 @@ static int32_t sendSingleObject(UAVTalkConnectionData *connection, uint8_t type,
     return 0;
 }
 
+/**
+ * Tell the peer which optional packet types this end understands.
+ * A peer that knows about capabilities answers with its own, others with a NACK.
+ * \param[in] connection UAVTalkConnection to be used
+ * \return 0 Success
+ * \return -1 Failure
+ */
+int32_t UAVTalkSendCapabilities(UAVTalkConnection connectionHandle)
+{
+    UAVTalkConnectionData *connection;
+
+    CHECKCONHANDLE(connectionHandle, connection, return -1);
+
+    xSemaphoreTakeRecursive(connection->lock, portMAX_DELAY);
+    int32_t ret = sendSingleObject(connection, UAVTALK_TYPE_OBJ_REQ, UAVTALK_CAPS_OBJID, UAVTALK_CAPS, NULL);
+    xSemaphoreGiveRecursive(connection->lock);
+
+    return ret;
+}
+
+/**
+ * Forget the capabilities of the peer, to be called when the link is lost as
+ * a different peer may connect. Objects are sent in full until the next exchange.
+ * \param[in] connection UAVTalkConnection to be used
+ */
+void UAVTalkResetCapabilities(UAVTalkConnection connectionHandle)
+{
+    UAVTalkConnectionData *connection;
+
+    CHECKCONHANDLE(connectionHandle, connection, return );
+
+    xSemaphoreTakeRecursive(connection->lock, portMAX_DELAY);
+    connection->peerCaps     = 0;
+    forgetDeltaBases(connection);
+    // What is still bundled was meant for the old peer
+    connection->bundleLength = 0;
+    connection->bundleFill   = UAVTALK_MIN_HEADER_LENGTH;
+    connection->bundleCount  = 0;
+    xSemaphoreGiveRecursive(connection->lock);
+}
+
+/**
+ * Start collecting the objects sent without an ack into bundle frames, until
+ * UAVTalkEndBundle(). Other packets sent in the meantime flush the bundle first,
+ * so that everything is still sent in order. Does nothing unless the peer
+ * understands bundles.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] maxLength Largest frame to send, usually the MTU of the link
+ */
+void UAVTalkBeginBundle(UAVTalkConnection connectionHandle, uint16_t maxLength)
+{
+    UAVTalkConnectionData *connection;
+
+    CHECKCONHANDLE(connectionHandle, connection, return );
+
+    if (maxLength > UAVTALK_BUNDLE_MAX_LENGTH) {
+        maxLength = UAVTALK_BUNDLE_MAX_LENGTH;
+    }
+
+    xSemaphoreTakeRecursive(connection->lock, portMAX_DELAY);
+    if ((connection->peerCaps & UAVTALK_CAP_BUNDLE) && connection->bundleBuffer) {
+        connection->bundleLength = maxLength;
+    }
+    xSemaphoreGiveRecursive(connection->lock);
+}
+
+/**
+ * Send what is left in the bundle and go back to a packet per object.
+ * \param[in] connection UAVTalkConnection to be used
+ * \return 0 Success
+ * \return -1 Failure
+ */
+int32_t UAVTalkEndBundle(UAVTalkConnection connectionHandle)
+{
+    UAVTalkConnectionData *connection;
+
+    CHECKCONHANDLE(connectionHandle, connection, return -1);
+
+    xSemaphoreTakeRecursive(connection->lock, portMAX_DELAY);
+    int32_t ret = flushBundle(connection);
+    connection->bundleLength = 0;
+    xSemaphoreGiveRecursive(connection->lock);
+
+    return ret;
+}
+
+/**
+ * Store the capabilities received from the peer and answer them with ours.
+ * The memory for delta packets is only taken once a peer accepts them.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] caps The capability flags of the peer
+ */
+static void receiveCapabilities(UAVTalkConnectionData *connection, uint16_t caps)
+{
+    if (!(caps & UAVTALK_CAP_REPLY)) {
+        sendSingleObject(connection, UAVTALK_TYPE_OBJ_REQ, UAVTALK_CAPS_OBJID, UAVTALK_CAPS | UAVTALK_CAP_REPLY, NULL);
+    }
+
+    if ((caps & UAVTALK_CAP_DELTA) && !connection->deltaBases && UAVTALK_DELTA_SLOTS > 0) {
+        // Slots and their data in a single block, never freed
+        uint8_t *block = pios_malloc(UAVTALK_DELTA_SLOTS * (sizeof(UAVTalkDeltaBase) + UAVOBJECTS_LARGEST));
+        if (block) {
+            connection->deltaBases = (UAVTalkDeltaBase *)block;
+            connection->deltaSlots = UAVTALK_DELTA_SLOTS;
+            block += UAVTALK_DELTA_SLOTS * sizeof(UAVTalkDeltaBase);
+            for (uint8_t n = 0; n < connection->deltaSlots; n++) {
+                connection->deltaBases[n].data = block + n * UAVOBJECTS_LARGEST;
+            }
+        }
+    }
+
+    if ((caps & UAVTALK_CAP_BUNDLE) && !connection->bundleBuffer && UAVTALK_BUNDLE_MAX_LENGTH > 0) {
+        // Never freed either
+        connection->bundleBuffer = pios_malloc(UAVTALK_BUNDLE_MAX_LENGTH);
+    }
+
+    // A new peer has none of the data sent before
+    connection->peerCaps = caps & ~UAVTALK_CAP_REPLY;
+    forgetDeltaBases(connection);
+}
+
+/**
+ * Find the data last sent of an instance, or take the oldest slot for it.
+ * A new slot is not valid, the instance is then sent in full.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] objId The object ID
+ * \param[in] instId The instance ID
+ * \return The slot
+ */
+static UAVTalkDeltaBase *findDeltaBase(UAVTalkConnectionData *connection, uint32_t objId, uint16_t instId)
+{
+    UAVTalkDeltaBase *base;
+
+    for (uint8_t n = 0; n < connection->deltaSlots; n++) {
+        base = &connection->deltaBases[n];
+        if (base->valid && base->objId == objId && base->instId == instId) {
+            return base;
+        }
+    }
+
+    base = &connection->deltaBases[connection->deltaNext];
+    if (++connection->deltaNext >= connection->deltaSlots) {
+        connection->deltaNext = 0;
+    }
+    base->objId  = objId;
+    base->instId = instId;
+    base->valid  = 0;
+    return base;
+}
+
+/**
+ * Drop the data last sent of an instance, so that it is sent in full next.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] objId The object ID
+ * \param[in] instId The instance ID or UAVOBJ_ALL_INSTANCES for all instances
+ */
+static void forgetDeltaBase(UAVTalkConnectionData *connection, uint32_t objId, uint16_t instId)
+{
+    if (!connection->deltaBases) {
+        return;
+    }
+
+    for (uint8_t n = 0; n < connection->deltaSlots; n++) {
+        UAVTalkDeltaBase *base = &connection->deltaBases[n];
+        if (base->objId == objId && (instId == UAVOBJ_ALL_INSTANCES || base->instId == instId)) {
+            base->valid = 0;
+        }
+    }
+}
+
+/**
+ * Drop the data last sent of all instances.
+ * \param[in] connection UAVTalkConnection to be used
+ */
+static void forgetDeltaBases(UAVTalkConnectionData *connection)
+{
+    if (!connection->deltaBases) {
+        return;
+    }
+
+    for (uint8_t n = 0; n < connection->deltaSlots; n++) {
+        connection->deltaBases[n].valid = 0;
+    }
+}
+
+/**
+ * Turn packed object data into a delta against the data last sent, in place:
+ * a bitmask of the fields that changed, field n in bit n % 8 of byte n / 8,
+ * followed by these fields. The data is left whole when it is to be sent in full,
+ * as a keyframe or because the delta would not be any smaller.
+ * \param[in] base The data last sent of the instance, updated to the new data
+ * \param[in] layout The field layout of the object
+ * \param[in,out] data The packed data
+ * \param[in] length The packed length
+ * \return The payload length, length when sent in full
+ */
+static int32_t packDelta(UAVTalkDeltaBase *base, const uint16_t *layout, uint8_t *data, int32_t length)
+{
+    uint16_t numFields  = layout[0];
+    uint16_t maskLength = (numFields + 7) / 8;
+    uint8_t mask[UAVTALK_DELTA_MAX_FIELDS / 8];
+    uint8_t *pos = data;
+
+    if (!base->valid || base->deltas >= UAVTALK_DELTA_KEYFRAME) {
+        memcpy(base->data, data, length);
+        base->valid  = 1;
+        base->deltas = 0;
+        return length;
+    }
+
+    // Move the changed fields to the front, behind the ones already moved
+    memset(mask, 0, maskLength);
+    for (uint16_t n = 0; n < numFields; n++) {
+        uint16_t offset = layout[n + 1];
+        uint16_t size   = layout[n + 2] - offset;
+        if (memcmp(&data[offset], &base->data[offset], size) != 0) {
+            mask[n / 8] |= 1 << (n % 8);
+            memcpy(&base->data[offset], &data[offset], size);
+            memmove(pos, &data[offset], size);
+            pos += size;
+        }
+    }
+
+    int32_t deltaLength = maskLength + (pos - data);
+    if (deltaLength >= length) {
+        // The base holds all of the new data by now
+        memcpy(data, base->data, length);
+        base->deltas = 0;
+        return length;
+    }
+
+    memmove(&data[maskLength], data, pos - data);
+    memcpy(data, mask, maskLength);
+    base->deltas++;
+    return deltaLength;
+}
+
+/**
+ * Apply a delta to an existing instance, the fields it does not carry keep their value.
+ * The instance is unpacked in one go so that it raises a single event.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] obj The object
+ * \param[in] instId The instance ID
+ * \param[in] data The delta, as built by packDelta()
+ * \param[in] length The delta length
+ * \return 0 Success
+ * \return -1 Failure
+ */
+static int32_t unpackDelta(UAVTalkConnectionData *connection, UAVObjHandle obj, uint16_t instId, const uint8_t *data, int32_t length)
+{
+    const uint16_t *layout = UAVObjGetFieldLayout(obj);
+    // The transmit buffer is not in use while the connection is locked
+    uint8_t *current = connection->txBuffer;
+
+    if (!layout || instId >= UAVObjGetNumInstances(obj)) {
+        return -1;
+    }
+
+    uint16_t numFields  = layout[0];
+    uint16_t maskLength = (numFields + 7) / 8;
+    if (length < maskLength || UAVObjPack(obj, instId, current) == -1) {
+        return -1;
+    }
+
+    const uint8_t *pos = &data[maskLength];
+    const uint8_t *end = &data[length];
+    for (uint16_t n = 0; n < numFields; n++) {
+        if (data[n / 8] & (1 << (n % 8))) {
+            uint16_t offset = layout[n + 1];
+            uint16_t size   = layout[n + 2] - offset;
+            if (end - pos < size) {
+                return -1;
+            }
+            memcpy(&current[offset], pos, size);
+            pos += size;
+        }
+    }
+    if (pos != end) {
+        return -1;
+    }
+
+    return UAVObjUnpack(obj, instId, current);
+}
+
+/**
+ * Add a packet to the open bundle as a record: its type, with UAVTALK_BUNDLE_INSTID
+ * set when the instance ID is not zero, the object ID, the instance ID if set,
+ * the data length and the data. The bundle is sent first when the record would
+ * not fit behind the ones it holds.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] type UAVTALK_TYPE_OBJ or UAVTALK_TYPE_OBJ_DELTA
+ * \param[in] objId The object ID
+ * \param[in] instId The instance ID
+ * \param[in] data The packet data
+ * \param[in] length The data length
+ * \return 0 Success
+ * \return -1 The packet is too large for a bundle
+ */
+static int32_t appendBundle(UAVTalkConnectionData *connection, uint8_t type, uint32_t objId, uint16_t instId, const uint8_t *data, int32_t length)
+{
+    int32_t recordLength = UAVTALK_BUNDLE_RECORD_LENGTH + (instId ? 2 : 0) + length;
+
+    if (UAVTALK_MIN_HEADER_LENGTH + recordLength + UAVTALK_CHECKSUM_LENGTH > connection->bundleLength) {
+        return -1;
+    }
+    if (connection->bundleFill + recordLength + UAVTALK_CHECKSUM_LENGTH > connection->bundleLength) {
+        flushBundle(connection);
+    }
+
+    uint8_t *pos = &connection->bundleBuffer[connection->bundleFill];
+    *pos++ = instId ? (type | UAVTALK_BUNDLE_INSTID) : type;
+    *pos++ = (uint8_t)(objId & 0xFF);
+    *pos++ = (uint8_t)((objId >> 8) & 0xFF);
+    *pos++ = (uint8_t)((objId >> 16) & 0xFF);
+    *pos++ = (uint8_t)((objId >> 24) & 0xFF);
+    if (instId) {
+        *pos++ = (uint8_t)(instId & 0xFF);
+        *pos++ = (uint8_t)((instId >> 8) & 0xFF);
+    }
+    *pos++ = (uint8_t)length;
+    memcpy(pos, data, length);
+
+    connection->bundleFill += recordLength;
+    connection->bundleCount++;
+    return 0;
+}
+
+/**
+ * Send the records collected in the bundle, if any. A single record
+ * goes out as the packet it was, which is smaller.
+ * \param[in] connection UAVTalkConnection to be used
+ * \return 0 Success
+ * \return -1 Failure
+ */
+static int32_t flushBundle(UAVTalkConnectionData *connection)
+{
+    uint8_t *buffer = connection->bundleBuffer;
+    uint16_t length = connection->bundleFill;
+
+    if (connection->bundleCount == 0) {
+        return 0;
+    }
+
+    if (connection->bundleCount == 1) {
+        uint8_t type = buffer[UAVTALK_MIN_HEADER_LENGTH];
+        uint16_t recordHeaderLength = UAVTALK_BUNDLE_RECORD_LENGTH + ((type & UAVTALK_BUNDLE_INSTID) ? 2 : 0);
+        buffer[1] = type & ~UAVTALK_BUNDLE_INSTID;
+        memmove(&buffer[4], &buffer[UAVTALK_MIN_HEADER_LENGTH + 1], 4);
+        if (type & UAVTALK_BUNDLE_INSTID) {
+            buffer[8] = buffer[UAVTALK_MIN_HEADER_LENGTH + 5];
+            buffer[9] = buffer[UAVTALK_MIN_HEADER_LENGTH + 6];
+        } else {
+            buffer[8] = 0;
+            buffer[9] = 0;
+        }
+        length -= recordHeaderLength;
+        memmove(&buffer[UAVTALK_MIN_HEADER_LENGTH], &buffer[UAVTALK_MIN_HEADER_LENGTH + recordHeaderLength], length - UAVTALK_MIN_HEADER_LENGTH);
+    } else {
+        buffer[1] = UAVTALK_TYPE_BUNDLE;
+        buffer[4] = (uint8_t)(UAVTALK_BUNDLE_OBJID & 0xFF);
+        buffer[5] = (uint8_t)((UAVTALK_BUNDLE_OBJID >> 8) & 0xFF);
+        buffer[6] = (uint8_t)((UAVTALK_BUNDLE_OBJID >> 16) & 0xFF);
+        buffer[7] = (uint8_t)((UAVTALK_BUNDLE_OBJID >> 24) & 0xFF);
+        buffer[8] = connection->bundleCount;
+        buffer[9] = 0;
+    }
+    buffer[0] = UAVTALK_SYNC_VAL;
+    buffer[2] = (uint8_t)(length & 0xFF);
+    buffer[3] = (uint8_t)((length >> 8) & 0xFF);
+    buffer[length] = PIOS_CRC_updateCRC(0, buffer, length);
+
+    connection->bundleFill  = UAVTALK_MIN_HEADER_LENGTH;
+    connection->bundleCount = 0;
+
+    if (!connection->outStream) {
+        connection->stats.txErrors++;
+        return -1;
+    }
+
+    uint16_t tx_msg_len = length + UAVTALK_CHECKSUM_LENGTH;
+    int32_t rc = (*connection->outStream)(buffer, tx_msg_len);
+
+    if (rc != tx_msg_len) {
+        connection->stats.txErrors++;
+        connection->stats.txBytes += (rc > 0) ? rc : 0;
+        return -1;
+    }
+    connection->stats.txBytes += tx_msg_len;
+    return 0;
+}
+
+/**
+ * Receive the records of a bundle, each as the packet it stands for.
+ * \param[in] connection UAVTalkConnection to be used
+ * \param[in] data The bundle payload
+ * \param[in] length The payload length
+ * \return 0 Success
+ * \return -1 Failure, of any of the records
+ */
+static int32_t receiveBundle(UAVTalkConnectionData *connection, uint8_t *data, int32_t length)
+{
+    uint8_t *end = data + length;
+    int32_t ret  = 0;
+    uint16_t records = 0;
+
+    while (data < end) {
+        if (end - data < UAVTALK_BUNDLE_RECORD_LENGTH) {
+            return -1;
+        }
+        uint8_t type   = *data++;
+        uint32_t objId = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+        uint16_t instId = 0;
+        data += 4;
+        if (type & UAVTALK_BUNDLE_INSTID) {
+            if (end - data < 3) {
+                return -1;
+            }
+            instId = data[0] | (data[1] << 8);
+            data  += 2;
+            type  &= ~UAVTALK_BUNDLE_INSTID;
+        }
+        uint8_t recordLength = *data++;
+        if (end - data < recordLength) {
+            return -1;
+        }
+
+        UAVObjHandle obj = UAVObjGetByID(objId);
+        if ((type == UAVTALK_TYPE_OBJ && obj && UAVObjGetNumBytes(obj) == recordLength) || type == UAVTALK_TYPE_OBJ_DELTA) {
+            if (receiveObject(connection, type, objId, instId, data, recordLength) != 0) {
+                ret = -1;
+            }
+        } else {
+            ret = -1;
+        }
+        data += recordLength;
+        records++;
+    }
+
+    // The frame itself was counted as one object
+    if (records > 1) {
+        connection->stats.rxObjects += records - 1;
+    }
+    return ret;
+}
+
 /**
  * @}
  * @}
@@ -0,0 +1,19 @@
+#
+# Command line export of OpenPilot logs to per-object CSV and NumPy files.
+# Copyright (c) 2014, The OpenPilot Team, http://www.openpilot.org
+#
+
+QT += widgets network concurrent
+TARGET = logexport
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+include(../../../../openpilotgcs.pri)
+LIBS += -L$$GCS_PLUGIN_PATH/OpenPilot
+INCLUDEPATH += $$GCS_SOURCE_TREE/src/plugins
+include(../../../plugins/uavtalk/uavtalk.pri)
+
+SOURCES += main.cpp \
+    logexporter.cpp
+HEADERS += logexporter.h
@@ -0,0 +1,470 @@
+/**
+ ******************************************************************************
+ *
+ * @file       logexporter.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Parallel export of .opl and .oplz logs to per-object column files
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "logexporter.h"
+
+#include "uavtalk/uavtalk.h"
+#include "uavobjects/uavobjectmanager.h"
+#include "uavobjects/uavobjectsinit.h"
+#include "uavobjects/uavdataobject.h"
+#include <utils/logfile.h>
+
+#include <QDir>
+#include <QDebug>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+// Each record is a quint32 timestamp, a qint64 size and the data
+#define RECORD_HEADER_SIZE 12
+#define MAX_RECORD_SIZE    (1024 * 1024)
+
+// Parts per thread, so that a slow part does not hold the others back
+#define CHUNKS_PER_THREAD  4
+
+ChunkWriter::ChunkWriter(const QString &partPath) : m_partPath(partPath), m_timeStamp(0)
+{}
+
+ChunkWriter::~ChunkWriter()
+{
+    qDeleteAll(m_tables);
+}
+
+ChunkWriter::Table *ChunkWriter::table(UAVObject *obj)
+{
+    Table *table = m_tables.value(obj->getObjID());
+
+    if (table) {
+        return table;
+    }
+
+    table = new Table;
+    table->name = obj->getName();
+    table->rows = 0;
+    table->columns << "timestamp" << "instance";
+    foreach(UAVObjectField * field, obj->getFields()) {
+        if (field->getType() == UAVObjectField::STRING) {
+            continue;
+        }
+        QStringList names = field->getElementNames();
+        for (quint32 n = 0; n < field->getNumElements(); n++) {
+            if (field->getNumElements() == 1) {
+                table->columns << field->getName();
+            } else {
+                table->columns << field->getName() + "." + (n < (quint32)names.size() ? names[n] : QString::number(n));
+            }
+        }
+        table->options << (field->getType() == UAVObjectField::ENUM ? field->getOptions() : QStringList());
+    }
+    m_tables.insert(obj->getObjID(), table);
+    return table;
+}
+
+void ChunkWriter::newInstance(UAVObject *obj)
+{
+    connect(obj, SIGNAL(objectUnpacked(UAVObject *)), this, SLOT(objectUnpacked(UAVObject *)));
+}
+
+/**
+ * Append one row: the timestamp, the instance and every element of every
+ * field but strings. Enums are their option index in the values and their
+ * option name in the CSV.
+ */
+void ChunkWriter::objectUnpacked(UAVObject *obj)
+{
+    Table *table = this->table(obj);
+
+    m_row.resize(table->columns.size());
+    m_row[0] = m_timeStamp;
+    m_row[1] = obj->getInstID();
+    table->csv.append(QByteArray::number(m_timeStamp)).append(',').append(QByteArray::number(obj->getInstID()));
+
+    int column = 2;
+    int fieldIndex = 0;
+    quint8 options[256];
+    foreach(UAVObjectField * field, obj->getFields()) {
+        UAVObjectField::FieldType type = field->getType();
+        if (type == UAVObjectField::STRING) {
+            continue;
+        }
+        quint32 count = field->getNumElements();
+        if (type == UAVObjectField::ENUM) {
+            const QStringList &names = table->options[fieldIndex];
+            count = field->getElements(options, 0, qMin(count, (quint32)sizeof(options)));
+            for (quint32 n = 0; n < count; n++) {
+                m_row[column + n] = options[n];
+                table->csv.append(',').append(options[n] < names.size() ? names[options[n]].toUtf8() : QByteArray::number(options[n]));
+            }
+        } else {
+            count = field->getDoubles(m_row.data() + column, 0, count);
+            for (quint32 n = 0; n < count; n++) {
+                table->csv.append(',').append(QByteArray::number(m_row[column + n], 'g', 9));
+            }
+        }
+        column += field->getNumElements();
+        fieldIndex++;
+    }
+    table->csv.append('\n');
+    table->values.append((const char *)m_row.constData(), m_row.size() * sizeof(double));
+    table->rows++;
+
+    if (table->values.size() >= BUFFER_SIZE) {
+        flush(table);
+    }
+}
+
+void ChunkWriter::flush(Table *table)
+{
+    QFile csv(m_partPath.arg(table->name, "csv"));
+    QFile values(m_partPath.arg(table->name, "bin"));
+
+    if (csv.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        csv.write(table->csv);
+    }
+    if (values.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        values.write(table->values);
+    }
+    table->csv.clear();
+    table->values.clear();
+}
+
+void ChunkWriter::flush()
+{
+    foreach(Table * table, m_tables) {
+        flush(table);
+    }
+}
+
+QMap<QString, qint64> ChunkWriter::rows() const
+{
+    QMap<QString, qint64> rows;
+
+    foreach(const Table * table, m_tables) {
+        rows.insert(table->name, table->rows);
+    }
+    return rows;
+}
+
+QMap<QString, QStringList> ChunkWriter::columns() const
+{
+    QMap<QString, QStringList> columns;
+
+    foreach(const Table * table, m_tables) {
+        columns.insert(table->name, table->columns);
+    }
+    return columns;
+}
+
+LogExporter::LogExporter(const QString &outputPath, int threads) :
+    m_outputPath(outputPath), m_threads(qMax(threads, 1)), m_data(NULL),
+    m_compressed(false), m_bytes(0), m_records(0), m_rows(0)
+{}
+
+/**
+ * Hand the records in [begin, end) of data to UAVTalk one by one,
+ * returns the number of records.
+ */
+static qint64 exportRecords(const uchar *data, qint64 begin, qint64 end, ChunkWriter &writer, RecordDevice &device, UAVTalk &talk)
+{
+    qint64 records = 0;
+
+    for (qint64 pos = begin; pos < end;) {
+        quint32 timeStamp;
+        qint64 dataSize;
+        memcpy(&timeStamp, data + pos, sizeof(timeStamp));
+        memcpy(&dataSize, data + pos + sizeof(timeStamp), sizeof(dataSize));
+
+        writer.setTimeStamp(timeStamp);
+        device.setRecord((const char *)data + pos + RECORD_HEADER_SIZE, dataSize);
+        QMetaObject::invokeMethod(&talk, "processInputStream", Qt::DirectConnection);
+        pos += RECORD_HEADER_SIZE + dataSize;
+        records++;
+    }
+    return records;
+}
+
+/**
+ * Offsets splitting the valid records of the log in about equal parts,
+ * the last one being the end of the last valid record.
+ */
+QList<qint64> LogExporter::splitLog(qint64 size, int chunks)
+{
+    QList<qint64> bounds;
+    qint64 chunkSize = qMax(size / chunks, (qint64)1);
+    qint64 pos = 0;
+
+    bounds << 0;
+    while (pos + RECORD_HEADER_SIZE <= size) {
+        qint64 dataSize;
+        memcpy(&dataSize, m_data + pos + sizeof(quint32), sizeof(dataSize));
+        if (dataSize < 1 || dataSize > MAX_RECORD_SIZE || pos + RECORD_HEADER_SIZE + dataSize > size) {
+            qDebug() << "Log corrupted at" << pos << ", exporting up to there";
+            break;
+        }
+        pos += RECORD_HEADER_SIZE + dataSize;
+        if (pos >= bounds.last() + chunkSize) {
+            bounds << pos;
+        }
+    }
+    if (bounds.last() != pos) {
+        bounds << pos;
+    }
+    return bounds;
+}
+
+/**
+ * Block numbers splitting a compressed log in about equal parts, the last one
+ * being the number of blocks.
+ */
+QList<qint64> LogExporter::splitBlocks(int chunks)
+{
+    QList<qint64> bounds;
+    qint64 blocks = m_blockReader.blockCount();
+
+    chunks = (int)qMin((qint64)chunks, blocks);
+    bounds << 0;
+    for (int chunk = 1; chunk <= chunks; chunk++) {
+        bounds << blocks * chunk / chunks;
+    }
+    return bounds;
+}
+
+/**
+ * Decode the records between begin and end, offsets into a legacy log or block
+ * numbers of a compressed one, with an object manager of its own. Runs on a
+ * pool thread, which also decompresses the blocks.
+ */
+LogExporter::ChunkResult LogExporter::exportChunk(int chunk, qint64 begin, qint64 end)
+{
+    UAVObjectManager objManager;
+
+    UAVObjectsInitialize(&objManager);
+
+    RecordDevice device;
+    UAVTalk talk(&device, &objManager);
+    ChunkWriter writer(m_outputPath + "/.parts/%1." + QString::number(chunk) + ".%2");
+    foreach(QList<UAVObject *> instances, objManager.getObjects()) {
+        foreach(UAVObject * obj, instances) {
+            writer.newInstance(obj);
+        }
+    }
+    QObject::connect(&objManager, SIGNAL(newInstance(UAVObject *)), &writer, SLOT(newInstance(UAVObject *)));
+
+    ChunkResult result;
+    result.records = 0;
+    if (m_compressed) {
+        for (qint64 block = begin; block < end; block++) {
+            QByteArray records = m_blockReader.blockRecords((int)block);
+            if (records.isEmpty()) {
+                qDebug() << "Log corrupted in block" << block << ", skipping the rest of part" << chunk;
+                break;
+            }
+            result.records += exportRecords((const uchar *)records.constData(), 0, records.size(), writer, device, talk);
+        }
+    } else {
+        result.records = exportRecords(m_data, begin, end, writer, device, talk);
+    }
+    writer.flush();
+    result.rows    = writer.rows();
+    result.columns = writer.columns();
+    return result;
+}
+
+/**
+ * Concatenate the parts of an object in log order into <name>.csv and
+ * <name>.npy, the column names of the latter going to <name>.columns.
+ */
+bool LogExporter::mergeParts(const QString &name, const QStringList &columns, qint64 rows, int chunks)
+{
+    QDir dir(m_outputPath);
+    QFile csv(dir.filePath(name + ".csv"));
+    QFile npy(dir.filePath(name + ".npy"));
+    QFile names(dir.filePath(name + ".columns"));
+
+    if (!csv.open(QIODevice::WriteOnly | QIODevice::Truncate) || !npy.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || !names.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Unable to write the files of" << name;
+        return false;
+    }
+    csv.write(columns.join(",").toUtf8() + "\n");
+    names.write(columns.join("\n").toUtf8() + "\n");
+
+    // NPY 1.0, the header is padded with spaces so that the data is aligned
+    QByteArray header = QString("{'descr': '<f8', 'fortran_order': False, 'shape': (%1, %2), }")
+                        .arg(rows).arg(columns.size()).toLatin1();
+    int headerSize    = 10 + header.size() + 1;
+    header.append(QByteArray((64 - headerSize % 64) % 64, ' ')).append('\n');
+    quint16 headerLength = header.size();
+    npy.write("\x93NUMPY\x01\x00", 8);
+    npy.write((const char *)&headerLength, sizeof(headerLength));
+    npy.write(header);
+
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        QString part = dir.filePath(QString(".parts/%1.%2.").arg(name).arg(chunk));
+        QFile csvPart(part + "csv");
+        QFile valuesPart(part + "bin");
+        if (csvPart.open(QIODevice::ReadOnly)) {
+            while (!csvPart.atEnd()) {
+                csv.write(csvPart.read(1024 * 1024));
+            }
+            csvPart.remove();
+        }
+        if (valuesPart.open(QIODevice::ReadOnly)) {
+            while (!valuesPart.atEnd()) {
+                npy.write(valuesPart.read(1024 * 1024));
+            }
+            valuesPart.remove();
+        }
+    }
+    return true;
+}
+
+bool LogExporter::exportLog(const QString &fileName)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Unable to open" << fileName;
+        return false;
+    }
+    qint64 size = file.size();
+    m_data = file.map(0, size);
+    if (!m_data) {
+        qWarning() << "Unable to map" << fileName;
+        return false;
+    }
+    m_compressed = size >= 4 && memcmp(m_data, "OPLZ", 4) == 0;
+    if (m_compressed && !m_blockReader.open(m_data, size)) {
+        qWarning() << "Unable to read" << fileName;
+        file.unmap((uchar *)m_data);
+        return false;
+    }
+
+    QDir dir;
+    if (!dir.mkpath(m_outputPath + "/.parts")) {
+        qWarning() << "Unable to create" << m_outputPath;
+        file.unmap((uchar *)m_data);
+        return false;
+    }
+
+    // Records cannot be split, parts start and end on record boundaries, or
+    // on block boundaries for compressed logs
+    QList<qint64> bounds = m_compressed ? splitBlocks(m_threads * CHUNKS_PER_THREAD)
+                           : splitLog(size, m_threads * CHUNKS_PER_THREAD);
+    int chunks = bounds.size() - 1;
+    QThreadPool::globalInstance()->setMaxThreadCount(m_threads);
+
+    QList<QFuture<ChunkResult> > futures;
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        futures << QtConcurrent::run(this, &LogExporter::exportChunk, chunk, bounds[chunk], bounds[chunk + 1]);
+    }
+
+    QMap<QString, qint64> rows;
+    QMap<QString, QStringList> columns;
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        ChunkResult result = futures[chunk].result();
+        m_records += result.records;
+        QMapIterator<QString, qint64> i(result.rows);
+        while (i.hasNext()) {
+            i.next();
+            rows[i.key()] += i.value();
+        }
+        columns.unite(result.columns);
+    }
+    if (m_compressed) {
+        for (int block = 0; block < m_blockReader.blockCount(); block++) {
+            m_bytes += m_blockReader.blockRawSize(block);
+        }
+    } else {
+        m_bytes = bounds.last();
+    }
+    file.unmap((uchar *)m_data);
+    m_data  = NULL;
+
+    bool ok = true;
+    foreach(QString name, rows.keys()) {
+        ok &= mergeParts(name, columns.value(name), rows.value(name), chunks);
+        m_rows += rows.value(name);
+    }
+    dir.rmdir(m_outputPath + "/.parts");
+    return ok;
+}
+
+/**
+ * Write a log of about size bytes of made up updates of the usual telemetry
+ * objects, to measure the export throughput.
+ */
+bool LogExporter::generateLog(const QString &fileName, qint64 size)
+{
+    static const char *const names[] = {
+        "AttitudeState", "GyroState",       "AccelState",    "MagState", "BaroSensor",
+        "PositionState", "VelocityState",   "ActuatorCommand", "ManualControlCommand",
+        "FlightStatus",  "StabilizationDesired", "SystemStats", "FlightTelemetryStats"
+    };
+
+    UAVObjectManager objManager;
+
+    UAVObjectsInitialize(&objManager);
+
+    QList<UAVObject *> objects;
+    for (unsigned int n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+        UAVObject *obj = objManager.getObject(QString(names[n]));
+        if (obj) {
+            objects << obj;
+        }
+    }
+    if (objects.isEmpty()) {
+        return false;
+    }
+
+    LogFile logFile;
+    logFile.setFileName(fileName);
+    logFile.useProvidedTimeStamp(true);
+    if (!logFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    UAVTalk talk(&logFile, &objManager);
+    QByteArray data;
+    quint32 timeStamp = 0;
+    qint64 written    = 0;
+    qsrand(1);
+    while (written < size) {
+        foreach(UAVObject * obj, objects) {
+            data.resize(obj->getNumBytes());
+            for (int n = 0; n < data.size(); n++) {
+                data[n] = (char)(qrand() & 0xFF);
+            }
+            obj->unpack((const quint8 *)data.constData());
+            logFile.setNextTimeStamp(timeStamp);
+            talk.sendObject(obj, false, false);
+            // Record header, UAVTalk header, data and CRC
+            written += RECORD_HEADER_SIZE + 10 + obj->getNumBytes() + 1;
+        }
+        timeStamp += 2;
+    }
+    logFile.close();
+    return true;
+}
@@ -0,0 +1,175 @@
+/**
+ ******************************************************************************
+ *
+ * @file       logexporter.h
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Parallel export of .opl and .oplz logs to per-object column files
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef LOGEXPORTER_H
+#define LOGEXPORTER_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QFile>
+#include <QMap>
+#include <QHash>
+#include <QStringList>
+#include <utils/logfile.h>
+
+class UAVObject;
+class UAVObjectField;
+
+/**
+ * A log record handed to UAVTalk as if it came from a device
+ */
+class RecordDevice : public QIODevice {
+public:
+    RecordDevice() : m_data(NULL), m_size(0), m_pos(0)
+    {
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    void setRecord(const char *data, qint64 size)
+    {
+        m_data = data;
+        m_size = size;
+        m_pos  = 0;
+    }
+
+    qint64 bytesAvailable() const
+    {
+        return m_size - m_pos + QIODevice::bytesAvailable();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        qint64 size = qMin(maxSize, m_size - m_pos);
+
+        memcpy(data, m_data + m_pos, size);
+        m_pos += size;
+        return size;
+    }
+
+    // Nothing is sent back to a log
+    qint64 writeData(const char *data, qint64 size)
+    {
+        Q_UNUSED(data);
+        return size;
+    }
+
+private:
+    const char *m_data;
+    qint64 m_size;
+    qint64 m_pos;
+};
+
+/**
+ * Collects the unpacked objects of one part of a log, row by row, and appends
+ * them to per-object part files as CSV lines and native doubles.
+ */
+class ChunkWriter : public QObject {
+    Q_OBJECT
+
+public:
+    ChunkWriter(const QString &partPath);
+    ~ChunkWriter();
+
+    void setTimeStamp(quint32 timeStamp)
+    {
+        m_timeStamp = timeStamp;
+    }
+    void flush();
+
+    // Per object name
+    QMap<QString, qint64> rows() const;
+    QMap<QString, QStringList> columns() const;
+
+public slots:
+    void objectUnpacked(UAVObject *obj);
+    void newInstance(UAVObject *obj);
+
+private:
+    // Flush the buffers of an object past this size
+    static const int BUFFER_SIZE = 1024 * 1024;
+
+    struct Table {
+        QString name;
+        QStringList columns;
+        // The option names of each enum field, empty for the other fields
+        QList<QStringList> options;
+        qint64 rows;
+        QByteArray csv;
+        QByteArray values;
+    };
+
+    QString m_partPath;
+    quint32 m_timeStamp;
+    QHash<quint32, Table *> m_tables;
+    QVector<double> m_row;
+
+    Table *table(UAVObject *obj);
+    void flush(Table *table);
+};
+
+class LogExporter {
+public:
+    LogExporter(const QString &outputPath, int threads);
+
+    bool exportLog(const QString &fileName);
+    static bool generateLog(const QString &fileName, qint64 size);
+
+    qint64 bytes() const
+    {
+        return m_bytes;
+    }
+    qint64 records() const
+    {
+        return m_records;
+    }
+    qint64 rows() const
+    {
+        return m_rows;
+    }
+
+private:
+    struct ChunkResult {
+        qint64 records;
+        QMap<QString, qint64> rows;
+        QMap<QString, QStringList> columns;
+    };
+
+    QString m_outputPath;
+    int m_threads;
+    const uchar *m_data;
+    bool m_compressed;
+    LogFile::BlockReader m_blockReader;
+    qint64 m_bytes;
+    qint64 m_records;
+    qint64 m_rows;
+
+    QList<qint64> splitLog(qint64 size, int chunks);
+    QList<qint64> splitBlocks(int chunks);
+    ChunkResult exportChunk(int chunk, qint64 begin, qint64 end);
+    bool mergeParts(const QString &name, const QStringList &columns, qint64 rows, int chunks);
+};
+
+#endif // LOGEXPORTER_H
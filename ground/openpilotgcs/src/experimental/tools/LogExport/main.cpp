@@ -0,0 +1,84 @@
+/**
+ ******************************************************************************
+ *
+ * @file       main.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Headless export of .opl and .oplz logs to CSV and NumPy files
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QThread>
+#include <stdio.h>
+#include "logexporter.h"
+
+static int usage()
+{
+    fprintf(stderr, "Usage: logexport [-j threads] <log.opl|log.oplz> <output directory>\n"
+            "       logexport --generate <MB> <log.opl>\n"
+            "Writes <Object>.csv, <Object>.npy and <Object>.columns for each object in the log.\n");
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments().mid(1);
+    int threads = QThread::idealThreadCount();
+
+    if (args.size() == 3 && args[0] == "--generate") {
+        bool ok;
+        qint64 size = args[1].toLongLong(&ok) * 1024 * 1024;
+        if (!ok || size <= 0) {
+            return usage();
+        }
+        if (!LogExporter::generateLog(args[2], size)) {
+            fprintf(stderr, "Unable to write %s\n", qPrintable(args[2]));
+            return 1;
+        }
+        return 0;
+    }
+
+    if (args.size() > 2 && args[0] == "-j") {
+        bool ok;
+        threads = args[1].toInt(&ok);
+        if (!ok || threads < 1) {
+            return usage();
+        }
+        args = args.mid(2);
+    }
+    if (args.size() != 2) {
+        return usage();
+    }
+
+    LogExporter exporter(args[1], threads);
+    QElapsedTimer timer;
+    timer.start();
+    if (!exporter.exportLog(args[0])) {
+        return 1;
+    }
+    double seconds = qMax(timer.elapsed(), (qint64)1) / 1000.0;
+
+    printf("%lld bytes, %lld records, %lld rows in %.2f s with %d threads\n",
+           exporter.bytes(), exporter.records(), exporter.rows(), seconds, threads);
+    printf("%.1f MB/s, %.0f records/s, %.0f rows/s\n",
+           exporter.bytes() / seconds / (1024 * 1024), exporter.records() / seconds, exporter.rows() / seconds);
+    return 0;
+}
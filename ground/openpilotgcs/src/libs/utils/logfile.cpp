@@ -1,16 +1,72 @@
 #include "logfile.h"
+#include "crc.h"
 #include <QDebug>
 #include <QtGlobal>
+#include <QtEndian>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+
+#define LOG_VERSION          1
+#define LOG_HEADER_SIZE      12
+#define BLOCK_HEADER_SIZE    24
+#define INDEX_ENTRY_SIZE     16
+
+// GCS logs hold one UAVTalk packet per record
+#define UAVTALK_SYNC_VAL     0x3C
+#define UAVTALK_HEADER_SIZE  10
+
+static void appendUInt32(QByteArray &array, quint32 value)
+{
+    uchar bytes[sizeof(value)];
+
+    qToLittleEndian<quint32>(value, bytes);
+    array.append((const char *)bytes, sizeof(bytes));
+}
+
+static void appendUInt64(QByteArray &array, quint64 value)
+{
+    uchar bytes[sizeof(value)];
+
+    qToLittleEndian<quint64>(value, bytes);
+    array.append((const char *)bytes, sizeof(bytes));
+}
+
+static quint32 recordTimeStamp(const uchar *record)
+{
+    quint32 timeStamp;
+
+    memcpy(&timeStamp, record, sizeof(timeStamp));
+    return timeStamp;
+}
+
+static qint64 recordSize(const uchar *record)
+{
+    qint64 dataSize;
+
+    memcpy(&dataSize, record + sizeof(quint32), sizeof(dataSize));
+    return dataSize;
+}
 
 LogFile::LogFile(QObject *parent) :
     QIODevice(parent),
-    m_lastTimeStamp(0),
-    m_lastPlayed(0),
-    m_timeOffset(0),
+    m_dataBufferPos(0),
     m_playbackSpeed(1.0),
     m_nextTimeStamp(0),
-    m_useProvidedTimeStamp(false)
+    m_useProvidedTimeStamp(false),
+    m_replayData(NULL),
+    m_replaySize(0),
+    m_replayPos(0),
+    m_replayTime(0),
+    m_lastTick(0),
+    m_firstTimeStamp(0),
+    m_lastTimeStamp(0),
+    m_compressed(false),
+    m_blockFirstTimeStamp(0),
+    m_blockLastTimeStamp(0),
+    m_blockRecords(0),
+    m_blockBytesToWrite(0)
 {
+    m_blockCache.setMaxCost(BLOCK_CACHE_SIZE);
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(timerFired()));
 }
 
@@ -36,8 +92,9 @@ bool LogFile::open(OpenMode mode)
         return false;
     }
 
-    // TODO: Write a header at the beginng describing objects so that in future
-    // they can be read back if ID's change
+    if (m_compressed && m_file.isWritable()) {
+        writeHeader();
+    }
 
     // Must call parent function for QIODevice to pass calls to writeData
     // We always open ReadWrite, because otherwise we will get tons of warnings
@@ -54,6 +111,12 @@ void LogFile::close()
     if (m_timer.isActive()) {
         m_timer.stop();
     }
+    if (m_compressed && m_file.isWritable()) {
+        flushBlock();
+        m_blockWrite.waitForFinished();
+        writeIndex();
+    }
+    releaseReplayData();
     m_file.close();
     QIODevice::close();
 }
@@ -68,6 +131,21 @@ qint64 LogFile::writeData(const char *data, qint64 dataSize)
     // This is used when saving logs from on-board logging
     quint32 timeStamp = m_useProvidedTimeStamp ? m_nextTimeStamp : m_myTime.elapsed();
 
+    if (m_compressed) {
+        if (m_blockRecords++ == 0) {
+            m_blockFirstTimeStamp = timeStamp;
+        }
+        m_blockLastTimeStamp = timeStamp;
+        m_block.append((const char *)&timeStamp, sizeof(timeStamp));
+        m_block.append((const char *)&dataSize, sizeof(dataSize));
+        m_block.append(data, dataSize);
+        if (m_block.size() >= BLOCK_SIZE) {
+            flushBlock();
+        }
+        emit bytesWritten(dataSize);
+        return dataSize;
+    }
+
     m_file.write((char *)&timeStamp, sizeof(timeStamp));
     m_file.write((char *)&dataSize, sizeof(dataSize));
 
@@ -82,89 +160,305 @@ qint64 LogFile::writeData(const char *data, qint64 dataSize)
 qint64 LogFile::readData(char *data, qint64 maxSize)
 {
     QMutexLocker locker(&m_mutex);
-    qint64 toRead = qMin(maxSize, (qint64)m_dataBuffer.size());
+    qint64 toRead = qMin(maxSize, (qint64)(m_dataBuffer.size() - m_dataBufferPos));
 
-    memcpy(data, m_dataBuffer.data(), toRead);
-    m_dataBuffer.remove(0, toRead);
+    memcpy(data, m_dataBuffer.constData() + m_dataBufferPos, toRead);
+    m_dataBufferPos += toRead;
+    if (m_dataBufferPos == m_dataBuffer.size()) {
+        m_dataBuffer.clear();
+        m_dataBufferPos = 0;
+    }
     return toRead;
 }
 
 qint64 LogFile::bytesAvailable() const
 {
-    return m_dataBuffer.size();
+    return m_dataBuffer.size() - m_dataBufferPos;
 }
 
-void LogFile::timerFired()
+qint64 LogFile::bytesToWrite()
 {
-    qint64 dataSize;
+    if (m_compressed && m_file.isWritable()) {
+        // The file is written from a pool thread, ask it what it has left
+        QMutexLocker locker(&m_blockWriteMutex);
+        return m_blockBytesToWrite;
+    }
+    return m_file.bytesToWrite();
+}
 
-    if (m_file.bytesAvailable() > 4) {
-        int time;
-        time = m_myTime.elapsed();
+/**
+ * The record at pos, NULL if it is in a corrupted block, replay then ends
+ * before that block.
+ */
+const uchar *LogFile::replayRecord(qint64 pos)
+{
+    if (m_blockStart.isEmpty()) {
+        return m_replayData + pos;
+    }
 
-        // TODO: going back in time will be a problem
-        while ((m_lastPlayed + ((time - m_timeOffset) * m_playbackSpeed) > m_lastTimeStamp)) {
-            m_lastPlayed += ((time - m_timeOffset) * m_playbackSpeed);
-            if (m_file.bytesAvailable() < (qint64)sizeof(dataSize)) {
-                stopReplay();
-                return;
-            }
+    int block = std::upper_bound(m_blockStart.constBegin(), m_blockStart.constEnd(), pos) - m_blockStart.constBegin() - 1;
+    QByteArray *records = m_blockCache.object(block);
+    if (!records) {
+        records = new QByteArray(m_blockReader.blockRecords(block));
+        if (records->isEmpty()) {
+            delete records;
+            qDebug() << "Error: Logfile corrupted! Replay ends at block" << block;
+            m_replaySize    = m_blockStart[block];
+            m_lastTimeStamp = block > 0 ? m_blockReader.blockLastTimeStamp(block - 1) : m_firstTimeStamp;
+            return NULL;
+        }
+        m_blockCache.insert(block, records);
+    }
+    return (const uchar *)records->constData() + pos - m_blockStart[block];
+}
 
-            m_file.read((char *)&dataSize, sizeof(dataSize));
+/**
+ * Walk the record headers once, checking them and indexing the offset
+ * of the first record of each INDEX_INTERVAL. Replay ends at the first
+ * corrupted or truncated record.
+ */
+void LogFile::buildIndex(qint64 fileSize)
+{
+    qint64 pos = 0;
 
-            if (dataSize < 1 || dataSize > (1024 * 1024)) {
-                qDebug() << "Error: Logfile corrupted! Unlikely packet size: " << dataSize << "\n";
-                stopReplay();
-                return;
-            }
+    m_index.clear();
+    m_firstTimeStamp = 0;
+    m_lastTimeStamp  = 0;
+    while (pos + RECORD_HEADER_SIZE <= fileSize) {
+        quint32 timeStamp = recordTimeStamp(m_replayData + pos);
+        qint64 dataSize   = recordSize(m_replayData + pos);
 
-            if (m_file.bytesAvailable() < dataSize) {
-                stopReplay();
-                return;
-            }
+        if (dataSize < 1 || dataSize > MAX_RECORD_SIZE) {
+            qDebug() << "Error: Logfile corrupted! Unlikely packet size: " << dataSize << "\n";
+            break;
+        }
+        if (pos + RECORD_HEADER_SIZE + dataSize > fileSize) {
+            break;
+        }
+        if (pos == 0) {
+            m_firstTimeStamp = timeStamp;
+            m_lastTimeStamp  = timeStamp;
+        } else if (timeStamp < m_lastTimeStamp // logfile goes back in time
+                   || (timeStamp - m_lastTimeStamp) > (60 * 60 * 1000)) { // gap of more than 60 minutes
+            qDebug() << "Error: Logfile corrupted! Unlikely timestamp " << timeStamp << " after " << m_lastTimeStamp << "\n";
+            break;
+        }
+        while ((qint64)m_index.size() * INDEX_INTERVAL <= (qint64)(timeStamp - m_firstTimeStamp)) {
+            m_index.append(pos);
+        }
+        m_lastTimeStamp = timeStamp;
+        pos += RECORD_HEADER_SIZE + dataSize;
+    }
+    m_replaySize = pos;
+}
 
-            m_mutex.lock();
-            m_dataBuffer.append(m_file.read(dataSize));
-            m_mutex.unlock();
+/**
+ * Lay the blocks of a compressed log end to end, their headers give the
+ * time span of the log without decompressing anything.
+ */
+void LogFile::indexBlocks()
+{
+    int count = m_blockReader.blockCount();
 
-            emit readyRead();
+    m_schema = m_blockReader.schema();
+    m_blockStart.clear();
+    m_blockStart.append(0);
+    for (int block = 0; block < count; block++) {
+        m_blockStart.append(m_blockStart.last() + m_blockReader.blockRawSize(block));
+    }
+    m_replaySize     = m_blockStart.last();
+    m_firstTimeStamp = count > 0 ? m_blockReader.blockFirstTimeStamp(0) : 0;
+    m_lastTimeStamp  = count > 0 ? m_blockReader.blockLastTimeStamp(count - 1) : 0;
+}
 
-            if (m_file.bytesAvailable() < (qint64)sizeof(m_lastTimeStamp)) {
-                stopReplay();
-                return;
-            }
+/**
+ * Offset of the first record with a timestamp at or after timeStamp. The index,
+ * or the block time spans for compressed logs, narrow the search to one
+ * INDEX_INTERVAL or one block whatever the length of the log.
+ */
+qint64 LogFile::findRecord(double timeStamp)
+{
+    qint64 pos;
 
-            int save = m_lastTimeStamp;
-            m_file.read((char *)&m_lastTimeStamp, sizeof(m_lastTimeStamp));
-            // some validity checks
-            if (m_lastTimeStamp < save // logfile goes back in time
-                || (m_lastTimeStamp - save) > (60 * 60 * 1000)) { // gap of more than 60 minutes)
-                qDebug() << "Error: Logfile corrupted! Unlikely timestamp " << m_lastTimeStamp << " after " << save << "\n";
-                stopReplay();
-                return;
+    if (timeStamp <= m_firstTimeStamp) {
+        return 0;
+    }
+    if (!m_blockStart.isEmpty()) {
+        // First block ending at or after timeStamp
+        int low  = 0;
+        int high = m_blockReader.blockCount();
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (m_blockReader.blockLastTimeStamp(middle) < timeStamp) {
+                low = middle + 1;
+            } else {
+                high = middle;
             }
+        }
+        if (low == m_blockReader.blockCount()) {
+            return m_replaySize;
+        }
+        pos = m_blockStart[low];
+    } else {
+        if (m_index.isEmpty()) {
+            return 0;
+        }
+        qint64 entry = (qint64)(timeStamp - m_firstTimeStamp) / INDEX_INTERVAL;
+        if (entry >= m_index.size()) {
+            return m_replaySize;
+        }
+        pos = m_index[entry];
+    }
+
+    const uchar *record;
+    while (pos < m_replaySize && (record = replayRecord(pos)) && recordTimeStamp(record) < timeStamp) {
+        pos += RECORD_HEADER_SIZE + recordSize(record);
+    }
+    return qMin(pos, m_replaySize);
+}
+
+/**
+ * Queue the data of the records in [from, to) for reading, in file order.
+ */
+void LogFile::playRecords(qint64 from, qint64 to)
+{
+    if (from >= to) {
+        return;
+    }
+
+    m_mutex.lock();
+    if (m_dataBufferPos > 0) {
+        m_dataBuffer.remove(0, m_dataBufferPos);
+        m_dataBufferPos = 0;
+    }
+    for (qint64 pos = from; pos < to && pos < m_replaySize;) {
+        const uchar *record = replayRecord(pos);
+        if (!record) {
+            break;
+        }
+        int start = m_dataBuffer.size();
+        m_dataBuffer.append((const char *)record + RECORD_HEADER_SIZE, recordSize(record));
+        remapObjectId(m_dataBuffer.data() + start, recordSize(record));
+        pos += RECORD_HEADER_SIZE + recordSize(record);
+    }
+    m_mutex.unlock();
+
+    emit readyRead();
+}
+
+void LogFile::timerFired()
+{
+    int time = m_myTime.elapsed();
+    double step = (time - m_lastTick) * m_playbackSpeed;
+
+    m_lastTick = time;
+
+    if (step >= 0) {
+        // Play everything up to the new position
+        double target = m_replayTime + step;
+        qint64 pos    = m_replayPos;
+        const uchar *record;
+        while (pos < m_replaySize && (record = replayRecord(pos)) && recordTimeStamp(record) <= target) {
+            pos += RECORD_HEADER_SIZE + recordSize(record);
+        }
+        playRecords(m_replayPos, pos);
+        m_replayPos  = pos;
+        m_replayTime = qMin(target, (double)m_lastTimeStamp);
 
-            m_timeOffset = time;
-            time = m_myTime.elapsed();
+        if (m_replayPos >= m_replaySize) {
+            stopReplay();
+            return;
         }
     } else {
-        stopReplay();
+        // Going backwards, jump to the new position and play the step of log
+        // leading up to it, which leaves the objects as they were at that time
+        double target = qMax(m_replayTime + step, (double)m_firstTimeStamp);
+        seekTo(target);
+        playRecords(findRecord(target + step), m_replayPos);
+    }
+    emit replayPositionChanged(replayPosition());
+}
+
+/**
+ * Jump to a log time, the records in between are not played.
+ */
+void LogFile::seekReplay(quint32 timeStamp)
+{
+    if (!m_replayData) {
+        return;
     }
+
+    seekTo(qBound((double)m_firstTimeStamp, (double)timeStamp, (double)m_lastTimeStamp));
+    emit replayPositionChanged(replayPosition());
+}
+
+/**
+ * Move the replay position, dropping what was queued for the old one.
+ */
+void LogFile::seekTo(double timeStamp)
+{
+    m_replayTime = timeStamp;
+    m_replayPos  = findRecord(timeStamp);
+
+    // Whatever was queued belongs to the old position
+    m_mutex.lock();
+    m_dataBuffer.clear();
+    m_dataBufferPos = 0;
+    m_mutex.unlock();
 }
 
 bool LogFile::startReplay()
 {
     m_dataBuffer.clear();
+    m_dataBufferPos = 0;
+
+    releaseReplayData();
+    qint64 fileSize = m_file.size();
+    m_replayData = m_file.map(0, fileSize);
+    if (!m_replayData) {
+        qDebug() << "Unable to map" << m_file.fileName() << ", reading it instead";
+        m_replayCopy = m_file.readAll();
+        m_replayData = (const uchar *)m_replayCopy.constData();
+        fileSize     = m_replayCopy.size();
+    }
+
+    m_schema.clear();
+    m_objectIdMap.clear();
+    if (fileSize >= LOG_HEADER_SIZE && memcmp(m_replayData, "OPLZ", 4) == 0) {
+        if (!m_blockReader.open(m_replayData, fileSize)) {
+            releaseReplayData();
+            return false;
+        }
+        indexBlocks();
+    } else {
+        buildIndex(fileSize);
+    }
+
+    m_replayPos  = 0;
+    m_replayTime = m_firstTimeStamp;
     m_myTime.restart();
-    m_timeOffset = 0;
-    m_lastPlayed = 0;
-    m_file.read((char *)&m_lastTimeStamp, sizeof(m_lastTimeStamp));
+    m_lastTick   = 0;
     m_timer.setInterval(10);
     m_timer.start();
     emit replayStarted();
     return true;
 }
 
+void LogFile::releaseReplayData()
+{
+    if (m_replayData && m_replayData != (const uchar *)m_replayCopy.constData()) {
+        m_file.unmap((uchar *)m_replayData);
+    }
+    m_replayData = NULL;
+    m_replayCopy.clear();
+    m_blockReader = BlockReader();
+    m_blockStart.clear();
+    m_blockCache.clear();
+    m_index.clear();
+    m_replaySize = 0;
+    m_replayPos  = 0;
+}
+
 bool LogFile::stopReplay()
 {
     close();
@@ -179,6 +473,245 @@ void LogFile::pauseReplay()
 
 void LogFile::resumeReplay()
 {
-    m_timeOffset = m_myTime.elapsed();
+    m_lastTick = m_myTime.elapsed();
     m_timer.start();
 }
+
+/**
+ * Rewrite the object ID of a replayed packet, for logs written by another firmware
+ * version whose objects changed ID but not layout.
+ */
+void LogFile::remapObjectId(char *data, qint64 size)
+{
+    if (m_objectIdMap.isEmpty() || size <= UAVTALK_HEADER_SIZE || (quint8)data[0] != UAVTALK_SYNC_VAL) {
+        return;
+    }
+    quint16 length = qFromLittleEndian<quint16>((const uchar *)data + 2);
+    if (length < UAVTALK_HEADER_SIZE || length >= size) {
+        return;
+    }
+    QHash<quint32, quint32>::const_iterator i = m_objectIdMap.constFind(qFromLittleEndian<quint32>((const uchar *)data + 4));
+    if (i != m_objectIdMap.constEnd()) {
+        qToLittleEndian<quint32>(i.value(), (uchar *)data + 4);
+        data[length] = Utils::Crc::updateCRC(0, (const quint8 *)data, length);
+    }
+}
+
+void LogFile::writeHeader()
+{
+    QByteArray header("OPLZ");
+    QByteArray schema = m_schema.isEmpty() ? QByteArray() : qCompress(m_schema);
+
+    appendUInt32(header, LOG_VERSION);
+    appendUInt32(header, schema.size());
+    header.append(schema);
+    m_file.write(header);
+
+    m_block.clear();
+    m_blockRecords = 0;
+    m_blocks.clear();
+}
+
+/**
+ * Hand the filled block to a pool thread for compression. Only one block is in
+ * flight at a time, which keeps the blocks in order and bounds the memory used.
+ */
+void LogFile::flushBlock()
+{
+    if (m_blockRecords == 0) {
+        return;
+    }
+    m_blockWrite.waitForFinished();
+    m_blockWriteMutex.lock();
+    m_blockBytesToWrite = m_block.size();
+    m_blockWriteMutex.unlock();
+    m_blockWrite = QtConcurrent::run(this, &LogFile::writeBlock, m_block,
+                                     m_blockFirstTimeStamp, m_blockLastTimeStamp, m_blockRecords);
+    m_block.clear();
+    m_blockRecords = 0;
+}
+
+void LogFile::writeBlock(QByteArray block, quint32 firstTimeStamp, quint32 lastTimeStamp, quint32 records)
+{
+    QByteArray compressed = qCompress(block);
+    QByteArray header("OPLB");
+
+    appendUInt32(header, firstTimeStamp);
+    appendUInt32(header, lastTimeStamp);
+    appendUInt32(header, records);
+    appendUInt32(header, block.size());
+    appendUInt32(header, compressed.size());
+
+    BlockInfo info = { firstTimeStamp, lastTimeStamp, (quint64)m_file.pos() };
+    m_file.write(header);
+    m_file.write(compressed);
+    m_file.flush();
+    m_blocks.append(info);
+
+    QMutexLocker locker(&m_blockWriteMutex);
+    m_blockBytesToWrite = 0;
+}
+
+void LogFile::writeIndex()
+{
+    QByteArray index("OPLI");
+    quint64 indexOffset = m_file.pos();
+
+    appendUInt32(index, m_blocks.size());
+    foreach(const BlockInfo &info, m_blocks) {
+        appendUInt32(index, info.firstTimeStamp);
+        appendUInt32(index, info.lastTimeStamp);
+        appendUInt64(index, info.offset);
+    }
+    appendUInt64(index, indexOffset);
+    index.append("OPLE");
+    m_file.write(index);
+}
+
+LogFile::BlockReader::BlockReader() : m_data(NULL)
+{}
+
+/**
+ * Read the schema of a compressed log and find its blocks, through the index
+ * or by walking them when the log was not closed properly. Only the blocks
+ * whole in the file are kept.
+ */
+bool LogFile::BlockReader::open(const uchar *data, qint64 size)
+{
+    m_data = data;
+    m_schema.clear();
+    m_blocks.clear();
+
+    if (size < LOG_HEADER_SIZE || memcmp(data, "OPLZ", 4) != 0) {
+        qDebug() << "Error: not a compressed log";
+        return false;
+    }
+    quint32 version = qFromLittleEndian<quint32>(data + 4);
+    if (version != LOG_VERSION) {
+        qDebug() << "Unsupported log version" << version;
+        return false;
+    }
+    qint64 pos = LOG_HEADER_SIZE + (qint64)qFromLittleEndian<quint32>(data + 8);
+    if (pos > size) {
+        qDebug() << "Error: Logfile corrupted! Truncated schema";
+        return false;
+    }
+    if (pos > LOG_HEADER_SIZE) {
+        m_schema = qUncompress(data + LOG_HEADER_SIZE, pos - LOG_HEADER_SIZE);
+    }
+
+    QList<qint64> offsets;
+    qint64 end = size;
+    if (size >= pos + 12 && memcmp(data + size - 4, "OPLE", 4) == 0) {
+        quint64 indexOffset = qFromLittleEndian<quint64>(data + size - 12);
+        if (indexOffset >= (quint64)pos && indexOffset + 8 <= (quint64)size - 12
+            && memcmp(data + indexOffset, "OPLI", 4) == 0) {
+            quint32 count = qFromLittleEndian<quint32>(data + indexOffset + 4);
+            if (indexOffset + 8 + (quint64)count * INDEX_ENTRY_SIZE == (quint64)size - 12) {
+                for (quint32 n = 0; n < count; n++) {
+                    offsets.append(qFromLittleEndian<quint64>(data + indexOffset + 8 + n * INDEX_ENTRY_SIZE + 8));
+                }
+                end = indexOffset;
+            }
+        }
+    }
+    if (offsets.isEmpty()) {
+        while (pos + BLOCK_HEADER_SIZE <= size && memcmp(data + pos, "OPLB", 4) == 0) {
+            offsets.append(pos);
+            pos += BLOCK_HEADER_SIZE + qFromLittleEndian<quint32>(data + pos + 20);
+        }
+    }
+
+    foreach(qint64 offset, offsets) {
+        if (offset < 0 || offset + BLOCK_HEADER_SIZE > end || memcmp(data + offset, "OPLB", 4) != 0) {
+            break;
+        }
+        Block block;
+        block.firstTimeStamp = qFromLittleEndian<quint32>(data + offset + 4);
+        block.lastTimeStamp  = qFromLittleEndian<quint32>(data + offset + 8);
+        block.rawSize        = qFromLittleEndian<quint32>(data + offset + 16);
+        block.compressedSize = qFromLittleEndian<quint32>(data + offset + 20);
+        block.offset         = offset;
+        if (offset + BLOCK_HEADER_SIZE + block.compressedSize > end) {
+            break;
+        }
+        m_blocks.append(block);
+    }
+    if (m_blocks.size() < offsets.size()) {
+        qDebug() << "Error: Logfile corrupted! Using the first" << m_blocks.size() << "of" << offsets.size() << "blocks";
+    }
+    return true;
+}
+
+/**
+ * Decompress a block and check that its records fill it exactly.
+ */
+QByteArray LogFile::BlockReader::blockRecords(int block) const
+{
+    const Block &info  = m_blocks[block];
+    QByteArray records = qUncompress(m_data + info.offset + BLOCK_HEADER_SIZE, info.compressedSize);
+
+    if (records.size() != (int)info.rawSize) {
+        return QByteArray();
+    }
+    const uchar *data = (const uchar *)records.constData();
+    qint64 pos = 0;
+    while (pos < records.size()) {
+        if (pos + RECORD_HEADER_SIZE > records.size()) {
+            return QByteArray();
+        }
+        qint64 dataSize = recordSize(data + pos);
+        if (dataSize < 1 || dataSize > MAX_RECORD_SIZE || pos + RECORD_HEADER_SIZE + dataSize > records.size()) {
+            return QByteArray();
+        }
+        pos += RECORD_HEADER_SIZE + dataSize;
+    }
+    return records;
+}
+
+bool LogFile::convertLegacyLog(const QString &legacyFileName, const QString &fileName, const QByteArray &schema)
+{
+    QFile legacy(legacyFileName);
+
+    if (!legacy.open(QIODevice::ReadOnly)) {
+        qDebug() << "Unable to open" << legacyFileName;
+        return false;
+    }
+    qint64 size = legacy.size();
+    QByteArray copy;
+    const uchar *data = legacy.map(0, size);
+    if (!data) {
+        copy = legacy.readAll();
+        data = (const uchar *)copy.constData();
+        size = copy.size();
+    }
+
+    LogFile logFile;
+    logFile.setFileName(fileName);
+    logFile.setCompressed(true);
+    logFile.setSchema(schema);
+    logFile.useProvidedTimeStamp(true);
+    if (!logFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    qint64 pos = 0;
+    int records = 0;
+    while (pos + RECORD_HEADER_SIZE <= size) {
+        quint32 timeStamp;
+        qint64 dataSize;
+        memcpy(&timeStamp, data + pos, sizeof(timeStamp));
+        memcpy(&dataSize, data + pos + sizeof(timeStamp), sizeof(dataSize));
+        if (dataSize < 1 || dataSize > MAX_RECORD_SIZE || pos + RECORD_HEADER_SIZE + dataSize > size) {
+            qDebug() << "Error: Logfile corrupted! Converted" << records << "records";
+            break;
+        }
+        logFile.setNextTimeStamp(timeStamp);
+        logFile.write((const char *)data + pos + RECORD_HEADER_SIZE, dataSize);
+        pos += RECORD_HEADER_SIZE + dataSize;
+        records++;
+    }
+    logFile.close();
+
+    return records > 0;
+}
@@ -8,17 +8,81 @@
 #include <QDebug>
 #include <QBuffer>
 #include <QFile>
+#include <QVector>
+#include <QHash>
+#include <QCache>
+#include <QFuture>
 #include "utils_global.h"
 
+/*!
+   Logs are either legacy .opl files, a plain sequence of records, or block
+   compressed .oplz files. A record is a quint32 timestamp in ms, a qint64
+   size and the logged data, one UAVTalk packet for logs written by the GCS.
+
+   An .oplz file, all integers little endian:
+   - "OPLZ", quint32 version, quint32 schema size and the qCompress()ed schema,
+     an XML description of the logged objects
+   - blocks of "OPLB", quint32 first and last timestamp, quint32 record count,
+     quint32 raw size, quint32 compressed size and the qCompress()ed records
+   - "OPLI", quint32 block count and for each block its first and last
+     timestamp and its quint64 file offset, then the quint64 offset of
+     "OPLI" and "OPLE". A log cut short has no index, its blocks are found
+     by walking them.
+ */
 class QTCREATOR_UTILS_EXPORT LogFile : public QIODevice {
     Q_OBJECT
 public:
+    /*!
+       Finds the blocks of an .oplz log and decompresses them one at a time,
+       the log data must stay valid while the reader is used. blockRecords()
+       may be called from several threads at once.
+     */
+    class QTCREATOR_UTILS_EXPORT BlockReader {
+public:
+        BlockReader();
+        // Reads the header and the block table, false if the log is not usable
+        bool open(const uchar *data, qint64 size);
+
+        QByteArray schema() const
+        {
+            return m_schema;
+        }
+        int blockCount() const
+        {
+            return m_blocks.size();
+        }
+        quint32 blockFirstTimeStamp(int block) const
+        {
+            return m_blocks[block].firstTimeStamp;
+        }
+        quint32 blockLastTimeStamp(int block) const
+        {
+            return m_blocks[block].lastTimeStamp;
+        }
+        qint64 blockRawSize(int block) const
+        {
+            return m_blocks[block].rawSize;
+        }
+        // The records of a block, empty if it is corrupted
+        QByteArray blockRecords(int block) const;
+
+private:
+        struct Block {
+            quint32 firstTimeStamp;
+            quint32 lastTimeStamp;
+            quint32 rawSize;
+            quint32 compressedSize;
+            qint64  offset;
+        };
+
+        const uchar *m_data;
+        QByteArray m_schema;
+        QVector<Block> m_blocks;
+    };
+
     explicit LogFile(QObject *parent = 0);
     qint64 bytesAvailable() const;
-    qint64 bytesToWrite()
-    {
-        return m_file.bytesToWrite();
-    };
+    qint64 bytesToWrite();
     bool open(OpenMode mode);
     void setFileName(QString name)
     {
@@ -30,6 +94,21 @@ public:
 
     bool startReplay();
     bool stopReplay();
+
+    // Log time span of the replayed file and the current position in it, in ms
+    quint32 replayStartTime() const
+    {
+        return m_firstTimeStamp;
+    }
+    quint32 replayEndTime() const
+    {
+        return m_lastTimeStamp;
+    }
+    quint32 replayPosition() const
+    {
+        return (quint32)m_replayTime;
+    }
+
     void useProvidedTimeStamp(bool useProvidedTimeStamp)
     {
         m_useProvidedTimeStamp = useProvidedTimeStamp;
@@ -40,6 +119,28 @@ public:
         m_nextTimeStamp = nextTimestamp;
     }
 
+    // Write the compressed format, both must be set before open()
+    void setCompressed(bool compressed)
+    {
+        m_compressed = compressed;
+    }
+    void setSchema(const QByteArray &schema)
+    {
+        m_schema = schema;
+    }
+    // The schema of the replayed log, empty for legacy logs
+    QByteArray schema() const
+    {
+        return m_schema;
+    }
+    // Object IDs to rewrite in the replayed UAVTalk packets
+    void setObjectIdMap(const QHash<quint32, quint32> &objectIdMap)
+    {
+        m_objectIdMap = objectIdMap;
+    }
+
+    static bool convertLegacyLog(const QString &legacyFileName, const QString &fileName, const QByteArray &schema);
+
 public slots:
     void setReplaySpeed(double val)
     {
@@ -48,6 +149,7 @@ public slots:
     };
     void pauseReplay();
     void resumeReplay();
+    void seekReplay(quint32 timeStamp);
 
 protected slots:
     void timerFired();
@@ -56,23 +158,88 @@ signals:
     void readReady();
     void replayStarted();
     void replayFinished();
+    void replayPositionChanged(quint32 timeStamp);
 
 protected:
     QByteArray m_dataBuffer;
+    int m_dataBufferPos;
     QTimer m_timer;
     QTime m_myTime;
     QFile m_file;
-    qint32 m_lastTimeStamp;
-    qint32 m_lastPlayed;
     QMutex m_mutex;
 
-
-    int m_timeOffset;
     double m_playbackSpeed;
 
 private:
+    // Each record is a quint32 timestamp, a qint64 size and the data
+    static const int RECORD_HEADER_SIZE = sizeof(quint32) + sizeof(qint64);
+    // One index entry per this many ms of log
+    static const int INDEX_INTERVAL     = 1000;
+    // Records larger than this are taken for corruption
+    static const int MAX_RECORD_SIZE    = 1024 * 1024;
+
     quint32 m_nextTimeStamp;
     bool m_useProvidedTimeStamp;
+
+    // The file being replayed, mapped or read at once when it can not be mapped
+    const uchar *m_replayData;
+    QByteArray m_replayCopy;
+    // Compressed logs replay from their blocks, which are decompressed when
+    // reached and the last few kept. Records are then at offsets into the
+    // blocks put end to end, m_blockStart holds the offset of each block and
+    // the total size, it is empty for legacy logs.
+    BlockReader m_blockReader;
+    QVector<qint64> m_blockStart;
+    QCache<int, QByteArray> m_blockCache;
+    // Up to the end of the last valid record
+    qint64 m_replaySize;
+    // Offset of the next record to play forwards
+    qint64 m_replayPos;
+    double m_replayTime;
+    int m_lastTick;
+    quint32 m_firstTimeStamp;
+    quint32 m_lastTimeStamp;
+    // Offset of the first record at or after m_firstTimeStamp + n * INDEX_INTERVAL
+    QVector<qint64> m_index;
+    QHash<quint32, quint32> m_objectIdMap;
+
+    // Raw size of the compressed blocks
+    static const int BLOCK_SIZE = 128 * 1024;
+    // Decompressed blocks kept for replay, enough for a step backwards over a block boundary
+    static const int BLOCK_CACHE_SIZE = 4;
+
+    struct BlockInfo {
+        quint32 firstTimeStamp;
+        quint32 lastTimeStamp;
+        quint64 offset;
+    };
+
+    bool m_compressed;
+    QByteArray m_schema;
+    // The block being filled, and the previous one being compressed and written
+    QByteArray m_block;
+    quint32 m_blockFirstTimeStamp;
+    quint32 m_blockLastTimeStamp;
+    quint32 m_blockRecords;
+    QFuture<void> m_blockWrite;
+    QVector<BlockInfo> m_blocks;
+    // Raw size of the block handed to writeBlock() and not yet in the file
+    QMutex m_blockWriteMutex;
+    qint64 m_blockBytesToWrite;
+
+    const uchar *replayRecord(qint64 pos);
+    void buildIndex(qint64 fileSize);
+    void indexBlocks();
+    qint64 findRecord(double timeStamp);
+    void seekTo(double timeStamp);
+    void playRecords(qint64 from, qint64 to);
+    void releaseReplayData();
+    void remapObjectId(char *data, qint64 size);
+
+    void writeHeader();
+    void flushBlock();
+    void writeBlock(QByteArray block, quint32 firstTimeStamp, quint32 lastTimeStamp, quint32 records);
+    void writeIndex();
 };
 
 #endif // LOGFILE_H
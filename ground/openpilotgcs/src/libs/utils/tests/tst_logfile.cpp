@@ -0,0 +1,371 @@
+/**
+ ******************************************************************************
+ *
+ * @file       tst_logfile.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Replay, seek and index tests for LogFile
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "logfile.h"
+#include "crc.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QtEndian>
+#include <QtTest/QtTest>
+
+// Three hours of log, one record every 100 ms
+#define NUM_RECORDS 108000
+#define RECORD_STEP 100
+
+class tst_LogFile : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void replayForward();
+    void seek();
+    void reverse();
+    void truncatedLog();
+    void compressedLog();
+    void compressedLogWithoutIndex();
+    void compressedLogReverse();
+    void compressedLogCorruptedBlock();
+    void compressedLogUnsupportedVersion();
+    void objectIdRemap();
+    void benchmarkSeek();
+
+private:
+    QTemporaryDir dir;
+    QString fileName;
+
+    void startReplay(LogFile &logFile, const QString &name);
+    quint32 readRecord(LogFile &logFile);
+};
+
+// Each record carries its own timestamp so that the tests can tell where replay is
+void tst_LogFile::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    fileName = dir.path() + "/replay.opl";
+
+    LogFile logFile;
+    logFile.setFileName(fileName);
+    logFile.useProvidedTimeStamp(true);
+    QVERIFY(logFile.open(QIODevice::WriteOnly));
+    for (quint32 n = 0; n < NUM_RECORDS; n++) {
+        quint32 timeStamp = 5000 + n * RECORD_STEP;
+        logFile.setNextTimeStamp(timeStamp);
+        QCOMPARE(logFile.write((const char *)&timeStamp, sizeof(timeStamp)), (qint64)sizeof(timeStamp));
+    }
+    logFile.close();
+}
+
+void tst_LogFile::startReplay(LogFile &logFile, const QString &name)
+{
+    logFile.setFileName(name);
+    QVERIFY(logFile.open(QIODevice::ReadOnly));
+    QVERIFY(logFile.startReplay());
+}
+
+quint32 tst_LogFile::readRecord(LogFile &logFile)
+{
+    quint32 timeStamp = 0;
+
+    if (logFile.read((char *)&timeStamp, sizeof(timeStamp)) != sizeof(timeStamp)) {
+        return 0;
+    }
+    return timeStamp;
+}
+
+void tst_LogFile::replayForward()
+{
+    LogFile logFile;
+
+    startReplay(logFile, fileName);
+    QCOMPARE(logFile.replayStartTime(), (quint32)5000);
+    QCOMPARE(logFile.replayEndTime(), (quint32)(5000 + (NUM_RECORDS - 1) * RECORD_STEP));
+    QCOMPARE(logFile.replayPosition(), (quint32)5000);
+
+    // The first record is due right away, the next ones follow in order
+    logFile.setReplaySpeed(10.0);
+    QTRY_VERIFY(logFile.bytesAvailable() >= 3 * (qint64)sizeof(quint32));
+    QCOMPARE(readRecord(logFile), (quint32)5000);
+    QCOMPARE(readRecord(logFile), (quint32)5100);
+    QCOMPARE(readRecord(logFile), (quint32)5200);
+    logFile.close();
+}
+
+void tst_LogFile::seek()
+{
+    LogFile logFile;
+
+    startReplay(logFile, fileName);
+    logFile.pauseReplay();
+
+    QSignalSpy spy(&logFile, SIGNAL(replayPositionChanged(quint32)));
+    logFile.seekReplay(2 * 3600 * 1000 + 50);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(logFile.replayPosition(), (quint32)(2 * 3600 * 1000 + 50));
+    QCOMPARE(logFile.bytesAvailable(), (qint64)0);
+
+    // Playing resumes at the first record at or after the new position
+    logFile.resumeReplay();
+    QTRY_VERIFY(logFile.bytesAvailable() > 0);
+    QCOMPARE(readRecord(logFile), (quint32)(2 * 3600 * 1000 + 100));
+
+    // Seeking outside of the log clamps to it
+    logFile.seekReplay(0);
+    QCOMPARE(logFile.replayPosition(), logFile.replayStartTime());
+    logFile.seekReplay(0xFFFFFFFF);
+    QCOMPARE(logFile.replayPosition(), logFile.replayEndTime());
+    logFile.close();
+}
+
+void tst_LogFile::reverse()
+{
+    LogFile logFile;
+
+    startReplay(logFile, fileName);
+    logFile.seekReplay(3600 * 1000);
+    logFile.setReplaySpeed(-10.0);
+    QTRY_VERIFY(logFile.replayPosition() < 3600 * 1000 - 1000);
+
+    // Records come in file order within each step, all of them from before the seek position
+    quint32 previous = 0;
+    while (logFile.bytesAvailable() >= (qint64)sizeof(quint32)) {
+        quint32 timeStamp = readRecord(logFile);
+        QVERIFY(timeStamp <= 3600 * 1000);
+        if (previous && timeStamp > previous) {
+            QCOMPARE(timeStamp, previous + RECORD_STEP);
+        }
+        previous = timeStamp;
+    }
+    QVERIFY(previous > 0);
+    logFile.close();
+}
+
+void tst_LogFile::truncatedLog()
+{
+    QString truncated = dir.path() + "/truncated.opl";
+    QFile source(fileName);
+
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QFile target(truncated);
+    QVERIFY(target.open(QIODevice::WriteOnly));
+    // 10 whole records and half of the 11th
+    target.write(source.read(10 * 16 + 8));
+    target.close();
+
+    LogFile logFile;
+    startReplay(logFile, truncated);
+    QCOMPARE(logFile.replayEndTime(), (quint32)(5000 + 9 * RECORD_STEP));
+
+    QSignalSpy spy(&logFile, SIGNAL(replayFinished()));
+    logFile.setReplaySpeed(10.0);
+    QTRY_COMPARE(spy.count(), 1);
+}
+
+void tst_LogFile::compressedLog()
+{
+    QString compressed = dir.path() + "/replay.oplz";
+    QByteArray schema("<uavobjects/>");
+
+    QVERIFY(LogFile::convertLegacyLog(fileName, compressed, schema));
+    QVERIFY(QFileInfo(compressed).size() < QFileInfo(fileName).size() / 2);
+
+    LogFile logFile;
+    startReplay(logFile, compressed);
+    QCOMPARE(logFile.schema(), schema);
+    QCOMPARE(logFile.replayStartTime(), (quint32)5000);
+    QCOMPARE(logFile.replayEndTime(), (quint32)(5000 + (NUM_RECORDS - 1) * RECORD_STEP));
+
+    logFile.pauseReplay();
+    logFile.seekReplay(1234567);
+    logFile.resumeReplay();
+    QTRY_VERIFY(logFile.bytesAvailable() > 0);
+    QCOMPARE(readRecord(logFile), (quint32)1234600);
+    logFile.close();
+}
+
+void tst_LogFile::compressedLogWithoutIndex()
+{
+    QString compressed = dir.path() + "/replay.oplz";
+    QString cut = dir.path() + "/cut.oplz";
+    QFile source(compressed);
+
+    // Drop the index and half of the last block, as when the GCS is killed while logging
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QByteArray data = source.readAll();
+    quint64 indexOffset = qFromLittleEndian<quint64>((const uchar *)data.constData() + data.size() - 12);
+    QVERIFY(indexOffset < (quint64)data.size());
+    QFile target(cut);
+    QVERIFY(target.open(QIODevice::WriteOnly));
+    target.write(data.left(indexOffset - 100));
+    target.close();
+
+    LogFile logFile;
+    startReplay(logFile, cut);
+    QCOMPARE(logFile.replayStartTime(), (quint32)5000);
+    QVERIFY(logFile.replayEndTime() > 5000);
+    QVERIFY(logFile.replayEndTime() < (quint32)(5000 + (NUM_RECORDS - 1) * RECORD_STEP));
+    logFile.close();
+}
+
+void tst_LogFile::compressedLogReverse()
+{
+    LogFile logFile;
+
+    // A block holds about 800 s of this log, go back over a few of them
+    startReplay(logFile, dir.path() + "/replay.oplz");
+    logFile.seekReplay(3600 * 1000);
+    logFile.setReplaySpeed(-10000.0);
+    QTRY_VERIFY(logFile.replayPosition() < 3600 * 1000 - 2000 * 1000);
+
+    quint32 previous = 0;
+    while (logFile.bytesAvailable() >= (qint64)sizeof(quint32)) {
+        quint32 timeStamp = readRecord(logFile);
+        QVERIFY(timeStamp <= 3600 * 1000);
+        if (previous && timeStamp > previous) {
+            QCOMPARE(timeStamp, previous + RECORD_STEP);
+        }
+        previous = timeStamp;
+    }
+    QVERIFY(previous > 0);
+    logFile.close();
+}
+
+void tst_LogFile::compressedLogCorruptedBlock()
+{
+    QString corrupted = dir.path() + "/corrupted.oplz";
+    QFile source(dir.path() + "/replay.oplz");
+
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QByteArray data = source.readAll();
+
+    // Scramble the data of the third block
+    LogFile::BlockReader reader;
+    QVERIFY(reader.open((const uchar *)data.constData(), data.size()));
+    QVERIFY(reader.blockCount() > 3);
+    quint32 endTimeStamp = reader.blockLastTimeStamp(1);
+    int offset = data.indexOf("OPLB");
+    for (int n = 0; n < 2; n++) {
+        offset = data.indexOf("OPLB", offset + 4);
+    }
+    for (int n = offset + 30; n < offset + 60; n++) {
+        data[n] = ~data[n];
+    }
+    QVERIFY(reader.open((const uchar *)data.constData(), data.size()));
+    QVERIFY(!reader.blockRecords(1).isEmpty());
+    QVERIFY(reader.blockRecords(2).isEmpty());
+
+    QFile target(corrupted);
+    QVERIFY(target.open(QIODevice::WriteOnly));
+    target.write(data);
+    target.close();
+
+    // Replay ends with the last good block
+    LogFile logFile;
+    startReplay(logFile, corrupted);
+    QSignalSpy spy(&logFile, SIGNAL(replayFinished()));
+    logFile.setReplaySpeed(1000.0);
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(logFile.replayEndTime(), endTimeStamp);
+}
+
+void tst_LogFile::compressedLogUnsupportedVersion()
+{
+    QString future = dir.path() + "/future.oplz";
+    QFile source(dir.path() + "/replay.oplz");
+
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QByteArray data = source.readAll();
+    data[4] = 2;
+    QFile target(future);
+    QVERIFY(target.open(QIODevice::WriteOnly));
+    target.write(data);
+    target.close();
+
+    LogFile logFile;
+    logFile.setFileName(future);
+    QVERIFY(logFile.open(QIODevice::ReadOnly));
+    QVERIFY(!logFile.startReplay());
+    logFile.close();
+}
+
+void tst_LogFile::objectIdRemap()
+{
+    QString packetLog = dir.path() + "/packets.oplz";
+    quint8 packet[15] = { 0x3C, 0x20, 14, 0, 0x78, 0x56, 0x34, 0x12, 0, 0, 1, 2, 3, 4, 0 };
+
+    packet[14] = Utils::Crc::updateCRC(0, packet, 14);
+
+    LogFile writer;
+    writer.setFileName(packetLog);
+    writer.setCompressed(true);
+    writer.useProvidedTimeStamp(true);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    // The second copy keeps the replay running while the first one is checked
+    writer.setNextTimeStamp(0);
+    writer.write((const char *)packet, sizeof(packet));
+    writer.setNextTimeStamp(100000);
+    writer.write((const char *)packet, sizeof(packet));
+    writer.close();
+
+    QHash<quint32, quint32> objectIdMap;
+    objectIdMap.insert(0x12345678, 0xCAFEBABE);
+
+    LogFile logFile;
+    startReplay(logFile, packetLog);
+    logFile.setObjectIdMap(objectIdMap);
+    QTRY_VERIFY(logFile.bytesAvailable() >= (qint64)sizeof(packet));
+
+    quint8 replayed[sizeof(packet)];
+    QCOMPARE(logFile.read((char *)replayed, sizeof(replayed)), (qint64)sizeof(replayed));
+    QCOMPARE(qFromLittleEndian<quint32>(&replayed[4]), (quint32)0xCAFEBABE);
+    QVERIFY(memcmp(&replayed[10], &packet[10], 4) == 0);
+    QCOMPARE(replayed[14], Utils::Crc::updateCRC(0, replayed, 14));
+    logFile.close();
+}
+
+// Seeking must not depend on where in the log the position is
+void tst_LogFile::benchmarkSeek()
+{
+    LogFile logFile;
+    QElapsedTimer timer;
+    const int seeks = 100000;
+
+    startReplay(logFile, fileName);
+    logFile.pauseReplay();
+
+    timer.start();
+    for (int n = 0; n < seeks; n++) {
+        logFile.seekReplay(logFile.replayStartTime() + (quint32)(((quint64)n * 7919 * 1000) % (NUM_RECORDS * RECORD_STEP)));
+    }
+    qint64 elapsed = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    qDebug("%.2f us per seek in %d s of log", elapsed / 1000.0 / seeks, NUM_RECORDS * RECORD_STEP / 1000);
+    logFile.close();
+}
+
+QTEST_MAIN(tst_LogFile)
+
+#include "tst_logfile.moc"
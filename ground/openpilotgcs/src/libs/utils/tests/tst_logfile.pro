@@ -0,0 +1,13 @@
+QT += testlib concurrent
+TARGET = tst_logfile
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+DEFINES += QTCREATOR_UTILS_STATIC_LIB
+INCLUDEPATH += ..
+
+SOURCES += tst_logfile.cpp \
+    ../logfile.cpp \
+    ../crc.cpp
+HEADERS += ../logfile.h
@@ -2,6 +2,7 @@ TEMPLATE = lib
 TARGET = Utils
 
 QT += gui \
+    concurrent \
     network \
     xml \
     svg \
@@ -326,7 +326,7 @@ void VehicleConfig::getThrottleCurve(UAVDataObject *mixer, MixerThrottleCurveEle
     if (field) {
         curve->clear();
         for (unsigned int i = 0; i < field->getNumElements(); i++) {
-            curve->append(field->getValue(i).toDouble());
+            curve->append(field->getDouble(i));
         }
     }
 }
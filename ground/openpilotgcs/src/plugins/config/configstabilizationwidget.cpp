@@ -261,7 +261,7 @@ void ConfigStabilizationWidget::updateThrottleCurveFromObject()
 
     QList<double> curve;
     for (quint32 i = 0; i < field->getNumElements(); i++) {
-        curve.append(field->getValue(i).toDouble());
+        curve.append(field->getDouble(i));
     }
 
     ui->thrustPIDScalingCurve->setCurve(&curve);
@@ -357,7 +357,7 @@ void ConfigStabilizationWidget::resetThrottleCurveToDefault()
 
     QList<double> curve;
     for (quint32 i = 0; i < field->getNumElements(); i++) {
-        curve.append(field->getValue(i).toDouble());
+        curve.append(field->getDouble(i));
     }
 
     ui->thrustPIDScalingCurve->setCurve(&curve);
@@ -1,7 +1,7 @@
 TEMPLATE = lib 
 TARGET = FlightLog
 
-QT += qml quick
+QT += qml quick concurrent
 
 include(../../openpilotgcsplugin.pri)
 include(../../plugins/coreplugin/coreplugin.pri)
@@ -33,6 +33,8 @@
 #include <QXmlStreamReader>
 #include <QMessageBox>
 #include <QDebug>
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include "debuglogcontrol.h"
 #include "uavobjecthelper.h"
@@ -44,7 +46,8 @@
 FlightLogManager::FlightLogManager(QObject *parent) :
     QObject(parent), m_disableControls(false),
     m_disableExport(true), m_cancelDownload(false),
-    m_adjustExportedTimestamps(true)
+    m_adjustExportedTimestamps(true), m_batchFlight(0), m_batchLast(-1),
+    m_batchWaitFrom(0), m_batchWaitTo(0), m_batchInterval(10)
 {
     ExtensionSystem::PluginManager *pluginManager = ExtensionSystem::PluginManager::instance();
 
@@ -77,6 +80,9 @@ FlightLogManager::FlightLogManager(QObject *parent) :
 
     updateFlightEntries(m_flightLogStatus->getFlight());
 
+    m_batchTimer.setSingleShot(true);
+    connect(&m_batchTimer, SIGNAL(timeout()), &m_batchLoop, SLOT(quit()));
+
     setupLogSettings();
     setupLogStatuses();
     setupUAVOWrappers();
@@ -186,13 +192,46 @@ void FlightLogManager::clearLogList()
     }
 }
 
+// Split the entries of one flight into one record per object, unpacking
+// the objects stored in MultipleUAVObjects entries. Runs on a worker thread.
+static QList<DebugLogEntry::DataFields> decodeFlightEntries(const QList<DebugLogEntry::DataFields> &entries)
+{
+    const quint32 total_len  = sizeof(DebugLogEntry::DataFields);
+    const quint32 data_len   = sizeof(((DebugLogEntry::DataFields *)0)->Data);
+    const quint32 header_len = total_len - data_len;
+
+    QList<DebugLogEntry::DataFields> records;
+
+    foreach(const DebugLogEntry::DataFields &entry, entries) {
+        records << entry;
+        if (entry.Type == DebugLogEntry::TYPE_MULTIPLEUAVOBJECTS) {
+            DebugLogEntry::DataFields fields;
+            quint32 start = entry.Size;
+
+            // cycle until there is space for another object
+            while (start + header_len + 1 < data_len) {
+                memset(&fields, 0xFF, total_len);
+                memcpy(&fields, &entry.Data[start], header_len);
+                // check wether a packed object is found
+                // note that empty data blocks are set as 0xFF in flight side to minimize flash wearing
+                // thus as soon as this read outside of used area, the test will fail as lenght would be 0xFFFF
+                quint32 toread = header_len + fields.Size;
+                if (!(toread + start > data_len)) {
+                    memcpy(&fields, &entry.Data[start], toread);
+                    records << fields;
+                }
+                start += toread;
+            }
+        }
+    }
+    return records;
+}
+
 void FlightLogManager::retrieveLogs(int flightToRetrieve)
 {
     setDisableControls(true);
     QApplication::setOverrideCursor(Qt::WaitCursor);
     m_cancelDownload = false;
-    UAVObjectUpdaterHelper updateHelper;
-    UAVObjectRequestHelper requestHelper;
 
     clearLogList();
 
@@ -200,66 +239,27 @@ void FlightLogManager::retrieveLogs(int flightToRetrieve)
     int startFlight = (flightToRetrieve == -1) ? 0 : flightToRetrieve;
     int endFlight   = (flightToRetrieve == -1) ? m_flightLogStatus->getFlight() : flightToRetrieve;
 
-    // Prepare to send request for event retrieval
-    m_flightLogControl->setOperation(DebugLogControl::OPERATION_RETRIEVE);
-    for (int flight = startFlight; flight <= endFlight; flight++) {
-        m_flightLogControl->setFlight(flight);
-        bool gotLast = false;
-        int slot     = 0;
-        while (!gotLast) {
-            // Send request for loading flight entry on flight side and wait for ack/nack
-            m_flightLogControl->setEntry(slot);
-
-            if (updateHelper.doObjectAndWait(m_flightLogControl, UAVTALK_TIMEOUT) == UAVObjectUpdaterHelper::SUCCESS &&
-                requestHelper.doObjectAndWait(m_flightLogEntry, UAVTALK_TIMEOUT) == UAVObjectUpdaterHelper::SUCCESS) {
-                if (m_flightLogEntry->getType() != DebugLogEntry::TYPE_EMPTY) {
-                    // Ok, we retrieved the entry, and it was the correct one. clone it and add it to the list
-                    ExtendedDebugLogEntry *logEntry = new ExtendedDebugLogEntry();
-
-                    logEntry->setData(m_flightLogEntry->getData(), m_objectManager);
-                    m_logEntries << logEntry;
-                    if (logEntry->getData().Type == DebugLogEntry::TYPE_MULTIPLEUAVOBJECTS) {
-                        const quint32 total_len  = sizeof(DebugLogEntry::DataFields);
-                        const quint32 data_len   = sizeof(((DebugLogEntry::DataFields *)0)->Data);
-                        const quint32 header_len = total_len - data_len;
-
-                        DebugLogEntry::DataFields fields;
-                        quint32 start = logEntry->getData().Size;
-
-                        // cycle until there is space for another object
-                        while (start + header_len + 1 < data_len) {
-                            memset(&fields, 0xFF, total_len);
-                            memcpy(&fields, &logEntry->getData().Data[start], header_len);
-                            // check wether a packed object is found
-                            // note that empty data blocks are set as 0xFF in flight side to minimize flash wearing
-                            // thus as soon as this read outside of used area, the test will fail as lenght would be 0xFFFF
-                            quint32 toread = header_len + fields.Size;
-                            if (!(toread + start > data_len)) {
-                                memcpy(&fields, &logEntry->getData().Data[start], toread);
-                                ExtendedDebugLogEntry *subEntry = new ExtendedDebugLogEntry();
-                                subEntry->setData(fields, m_objectManager);
-                                m_logEntries << subEntry;
-                            }
-                            start += toread;
-                        }
-                    }
+    // Entries pushed by the flight side, and the answers to single requests, all arrive here
+    connect(m_flightLogEntry, SIGNAL(objectUnpacked(UAVObject *)), this, SLOT(batchEntryReceived(UAVObject *)));
 
-                    // Increment to get next entry from flight side
-                    slot++;
-                } else {
-                    // We are done, not more entries on this flight
-                    gotLast = true;
-                }
-            } else {
-                // We failed for some reason
-                break;
-            }
+    // Each flight is decoded on a worker thread while the next one is downloaded
+    QList<QFuture<QList<DebugLogEntry::DataFields> > > decoded;
+    for (int flight = startFlight; flight <= endFlight && !m_cancelDownload; flight++) {
+        decoded << QtConcurrent::run(decodeFlightEntries, retrieveFlight(flight));
+    }
+
+    disconnect(m_flightLogEntry, SIGNAL(objectUnpacked(UAVObject *)), this, SLOT(batchEntryReceived(UAVObject *)));
+    m_batchEntries.clear();
+
+    // The clones of the logged objects belong to the UI thread, create them here
+    for (int i = 0; i < decoded.count(); i++) {
+        foreach(const DebugLogEntry::DataFields &record, decoded[i].result()) {
             if (m_cancelDownload) {
                 break;
             }
-        }
-        if (m_cancelDownload) {
-            break;
+            ExtendedDebugLogEntry *logEntry = new ExtendedDebugLogEntry();
+            logEntry->setData(record, m_objectManager);
+            m_logEntries << logEntry;
         }
     }
 
@@ -275,6 +275,143 @@ void FlightLogManager::retrieveLogs(int flightToRetrieve)
     setDisableControls(false);
 }
 
+QList<DebugLogEntry::DataFields> FlightLogManager::retrieveFlight(int flight)
+{
+    m_batchFlight = flight;
+    m_batchLast   = -1;
+    m_batchEntries.clear();
+
+    int next       = 0;
+    int failures   = 0;
+    bool streaming = true;
+    while (!m_cancelDownload) {
+        // Skip what we already have, we are done once we reach the end of the flight
+        while (m_batchEntries.contains(next)) {
+            next++;
+        }
+        if (m_batchLast >= 0 && next >= m_batchLast) {
+            break;
+        }
+
+        if (!streaming) {
+            // One round trip per entry for the rest of the flight
+            if (!requestEntry(next)) {
+                // We failed for some reason
+                break;
+            }
+            continue;
+        }
+
+        // Ask for a full window, or only for the gap up to the next entry already received
+        int count = BATCH_WINDOW;
+        QMap<quint16, DebugLogEntry::DataFields>::const_iterator it = m_batchEntries.lowerBound(next);
+        if (it != m_batchEntries.constEnd()) {
+            count = qMin(count, it.key() - next);
+        }
+        if (m_batchLast >= 0) {
+            count = qMin(count, m_batchLast - next);
+        }
+
+        int received = m_batchEntries.count();
+        if (requestBatch(next, count)) {
+            failures = 0;
+            // Slow the flight side down when entries got lost, speed it up again while the link keeps up
+            int expected = (m_batchLast >= 0) ? qMin(count, m_batchLast - next) : count;
+            if (m_batchEntries.count() - received < expected) {
+                m_batchInterval = qMin(m_batchInterval * 2, (int)BATCH_MAX_INTERVAL);
+            } else {
+                m_batchInterval = qMax(m_batchInterval - qMax(m_batchInterval / 8, 1), (int)BATCH_MIN_INTERVAL);
+            }
+        } else if (++failures >= BATCH_RETRIES) {
+            // Streaming does not get through, asking for more batches would only add timeouts
+            streaming = false;
+        }
+    }
+
+    return m_batchEntries.values();
+}
+
+bool FlightLogManager::requestBatch(int from, int count)
+{
+    UAVObjectUpdaterHelper updateHelper;
+    int received = m_batchEntries.count();
+    int last     = m_batchLast;
+
+    m_batchWaitFrom = from;
+    m_batchWaitTo   = from + count;
+
+    m_flightLogControl->setOperation(DebugLogControl::OPERATION_RETRIEVEBATCH);
+    m_flightLogControl->setFlight(m_batchFlight);
+    m_flightLogControl->setEntry(from);
+    m_flightLogControl->setCount(count);
+    m_flightLogControl->setInterval(m_batchInterval);
+    if (updateHelper.doObjectAndWait(m_flightLogControl, UAVTALK_TIMEOUT) != UAVObjectUpdaterHelper::SUCCESS) {
+        return false;
+    }
+
+    // Entries may already have arrived while waiting for the ack, batchEntryReceived()
+    // restarts the timer for each one so this only times out once the stream stops
+    if (!batchWindowComplete()) {
+        m_batchTimer.start(BATCH_IDLE_TIMEOUT + 4 * m_batchInterval);
+        m_batchLoop.exec();
+        m_batchTimer.stop();
+    }
+
+    return m_batchEntries.count() != received || m_batchLast != last;
+}
+
+bool FlightLogManager::requestEntry(int entry)
+{
+    UAVObjectUpdaterHelper updateHelper;
+    UAVObjectRequestHelper requestHelper;
+
+    // Send request for loading flight entry on flight side and wait for ack/nack, then fetch it
+    m_flightLogControl->setOperation(DebugLogControl::OPERATION_RETRIEVE);
+    m_flightLogControl->setFlight(m_batchFlight);
+    m_flightLogControl->setEntry(entry);
+
+    return updateHelper.doObjectAndWait(m_flightLogControl, UAVTALK_TIMEOUT) == UAVObjectUpdaterHelper::SUCCESS &&
+           requestHelper.doObjectAndWait(m_flightLogEntry, UAVTALK_TIMEOUT) == UAVObjectUpdaterHelper::SUCCESS;
+}
+
+bool FlightLogManager::batchWindowComplete() const
+{
+    for (int entry = m_batchWaitFrom; entry < m_batchWaitTo; entry++) {
+        if (m_batchLast >= 0 && entry >= m_batchLast) {
+            return true;
+        }
+        if (!m_batchEntries.contains(entry)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FlightLogManager::batchEntryReceived(UAVObject *object)
+{
+    Q_UNUSED(object);
+
+    DebugLogEntry::DataFields data = m_flightLogEntry->getData();
+    if (data.Flight != m_batchFlight) {
+        return;
+    }
+
+    if (data.Type == DebugLogEntry::TYPE_EMPTY) {
+        // First entry past the end of the flight
+        if (m_batchLast < 0 || data.Entry < m_batchLast) {
+            m_batchLast = data.Entry;
+        }
+    } else {
+        m_batchEntries.insert(data.Entry, data);
+    }
+
+    if (batchWindowComplete()) {
+        m_batchLoop.quit();
+    } else if (m_batchTimer.isActive()) {
+        m_batchTimer.start();
+    }
+}
+
 void FlightLogManager::exportToOPL(QString fileName)
 {
     // Fix the file name
@@ -31,6 +31,9 @@
 #include <QObject>
 #include <QList>
 #include <QHash>
+#include <QMap>
+#include <QEventLoop>
+#include <QTimer>
 #include <QQmlListProperty>
 #include <QSemaphore>
 #include <QXmlStreamWriter>
@@ -319,6 +322,7 @@ private slots:
     void setupLogStatuses();
     void connectionStatusChanged();
     bool updateLogWrapper(QString name, int level, int period);
+    void batchEntryReceived(UAVObject *object);
 
 private:
     UAVObjectManager *m_objectManager;
@@ -338,11 +342,34 @@ private:
     QList<UAVOLogSettingsWrapper *> m_uavoEntries;
     QHash<QString, UAVOLogSettingsWrapper *> m_uavoEntriesHash;
 
+    // State of the flight currently being retrieved, filled in by batchEntryReceived()
+    QMap<quint16, DebugLogEntry::DataFields> m_batchEntries;
+    quint16 m_batchFlight;
+    int m_batchLast;
+    int m_batchWaitFrom;
+    int m_batchWaitTo;
+    int m_batchInterval;
+    QEventLoop m_batchLoop;
+    QTimer m_batchTimer;
+
+    QList<DebugLogEntry::DataFields> retrieveFlight(int flight);
+    bool requestBatch(int from, int count);
+    bool requestEntry(int entry);
+    bool batchWindowComplete() const;
+
     void exportToOPL(QString fileName);
     void exportToCSV(QString fileName);
     void exportToXML(QString fileName);
 
     static const int UAVTALK_TIMEOUT = 4000;
+    // Entries asked for per batch request, and the retries before falling back to one entry per request
+    // for the rest of the flight
+    static const int BATCH_WINDOW    = 64;
+    static const int BATCH_RETRIES   = 3;
+    // Pace of the flight side in ms per entry, adapted to the losses seen on the link
+    static const int BATCH_MIN_INTERVAL = 2;
+    static const int BATCH_MAX_INTERVAL = 200;
+    static const int BATCH_IDLE_TIMEOUT = 500;
     static const int LOG_SETTINGS_FILE_VERSION = 1;
     bool m_disableControls;
     bool m_disableExport;
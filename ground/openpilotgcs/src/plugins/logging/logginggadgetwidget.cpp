@@ -58,8 +58,52 @@ void LoggingGadgetWidget::setPlugin(LoggingPlugin *p)
     connect(m_logging->pauseButton, SIGNAL(clicked()), p->getLogfile(), SLOT(pauseReplay()));
     connect(m_logging->pauseButton, SIGNAL(clicked()), scpPlugin, SLOT(stopPlotting()));
     connect(m_logging->playbackSpeed, SIGNAL(valueChanged(double)), p->getLogfile(), SLOT(setReplaySpeed(double)));
-    void pauseReplay();
-    void resumeReplay();
+    connect(p->getLogfile(), SIGNAL(replayStarted()), this, SLOT(replayStarted()));
+    connect(p->getLogfile(), SIGNAL(replayFinished()), this, SLOT(replayFinished()));
+    connect(p->getLogfile(), SIGNAL(replayPositionChanged(quint32)), this, SLOT(replayPositionChanged(quint32)));
+    // Dragging, clicking or stepping the slider all trigger an action
+    connect(m_logging->positionSlider, SIGNAL(actionTriggered(int)), this, SLOT(seek()));
+}
+
+static QString formatLogTime(quint32 ms)
+{
+    quint32 seconds = ms / 1000;
+
+    return QString("%1:%2:%3").arg(seconds / 3600, 2, 10, QChar('0'))
+           .arg((seconds / 60) % 60, 2, 10, QChar('0'))
+           .arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+void LoggingGadgetWidget::replayStarted()
+{
+    LogFile *logFile = loggingPlugin->getLogfile();
+
+    m_logging->positionSlider->setRange(logFile->replayStartTime(), logFile->replayEndTime());
+    m_logging->positionSlider->setPageStep(10000);
+    m_logging->positionSlider->setEnabled(true);
+    replayPositionChanged(logFile->replayPosition());
+}
+
+void LoggingGadgetWidget::replayFinished()
+{
+    m_logging->positionSlider->setEnabled(false);
+}
+
+void LoggingGadgetWidget::replayPositionChanged(quint32 timeStamp)
+{
+    // Leave the slider alone while it is being dragged
+    if (!m_logging->positionSlider->isSliderDown()) {
+        m_logging->positionSlider->setValue(timeStamp);
+    }
+    LogFile *logFile = loggingPlugin->getLogfile();
+    m_logging->positionLabel->setText(QString("%1 / %2")
+                                      .arg(formatLogTime(timeStamp - logFile->replayStartTime()))
+                                      .arg(formatLogTime(logFile->replayEndTime() - logFile->replayStartTime())));
+}
+
+void LoggingGadgetWidget::seek()
+{
+    loggingPlugin->getLogfile()->seekReplay(m_logging->positionSlider->sliderPosition());
 }
 
 
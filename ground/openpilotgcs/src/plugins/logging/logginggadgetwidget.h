@@ -47,6 +47,10 @@ public:
 
 protected slots:
     void stateChanged(QString status);
+    void replayStarted();
+    void replayFinished();
+    void replayPositionChanged(quint32 timeStamp);
+    void seek();
 
 signals:
     void pause();
@@ -38,12 +38,116 @@
 #include <QList>
 #include <QErrorMessage>
 #include <QWriteLocker>
+#include <QXmlStreamWriter>
+#include <QXmlStreamReader>
+#include <QApplication>
 
 #include <extensionsystem/pluginmanager.h>
 #include <QKeySequence>
 #include "uavobjectmanager.h"
 
 
+static QString fieldLayout(const QString &type, const QString &elements, const QString &options)
+{
+    return QString("%1*%2%3;").arg(type).arg(elements).arg(options.isEmpty() ? QString() : "(" + options + ")");
+}
+
+/**
+ * What the packed data of an object looks like, two objects with the same
+ * layout can be unpacked from each other's data.
+ */
+static QString objectLayout(UAVObject *obj)
+{
+    QString layout;
+
+    foreach(UAVObjectField * field, obj->getFields()) {
+        layout.append(fieldLayout(field->getTypeAsString(), QString::number(field->getNumElements()),
+                                  field->getType() == UAVObjectField::ENUM ? field->getOptions().join(",") : QString()));
+    }
+    return layout;
+}
+
+/**
+ * Describe the objects of this firmware, compressed logs carry it so that
+ * they can still be replayed when object IDs change.
+ */
+static QByteArray objectSchema(UAVObjectManager *objManager)
+{
+    QByteArray schema;
+    QXmlStreamWriter xml(&schema);
+
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("uavobjects");
+    foreach(QList<UAVDataObject *> instances, objManager->getDataObjects()) {
+        UAVDataObject *obj = instances.first();
+
+        xml.writeStartElement("object");
+        xml.writeAttribute("name", obj->getName());
+        xml.writeAttribute("id", "0x" + QString::number(obj->getObjID(), 16).toUpper());
+        xml.writeAttribute("singleinstance", obj->isSingleInstance() ? "true" : "false");
+        xml.writeAttribute("settings", obj->isSettingsObject() ? "true" : "false");
+        foreach(UAVObjectField * field, obj->getFields()) {
+            xml.writeStartElement("field");
+            xml.writeAttribute("name", field->getName());
+            xml.writeAttribute("type", field->getTypeAsString());
+            xml.writeAttribute("elements", QString::number(field->getNumElements()));
+            xml.writeAttribute("units", field->getUnits());
+            if (field->getType() == UAVObjectField::ENUM) {
+                xml.writeAttribute("options", field->getOptions().join(","));
+            }
+            xml.writeEndElement();
+        }
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    return schema;
+}
+
+/**
+ * Map the IDs of the logged objects to the IDs of this firmware, for the
+ * objects that changed ID but whose data can still be unpacked.
+ */
+static QHash<quint32, quint32> objectIdMap(const QByteArray &schema, UAVObjectManager *objManager)
+{
+    QHash<quint32, quint32> map;
+    QXmlStreamReader xml(schema);
+    QString name;
+    quint32 objId = 0;
+    QString layout;
+
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement() && xml.name() == "object") {
+            name  = xml.attributes().value("name").toString();
+            objId = xml.attributes().value("id").toString().toUInt(NULL, 0);
+            layout.clear();
+        } else if (xml.isStartElement() && xml.name() == "field") {
+            layout.append(fieldLayout(xml.attributes().value("type").toString(),
+                                      xml.attributes().value("elements").toString(),
+                                      xml.attributes().value("options").toString()));
+        } else if (xml.isEndElement() && xml.name() == "object") {
+            UAVObject *obj = objManager->getObject(name);
+            if (!obj) {
+                qDebug() << "Logged object" << name << "does not exist in this firmware";
+            } else if (obj->getObjID() != objId) {
+                if (objectLayout(obj) == layout) {
+                    // The metaobject ID follows the object ID
+                    map.insert(objId, obj->getObjID());
+                    map.insert(objId + 1, obj->getObjID() + 1);
+                } else {
+                    qDebug() << "Logged object" << name << "has changed, it will not be replayed";
+                }
+            }
+        }
+    }
+    if (xml.hasError()) {
+        qDebug() << "Invalid log schema:" << xml.errorString();
+    }
+    return map;
+}
+
 LoggingConnection::LoggingConnection(LoggingPlugin *loggingPlugin) :
     loggingPlugin(loggingPlugin),
     m_deviceOpened(false)
@@ -73,7 +177,7 @@ QIODevice *LoggingConnection::openDevice(const QString &deviceName)
     loggingPlugin->stopLogging();
     closeDevice(deviceName);
 
-    QString fileName = QFileDialog::getOpenFileName(NULL, tr("Open file"), QString(""), tr("OpenPilot Log (*.opl)"));
+    QString fileName = QFileDialog::getOpenFileName(NULL, tr("Open file"), QString(""), tr("OpenPilot Log (*.oplz *.opl)"));
     if (!fileName.isNull()) {
         startReplay(fileName);
         return &logFile;
@@ -89,6 +193,13 @@ void LoggingConnection::startReplay(QString file)
         qDebug() << "Replaying " << file;
         // state = REPLAY;
         logFile.startReplay();
+
+        // Nothing is played before the event loop runs, there is time to fix up the object IDs
+        if (!logFile.schema().isEmpty()) {
+            ExtensionSystem::PluginManager *pm = ExtensionSystem::PluginManager::instance();
+            UAVObjectManager *objManager = pm->getObject<UAVObjectManager>();
+            logFile.setObjectIdMap(objectIdMap(logFile.schema(), objManager));
+        }
     }
 }
 
@@ -127,12 +238,17 @@ LoggingThread::~LoggingThread()
  */
 bool LoggingThread::openFile(QString file, LoggingPlugin *parent)
 {
-    logFile.setFileName(file);
-    logFile.open(QIODevice::WriteOnly);
-
     ExtensionSystem::PluginManager *pm = ExtensionSystem::PluginManager::instance();
     UAVObjectManager *objManager = pm->getObject<UAVObjectManager>();
 
+    // Legacy logs can still be written for older GCS versions
+    if (!file.endsWith(".opl", Qt::CaseInsensitive)) {
+        logFile.setCompressed(true);
+        logFile.setSchema(objectSchema(objManager));
+    }
+    logFile.setFileName(file);
+    logFile.open(QIODevice::WriteOnly);
+
     uavTalk = new UAVTalk(&logFile, objManager);
     connect(parent, SIGNAL(stopLoggingSignal()), this, SLOT(stopLogging()));
 
@@ -333,6 +449,15 @@ bool LoggingPlugin::initialize(const QStringList & args, QString *errMsg)
 
     connect(cmd->action(), SIGNAL(triggered(bool)), this, SLOT(toggleLogging()));
 
+    // Command to convert legacy logs
+    Core::Command *convertCmd = am->registerAction(new QAction(this),
+                                                   "LoggingPlugin.ConvertLog",
+                                                   QList<int>() <<
+                                                   Core::Constants::C_GLOBAL_ID);
+    convertCmd->action()->setText(tr("Convert legacy log..."));
+    ac->addAction(convertCmd, "Logging");
+    connect(convertCmd->action(), SIGNAL(triggered(bool)), this, SLOT(convertLog()));
+
 
     mf = new LoggingGadgetFactory(this);
     addAutoReleasedObject(mf);
@@ -352,8 +477,8 @@ void LoggingPlugin::toggleLogging()
 {
     if (state == IDLE) {
         QString fileName = QFileDialog::getSaveFileName(NULL, tr("Start Log"),
-                                                        tr("OP-%0.opl").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss")),
-                                                        tr("OpenPilot Log (*.opl)"));
+                                                        tr("OP-%0.oplz").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss")),
+                                                        tr("OpenPilot Log (*.oplz);;OpenPilot Legacy Log (*.opl)"));
         if (fileName.isEmpty()) {
             return;
         }
@@ -367,6 +492,38 @@ void LoggingPlugin::toggleLogging()
 }
 
 
+/**
+ * Convert a legacy .opl log to the compressed format. Legacy logs do not
+ * describe their objects, the schema of this firmware is stored with them.
+ */
+void LoggingPlugin::convertLog()
+{
+    QString legacyFileName = QFileDialog::getOpenFileName(NULL, tr("Convert log"), QString(""),
+                                                          tr("OpenPilot Legacy Log (*.opl)"));
+
+    if (legacyFileName.isEmpty()) {
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(NULL, tr("Save converted log"),
+                                                    legacyFileName.left(legacyFileName.lastIndexOf('.')) + ".oplz",
+                                                    tr("OpenPilot Log (*.oplz)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    ExtensionSystem::PluginManager *pm = ExtensionSystem::PluginManager::instance();
+    UAVObjectManager *objManager = pm->getObject<UAVObjectManager>();
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool converted = LogFile::convertLegacyLog(legacyFileName, fileName, objectSchema(objManager));
+    QApplication::restoreOverrideCursor();
+    if (!converted) {
+        QErrorMessage err;
+        err.showMessage(tr("Unable to convert %1").arg(legacyFileName));
+        err.exec();
+    }
+}
+
 /**
  * Starts the logging thread to a certain file
  */
@@ -154,6 +154,7 @@ protected:
 
 private slots:
     void toggleLogging();
+    void convertLog();
     void startLogging(QString file);
     void stopLogging();
     void loggingStopped();
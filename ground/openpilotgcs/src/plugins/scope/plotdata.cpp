@@ -35,7 +35,8 @@ PlotData::PlotData(UAVObject *object, UAVObjectField *field, int element,
                    double plotDataSize, QPen pen, bool antialiased) :
     m_scalePower(scaleOrderFactor), m_meanSamples(meanSamples),
     m_meanSum(0.0f), m_mathFunction(mathFunction), m_correctionSum(0.0f),
-    m_correctionCount(0), m_plotDataSize(plotDataSize),
+    m_correctionCount(0), m_plotDataSize(plotDataSize), m_plotData(NULL),
+    m_yDataHistory(qMax(meanSamples, 1), true),
     m_object(object), m_field(field), m_element(element),
     m_plotCurve(NULL), m_isVisible(true), m_pen(pen), m_isEnumPlot(false)
 {
@@ -62,7 +63,6 @@ PlotData::PlotData(UAVObject *object, UAVObjectField *field, int element,
     }
 
     m_plotCurve->setPen(m_pen);
-    m_plotCurve->setSamples(m_xDataEntries, m_yDataEntries);
     m_isEnumPlot = m_field->getType() == UAVObjectField::ENUM;
 }
 
@@ -90,13 +90,17 @@ void PlotData::setVisible(bool visible)
 
 void PlotData::updatePlotData()
 {
-    m_plotCurve->setSamples(m_xDataEntries, m_yDataEntries);
+    // Qwt reads the samples in place, only the decimation and bounds need refreshing
+    QwtPlot *plot = m_plotCurve->plot();
+
+    m_plotData->update(plot ? plot->canvas()->width() : 0);
+    m_plotCurve->itemChanged();
 }
 
 bool PlotData::hasData() const
 {
     if (!m_isEnumPlot) {
-        return !m_xDataEntries.isEmpty();
+        return !m_plotData->isEmpty();
     } else {
         return !m_enumMarkerList.isEmpty();
     }
@@ -105,12 +109,18 @@ bool PlotData::hasData() const
 QString PlotData::lastDataAsString()
 {
     if (!m_isEnumPlot) {
-        return QString().sprintf("%3.10g", m_yDataEntries.last());
+        return QString().sprintf("%3.10g", m_plotData->y(m_plotData->count() - 1));
     } else {
         return m_enumMarkerList.last()->title().text();
     }
 }
 
+void PlotData::setPlotData(PlotSeriesData *plotData)
+{
+    m_plotData = plotData;
+    m_plotCurve->setData(m_plotData);
+}
+
 void PlotData::attach(QwtPlot *plot)
 {
     m_plotCurve->attach(plot);
@@ -125,17 +135,17 @@ void PlotData::visibilityChanged(QwtPlotItem *item)
     }
 }
 
-void PlotData::calcMathFunction(double currentValue)
+double PlotData::calcMathFunction(double currentValue)
 {
+    // calculate average value, the oldest value drops out when the history is full
+    if (!m_yDataHistory.isEmpty() && m_yDataHistory.count() >= m_meanSamples) {
+        m_meanSum -= m_yDataHistory.y(0);
+    }
+    m_meanSum += currentValue;
+
     // Put the new value at the back
-    m_yDataHistory.append(currentValue);
+    m_yDataHistory.append(0, currentValue);
 
-    // calculate average value
-    m_meanSum += currentValue;
-    if (m_yDataHistory.size() > m_meanSamples) {
-        m_meanSum -= m_yDataHistory.first();
-        m_yDataHistory.pop_front();
-    }
     // make sure to correct the sum every meanSamples steps to prevent it
     // from running away due to floating point rounding errors
     m_correctionSum += currentValue;
@@ -145,17 +155,16 @@ void PlotData::calcMathFunction(double currentValue)
         m_correctionCount = 0;
     }
 
-    double boxcarAvg = m_meanSum / m_yDataHistory.size();
+    double boxcarAvg = m_meanSum / m_yDataHistory.count();
     if (m_mathFunction == "Standard deviation") {
         // Calculate square of sample standard deviation, with Bessel's correction
         double stdSum = 0;
-        for (int i = 0; i < m_yDataHistory.size(); i++) {
-            stdSum += pow(m_yDataHistory.at(i) - boxcarAvg, 2) / (m_meanSamples - 1);
+        for (int i = 0; i < m_yDataHistory.count(); i++) {
+            stdSum += pow(m_yDataHistory.y(i) - boxcarAvg, 2) / (m_meanSamples - 1);
         }
-        m_yDataEntries.append(sqrt(stdSum));
-    } else {
-        m_yDataEntries.append(boxcarAvg);
+        return sqrt(stdSum);
     }
+    return boxcarAvg;
 }
 
 QwtPlotMarker *PlotData::createMarker(QString value)
@@ -186,22 +195,15 @@ bool SequentialPlotData::append(UAVObject *obj)
 {
     if (m_object == obj && m_field) {
         if (!m_isEnumPlot) {
-            double currentValue = m_field->getValue(m_element).toDouble() * pow(10, m_scalePower);
+            double currentValue = m_field->getDouble(m_element) * pow(10, m_scalePower);
 
             // Perform scope math, if necessary
             if (m_mathFunction == "Boxcar average" || m_mathFunction == "Standard deviation") {
-                calcMathFunction(currentValue);
-            } else {
-                m_yDataEntries.append(currentValue);
+                currentValue = calcMathFunction(currentValue);
             }
 
-            if (m_yDataEntries.size() > m_plotDataSize) {
-                // If new data overflows the window, remove old data...
-                m_yDataEntries.pop_front();
-            } else {
-                // ...otherwise, add a new y point at position xData
-                m_xDataEntries.insert(m_xDataEntries.size(), m_xDataEntries.size());
-            }
+            // Once the window is full the oldest sample is dropped and the others shift left
+            m_plotData->append(0, currentValue);
             return true;
         } else {
             // Enum markers
@@ -231,16 +233,14 @@ bool ChronoPlotData::append(UAVObject *obj)
 
         double xValue = NOW.toTime_t() + NOW.time().msec() / 1000.0;
         if (!m_isEnumPlot) {
-            double currentValue = m_field->getValue(m_element).toDouble() * pow(10, m_scalePower);
+            double currentValue = m_field->getDouble(m_element) * pow(10, m_scalePower);
 
             // Perform scope math, if necessary
             if (m_mathFunction == "Boxcar average" || m_mathFunction == "Standard deviation") {
-                calcMathFunction(currentValue);
-            } else {
-                m_yDataEntries.append(currentValue);
+                currentValue = calcMathFunction(currentValue);
             }
 
-            m_xDataEntries.append(xValue);
+            m_plotData->append(xValue, currentValue);
         } else {
             // Enum markers
             QString value = m_field->getValue(m_element).toString();
@@ -264,10 +264,9 @@ bool ChronoPlotData::append(UAVObject *obj)
 
 void ChronoPlotData::removeStaleData()
 {
-    while (!m_xDataEntries.isEmpty() &&
-           (m_xDataEntries.last() - m_xDataEntries.first()) > m_plotDataSize) {
-        m_yDataEntries.pop_front();
-        m_xDataEntries.pop_front();
+    while (!m_plotData->isEmpty() &&
+           (m_plotData->x(m_plotData->count() - 1) - m_plotData->x(0)) > m_plotDataSize) {
+        m_plotData->removeFirst();
     }
     while (!m_enumMarkerList.isEmpty() &&
            (m_enumMarkerList.last()->xValue() - m_enumMarkerList.first()->xValue()) > m_plotDataSize) {
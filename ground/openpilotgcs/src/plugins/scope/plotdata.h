@@ -29,6 +29,7 @@
 #define PLOTDATA_H
 
 #include "uavobject.h"
+#include "plotseriesdata.h"
 
 #include "qwt/src/qwt.h"
 #include "qwt/src/qwt_plot.h"
@@ -112,9 +113,9 @@ protected:
     int m_correctionCount;
     double m_plotDataSize;
 
-    QVector<double> m_xDataEntries;
-    QVector<double> m_yDataEntries;
-    QVector<double> m_yDataHistory;
+    // Owned by m_plotCurve
+    PlotSeriesData *m_plotData;
+    PlotSeriesData m_yDataHistory;
 
     UAVObject *m_object;
     UAVObjectField *m_field;
@@ -126,7 +127,8 @@ protected:
     bool m_isVisible;
     QPen m_pen;
     bool m_isEnumPlot;
-    virtual void calcMathFunction(double currentValue);
+    double calcMathFunction(double currentValue);
+    void setPlotData(PlotSeriesData *plotData);
     QwtPlotMarker *createMarker(QString value);
 };
 
@@ -141,7 +143,11 @@ public:
                        int scaleFactor, int meanSamples, QString mathFunction,
                        double plotDataSize, QPen pen, bool antialiased)
         : PlotData(object, field, element, scaleFactor, meanSamples,
-                   mathFunction, plotDataSize, pen, antialiased) {}
+                   mathFunction, plotDataSize, pen, antialiased)
+    {
+        // A fixed number of samples, plotted against their position
+        setPlotData(new PlotSeriesData(qMax((int)plotDataSize, 1), true));
+    }
     ~SequentialPlotData() {}
 
     bool append(UAVObject *obj);
@@ -163,7 +169,9 @@ public:
                    double plotDataSize, QPen pen, bool antialiased)
         : PlotData(object, field, element, scaleFactor, meanSamples,
                    mathFunction, plotDataSize, pen, antialiased)
-    {}
+    {
+        setPlotData(new PlotSeriesData());
+    }
     ~ChronoPlotData() {}
 
     bool append(UAVObject *obj);
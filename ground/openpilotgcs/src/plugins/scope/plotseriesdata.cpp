@@ -0,0 +1,195 @@
+/**
+ ******************************************************************************
+ *
+ * @file       plotseriesdata.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @addtogroup GCSPlugins GCS Plugins
+ * @{
+ * @addtogroup ScopePlugin Scope Gadget Plugin
+ * @{
+ * @brief Circular sample storage for the scope curves
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "plotseriesdata.h"
+#include <math.h>
+
+#define INITIAL_SIZE 256
+
+PlotSeriesData::PlotSeriesData(int capacity, bool indexed) :
+    m_capacity(qMax(capacity, 0)), m_head(0), m_count(0),
+    m_indexed(indexed), m_decimated(false)
+{
+    if (m_capacity > 0) {
+        m_y.resize(m_capacity);
+        if (!m_indexed) {
+            m_x.resize(m_capacity);
+        }
+    }
+}
+
+void PlotSeriesData::append(double x, double y)
+{
+    if (m_count == m_y.size()) {
+        if (m_capacity > 0) {
+            // Full, overwrite the oldest sample
+            m_head = at(1);
+            m_count--;
+        } else {
+            grow();
+        }
+    }
+    int pos = at(m_count);
+    m_y[pos] = y;
+    if (!m_indexed) {
+        m_x[pos] = x;
+    }
+    m_count++;
+}
+
+void PlotSeriesData::removeFirst(int count)
+{
+    count    = qBound(0, count, m_count);
+    m_head   = m_count > count ? at(count) : 0;
+    m_count -= count;
+}
+
+void PlotSeriesData::clear()
+{
+    m_head      = 0;
+    m_count     = 0;
+    m_decimated = false;
+    m_decimatedSamples.resize(0);
+    d_boundingRect = QRectF(0.0, 0.0, -1.0, -1.0);
+}
+
+void PlotSeriesData::grow()
+{
+    int size = qMax(INITIAL_SIZE, m_y.size() * 2);
+    QVector<double> x(m_indexed ? 0 : size);
+    QVector<double> y(size);
+
+    for (int i = 0; i < m_count; i++) {
+        y[i] = m_y[at(i)];
+        if (!m_indexed) {
+            x[i] = m_x[at(i)];
+        }
+    }
+    m_x    = x;
+    m_y    = y;
+    m_head = 0;
+}
+
+void PlotSeriesData::update(int pixelWidth)
+{
+    m_decimated = false;
+    m_decimatedSamples.resize(0);
+
+    if (m_count == 0) {
+        d_boundingRect = QRectF(0.0, 0.0, -1.0, -1.0);
+        return;
+    }
+
+    double minX = x(0), maxX = x(0);
+    double minY = y(0), maxY = y(0);
+    for (int i = 1; i < m_count; i++) {
+        double sampleY = y(i);
+        minY = qMin(minY, sampleY);
+        maxY = qMax(maxY, sampleY);
+        if (!m_indexed) {
+            double sampleX = m_x[at(i)];
+            minX = qMin(minX, sampleX);
+            maxX = qMax(maxX, sampleX);
+        }
+    }
+    if (m_indexed) {
+        maxX = m_count - 1;
+    }
+    d_boundingRect = QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+
+    if (pixelWidth > 0 && m_count > MIN_DECIMATION * pixelWidth) {
+        decimate(pixelWidth);
+    }
+}
+
+/**
+ * Keep the lowest and the highest sample of each pixel column, in the order they
+ * were appended, so that spikes survive however long the window is.
+ */
+void PlotSeriesData::decimate(int pixelWidth)
+{
+    // Pixel columns follow the visible scale, when zoomed in there are fewer samples per column
+    double span = m_rectOfInterest.isValid() ? m_rectOfInterest.width() : d_boundingRect.width();
+
+    if (!(span > 0.0)) {
+        return;
+    }
+    double columnWidth = span / pixelWidth;
+    double origin = x(0);
+    qint64 column = 0;
+    int minIndex  = 0;
+    int maxIndex  = 0;
+
+    m_decimatedSamples.reserve(2 * pixelWidth + 2);
+    for (int i = 1; i <= m_count; i++) {
+        qint64 sampleColumn = i < m_count ? (qint64)floor((x(i) - origin) / columnWidth) : column + 1;
+        if (sampleColumn != column) {
+            int first = qMin(minIndex, maxIndex);
+            int last  = qMax(minIndex, maxIndex);
+            m_decimatedSamples.append(QPointF(x(first), y(first)));
+            if (last != first) {
+                m_decimatedSamples.append(QPointF(x(last), y(last)));
+            }
+            column   = sampleColumn;
+            minIndex = maxIndex = i;
+        } else {
+            if (y(i) < y(minIndex)) {
+                minIndex = i;
+            }
+            if (y(i) > y(maxIndex)) {
+                maxIndex = i;
+            }
+        }
+    }
+    m_decimated = m_decimatedSamples.size() < m_count;
+    if (!m_decimated) {
+        m_decimatedSamples.resize(0);
+    }
+}
+
+size_t PlotSeriesData::size() const
+{
+    return m_decimated ? m_decimatedSamples.size() : m_count;
+}
+
+QPointF PlotSeriesData::sample(size_t i) const
+{
+    if (m_decimated) {
+        return m_decimatedSamples[i];
+    }
+    return QPointF(x(i), y(i));
+}
+
+QRectF PlotSeriesData::boundingRect() const
+{
+    return d_boundingRect;
+}
+
+void PlotSeriesData::setRectOfInterest(const QRectF &rect)
+{
+    m_rectOfInterest = rect;
+}
@@ -0,0 +1,110 @@
+/**
+ ******************************************************************************
+ *
+ * @file       plotseriesdata.h
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @addtogroup GCSPlugins GCS Plugins
+ * @{
+ * @addtogroup ScopePlugin Scope Gadget Plugin
+ * @{
+ * @brief Circular sample storage for the scope curves
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef PLOTSERIESDATA_H
+#define PLOTSERIESDATA_H
+
+#include "qwt/src/qwt_series_data.h"
+
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+
+/*!
+   \brief Circular buffer of curve samples, read by Qwt in place.
+
+   Appending and dropping the oldest samples are O(1). With a capacity the
+   oldest sample is overwritten once the buffer is full, without one it grows.
+   When indexed, the x value of a sample is its position in the buffer and
+   only the y values are stored.
+
+   update() must be called before a replot, it refreshes the bounding rect and,
+   when there are more samples than the curve is wide in pixels, replaces the
+   series seen by Qwt with the min and max of each pixel column.
+ */
+class PlotSeriesData : public QwtSeriesData<QPointF> {
+public:
+    PlotSeriesData(int capacity = 0, bool indexed = false);
+
+    void append(double x, double y);
+    void removeFirst(int count = 1);
+    void clear();
+
+    int count() const
+    {
+        return m_count;
+    }
+    bool isEmpty() const
+    {
+        return m_count == 0;
+    }
+    double x(int i) const
+    {
+        return m_indexed ? i : m_x[at(i)];
+    }
+    double y(int i) const
+    {
+        return m_y[at(i)];
+    }
+
+    void update(int pixelWidth);
+    bool isDecimated() const
+    {
+        return m_decimated;
+    }
+
+    // QwtSeriesData
+    size_t size() const;
+    QPointF sample(size_t i) const;
+    QRectF boundingRect() const;
+    void setRectOfInterest(const QRectF &rect);
+
+private:
+    // Below this many samples per pixel the curve is drawn as is
+    static const int MIN_DECIMATION = 4;
+
+    QVector<double> m_x;
+    QVector<double> m_y;
+    int m_capacity;
+    int m_head;
+    int m_count;
+    bool m_indexed;
+    bool m_decimated;
+    QVector<QPointF> m_decimatedSamples;
+    QRectF m_rectOfInterest;
+
+    int at(int i) const
+    {
+        int pos = m_head + i;
+
+        return pos < m_y.size() ? pos : pos - m_y.size();
+    }
+    void grow();
+    void decimate(int pixelWidth);
+};
+
+#endif // PLOTSERIESDATA_H
@@ -9,6 +9,7 @@ include (scope_dependencies.pri)
 HEADERS += \
     scopeplugin.h \
     plotdata.h \
+    plotseriesdata.h \
     scope_global.h \
     scopegadgetoptionspage.h \
     scopegadgetconfiguration.h \
@@ -19,6 +20,7 @@ HEADERS += \
 SOURCES += \
     scopeplugin.cpp \
     plotdata.cpp \
+    plotseriesdata.cpp \
     scopegadgetoptionspage.cpp \
     scopegadgetconfiguration.cpp \
     scopegadget.cpp \
@@ -0,0 +1,224 @@
+/**
+ ******************************************************************************
+ *
+ * @file       tst_plotseriesdata.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Tests and benchmarks for the scope sample storage
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "plotseriesdata.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
+#include <QtTest/QtTest>
+#include <math.h>
+
+// 10 minutes of a 100 Hz object, a long chrono window
+#define WINDOW_SAMPLES 60000
+#define PIXEL_WIDTH    800
+
+class tst_PlotSeriesData : public QObject {
+    Q_OBJECT
+
+private slots:
+    void fixedCapacity();
+    void growAndRemove();
+    void boundingRect();
+    void decimationKeepsExtremes();
+    void noDecimationWhenSparse();
+    void benchmarkAppend();
+    void benchmarkQVector();
+    void benchmarkUpdate();
+};
+
+void tst_PlotSeriesData::fixedCapacity()
+{
+    PlotSeriesData data(5, true);
+
+    for (int i = 0; i < 12; i++) {
+        data.append(0, i);
+    }
+    QCOMPARE(data.count(), 5);
+    QCOMPARE((int)data.size(), 5);
+    for (int i = 0; i < 5; i++) {
+        QCOMPARE(data.x(i), (double)i);
+        QCOMPARE(data.y(i), (double)(7 + i));
+        QCOMPARE(data.sample(i).y(), (double)(7 + i));
+    }
+}
+
+void tst_PlotSeriesData::growAndRemove()
+{
+    PlotSeriesData data;
+    int removed = 0;
+
+    for (int i = 0; i < 1000; i++) {
+        data.append(i * 0.01, i);
+        if (i % 3 == 0) {
+            data.removeFirst();
+            removed++;
+        }
+    }
+    QCOMPARE(data.count(), 1000 - removed);
+    for (int i = 0; i < data.count(); i++) {
+        QCOMPARE(data.y(i), (double)(i + removed));
+    }
+
+    data.removeFirst(data.count() + 10);
+    QVERIFY(data.isEmpty());
+    data.append(1.0, 2.0);
+    QCOMPARE(data.y(0), 2.0);
+}
+
+void tst_PlotSeriesData::boundingRect()
+{
+    PlotSeriesData data;
+
+    data.append(10.0, -1.0);
+    data.append(11.0, 5.0);
+    data.append(12.0, 2.0);
+    data.update(PIXEL_WIDTH);
+    QCOMPARE(data.boundingRect(), QRectF(QPointF(10.0, -1.0), QPointF(12.0, 5.0)));
+
+    data.clear();
+    data.update(PIXEL_WIDTH);
+    QVERIFY(!data.boundingRect().isValid());
+}
+
+void tst_PlotSeriesData::decimationKeepsExtremes()
+{
+    PlotSeriesData data;
+
+    for (int i = 0; i < WINDOW_SAMPLES; i++) {
+        double value = sin(i * 0.001);
+        // Single sample spikes must still be drawn
+        if (i == 12345) {
+            value = 10.0;
+        } else if (i == 54321) {
+            value = -10.0;
+        }
+        data.append(i * 0.01, value);
+    }
+    data.update(PIXEL_WIDTH);
+
+    QVERIFY(data.isDecimated());
+    QVERIFY((int)data.size() <= 2 * PIXEL_WIDTH + 2);
+
+    double minY = 0, maxY = 0, lastX = -1;
+    for (size_t i = 0; i < data.size(); i++) {
+        QPointF point = data.sample(i);
+        QVERIFY(point.x() > lastX);
+        lastX = point.x();
+        minY  = qMin(minY, point.y());
+        maxY  = qMax(maxY, point.y());
+    }
+    QCOMPARE(minY, -10.0);
+    QCOMPARE(maxY, 10.0);
+    QCOMPARE(data.sample(0).x(), 0.0);
+    QCOMPARE(lastX, (WINDOW_SAMPLES - 1) * 0.01);
+}
+
+void tst_PlotSeriesData::noDecimationWhenSparse()
+{
+    PlotSeriesData data;
+
+    for (int i = 0; i < PIXEL_WIDTH; i++) {
+        data.append(i, i);
+    }
+    data.update(PIXEL_WIDTH);
+    QVERIFY(!data.isDecimated());
+    QCOMPARE((int)data.size(), PIXEL_WIDTH);
+
+    // Zoomed in far enough every sample gets its own pixel column
+    for (int i = PIXEL_WIDTH; i < 10 * PIXEL_WIDTH; i++) {
+        data.append(i, i);
+    }
+    data.setRectOfInterest(QRectF(0, 0, PIXEL_WIDTH / 2, 1));
+    data.update(PIXEL_WIDTH);
+    QVERIFY(!data.isDecimated());
+}
+
+// Full window, every new sample drops the oldest one
+void tst_PlotSeriesData::benchmarkAppend()
+{
+    PlotSeriesData data(WINDOW_SAMPLES, true);
+    double value = 0;
+
+    QBENCHMARK {
+        for (int i = 0; i < 1000; i++) {
+            data.append(0, value++);
+        }
+    }
+    QVERIFY(data.count() > 0);
+}
+
+// How the scope kept its samples before
+void tst_PlotSeriesData::benchmarkQVector()
+{
+    QVector<double> data(WINDOW_SAMPLES);
+    double value = 0;
+
+    QBENCHMARK {
+        for (int i = 0; i < 1000; i++) {
+            data.append(value++);
+            data.pop_front();
+        }
+    }
+    QCOMPARE(data.size(), WINDOW_SAMPLES);
+}
+
+// Report what one replot of a long window costs, compared with copying it into the curve
+void tst_PlotSeriesData::benchmarkUpdate()
+{
+    const int replots = 200;
+    PlotSeriesData data;
+    QVector<double> x, y;
+    QElapsedTimer timer;
+
+    for (int i = 0; i < WINDOW_SAMPLES; i++) {
+        data.append(i * 0.01, sin(i * 0.001));
+        x.append(i * 0.01);
+        y.append(sin(i * 0.001));
+    }
+
+    timer.start();
+    for (int n = 0; n < replots; n++) {
+        data.update(PIXEL_WIDTH);
+    }
+    qint64 updateNs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    timer.restart();
+    QVector<QPointF> copy;
+    for (int n = 0; n < replots; n++) {
+        copy.resize(0);
+        for (int i = 0; i < WINDOW_SAMPLES; i++) {
+            copy.append(QPointF(x[i], y[i]));
+        }
+    }
+    qint64 copyNs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    QVERIFY(copy.size() == WINDOW_SAMPLES);
+    qDebug("update(): %.1f us, %d points drawn instead of %d", updateNs / 1000.0 / replots, (int)data.size(), WINDOW_SAMPLES);
+    qDebug("copy:     %.1f us", copyNs / 1000.0 / replots);
+}
+
+QTEST_MAIN(tst_PlotSeriesData)
+
+#include "tst_plotseriesdata.moc"
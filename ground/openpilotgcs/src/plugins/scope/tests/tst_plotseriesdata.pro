@@ -0,0 +1,11 @@
+QT += testlib
+TARGET = tst_plotseriesdata
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+INCLUDEPATH += .. ../../../libs
+
+SOURCES += tst_plotseriesdata.cpp \
+    ../plotseriesdata.cpp
+HEADERS += ../plotseriesdata.h
@@ -282,7 +282,7 @@ public:
 
     void update()
     {
-        double value = m_field->getValue(m_index).toDouble();
+        double value = m_field->getDouble(m_index);
 
         if (data() != value || changed()) {
             TreeItem::setData(value);
@@ -0,0 +1,255 @@
+/**
+ ******************************************************************************
+ *
+ * @file       tst_uavobjectfield.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Accessor tests and benchmarks for UAVObjectField
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uavdataobject.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
+#include <QtTest/QtTest>
+
+#define SAMPLES_PER_BURST 1000
+
+// One field of every numeric type, laid out like a generated object
+struct __attribute__((packed)) TestData {
+    qint8   Int8[2];
+    qint16  Int16[2];
+    qint32  Int32;
+    quint8  UInt8[3];
+    quint16 UInt16;
+    quint32 UInt32;
+    float   Float[4];
+    quint8  Enum[2];
+    quint8  Bits;
+};
+
+class TestObject : public UAVDataObject {
+public:
+    TestObject() : UAVDataObject(0x12345678, true, false, QString("TestObject"))
+    {
+        QList<UAVObjectField *> fields;
+        fields.append(new UAVObjectField(QString("Int8"), QString(""), QString(""), UAVObjectField::INT8, 2, QStringList()));
+        fields.append(new UAVObjectField(QString("Int16"), QString(""), QString(""), UAVObjectField::INT16, 2, QStringList()));
+        fields.append(new UAVObjectField(QString("Int32"), QString(""), QString(""), UAVObjectField::INT32, 1, QStringList()));
+        fields.append(new UAVObjectField(QString("UInt8"), QString(""), QString(""), UAVObjectField::UINT8, 3, QStringList()));
+        fields.append(new UAVObjectField(QString("UInt16"), QString(""), QString(""), UAVObjectField::UINT16, 1, QStringList()));
+        fields.append(new UAVObjectField(QString("UInt32"), QString(""), QString(""), UAVObjectField::UINT32, 1, QStringList()));
+        fields.append(new UAVObjectField(QString("Float"), QString(""), QString(""), UAVObjectField::FLOAT32, 4, QStringList()));
+        fields.append(new UAVObjectField(QString("Enum"), QString(""), QString(""), UAVObjectField::ENUM, 2, QStringList() << "Off" << "2" << "3.5"));
+        fields.append(new UAVObjectField(QString("Bits"), QString(""), QString(""), UAVObjectField::BITFIELD, 8, QStringList()));
+        initializeFields(fields, (quint8 *)&data, sizeof(data));
+
+        data.Int8[0]  = -12;
+        data.Int8[1]  = 127;
+        data.Int16[0] = -30000;
+        data.Int16[1] = 1234;
+        data.Int32    = -123456789;
+        data.UInt8[0] = 0;
+        data.UInt8[1] = 200;
+        data.UInt8[2] = 255;
+        data.UInt16   = 65000;
+        data.UInt32   = 4000000000u;
+        data.Float[0] = 1.5f;
+        data.Float[1] = -0.1f;
+        data.Float[2] = 3.0e10f;
+        data.Float[3] = 0.0f;
+        data.Enum[0]  = 2;
+        data.Enum[1]  = 0;
+        data.Bits     = 0xA5;
+    }
+
+    Metadata getDefaultMetadata()
+    {
+        Metadata metadata;
+
+        memset(&metadata, 0, sizeof(metadata));
+        return metadata;
+    }
+
+    UAVDataObject *clone(quint32 instID)
+    {
+        TestObject *obj = new TestObject();
+
+        obj->initialize(instID, getMetaObject());
+        return obj;
+    }
+
+    UAVDataObject *dirtyClone()
+    {
+        return new TestObject();
+    }
+
+    TestData data;
+};
+
+class tst_UAVObjectField : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void doubleMatchesVariant();
+    void doublesSpan();
+    void rawElements();
+    void outOfBounds();
+    void benchmarkVariant();
+    void benchmarkDouble();
+    void benchmarkScopeRate();
+
+private:
+    TestObject *obj;
+    UAVObjectField *floatField;
+};
+
+void tst_UAVObjectField::initTestCase()
+{
+    obj = new TestObject();
+    floatField = obj->getField("Float");
+    QVERIFY(floatField != NULL);
+}
+
+void tst_UAVObjectField::cleanupTestCase()
+{
+    delete obj;
+}
+
+void tst_UAVObjectField::doubleMatchesVariant()
+{
+    foreach(UAVObjectField * field, obj->getFields()) {
+        for (quint32 n = 0; n < field->getNumElements(); n++) {
+            QCOMPARE(field->getDouble(n), field->getValue(n).toDouble());
+        }
+    }
+    QCOMPARE(obj->getField("Enum")->getDouble(0), 3.5);
+    QCOMPARE(obj->getField("Bits")->getDouble(2), 1.0);
+    QCOMPARE(obj->getField("Bits")->getDouble(3), 0.0);
+}
+
+void tst_UAVObjectField::doublesSpan()
+{
+    double values[8];
+
+    QCOMPARE(floatField->getDoubles(values), (quint32)4);
+    for (quint32 n = 0; n < 4; n++) {
+        QCOMPARE(values[n], floatField->getValue(n).toDouble());
+    }
+
+    // A span running past the end is clipped
+    UAVObjectField *bits = obj->getField("Bits");
+    QCOMPARE(bits->getDoubles(values, 6, 8), (quint32)2);
+    QCOMPARE(values[0], 0.0);
+    QCOMPARE(values[1], 1.0);
+}
+
+void tst_UAVObjectField::rawElements()
+{
+    float floats[4];
+
+    QCOMPARE(floatField->getElements(floats), (quint32)4);
+    QVERIFY(memcmp(floats, obj->data.Float, sizeof(floats)) == 0);
+
+    qint16 int16;
+    QCOMPARE(obj->getField("Int16")->getElements(&int16, 1, 1), (quint32)1);
+    QCOMPARE(int16, (qint16)1234);
+
+    // Enums read as their option index
+    quint8 options[2];
+    QCOMPARE(obj->getField("Enum")->getElements(options), (quint32)2);
+    QCOMPARE(options[0], (quint8)2);
+
+    // A mismatching type is refused
+    QCOMPARE(floatField->getElements((qint32 *)floats), (quint32)0);
+    QCOMPARE(obj->getField("Bits")->getElements(options), (quint32)0);
+}
+
+void tst_UAVObjectField::outOfBounds()
+{
+    double value;
+
+    QCOMPARE(floatField->getDouble(4), 0.0);
+    QCOMPARE(floatField->getDoubles(&value, 4, 1), (quint32)0);
+    QCOMPARE(floatField->getElements((float *)&value, 4, 1), (quint32)0);
+}
+
+// What scope used to do for each sample
+void tst_UAVObjectField::benchmarkVariant()
+{
+    double sum = 0;
+
+    QBENCHMARK {
+        for (int n = 0; n < SAMPLES_PER_BURST; n++) {
+            sum += floatField->getValue(n & 3).toDouble();
+        }
+    }
+    QVERIFY(sum != 0);
+}
+
+void tst_UAVObjectField::benchmarkDouble()
+{
+    double sum = 0;
+
+    QBENCHMARK {
+        for (int n = 0; n < SAMPLES_PER_BURST; n++) {
+            sum += floatField->getDouble(n & 3);
+        }
+    }
+    QVERIFY(sum != 0);
+}
+
+// Report the samples/s of each accessor, one sample being one element as scope plots it
+void tst_UAVObjectField::benchmarkScopeRate()
+{
+    const int samples = 4000000;
+    double sum = 0;
+    double values[4];
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int n = 0; n < samples; n++) {
+        sum += floatField->getValue(n & 3).toDouble();
+    }
+    qint64 variantNs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    timer.restart();
+    for (int n = 0; n < samples; n++) {
+        sum += floatField->getDouble(n & 3);
+    }
+    qint64 doubleNs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    timer.restart();
+    for (int n = 0; n < samples; n += 4) {
+        floatField->getDoubles(values);
+        sum += values[0] + values[1] + values[2] + values[3];
+    }
+    qint64 spanNs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    QVERIFY(sum != 0);
+    qDebug("getValue().toDouble(): %.0f samples/s", samples * 1e9 / variantNs);
+    qDebug("getDouble():           %.0f samples/s (%.1fx)", samples * 1e9 / doubleNs, (double)variantNs / doubleNs);
+    qDebug("getDoubles():          %.0f samples/s (%.1fx)", samples * 1e9 / spanNs, (double)variantNs / spanNs);
+}
+
+QTEST_MAIN(tst_UAVObjectField)
+
+#include "tst_uavobjectfield.moc"
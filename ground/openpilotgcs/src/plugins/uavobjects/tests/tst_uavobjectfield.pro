@@ -0,0 +1,19 @@
+QT += widgets testlib
+TARGET = tst_uavobjectfield
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+DEFINES += UAVOBJECTS_LIBRARY QTCREATOR_UTILS_STATIC_LIB
+INCLUDEPATH += .. ../../../libs
+
+SOURCES += tst_uavobjectfield.cpp \
+    ../uavobjectfield.cpp \
+    ../uavobject.cpp \
+    ../uavmetaobject.cpp \
+    ../uavdataobject.cpp \
+    ../../../libs/utils/crc.cpp
+HEADERS += ../uavobjectfield.h \
+    ../uavobject.h \
+    ../uavmetaobject.h \
+    ../uavdataobject.h
@@ -0,0 +1,242 @@
+/**
+ ******************************************************************************
+ *
+ * @file       tst_uavobjectmanager.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Lookup tests and benchmarks for the UAVObjectManager
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uavobjectmanager.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
+#include <QtTest/QtTest>
+
+// Roughly the number of object types of a current firmware, a few of them with many instances
+#define NUM_OBJECTS       150
+#define MULTI_INSTANCES   20
+#define BASE_OBJID        0x10000000
+#define OBJID_STRIDE      0x01234566
+#define LOOKUPS_PER_BURST 1000
+
+// A minimal data object, the generated ones are not available to this test
+class TestObject : public UAVDataObject {
+public:
+    TestObject(quint32 objId, bool isSingleInst, const QString &name) :
+        UAVDataObject(objId, isSingleInst, false, name), value(0)
+    {
+        QList<UAVObjectField *> fields;
+        fields.append(new UAVObjectField(QString("Value"), QString(""), QString(""), UAVObjectField::UINT32, 1, QStringList()));
+        initializeFields(fields, (quint8 *)&value, sizeof(value));
+    }
+
+    Metadata getDefaultMetadata()
+    {
+        Metadata metadata;
+
+        memset(&metadata, 0, sizeof(metadata));
+        return metadata;
+    }
+
+    UAVDataObject *clone(quint32 instID)
+    {
+        TestObject *obj = new TestObject(getObjID(), isSingleInstance(), getName());
+
+        obj->initialize(instID, getMetaObject());
+        return obj;
+    }
+
+    UAVDataObject *dirtyClone()
+    {
+        return new TestObject(getObjID(), isSingleInstance(), getName());
+    }
+
+private:
+    quint32 value;
+};
+
+class tst_UAVObjectManager : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void lookupById();
+    void lookupByName();
+    void lookupMissing();
+    void instancesAddedLater();
+    void benchmarkById();
+    void benchmarkByName();
+    void benchmarkTelemetryRate();
+
+private:
+    UAVObjectManager *manager;
+    QList<quint32> objIds;
+    QStringList names;
+    QList<quint32> numInstances;
+};
+
+static quint32 objIdAt(int i)
+{
+    // Keep the low bit clear, the metaobject of each type uses objId + 1
+    return (BASE_OBJID + i * OBJID_STRIDE) & ~1u;
+}
+
+void tst_UAVObjectManager::initTestCase()
+{
+    manager = new UAVObjectManager();
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        bool multi = (i % 10 == 0);
+        QString name = QString("TestObject%1").arg(i);
+        objIds << objIdAt(i);
+        names << name;
+        numInstances << (multi ? MULTI_INSTANCES : 1);
+        QVERIFY(manager->registerObject(new TestObject(objIdAt(i), !multi, name)));
+        for (int inst = 1; inst < (multi ? MULTI_INSTANCES : 1); inst++) {
+            QVERIFY(manager->registerObject(new TestObject(objIdAt(i), false, name)));
+        }
+    }
+}
+
+void tst_UAVObjectManager::cleanupTestCase()
+{
+    // The manager does not own the objects, they live until the process exits like in the GCS
+    delete manager;
+}
+
+void tst_UAVObjectManager::lookupById()
+{
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        for (quint32 inst = 0; inst < numInstances[i]; inst++) {
+            UAVObject *obj = manager->getObject(objIds[i], inst);
+            QVERIFY(obj != NULL);
+            QCOMPARE(obj->getObjID(), objIds[i]);
+            QCOMPARE(obj->getInstID(), inst);
+        }
+        QCOMPARE(manager->getNumInstances(objIds[i]), (qint32)numInstances[i]);
+        QCOMPARE(manager->getObjectInstances(objIds[i]).length(), (int)numInstances[i]);
+
+        // The metaobject is registered right after its data object
+        UAVObject *meta = manager->getObject(objIds[i] + 1);
+        QVERIFY(meta != NULL);
+        QVERIFY(meta->isMetaDataObject());
+        QCOMPARE(meta->getName(), names[i] + "Meta");
+    }
+}
+
+void tst_UAVObjectManager::lookupByName()
+{
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        UAVObject *obj = manager->getObject(names[i], numInstances[i] - 1);
+        QVERIFY(obj != NULL);
+        QCOMPARE(obj->getObjID(), objIds[i]);
+        QCOMPARE(obj->getInstID(), numInstances[i] - 1);
+        QCOMPARE(manager->getNumInstances(names[i]), (qint32)numInstances[i]);
+        QVERIFY(manager->getObject(names[i] + "Meta") == manager->getObject(objIds[i] + 1));
+    }
+}
+
+void tst_UAVObjectManager::lookupMissing()
+{
+    QVERIFY(manager->getObject(0xdeadbeee) == NULL);
+    QVERIFY(manager->getObject(QString("NoSuchObject")) == NULL);
+    QVERIFY(manager->getObject(objIds[0], MULTI_INSTANCES) == NULL);
+    QVERIFY(manager->getObject(objIds[1], 1) == NULL);
+    QCOMPARE(manager->getNumInstances(0xdeadbeee), -1);
+    QVERIFY(manager->getObjectInstances(QString("NoSuchObject")).isEmpty());
+
+    // Single instance objects can not get a second instance
+    QVERIFY(!manager->registerObject(new TestObject(objIds[1], true, names[1])));
+}
+
+void tst_UAVObjectManager::instancesAddedLater()
+{
+    // Registering an instance out of order fills the gap, all of them must be found
+    TestObject *refObj = dynamic_cast<TestObject *>(manager->getObject(objIds[0]));
+
+    QVERIFY(refObj != NULL);
+    UAVDataObject *obj = refObj->clone(MULTI_INSTANCES + 5);
+    QVERIFY(manager->registerObject(obj));
+    QCOMPARE(manager->getNumInstances(objIds[0]), (qint32)MULTI_INSTANCES + 6);
+    for (quint32 inst = 0; inst < MULTI_INSTANCES + 6; inst++) {
+        UAVObject *found = manager->getObject(objIds[0], inst);
+        QVERIFY(found != NULL);
+        QCOMPARE(found->getInstID(), inst);
+    }
+    QVERIFY(manager->getObject(objIds[0], MULTI_INSTANCES + 5) == obj);
+    numInstances[0] = MULTI_INSTANCES + 6;
+}
+
+// UAVTalk resolves every received packet by object and instance ID
+void tst_UAVObjectManager::benchmarkById()
+{
+    int found = 0;
+
+    QBENCHMARK {
+        for (int n = 0; n < LOOKUPS_PER_BURST; n++) {
+            int i = (n * 7) % NUM_OBJECTS;
+            if (manager->getObject(objIds[i], n % numInstances[i])) {
+                found++;
+            }
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+// Gadgets resolve objects by name
+void tst_UAVObjectManager::benchmarkByName()
+{
+    int found = 0;
+
+    QBENCHMARK {
+        for (int n = 0; n < LOOKUPS_PER_BURST; n++) {
+            if (manager->getObject(names[(n * 7) % NUM_OBJECTS])) {
+                found++;
+            }
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+// Report the lookup rate against what a fast link can deliver, about 5000 packets/s
+void tst_UAVObjectManager::benchmarkTelemetryRate()
+{
+    const int lookups = 1000000;
+    int found = 0;
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int n = 0; n < lookups; n++) {
+        int i = (n * 7) % NUM_OBJECTS;
+        if (manager->getObject(objIds[i], n % numInstances[i])) {
+            found++;
+        }
+    }
+    qint64 elapsed = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    QCOMPARE(found, lookups);
+    double rate = lookups * 1e9 / elapsed;
+    qDebug("%.0f lookups/s, %.1f ns per lookup, %.3f%% of one core at 5000 packets/s",
+           rate, (double)elapsed / lookups, 5000 * 100.0 / rate);
+}
+
+QTEST_MAIN(tst_UAVObjectManager)
+
+#include "tst_uavobjectmanager.moc"
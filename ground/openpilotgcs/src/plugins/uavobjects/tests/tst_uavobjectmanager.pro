@@ -0,0 +1,21 @@
+QT += widgets testlib
+TARGET = tst_uavobjectmanager
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+DEFINES += UAVOBJECTS_LIBRARY QTCREATOR_UTILS_STATIC_LIB
+INCLUDEPATH += .. ../../../libs
+
+SOURCES += tst_uavobjectmanager.cpp \
+    ../uavobjectmanager.cpp \
+    ../uavobjectfield.cpp \
+    ../uavobject.cpp \
+    ../uavmetaobject.cpp \
+    ../uavdataobject.cpp \
+    ../../../libs/utils/crc.cpp
+HEADERS += ../uavobjectmanager.h \
+    ../uavobjectfield.h \
+    ../uavobject.h \
+    ../uavmetaobject.h \
+    ../uavdataobject.h
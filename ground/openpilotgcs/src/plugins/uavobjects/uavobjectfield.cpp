@@ -28,6 +28,7 @@
 #include "uavobjectfield.h"
 #include <QtEndian>
 #include <QDebug>
+#include <QVarLengthArray>
 #include <QtWidgets>
 
 UAVObjectField::UAVObjectField(const QString & name, const QString & description, const QString & units, FieldType type, quint32 numElements, const QStringList & options, const QString &limits)
@@ -695,9 +696,11 @@ QString UAVObjectField::toString()
 {
     QString sout;
 
+    QVarLengthArray<double, 16> values(numElements);
+    getDoubles(values.data(), 0, numElements);
     sout.append(QString("%1: [ ").arg(name));
     for (unsigned int n = 0; n < numElements; ++n) {
-        sout.append(QString("%1 ").arg(getDouble(n)));
+        sout.append(QString("%1 ").arg(values[n]));
     }
     sout.append(QString("] %1\n").arg(units));
     return sout;
@@ -747,7 +750,12 @@ void UAVObjectField::toJson(QJsonObject &jsonObject)
     for (unsigned int n = 0; n < numElements; ++n) {
         QJsonObject value;
         value["name"]  = getElementNames().at(n);
-        value["value"] = QJsonValue::fromVariant(getValue(n));
+        if (type == ENUM || type == STRING) {
+            value["value"] = QJsonValue::fromVariant(getValue(n));
+        } else {
+            // JSON numbers are doubles anyway, skip the QVariant
+            value["value"] = getDouble(n);
+        }
         values.append(value);
     }
     jsonObject["values"] = values;
@@ -1178,11 +1186,114 @@ void UAVObjectField::setValue(const QVariant & value, quint32 index)
     }
 }
 
-double UAVObjectField::getDouble(quint32 index)
+/**
+ * Read one element as a double without boxing it in a QVariant, the result is
+ * the same as getValue(index).toDouble(). The object mutex must be held.
+ */
+double UAVObjectField::elementToDouble(quint32 index)
 {
+    const quint8 *element = &data[offset + numBytesPerElement * index];
+
+    switch (type) {
+    case INT8:
+        return *(const qint8 *)element;
+
+    case INT16:
+    {
+        qint16 tmpint16;
+        memcpy(&tmpint16, element, sizeof(tmpint16));
+        return tmpint16;
+    }
+    case INT32:
+    {
+        qint32 tmpint32;
+        memcpy(&tmpint32, element, sizeof(tmpint32));
+        return tmpint32;
+    }
+    case UINT8:
+        return *element;
+
+    case UINT16:
+    {
+        quint16 tmpuint16;
+        memcpy(&tmpuint16, element, sizeof(tmpuint16));
+        return tmpuint16;
+    }
+    case UINT32:
+    {
+        quint32 tmpuint32;
+        memcpy(&tmpuint32, element, sizeof(tmpuint32));
+        return tmpuint32;
+    }
+    case FLOAT32:
+    {
+        float tmpfloat;
+        memcpy(&tmpfloat, element, sizeof(tmpfloat));
+        return tmpfloat;
+    }
+    case ENUM:
+    {
+        quint8 tmpenum = *element;
+        if (tmpenum >= options.length()) {
+            qDebug() << "Invalid value for" << name;
+            tmpenum = 0;
+        }
+        return options[tmpenum].toDouble();
+    }
+    case BITFIELD:
+        return (data[offset + numBytesPerElement * (index / 8)] >> (index % 8)) & 1;
+
+    case STRING:
+        break;
+    }
+    // Strings are rare enough to go the slow way
     return getValue(index).toDouble();
 }
 
+double UAVObjectField::getDouble(quint32 index)
+{
+    QMutexLocker locker(obj->getMutex());
+
+    // Check that index is not out of bounds
+    if (index >= numElements) {
+        return 0.0;
+    }
+    return elementToDouble(index);
+}
+
+/**
+ * Read a span of elements as doubles, taking the object mutex only once.
+ * \return The number of elements stored in values
+ */
+quint32 UAVObjectField::getDoubles(double *values, quint32 first, quint32 count)
+{
+    QMutexLocker locker(obj->getMutex());
+
+    if (first >= numElements) {
+        return 0;
+    }
+    count = qMin(count, numElements - first);
+    for (quint32 n = 0; n < count; ++n) {
+        values[n] = elementToDouble(first + n);
+    }
+    return count;
+}
+
+quint32 UAVObjectField::getRawElements(FieldType elementType, void *values, quint32 first, quint32 count)
+{
+    QMutexLocker locker(obj->getMutex());
+
+    if (elementType != type && !(elementType == UINT8 && type == ENUM)) {
+        return 0;
+    }
+    if (first >= numElements) {
+        return 0;
+    }
+    count = qMin(count, numElements - first);
+    memcpy(values, &data[offset + numBytesPerElement * first], numBytesPerElement * count);
+    return count;
+}
+
 void UAVObjectField::setDouble(double value, quint32 index)
 {
     setValue(QVariant(value), index);
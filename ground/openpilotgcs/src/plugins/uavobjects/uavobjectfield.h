@@ -70,6 +70,8 @@ public:
     bool checkValue(const QVariant & data, quint32 index = 0);
     void setValue(const QVariant & data, quint32 index = 0);
     double getDouble(quint32 index = 0);
+    quint32 getDoubles(double *values, quint32 first = 0, quint32 count = 0xFFFFFFFF);
+    template<typename T> quint32 getElements(T *values, quint32 first = 0, quint32 count = 0xFFFFFFFF);
     void setDouble(double value, quint32 index = 0);
     quint32 getDataOffset();
     quint32 getNumBytes();
@@ -105,8 +107,46 @@ protected:
     UAVObject *obj;
     QMap<quint32, QList<LimitStruct> > elementLimits;
     void clear();
+    double elementToDouble(quint32 index);
+    quint32 getRawElements(FieldType elementType, void *values, quint32 first, quint32 count);
     void constructorInitialize(const QString & name, const QString & description, const QString & units, FieldType type, const QStringList & elementNames, const QStringList & options, const QString &limits);
     void limitsInitialize(const QString &limits);
 };
 
+/**
+ * The element type stored for each FieldType, used by UAVObjectField::getElements()
+ */
+template<typename T> struct UAVObjectFieldElement;
+template<> struct UAVObjectFieldElement<qint8> {
+    static const UAVObjectField::FieldType type = UAVObjectField::INT8;
+};
+template<> struct UAVObjectFieldElement<qint16> {
+    static const UAVObjectField::FieldType type = UAVObjectField::INT16;
+};
+template<> struct UAVObjectFieldElement<qint32> {
+    static const UAVObjectField::FieldType type = UAVObjectField::INT32;
+};
+template<> struct UAVObjectFieldElement<quint8> {
+    static const UAVObjectField::FieldType type = UAVObjectField::UINT8;
+};
+template<> struct UAVObjectFieldElement<quint16> {
+    static const UAVObjectField::FieldType type = UAVObjectField::UINT16;
+};
+template<> struct UAVObjectFieldElement<quint32> {
+    static const UAVObjectField::FieldType type = UAVObjectField::UINT32;
+};
+template<> struct UAVObjectFieldElement<float> {
+    static const UAVObjectField::FieldType type = UAVObjectField::FLOAT32;
+};
+
+/**
+ * Copy a span of elements in their native type, without any conversion.
+ * T must match the field type, quint8 also reads the option index of ENUM fields.
+ * \return The number of elements copied, 0 if T does not match the field type
+ */
+template<typename T> quint32 UAVObjectField::getElements(T *values, quint32 first, quint32 count)
+{
+    return getRawElements(UAVObjectFieldElement<T>::type, values, first, count);
+}
+
 #endif // UAVOBJECTFIELD_H
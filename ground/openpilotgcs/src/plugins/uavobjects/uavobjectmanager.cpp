@@ -53,54 +53,52 @@ bool UAVObjectManager::registerObject(UAVDataObject *obj)
     QMutexLocker locker(mutex);
 
     // Check if this object type is already in the list
-    for (int objidx = 0; objidx < objects.length(); ++objidx) {
-        // Check if the object ID is in the list
-        if (objects[objidx].length() > 0 && objects[objidx][0]->getObjID() == obj->getObjID()) {
-            // Check if this is a single instance object, if yes we can not add a new instance
-            if (obj->isSingleInstance()) {
-                return false;
-            }
-            // The object type has alredy been added, so now we need to initialize the new instance with the appropriate id
-            // There is a single metaobject for all object instances of this type, so no need to create a new one
-            // Get object type metaobject from existing instance
-            UAVDataObject *refObj = dynamic_cast<UAVDataObject *>(objects[objidx][0]);
-            if (refObj == NULL) {
-                return false;
-            }
-            UAVMetaObject *mobj = refObj->getMetaObject();
-            // If the instance ID is specified and not at the default value (0) then we need to make sure
-            // that there are no gaps in the instance list. If gaps are found then then additional instances
-            // will be created.
-            if ((obj->getInstID() > 0) && (obj->getInstID() < MAX_INSTANCES)) {
-                for (int instidx = 0; instidx < objects[objidx].length(); ++instidx) {
-                    if (objects[objidx][instidx]->getInstID() == obj->getInstID()) {
-                        // Instance conflict, do not add
-                        return false;
-                    }
-                }
-                // Check if there are any gaps between the requested instance ID and the ones in the list,
-                // if any then create the missing instances.
-                for (quint32 instidx = objects[objidx].length(); instidx < obj->getInstID(); ++instidx) {
-                    UAVDataObject *cobj = obj->clone(instidx);
-                    cobj->initialize(mobj);
-                    objects[objidx].append(cobj);
-                    getObject(cobj->getObjID())->emitNewInstance(cobj);
-                    emit newInstance(cobj);
+    int objidx = objectIdIndex.value(obj->getObjID(), -1);
+    if (objidx >= 0) {
+        // Check if this is a single instance object, if yes we can not add a new instance
+        if (obj->isSingleInstance()) {
+            return false;
+        }
+        // The object type has alredy been added, so now we need to initialize the new instance with the appropriate id
+        // There is a single metaobject for all object instances of this type, so no need to create a new one
+        // Get object type metaobject from existing instance
+        UAVDataObject *refObj = dynamic_cast<UAVDataObject *>(objects[objidx][0]);
+        if (refObj == NULL) {
+            return false;
+        }
+        UAVMetaObject *mobj = refObj->getMetaObject();
+        // If the instance ID is specified and not at the default value (0) then we need to make sure
+        // that there are no gaps in the instance list. If gaps are found then then additional instances
+        // will be created.
+        if ((obj->getInstID() > 0) && (obj->getInstID() < MAX_INSTANCES)) {
+            for (int instidx = 0; instidx < objects[objidx].length(); ++instidx) {
+                if (objects[objidx][instidx]->getInstID() == obj->getInstID()) {
+                    // Instance conflict, do not add
+                    return false;
                 }
-                // Finally, initialize the actual object instance
-                obj->initialize(mobj);
-            } else if (obj->getInstID() == 0) {
-                // Assign the next available ID and initialize the object instance
-                obj->initialize(objects[objidx].length(), mobj);
-            } else {
-                return false;
             }
-            // Add the actual object instance in the list
-            objects[objidx].append(obj);
-            getObject(obj->getObjID())->emitNewInstance(obj);
-            emit newInstance(obj);
-            return true;
+            // Check if there are any gaps between the requested instance ID and the ones in the list,
+            // if any then create the missing instances.
+            for (quint32 instidx = objects[objidx].length(); instidx < obj->getInstID(); ++instidx) {
+                UAVDataObject *cobj = obj->clone(instidx);
+                cobj->initialize(mobj);
+                objects[objidx].append(cobj);
+                getObject(cobj->getObjID())->emitNewInstance(cobj);
+                emit newInstance(cobj);
+            }
+            // Finally, initialize the actual object instance
+            obj->initialize(mobj);
+        } else if (obj->getInstID() == 0) {
+            // Assign the next available ID and initialize the object instance
+            obj->initialize(objects[objidx].length(), mobj);
+        } else {
+            return false;
         }
+        // Add the actual object instance in the list
+        objects[objidx].append(obj);
+        getObject(obj->getObjID())->emitNewInstance(obj);
+        emit newInstance(obj);
+        return true;
     }
     // If this point is reached then this is the first time this object type (ID) is added in the list
     // create a new list of the instances, add in the object collection and create the object's metaobject
@@ -121,6 +119,8 @@ void UAVObjectManager::addObject(UAVObject *obj)
     // Add to list
     QList<UAVObject *> list;
     list.append(obj);
+    objectIdIndex.insert(obj->getObjID(), objects.length());
+    objectNameIndex.insert(obj->getName(), objects.length());
     objects.append(list);
     emit newObject(obj);
 }
@@ -220,6 +220,19 @@ UAVObject *UAVObjectManager::getObject(quint32 objId, quint32 instId)
     return getObject(NULL, objId, instId);
 }
 
+/**
+ * Find the position of an object type in the objects list, by name if one is given or else by object ID.
+ * The mutex must be held by the caller.
+ * @returns The index or -1 if the object type is not registered
+ */
+int UAVObjectManager::findObjectIndex(const QString *name, quint32 objId) const
+{
+    if (name != NULL) {
+        return objectNameIndex.value(*name, -1);
+    }
+    return objectIdIndex.value(objId, -1);
+}
+
 /**
  * Helper function for the public getObject() functions.
  */
@@ -227,21 +240,23 @@ UAVObject *UAVObjectManager::getObject(const QString *name, quint32 objId, quint
 {
     QMutexLocker locker(mutex);
 
-    // Check if this object type is already in the list
-    for (int objidx = 0; objidx < objects.length(); ++objidx) {
-        // Check if the object ID is in the list
-        if (objects[objidx].length() > 0) {
-            if ((name != NULL && objects[objidx][0]->getName().compare(name) == 0) || (name == NULL && objects[objidx][0]->getObjID() == objId)) {
-                // Look for the requested instance ID
-                for (int instidx = 0; instidx < objects[objidx].length(); ++instidx) {
-                    if (objects[objidx][instidx]->getInstID() == instId) {
-                        return objects[objidx][instidx];
-                    }
-                }
-            }
+    int objidx = findObjectIndex(name, objId);
+
+    if (objidx < 0) {
+        // qWarning("UAVObjectManager::getObject: Object not found.  Probably a bug or mismatched GCS/flight versions.");
+        return NULL;
+    }
+    const QList<UAVObject *> &instances = objects[objidx];
+    // registerObject() fills any gaps, so the instance ID is normally also the position in the list
+    if (instId < (quint32)instances.length() && instances[instId]->getInstID() == instId) {
+        return instances[instId];
+    }
+    // Look for the requested instance ID
+    for (int instidx = 0; instidx < instances.length(); ++instidx) {
+        if (instances[instidx]->getInstID() == instId) {
+            return instances[instidx];
         }
     }
-    // qWarning("UAVObjectManager::getObject: Object not found.  Probably a bug or mismatched GCS/flight versions.");
     // If this point is reached then the requested object could not be found
     return NULL;
 }
@@ -269,14 +284,10 @@ QList<UAVObject *> UAVObjectManager::getObjectInstances(const QString *name, qui
 {
     QMutexLocker locker(mutex);
 
-    // Check if this object type is already in the list
-    for (int objidx = 0; objidx < objects.length(); ++objidx) {
-        // Check if the object ID is in the list
-        if (objects[objidx].length() > 0) {
-            if ((name != NULL && objects[objidx][0]->getName().compare(name) == 0) || (name == NULL && objects[objidx][0]->getObjID() == objId)) {
-                return objects[objidx];
-            }
-        }
+    int objidx = findObjectIndex(name, objId);
+
+    if (objidx >= 0) {
+        return objects[objidx];
     }
     // If this point is reached then the requested object could not be found
     return QList<UAVObject *>();
@@ -363,14 +374,10 @@ qint32 UAVObjectManager::getNumInstances(const QString *name, quint32 objId)
 {
     QMutexLocker locker(mutex);
 
-    // Check if this object type is already in the list
-    for (int objidx = 0; objidx < objects.length(); ++objidx) {
-        // Check if the object ID is in the list
-        if (objects[objidx].length() > 0) {
-            if ((name != NULL && objects[objidx][0]->getName().compare(name) == 0) || (name == NULL && objects[objidx][0]->getObjID() == objId)) {
-                return objects[objidx].length();
-            }
-        }
+    int objidx = findObjectIndex(name, objId);
+
+    if (objidx >= 0) {
+        return objects[objidx].length();
     }
     // If this point is reached then the requested object could not be found
     return -1;
@@ -33,6 +33,7 @@
 #include "uavdataobject.h"
 #include "uavmetaobject.h"
 #include <QList>
+#include <QHash>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QJsonObject>
@@ -69,9 +70,13 @@ private:
     static const quint32 MAX_INSTANCES = 1000;
 
     QList< QList<UAVObject *> > objects;
+    // Position of each object type in objects, lists are only ever appended so these never move
+    QHash<quint32, int> objectIdIndex;
+    QHash<QString, int> objectNameIndex;
     QMutex *mutex;
 
     void addObject(UAVObject *obj);
+    int findObjectIndex(const QString *name, quint32 objId) const;
     UAVObject *getObject(const QString *name, quint32 objId, quint32 instId);
     QList<UAVObject *> getObjectInstances(const QString *name, quint32 objId);
     qint32 getNumInstances(const QString *name, quint32 objId);
@@ -28,7 +28,6 @@
 #include "telemetry.h"
 #include "oplinksettings.h"
 #include "objectpersistence.h"
-#include <QTime>
 #include <QtGlobal>
 #include <stdlib.h>
 #include <QDebug>
@@ -40,6 +39,12 @@ Telemetry::Telemetry(UAVTalk *utalk, UAVObjectManager *objMngr) : objMngr(objMng
 {
     mutex = new QMutex(QMutex::Recursive);
 
+    // Setup the periodic timer, it is started as objects are scheduled
+    updateClock.start();
+    updateTimer = new QTimer(this);
+    updateTimer->setSingleShot(true);
+    connect(updateTimer, SIGNAL(timeout()), this, SLOT(processPeriodicUpdates()));
+
     // Register all objects in the list
     foreach(QList<UAVObject *> instances, objMngr->getObjects()) {
         foreach(UAVObject * object, instances) {
@@ -63,15 +68,12 @@ Telemetry::Telemetry(UAVTalk *utalk, UAVObjectManager *objMngr) : objMngr(objMng
     // Get GCS stats object
     gcsStatsObj = GCSTelemetryStats::GetInstance(objMngr);
 
-    // Setup and start the periodic timer
-    timeToNextUpdateMs = 0;
-    updateTimer = new QTimer(this);
-    connect(updateTimer, SIGNAL(timeout()), this, SLOT(processPeriodicUpdates()));
-    updateTimer->start(1000);
-
-    // Setup and start the stats timer
+    // Setup the stats
     txErrors  = 0;
     txRetries = 0;
+    txPeriodicUpdates  = 0;
+    txPeriodicLagMs    = 0;
+    txPeriodicLagMaxMs = 0;
 }
 
 Telemetry::~Telemetry()
@@ -103,18 +105,17 @@ void Telemetry::registerObject(UAVObject *obj)
 void Telemetry::addObject(UAVObject *obj)
 {
     // Check if object type is already in the list
-    for (int n = 0; n < objList.length(); ++n) {
-        if (objList[n].obj->getObjID() == obj->getObjID()) {
-            // Object type (not instance!) is already in the list, do nothing
-            return;
-        }
+    if (objIndex.contains(obj->getObjID())) {
+        // Object type (not instance!) is already in the list, do nothing
+        return;
     }
 
     // If this point is reached, then the object type is new, let's add it
     ObjectTimeInfo timeInfo;
     timeInfo.obj = obj;
-    timeInfo.timeToNextUpdateMs = 0;
-    timeInfo.updatePeriodMs     = 0;
+    timeInfo.nextUpdateMs   = 0;
+    timeInfo.updatePeriodMs = 0;
+    objIndex.insert(obj->getObjID(), objList.length());
     objList.append(timeInfo);
 }
 
@@ -124,11 +125,37 @@ void Telemetry::addObject(UAVObject *obj)
 void Telemetry::setUpdatePeriod(UAVObject *obj, qint32 periodMs)
 {
     // Find object type (not instance!) and update its period
-    for (int n = 0; n < objList.length(); ++n) {
-        if (objList[n].obj->getObjID() == obj->getObjID()) {
-            objList[n].updatePeriodMs     = periodMs;
-            objList[n].timeToNextUpdateMs = quint32((float)periodMs * (float)qrand() / (float)RAND_MAX); // avoid bunching of updates
-        }
+    int n = objIndex.value(obj->getObjID(), -1);
+
+    // Objects keep their phase while their period does not change
+    if (n < 0 || objList[n].updatePeriodMs == periodMs) {
+        return;
+    }
+    ObjectTimeInfo &timeInfo = objList[n];
+    if (timeInfo.updatePeriodMs > 0) {
+        updateSchedule.remove(timeInfo.nextUpdateMs, n);
+    }
+    timeInfo.updatePeriodMs = periodMs;
+    if (periodMs > 0) {
+        timeInfo.nextUpdateMs = updateClock.elapsed() + qint64((float)periodMs * (float)qrand() / (float)RAND_MAX); // avoid bunching of updates
+        updateSchedule.insert(timeInfo.nextUpdateMs, n);
+    }
+    scheduleNextUpdate();
+}
+
+/**
+ * Set the timer to expire when the first scheduled object is due
+ */
+void Telemetry::scheduleNextUpdate()
+{
+    qint64 delayMs = MAX_UPDATE_PERIOD_MS;
+
+    if (!updateSchedule.isEmpty()) {
+        delayMs = qBound((qint64)MIN_UPDATE_PERIOD_MS, updateSchedule.firstKey() - updateClock.elapsed(), (qint64)MAX_UPDATE_PERIOD_MS);
+    }
+    // Only ever bring the timer forward, processPeriodicUpdates() reschedules it anyway
+    if (!updateTimer->isActive() || delayMs < updateTimer->remainingTime()) {
+        updateTimer->start(delayMs);
     }
 }
 
@@ -449,59 +476,43 @@ void Telemetry::processObjectQueue()
 }
 
 /**
- * Check is any objects are pending for periodic updates
- * TODO: Clean-up
+ * Send the objects due for a periodic update. Objects are kept sorted by the
+ * time of their next update, so only the due ones are visited, and they are
+ * written to the link in one go.
  */
 void Telemetry::processPeriodicUpdates()
 {
     QMutexLocker locker(mutex);
 
-    // Stop timer
-    updateTimer->stop();
-
-    // Iterate through each object and update its timer, if zero then transmit object.
-    // Also calculate smallest delay to next update (will be used for setting timeToNextUpdateMs)
-    qint32 minDelay  = MAX_UPDATE_PERIOD_MS;
-    ObjectTimeInfo *objinfo;
-    qint32 elapsedMs = 0;
-    QTime time;
-    qint32 offset;
-    bool allInstances;
-    for (int n = 0; n < objList.length(); ++n) {
-        objinfo = &objList[n];
-        // If object is configured for periodic updates
-        if (objinfo->updatePeriodMs > 0) {
-            objinfo->timeToNextUpdateMs -= timeToNextUpdateMs;
-            // Check if time for the next update
-            if (objinfo->timeToNextUpdateMs <= 0) {
-                // Reset timer
-                offset = (-objinfo->timeToNextUpdateMs) % objinfo->updatePeriodMs;
-                objinfo->timeToNextUpdateMs = objinfo->updatePeriodMs - offset;
-                // Send object
-                time.start();
-                allInstances = !objinfo->obj->isSingleInstance();
-                processObjectUpdates(objinfo->obj, EV_UPDATED_PERIODIC, allInstances, false);
-                elapsedMs    = time.elapsed();
-                // Update timeToNextUpdateMs with the elapsed delay of sending the object;
-                timeToNextUpdateMs += elapsedMs;
-            }
-            // Update minimum delay
-            if (objinfo->timeToNextUpdateMs < minDelay) {
-                minDelay = objinfo->timeToNextUpdateMs;
-            }
-        }
+    qint64 now = updateClock.elapsed();
+
+    utalk->beginBatch();
+    while (!updateSchedule.isEmpty() && updateSchedule.firstKey() <= now) {
+        QMultiMap<qint64, int>::iterator first = updateSchedule.begin();
+        qint64 dueMs = first.key();
+        int n = first.value();
+        updateSchedule.erase(first);
+
+        // Schedule the next update first, updates missed while late are skipped
+        ObjectTimeInfo &timeInfo = objList[n];
+        qint64 lagMs = now - dueMs;
+        timeInfo.nextUpdateMs = dueMs + timeInfo.updatePeriodMs * (lagMs / timeInfo.updatePeriodMs + 1);
+        updateSchedule.insert(timeInfo.nextUpdateMs, n);
+
+        ++txPeriodicUpdates;
+        txPeriodicLagMs   += lagMs;
+        txPeriodicLagMaxMs = qMax(txPeriodicLagMaxMs, lagMs);
+
+        // Send object
+        UAVObject *obj    = timeInfo.obj;
+        bool allInstances = !obj->isSingleInstance();
+        processObjectUpdates(obj, EV_UPDATED_PERIODIC, allInstances, false);
     }
+    utalk->endBatch();
 
-    // Check if delay for the next update is too short
-    if (minDelay < MIN_UPDATE_PERIOD_MS) {
-        minDelay = MIN_UPDATE_PERIOD_MS;
-    }
-
-    // Done
-    timeToNextUpdateMs = minDelay;
-
-    // Restart timer
-    updateTimer->start(timeToNextUpdateMs);
+    // Sleep until the next object is due
+    updateTimer->stop();
+    scheduleNextUpdate();
 }
 
 Telemetry::TelemetryStats Telemetry::getStats()
@@ -519,6 +530,9 @@ Telemetry::TelemetryStats Telemetry::getStats()
     stats.txObjects     = utalkStats.txObjects;
     stats.txErrors      = utalkStats.txErrors + txErrors;
     stats.txRetries     = txRetries;
+    stats.txPeriodicUpdates  = txPeriodicUpdates;
+    stats.txPeriodicLagAvgMs = txPeriodicUpdates > 0 ? txPeriodicLagMs / txPeriodicUpdates : 0;
+    stats.txPeriodicLagMaxMs = txPeriodicLagMaxMs;
 
     stats.rxBytes       = utalkStats.rxBytes;
     stats.rxObjectBytes = utalkStats.rxObjectBytes;
@@ -538,6 +552,25 @@ void Telemetry::resetStats()
     utalk->resetStats();
     txErrors  = 0;
     txRetries = 0;
+    txPeriodicUpdates  = 0;
+    txPeriodicLagMs    = 0;
+    txPeriodicLagMaxMs = 0;
+}
+
+/**
+ * Offer the autopilot to send objects as deltas, when a connection is established
+ */
+void Telemetry::negotiateCapabilities()
+{
+    utalk->sendCapabilities();
+}
+
+/**
+ * Send objects in full again, when the connection is lost
+ */
+void Telemetry::resetCapabilities()
+{
+    utalk->resetCapabilities();
 }
 
 void Telemetry::objectUpdatedAuto(UAVObject *obj)
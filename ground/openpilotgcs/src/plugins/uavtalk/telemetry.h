@@ -36,6 +36,8 @@
 #include <QTimer>
 #include <QQueue>
 #include <QMap>
+#include <QHash>
+#include <QElapsedTimer>
 
 class ObjectTransactionInfo : public QObject {
     Q_OBJECT
@@ -64,6 +66,9 @@ public:
         quint32 txObjects;
         quint32 txErrors;
         quint32 txRetries;
+        quint32 txPeriodicUpdates; /** Periodic updates sent */
+        quint32 txPeriodicLagAvgMs; /** Average delay between when periodic updates were due and sent */
+        quint32 txPeriodicLagMaxMs; /** Longest such delay */
 
         quint32 rxBytes;
         quint32 rxObjectBytes;
@@ -78,6 +83,8 @@ public:
     TelemetryStats getStats();
     void resetStats();
     void transactionTimeout(ObjectTransactionInfo *info);
+    void negotiateCapabilities();
+    void resetCapabilities();
 
 private:
     // Constants
@@ -103,7 +110,7 @@ private:
     typedef struct {
         UAVObject *obj;
         qint32    updatePeriodMs; /** Update period in ms or 0 if no periodic updates are needed */
-        qint32    timeToNextUpdateMs; /** Time delay to the next update */
+        qint64    nextUpdateMs; /** Time of the next update, on updateClock */
     } ObjectTimeInfo;
 
     typedef struct {
@@ -117,20 +124,28 @@ private:
     UAVTalk *utalk;
     GCSTelemetryStats *gcsStatsObj;
     QList<ObjectTimeInfo> objList;
+    // Index in objList of each object type
+    QHash<quint32, int> objIndex;
+    // Objects due for a periodic update, by time of the update
+    QMultiMap<qint64, int> updateSchedule;
+    QElapsedTimer updateClock;
     QQueue<ObjectQueueInfo> objQueue;
     QQueue<ObjectQueueInfo> objPriorityQueue;
     QMap<quint32, QMap<quint32, ObjectTransactionInfo *> *> transMap;
     QMutex *mutex;
     QTimer *updateTimer;
     QTimer *statsTimer;
-    qint32 timeToNextUpdateMs;
     quint32 txErrors;
     quint32 txRetries;
+    quint32 txPeriodicUpdates;
+    qint64 txPeriodicLagMs;
+    qint64 txPeriodicLagMaxMs;
 
     // Methods
     void registerObject(UAVObject *obj);
     void addObject(UAVObject *obj);
     void setUpdatePeriod(UAVObject *obj, qint32 periodMs);
+    void scheduleNextUpdate();
     void connectToObjectInstances(UAVObject *obj, quint32 eventMask);
     void connectToObject(UAVObject *obj, quint32 eventMask);
     void updateObject(UAVObject *obj, quint32 eventMask);
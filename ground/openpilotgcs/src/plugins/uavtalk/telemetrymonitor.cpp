@@ -253,11 +253,13 @@ void TelemetryMonitor::processStatsUpdates()
     if (gcsStats.Status == GCSTelemetryStats::STATUS_CONNECTED && gcsStats.Status != oldStatus) {
         statsTimer->setInterval(STATS_UPDATE_PERIOD_MS);
         qDebug("Connection with the autopilot established");
+        tel->negotiateCapabilities();
         startRetrievingObjects();
     }
     if (gcsStats.Status == GCSTelemetryStats::STATUS_DISCONNECTED && gcsStats.Status != oldStatus) {
         statsTimer->setInterval(STATS_CONNECT_PERIOD_MS);
         qDebug("Connection with the autopilot lost");
+        tel->resetCapabilities();
         qDebug("Trying to connect to the autopilot");
         emit disconnected();
     }
@@ -0,0 +1,599 @@
+/**
+ ******************************************************************************
+ *
+ * @file       tst_uavtalk.cpp
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      Receive tests and replay benchmark for UAVTalk
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uavtalk/uavtalk.h"
+#include "uavobjectmanager.h"
+#include "utils/crc.h"
+#include "attitudestate.h"
+#include "gyrostate.h"
+#include "accelstate.h"
+#include "magstate.h"
+#include "actuatorcommand.h"
+#include "systemstats.h"
+#include "deltavectors.h"
+#include "bundlevectors.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QBuffer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QtEndian>
+#include <QtTest/QtTest>
+
+#define NUM_PACKETS 5000
+
+// Hands out a recorded stream, at most up to the given limit, like a link where data trickles in.
+// What is written to it is kept for the other end of the link.
+class ReplayDevice : public QIODevice {
+public:
+    ReplayDevice(const QByteArray &data) : stream(data), offset(0), limit(data.size())
+    {
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    QByteArray written;
+
+    bool isSequential() const
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const
+    {
+        return limit - offset + QIODevice::bytesAvailable();
+    }
+
+    void setLimit(qint64 newLimit)
+    {
+        limit = qMin(newLimit, (qint64)stream.size());
+    }
+
+    void append(const QByteArray &data)
+    {
+        stream.append(data);
+        limit = stream.size();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        qint64 count = qMin(maxSize, limit - offset);
+
+        memcpy(data, stream.constData() + offset, count);
+        offset += count;
+        return count;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize)
+    {
+        written.append(data, maxSize);
+        return maxSize;
+    }
+
+private:
+    QByteArray stream;
+    qint64 offset;
+    qint64 limit;
+};
+
+// Counts the writes it receives, each one being a transfer on a real link
+class WriteCounter : public QBuffer {
+public:
+    WriteCounter() : writes(0)
+    {
+        open(QIODevice::WriteOnly);
+    }
+
+    int writes;
+
+protected:
+    qint64 writeData(const char *data, qint64 len)
+    {
+        ++writes;
+        return QBuffer::writeData(data, len);
+    }
+};
+
+// An object of deltavectors.h or bundlevectors.h, fields of bytes as the flight unit test has them
+class VectorObject : public UAVDataObject {
+public:
+    VectorObject(quint32 objId, bool isSingleInst, int numFields, int fieldLength) :
+        UAVDataObject(objId, isSingleInst, false, QString("VectorObject%1").arg(objId, 0, 16)),
+        numFields(numFields), fieldLength(fieldLength)
+    {
+        QList<UAVObjectField *> fields;
+
+        memset(data, 0, sizeof(data));
+        for (int n = 0; n < numFields; n++) {
+            fields.append(new UAVObjectField(QString("Field%1").arg(n), QString(""), QString(""), UAVObjectField::UINT8, fieldLength, QStringList()));
+        }
+        initializeFields(fields, data, numFields * fieldLength);
+    }
+
+    Metadata getDefaultMetadata()
+    {
+        Metadata metadata;
+
+        memset(&metadata, 0, sizeof(metadata));
+        return metadata;
+    }
+
+    UAVDataObject *clone(quint32 instID)
+    {
+        VectorObject *obj = new VectorObject(getObjID(), isSingleInstance(), numFields, fieldLength);
+
+        obj->initialize(instID, getMetaObject());
+        return obj;
+    }
+
+    UAVDataObject *dirtyClone()
+    {
+        return new VectorObject(getObjID(), isSingleInstance(), numFields, fieldLength);
+    }
+
+private:
+    int numFields;
+    int fieldLength;
+    quint8 data[DELTA_VECTORS_LENGTH];
+};
+
+// Records every unpacked object with a checksum of its data
+class UnpackRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    QList<QPair<quint32, quint32> > records;
+
+public slots:
+    void objectUnpacked(UAVObject *obj)
+    {
+        QByteArray data(obj->getNumBytes(), 0);
+
+        obj->pack((quint8 *)data.data());
+        records << qMakePair(obj->getObjID(), qChecksum(data.constData(), data.size()));
+    }
+};
+
+class tst_UAVTalk : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanStream();
+    void chunkedMatchesWhole_data();
+    void chunkedMatchesWhole();
+    void batchedWrites();
+    void deltaPackets();
+    void deltaVectors_data();
+    void deltaVectors();
+    void deltaVectorsEncoded();
+    void bundlePackets();
+    void bundleVectors();
+    void benchmarkReplay();
+
+private:
+    UAVObjectManager *manager;
+    QList<UAVDataObject *> objects;
+    VectorObject *vectorObject;
+    QList<UAVDataObject *> bundleObjects;
+    UnpackRecorder recorder;
+
+    QByteArray buildStream(int numPackets, bool noisy);
+    UAVTalk::ComStats replay(const QByteArray &stream, int chunk);
+};
+
+void tst_UAVTalk::initTestCase()
+{
+    manager = new UAVObjectManager();
+    objects << new AttitudeState() << new GyroState() << new AccelState()
+            << new MagState() << new ActuatorCommand() << new SystemStats();
+    foreach(UAVDataObject * obj, objects) {
+        QVERIFY(manager->registerObject(obj));
+        connect(obj, SIGNAL(objectUnpacked(UAVObject *)), &recorder, SLOT(objectUnpacked(UAVObject *)));
+    }
+    vectorObject = new VectorObject(DELTA_VECTORS_OBJID, true, DELTA_VECTORS_FIELDS, DELTA_VECTORS_FIELD_LENGTH);
+    QVERIFY(manager->registerObject(vectorObject));
+
+    // The small object, then the instances of the multi instance object, cloned once it is registered
+    bundleObjects << new VectorObject(BUNDLE_VECTORS_SMALL_OBJID, true, BUNDLE_VECTORS_SMALL_FIELDS, BUNDLE_VECTORS_FIELD_LENGTH)
+                  << new VectorObject(BUNDLE_VECTORS_MULTI_OBJID, false, BUNDLE_VECTORS_MULTI_FIELDS, BUNDLE_VECTORS_FIELD_LENGTH);
+    for (int i = 0; i < 1 + BUNDLE_VECTORS_INSTANCES; i++) {
+        if (i > 1) {
+            bundleObjects << bundleObjects[1]->clone(i - 1);
+        }
+        QVERIFY(manager->registerObject(bundleObjects[i]));
+        connect(bundleObjects[i], SIGNAL(objectUnpacked(UAVObject *)), &recorder, SLOT(objectUnpacked(UAVObject *)));
+    }
+}
+
+/**
+ * Record a telemetry stream, optionally with line noise and corrupted packets mixed in
+ */
+QByteArray tst_UAVTalk::buildStream(int numPackets, bool noisy)
+{
+    QBuffer buffer;
+
+    buffer.open(QIODevice::WriteOnly);
+    UAVTalk talk(&buffer, manager);
+
+    qsrand(42);
+    for (int i = 0; i < numPackets; i++) {
+        UAVDataObject *obj = objects[qrand() % objects.count()];
+        QByteArray data(obj->getNumBytes(), 0);
+        for (int n = 0; n < data.size(); n++) {
+            data[n] = qrand();
+        }
+        obj->unpack((const quint8 *)data.constData());
+
+        if (noisy && qrand() % 8 == 0) {
+            int noise = qrand() % 20;
+            for (int n = 0; n < noise; n++) {
+                buffer.putChar((qrand() % 4 == 0) ? 0x3C : qrand());
+            }
+        }
+
+        qint64 start = buffer.pos();
+        talk.sendObject(obj, false, false);
+        if (noisy && qrand() % 10 == 0) {
+            QByteArray &raw = buffer.buffer();
+            int pos = start + 1 + qrand() % (buffer.pos() - start - 1);
+            raw[pos] = raw[pos] ^ (1 << (qrand() % 8));
+        }
+    }
+    return buffer.data();
+}
+
+/**
+ * Feed a recorded stream to a fresh connection, chunk bytes per readyRead or everything at once if 0
+ */
+UAVTalk::ComStats tst_UAVTalk::replay(const QByteArray &stream, int chunk)
+{
+    ReplayDevice device(stream);
+    UAVTalk talk(&device, manager);
+
+    recorder.records.clear();
+    if (chunk == 0) {
+        QMetaObject::invokeMethod(&talk, "processInputStream", Qt::DirectConnection);
+    } else {
+        for (qint64 limit = chunk; limit < stream.size() + chunk; limit += chunk) {
+            device.setLimit(limit);
+            QMetaObject::invokeMethod(&talk, "processInputStream", Qt::DirectConnection);
+        }
+    }
+    return talk.getStats();
+}
+
+void tst_UAVTalk::cleanStream()
+{
+    QByteArray stream = buildStream(NUM_PACKETS, false);
+    UAVTalk::ComStats stats = replay(stream, 0);
+
+    QCOMPARE(stats.rxObjects, (quint32)NUM_PACKETS);
+    QCOMPARE(stats.rxErrors, 0u);
+    QCOMPARE(stats.rxSyncErrors, 0u);
+    QCOMPARE(stats.rxCrcErrors, 0u);
+    QCOMPARE(stats.rxBytes, (quint32)stream.size());
+    QCOMPARE(recorder.records.count(), NUM_PACKETS);
+}
+
+void tst_UAVTalk::chunkedMatchesWhole_data()
+{
+    QTest::addColumn<int>("chunk");
+    QTest::newRow("byte at a time") << 1;
+    QTest::newRow("split headers") << 7;
+    QTest::newRow("usb frames") << 64;
+    QTest::newRow("large reads") << 1000;
+}
+
+// Headers and payloads split across reads must parse exactly like a single read
+void tst_UAVTalk::chunkedMatchesWhole()
+{
+    QFETCH(int, chunk);
+
+    QByteArray stream = buildStream(NUM_PACKETS / 5, true);
+
+    UAVTalk::ComStats whole = replay(stream, 0);
+    QList<QPair<quint32, quint32> > wholeRecords = recorder.records;
+    UAVTalk::ComStats chunked = replay(stream, chunk);
+
+    QVERIFY(whole.rxCrcErrors > 0);
+    QVERIFY(whole.rxSyncErrors > 0);
+    QVERIFY(whole.rxObjects < (quint32)NUM_PACKETS / 5);
+    QCOMPARE(chunked.rxBytes, whole.rxBytes);
+    QCOMPARE(chunked.rxBytes, (quint32)stream.size());
+    QCOMPARE(chunked.rxObjects, whole.rxObjects);
+    QCOMPARE(chunked.rxObjectBytes, whole.rxObjectBytes);
+    QCOMPARE(chunked.rxErrors, whole.rxErrors);
+    QCOMPARE(chunked.rxSyncErrors, whole.rxSyncErrors);
+    QCOMPARE(chunked.rxCrcErrors, whole.rxCrcErrors);
+    QVERIFY(recorder.records == wholeRecords);
+}
+
+// Objects sent in a batch go out in a single write, byte for byte as if sent one by one
+void tst_UAVTalk::batchedWrites()
+{
+    WriteCounter single;
+    WriteCounter batched;
+    UAVTalk singleTalk(&single, manager);
+    UAVTalk batchedTalk(&batched, manager);
+
+    batchedTalk.beginBatch();
+    foreach(UAVDataObject * obj, objects) {
+        QVERIFY(singleTalk.sendObject(obj, false, false));
+        QVERIFY(batchedTalk.sendObject(obj, false, false));
+    }
+    QCOMPARE(batched.writes, 0);
+    batchedTalk.endBatch();
+
+    QCOMPARE(single.writes, objects.count());
+    QCOMPARE(batched.writes, 1);
+    QCOMPARE(batched.data(), single.data());
+    QCOMPARE(batchedTalk.getStats().txObjects, (quint32)objects.count());
+}
+
+// Hand what one end wrote to the other end and let it parse it
+static void deliver(ReplayDevice &from, ReplayDevice &to, UAVTalk &talk)
+{
+    to.append(from.written);
+    from.written.clear();
+    QMetaObject::invokeMethod(&talk, "processInputStream", Qt::DirectConnection);
+}
+
+// Deltas are only sent once offered, and the receiver ends up with the data that was sent
+void tst_UAVTalk::deltaPackets()
+{
+    QByteArray none;
+    ReplayDevice txDevice(none);
+    ReplayDevice rxDevice(none);
+    UAVTalk txTalk(&txDevice, manager);
+    UAVTalk rxTalk(&rxDevice, manager);
+    UAVDataObject *obj = objects.last();
+
+    QList<int> offsets;
+    int length = 0;
+    foreach(UAVObjectField * field, obj->getFields()) {
+        offsets << length;
+        length += field->getNumBytes();
+    }
+    offsets << length;
+    QCOMPARE(length, (int)obj->getNumBytes());
+
+    QByteArray truth(length, 0);
+    QByteArray mirror(length, 0);
+    qsrand(42);
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            rxTalk.sendCapabilities();
+            deliver(rxDevice, txDevice, txTalk);
+            deliver(txDevice, rxDevice, rxTalk);
+        }
+        for (int i = 0; i < NUM_PACKETS / 10; i++) {
+            int field = qrand() % (offsets.count() - 1);
+            for (int n = offsets[field]; n < offsets[field + 1]; n++) {
+                truth[n] = qrand();
+            }
+            obj->unpack((const quint8 *)truth.constData());
+            QVERIFY(txTalk.sendObject(obj, false, false));
+
+            // The receiver has its own view of the object
+            obj->unpack((const quint8 *)mirror.constData());
+            deliver(txDevice, rxDevice, rxTalk);
+            obj->pack((quint8 *)mirror.data());
+            QVERIFY(mirror == truth);
+        }
+        if (pass == 0) {
+            QCOMPARE(txTalk.getStats().txDeltas, 0u);
+        }
+    }
+    QVERIFY(txTalk.getStats().txDeltas > (quint32)NUM_PACKETS / 20);
+    QCOMPARE(rxTalk.getStats().rxErrors, 0u);
+}
+
+// Split a recorded stream into its frames
+static QList<QByteArray> splitFrames(const QByteArray &stream)
+{
+    QList<QByteArray> frames;
+
+    for (int pos = 0; pos + 4 <= stream.size();) {
+        int length = qFromLittleEndian<quint16>((const uchar *)stream.constData() + pos + 2) + 1;
+        frames << stream.mid(pos, length);
+        pos += length;
+    }
+    return frames;
+}
+
+void tst_UAVTalk::deltaVectors_data()
+{
+    QTest::addColumn<int>("lost");
+    QTest::newRow("all received") << -1;
+    QTest::newRow("delta lost") << 5;
+    QTest::newRow("delta lost before keyframe") << 33;
+}
+
+// What the flight code sends decodes to the data it was sent for, fields missed
+// with a lost delta are only back with the next keyframe
+void tst_UAVTalk::deltaVectors()
+{
+    QFETCH(int, lost);
+
+    QByteArray none;
+    ReplayDevice device(none);
+    UAVTalk talk(&device, manager);
+    QList<QByteArray> frames = splitFrames(QByteArray((const char *)deltavectors_stream, sizeof(deltavectors_stream)));
+    QByteArray truth(DELTA_VECTORS_LENGTH, 0);
+    QByteArray received(DELTA_VECTORS_LENGTH, 0);
+    bool behind = false;
+
+    QCOMPARE(frames.count(), DELTA_VECTORS_UPDATES);
+    vectorObject->unpack((const quint8 *)received.constData());
+    for (int i = 0; i < frames.count(); i++) {
+        // The first packet has nothing to be a delta of, then a keyframe follows every 16 deltas
+        bool keyframe = (i % 17 == 0);
+        QCOMPARE((int)(quint8)frames[i][1], keyframe ? 0x20 : 0x25);
+
+        deltavectors_update((quint8 *)truth.data(), i);
+        if (i == lost) {
+            behind = true;
+            continue;
+        }
+        behind = behind && !keyframe;
+
+        device.append(frames[i]);
+        QMetaObject::invokeMethod(&talk, "processInputStream", Qt::DirectConnection);
+        vectorObject->pack((quint8 *)received.data());
+        QCOMPARE(received == truth, !behind);
+    }
+
+    UAVTalk::ComStats stats = talk.getStats();
+    QCOMPARE(stats.rxObjects, (quint32)(lost < 0 ? frames.count() : frames.count() - 1));
+    QCOMPARE(stats.rxErrors, 0u);
+    QCOMPARE(stats.rxCrcErrors, 0u);
+}
+
+// Sent from the GCS, the same updates go out as the same bytes
+void tst_UAVTalk::deltaVectorsEncoded()
+{
+    QByteArray none;
+    ReplayDevice txDevice(none);
+    ReplayDevice rxDevice(none);
+    UAVTalk txTalk(&txDevice, manager);
+    UAVTalk rxTalk(&rxDevice, manager);
+    QByteArray data(DELTA_VECTORS_LENGTH, 0);
+
+    rxTalk.sendCapabilities();
+    deliver(rxDevice, txDevice, txTalk);
+    deliver(txDevice, rxDevice, rxTalk);
+    for (int i = 0; i < DELTA_VECTORS_UPDATES; i++) {
+        deltavectors_update((quint8 *)data.data(), i);
+        vectorObject->unpack((const quint8 *)data.constData());
+        QVERIFY(txTalk.sendObject(vectorObject, false, false));
+    }
+    QCOMPARE(txDevice.written, QByteArray((const char *)deltavectors_stream, sizeof(deltavectors_stream)));
+}
+
+// Append a bundle record of the current data of an object instance
+static void appendRecord(QByteArray &frame, UAVDataObject *obj, quint16 instId)
+{
+    QByteArray data(obj->getNumBytes(), 0);
+    quint8 header[8];
+    int headerLength = 5;
+
+    obj->pack((quint8 *)data.data());
+    header[0] = instId ? 0x20 | 0x80 : 0x20;
+    qToLittleEndian<quint32>(obj->getObjID(), &header[1]);
+    if (instId) {
+        qToLittleEndian<quint16>(instId, &header[5]);
+        headerLength += 2;
+    }
+    header[headerLength++] = data.size();
+    frame.append((const char *)header, headerLength);
+    frame.append(data);
+}
+
+// Every record of a bundle is received as the packet it stands for
+void tst_UAVTalk::bundlePackets()
+{
+    QByteArray frame(10, 0);
+    QList<QPair<quint32, quint32> > sent;
+
+    frame[0] = 0x3C;
+    frame[1] = 0x27;
+    qToLittleEndian<quint32>(0xFFFFFFFD, (quint8 *)frame.data() + 4);
+    frame[8] = 2;
+    for (int i = 1; i < 3; i++) {
+        UAVDataObject *obj = objects[i];
+        appendRecord(frame, obj, 0);
+        recorder.objectUnpacked(obj);
+    }
+    sent = recorder.records.mid(recorder.records.count() - 2);
+    qToLittleEndian<quint16>(frame.size(), (quint8 *)frame.data() + 2);
+    frame.append(Utils::Crc::updateCRC(0, (const quint8 *)frame.constData(), frame.size()));
+
+    UAVTalk::ComStats stats = replay(frame, 0);
+    QCOMPARE(stats.rxObjects, 2u);
+    QCOMPARE(stats.rxErrors, 0u);
+    QCOMPARE(stats.rxBytes, (quint32)frame.size());
+    QVERIFY(recorder.records == sent);
+}
+
+// What the flight code sends in bundles, plain and delta records, is received object by object in order
+void tst_UAVTalk::bundleVectors()
+{
+    QByteArray stream((const char *)bundlevectors_stream, sizeof(bundlevectors_stream));
+    QList<QPair<quint32, quint32> > sent;
+    QByteArray data[1 + BUNDLE_VECTORS_INSTANCES];
+    int bundles = 0;
+
+    foreach(const QByteArray &frame, splitFrames(stream)) {
+        bundles += ((quint8)frame[1] == 0x27) ? 1 : 0;
+    }
+    QVERIFY(bundles > 0);
+
+    for (int i = 0; i < bundleObjects.count(); i++) {
+        data[i] = QByteArray(bundleObjects[i]->getNumBytes(), 0);
+        bundleObjects[i]->unpack((const quint8 *)data[i].constData());
+    }
+    for (int send = 0; send < BUNDLE_VECTORS_SENDS; send++) {
+        quint32 objId;
+        quint16 instId;
+        bundlevectors_instance(send, &objId, &instId);
+        int i = (objId == BUNDLE_VECTORS_SMALL_OBJID) ? 0 : 1 + instId;
+        int numFields = (i == 0) ? BUNDLE_VECTORS_SMALL_FIELDS : BUNDLE_VECTORS_MULTI_FIELDS;
+
+        bundlevectors_update((quint8 *)data[i].data(), numFields, send);
+        sent << qMakePair(objId, (quint32)qChecksum(data[i].constData(), data[i].size()));
+    }
+
+    UAVTalk::ComStats stats = replay(stream, 0);
+    QCOMPARE(stats.rxObjects, (quint32)BUNDLE_VECTORS_SENDS);
+    QCOMPARE(stats.rxErrors, 0u);
+    QCOMPARE(stats.rxCrcErrors, 0u);
+    QCOMPARE(stats.rxBytes, (quint32)stream.size());
+    QVERIFY(recorder.records == sent);
+}
+
+// Replay a log as fast as possible, as the logging plugin does at high replay speeds
+void tst_UAVTalk::benchmarkReplay()
+{
+    QByteArray stream = buildStream(NUM_PACKETS, false);
+    UAVTalk::ComStats stats;
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    int passes     = 0;
+
+    QBENCHMARK {
+        timer.start();
+        stats = replay(stream, 0);
+        elapsed += timer.nsecsElapsed();
+        passes++;
+    }
+    QCOMPARE(stats.rxObjects, (quint32)NUM_PACKETS);
+
+    double seconds = qMax(elapsed, (qint64)1) / 1e9;
+    qDebug("%.0f packets/s, %.1f MB/s", NUM_PACKETS * passes / seconds, stream.size() * passes / seconds / 1e6);
+}
+
+QTEST_MAIN(tst_UAVTalk)
+
+#include "tst_uavtalk.moc"
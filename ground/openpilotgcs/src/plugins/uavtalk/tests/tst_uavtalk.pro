@@ -0,0 +1,14 @@
+QT += widgets network testlib
+TARGET = tst_uavtalk
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+include(../../../../openpilotgcs.pri)
+LIBS += -L$$GCS_PLUGIN_PATH/OpenPilot
+INCLUDEPATH += $$GCS_SOURCE_TREE/src/plugins
+# The packets of the flight unit test
+INCLUDEPATH += $$GCS_SOURCE_TREE/../../flight/tests/uavtalk
+include(../uavtalk.pri)
+
+SOURCES += tst_uavtalk.cpp
@@ -53,12 +53,17 @@ UAVTalk::UAVTalk(QIODevice *iodev, UAVObjectManager *objMngr) : io(iodev), objMn
 {
     rxState = STATE_SYNC;
     rxPacketLength = 0;
+    rxReadPos    = 0;
+    rxReadLength = 0;
+    txBatchDepth = 0;
+    peerCaps     = 0;
 
     memset(&stats, 0, sizeof(ComStats));
 
+    // There is no plugin manager when replaying from tests and tools
     ExtensionSystem::PluginManager *pm = ExtensionSystem::PluginManager::instance();
-    Core::Internal::GeneralSettings *settings = pm->getObject<Core::Internal::GeneralSettings>();
-    useUDPMirror = settings->useUDPMirror();
+    Core::Internal::GeneralSettings *settings = pm ? pm->getObject<Core::Internal::GeneralSettings>() : NULL;
+    useUDPMirror = settings && settings->useUDPMirror();
     qDebug() << "USE UDP:::::::::::." << useUDPMirror;
     if (useUDPMirror) {
         udpSocketTx = new QUdpSocket(this);
@@ -172,6 +177,31 @@ void UAVTalk::cancelTransaction(UAVObject *obj)
     if (trans != NULL) {
         closeTransaction(trans);
     }
+    // The peer may not have the data a retry would be a delta of
+    forgetDeltaBase(obj->getObjID(), ALL_INSTANCES);
+}
+
+/**
+ * Tell the peer which optional packet types are understood.
+ * A peer that knows about capabilities answers with its own, others with a NACK.
+ */
+void UAVTalk::sendCapabilities()
+{
+    QMutexLocker locker(&mutex);
+
+    transmitSingleObject(TYPE_OBJ_REQ, CAPS_OBJID, CAPS, NULL);
+}
+
+/**
+ * Forget the capabilities of the peer, a different one may connect once the
+ * link is lost. Objects are sent in full until the next exchange.
+ */
+void UAVTalk::resetCapabilities()
+{
+    QMutexLocker locker(&mutex);
+
+    peerCaps = 0;
+    deltaBases.clear();
 }
 
 /**
@@ -208,33 +238,199 @@ bool UAVTalk::objectTransaction(quint8 type, quint32 objId, quint16 instId, UAVO
  */
 void UAVTalk::processInputStream()
 {
-    quint8 tmp;
-
     if (io && io->isReadable()) {
-        while (io->bytesAvailable() > 0) {
-            int ret = io->read((char *)&tmp, 1);
-            if (ret != -1) {
-                processInputByte(tmp);
-            } else {
-                // TODOD
-            }
-            if (rxState == STATE_COMPLETE) {
-                mutex.lock();
-                if (receiveObject(rxType, rxObjId, rxInstId, rxBuffer, rxLength)) {
-                    stats.rxObjectBytes += rxLength;
-                    stats.rxObjects++;
-                } else {
-                    // TODO...
+        // A slot connected to a received object may run an event loop and call this again,
+        // the read position is shared so the nested call carries on where the outer one was
+        while (rxReadPos < rxReadLength || io->bytesAvailable() > 0) {
+            if (rxReadPos == rxReadLength) {
+                qint64 ret = io->read((char *)rxReadBuffer, RX_BUFFER_SIZE);
+                if (ret <= 0) {
+                    break;
                 }
-                mutex.unlock();
+                rxReadPos    = 0;
+                rxReadLength = ret;
+            }
+            processInputBuffer();
+        }
+    }
+}
 
-                if (useUDPMirror) {
-                    // it is safe to do this outside of the above critical section as the rxDataArray is
-                    // accessed from this thread only
-                    udpSocketTx->writeDatagram(rxDataArray, QHostAddress::LocalHost, udpSocketRx->localPort());
-                }
+/**
+ * Process the bytes read from the telemetry stream and not yet parsed.
+ * The sync search, complete headers and payloads are handled a span at a time,
+ * only headers split across two reads and the checksum byte go through the
+ * byte state machine. The mutex is taken once for the whole block.
+ */
+void UAVTalk::processInputBuffer()
+{
+    QMutexLocker locker(&mutex);
+
+    while (rxReadPos < rxReadLength) {
+        const quint8 *data = &rxReadBuffer[rxReadPos];
+        qint64 available   = rxReadLength - rxReadPos;
+
+        if (rxState == STATE_COMPLETE || rxState == STATE_ERROR) {
+            rxState = STATE_SYNC;
+
+            if (useUDPMirror) {
+                rxDataArray.clear();
             }
         }
+
+        if (rxState == STATE_SYNC) {
+            // Skip everything up to the next sync byte at once
+            const quint8 *sync = (const quint8 *)memchr(data, SYNC_VAL, available);
+            qint64 skipped     = sync ? sync - data : available;
+
+            stats.rxBytes      += skipped;
+            stats.rxSyncErrors += skipped;
+            rxReadPos += skipped;
+            if (!sync) {
+                break;
+            }
+            if (available - skipped >= HEADER_LENGTH) {
+                rxReadPos += processHeader(sync);
+                continue;
+            }
+        } else if (rxState == STATE_DATA) {
+            // Copy as much of the payload as is available and checksum it in one go
+            qint64 count = qMin((qint64)(rxLength - rxCount), available);
+
+            memcpy(&rxBuffer[rxCount], data, count);
+            rxCS = Crc::updateCRC(rxCS, data, count);
+            stats.rxBytes  += count;
+            rxPacketLength += count;
+            if (useUDPMirror) {
+                rxDataArray.append((const char *)data, count);
+            }
+            rxCount   += count;
+            rxReadPos += count;
+
+            if (rxCount == rxLength) {
+                rxCount = 0;
+                rxState = STATE_CS;
+            }
+            continue;
+        }
+
+        // Headers split across reads and the checksum go through the byte state machine
+        processInputByte(rxReadBuffer[rxReadPos++]);
+        if (rxState == STATE_COMPLETE) {
+            receivePacket();
+        }
+    }
+}
+
+/**
+ * Parse a complete packet header at once, starting at the sync byte.
+ * Consumes the same bytes and leaves the same state as the byte state machine would.
+ * \param[in] header At least HEADER_LENGTH received bytes
+ * \return The number of bytes consumed
+ */
+int UAVTalk::processHeader(const quint8 *header)
+{
+    int consumed = HEADER_LENGTH;
+
+    rxType = header[1];
+    if ((rxType & TYPE_MASK) != TYPE_VER) {
+        qWarning() << "UAVTalk - error : bad type";
+        stats.rxErrors++;
+        rxState  = STATE_ERROR;
+        consumed = 2;
+    } else {
+        packetSize = qFromLittleEndian<quint16>(&header[2]);
+        if (packetSize < HEADER_LENGTH || packetSize > HEADER_LENGTH + MAX_PAYLOAD_LENGTH) {
+            // incorrect packet size
+            qWarning() << "UAVTalk - error : incorrect packet size";
+            stats.rxErrors++;
+            rxState  = STATE_ERROR;
+            consumed = 4;
+        }
+    }
+
+    rxCS = Crc::updateCRC(0, header, consumed);
+    rxPacketLength = consumed;
+    rxCount = 0;
+    stats.rxBytes += consumed;
+    if (useUDPMirror) {
+        rxDataArray.append((const char *)header, consumed);
+    }
+
+    if (consumed == HEADER_LENGTH) {
+        rxObjId  = qFromLittleEndian<quint32>(&header[4]);
+        rxInstId = qFromLittleEndian<quint16>(&header[8]);
+        startPayload();
+    }
+    return consumed;
+}
+
+/**
+ * Look up the object of a complete header and decide what follows it,
+ * the payload, the checksum or an error.
+ */
+void UAVTalk::startPayload()
+{
+    // Search for object, if not found reset state machine
+    UAVObject *rxObj = objMngr->getObject(rxObjId);
+
+    if (rxObj == NULL && rxType != TYPE_OBJ_REQ && !(rxType == TYPE_NACK && rxObjId == CAPS_OBJID)
+        && !(rxType == TYPE_BUNDLE && rxObjId == BUNDLE_OBJID)) {
+        qWarning() << "UAVTalk - error : unknown object" << rxObjId;
+        stats.rxErrors++;
+        rxState = STATE_ERROR;
+        return;
+    }
+
+    // Determine data length
+    if (rxType == TYPE_OBJ_REQ || rxType == TYPE_ACK || rxType == TYPE_NACK) {
+        rxLength = 0;
+    } else if (rxObj && rxType != TYPE_OBJ_DELTA && rxType != TYPE_OBJ_ACK_DELTA) {
+        rxLength = rxObj->getNumBytes();
+    } else {
+        rxLength = packetSize - rxPacketLength;
+    }
+
+    // Check length and determine next state
+    if (rxLength >= MAX_PAYLOAD_LENGTH) {
+        // packet error - exceeded payload max length
+        qWarning() << "UAVTalk - error : exceeded payload max length" << rxObjId;
+        stats.rxErrors++;
+        rxState = STATE_ERROR;
+        return;
+    }
+
+    // Check the lengths match
+    if ((rxPacketLength + rxLength) != packetSize) {
+        // packet error - mismatched packet size
+        qWarning() << "UAVTalk - error : mismatched packet size" << rxObjId;
+        stats.rxErrors++;
+        rxState = STATE_ERROR;
+        return;
+    }
+
+    // If there is a payload get it, otherwise receive checksum
+    if (rxLength > 0) {
+        rxState = STATE_DATA;
+    } else {
+        rxState = STATE_CS;
+    }
+}
+
+/**
+ * Hand a completed packet to receiveObject(), the mutex must be held.
+ */
+void UAVTalk::receivePacket()
+{
+    if (receiveObject(rxType, rxObjId, rxInstId, rxBuffer, rxLength)) {
+        stats.rxObjectBytes += rxLength;
+        stats.rxObjects++;
+    } else {
+        // TODO...
+    }
+
+    if (useUDPMirror) {
+        // rxDataArray is accessed from this thread only
+        udpSocketTx->writeDatagram(rxDataArray, QHostAddress::LocalHost, udpSocketRx->localPort());
     }
 }
 
@@ -359,52 +555,7 @@ bool UAVTalk::processInputByte(quint8 rxbyte)
 
         rxInstId = (qint16)qFromLittleEndian<quint16>(rxTmpBuffer);
 
-        // Search for object, if not found reset state machine
-        {
-            UAVObject *rxObj = objMngr->getObject(rxObjId);
-            if (rxObj == NULL && rxType != TYPE_OBJ_REQ) {
-                qWarning() << "UAVTalk - error : unknown object" << rxObjId;
-                stats.rxErrors++;
-                rxState = STATE_ERROR;
-                break;
-            }
-
-            // Determine data length
-            if (rxType == TYPE_OBJ_REQ || rxType == TYPE_ACK || rxType == TYPE_NACK) {
-                rxLength = 0;
-            } else {
-                if (rxObj) {
-                    rxLength = rxObj->getNumBytes();
-                } else {
-                    rxLength = packetSize - rxPacketLength;
-                }
-            }
-
-            // Check length and determine next state
-            if (rxLength >= MAX_PAYLOAD_LENGTH) {
-                // packet error - exceeded payload max length
-                qWarning() << "UAVTalk - error : exceeded payload max length" << rxObjId;
-                stats.rxErrors++;
-                rxState = STATE_ERROR;
-                break;
-            }
-
-            // Check the lengths match
-            if ((rxPacketLength + rxLength) != packetSize) {
-                // packet error - mismatched packet size
-                qWarning() << "UAVTalk - error : mismatched packet size" << rxObjId;
-                stats.rxErrors++;
-                rxState = STATE_ERROR;
-                break;
-            }
-        }
-
-        // If there is a payload get it, otherwise receive checksum
-        if (rxLength > 0) {
-            rxState = STATE_DATA;
-        } else {
-            rxState = STATE_CS;
-        }
+        startPayload();
         break;
 
     case STATE_DATA:
@@ -465,7 +616,8 @@ bool UAVTalk::processInputByte(quint8 rxbyte)
  * Object handling errors are considered as application errors and are NACked.
  * In that case we want to nack as there is no point in the sender retrying to send invalid objects.
  *
- * \param[in] type Type of received message (TYPE_OBJ, TYPE_OBJ_REQ, TYPE_OBJ_ACK, TYPE_ACK, TYPE_NACK)
+ * \param[in] type Type of received message (TYPE_OBJ, TYPE_OBJ_REQ, TYPE_OBJ_ACK, TYPE_ACK, TYPE_NACK,
+ *            TYPE_OBJ_DELTA, TYPE_OBJ_ACK_DELTA, TYPE_BUNDLE)
  * \param[in] obj Handle of the received object
  * \param[in] instId The instance ID of UAVOBJ_ALL_INSTANCES for all instances.
  * \param[in] data Data buffer
@@ -474,12 +626,15 @@ bool UAVTalk::processInputByte(quint8 rxbyte)
  */
 bool UAVTalk::receiveObject(quint8 type, quint32 objId, quint16 instId, quint8 *data, qint32 length)
 {
-    Q_UNUSED(length);
-
     UAVObject *obj    = NULL;
     bool error        = false;
     bool allInstances = (instId == ALL_INSTANCES);
 
+    // The data the peer has is now its own, deltas against what was last sent to it would miss changes
+    if (type != TYPE_OBJ_REQ && type != TYPE_ACK && type != TYPE_BUNDLE) {
+        forgetDeltaBase(objId, instId);
+    }
+
     // Process message type
     switch (type) {
     case TYPE_OBJ:
@@ -503,11 +658,37 @@ bool UAVTalk::receiveObject(quint8 type, quint32 objId, quint16 instId, quint8 *
         }
         break;
 
+    case TYPE_OBJ_DELTA:
+        // All instances, not allowed for OBJ messages
+        if (!allInstances) {
+            obj = updateObjectDelta(objId, instId, data, length);
+#ifdef VERBOSE_UAVTALK
+            VERBOSE_FILTER(objId) qDebug() << "UAVTalk - received object delta" << objId << instId << (obj != NULL ? obj->toStringBrief() : "<null object>");
+#endif
+            if (obj != NULL) {
+                updateAck(TYPE_OBJ, objId, instId, obj);
+            } else {
+                error = true;
+            }
+        } else {
+            error = true;
+        }
+        break;
+
+    case TYPE_BUNDLE:
+        error = (objId != BUNDLE_OBJID) || !receiveBundle(data, length);
+        break;
+
     case TYPE_OBJ_ACK:
+    case TYPE_OBJ_ACK_DELTA:
         // All instances, not allowed for OBJ_ACK messages
         if (!allInstances) {
             // Get object and update its data
-            obj = updateObject(objId, instId, data);
+            if (type == TYPE_OBJ_ACK_DELTA) {
+                obj = updateObjectDelta(objId, instId, data, length);
+            } else {
+                obj = updateObject(objId, instId, data);
+            }
 #ifdef VERBOSE_UAVTALK
             VERBOSE_FILTER(objId) qDebug() << "UAVTalk - received object (acked)" << objId << instId << (obj != NULL ? obj->toStringBrief() : "<null object>");
 #endif
@@ -527,6 +708,10 @@ bool UAVTalk::receiveObject(quint8 type, quint32 objId, quint16 instId, quint8 *
         break;
 
     case TYPE_OBJ_REQ:
+        if (objId == CAPS_OBJID) {
+            receiveCapabilities(instId);
+            break;
+        }
         // Check if requested object exists
         if (allInstances) {
             // All instances, so get instance zero
@@ -538,8 +723,9 @@ bool UAVTalk::receiveObject(quint8 type, quint32 objId, quint16 instId, quint8 *
         VERBOSE_FILTER(objId) qDebug() << "UAVTalk - received object request" << objId << instId << (obj != NULL ? obj->toStringBrief() : "<null object>");
 #endif
         if (obj != NULL) {
-            // Object found, transmit it
+            // Object found, transmit it in full
             // The sent object will ack the object request on the receiver side
+            forgetDeltaBase(objId, instId);
             error = !transmitObject(TYPE_OBJ, objId, instId, obj);
         } else {
             error = true;
@@ -568,6 +754,10 @@ bool UAVTalk::receiveObject(quint8 type, quint32 objId, quint16 instId, quint8 *
         break;
 
     case TYPE_NACK:
+        if (objId == CAPS_OBJID) {
+            // The peer does not know about capabilities
+            break;
+        }
         // All instances, not allowed for NACK messages
         if (!allInstances) {
             // Get object
@@ -632,6 +822,201 @@ UAVObject *UAVTalk::updateObject(quint32 objId, quint16 instId, quint8 *data)
     }
 }
 
+/**
+ * Apply a delta to an existing object instance, the fields it does not carry keep their value.
+ * The instance is unpacked in one go so that it is signalled once.
+ */
+UAVObject *UAVTalk::updateObjectDelta(quint32 objId, quint16 instId, const quint8 *data, qint32 length)
+{
+    UAVObject *obj = objMngr->getObject(objId, instId);
+
+    if (obj == NULL) {
+        qWarning() << "UAVTalk - delta for a missing object, object ID :" << objId << instId;
+        return NULL;
+    }
+
+    const QVector<quint16> &layout = fieldLayout(obj);
+    int numFields  = layout.size() - 1;
+    int maskLength = (numFields + 7) / 8;
+    QByteArray current(obj->getNumBytes(), 0);
+    if (length < maskLength || !obj->pack((quint8 *)current.data())) {
+        return NULL;
+    }
+
+    const quint8 *pos = &data[maskLength];
+    const quint8 *end = &data[length];
+    for (int n = 0; n < numFields; ++n) {
+        if (data[n / 8] & (1 << (n % 8))) {
+            int size = layout[n + 1] - layout[n];
+            if (end - pos < size) {
+                return NULL;
+            }
+            memcpy(current.data() + layout[n], pos, size);
+            pos += size;
+        }
+    }
+    if (pos != end) {
+        return NULL;
+    }
+
+    obj->unpack((const quint8 *)current.constData());
+    return obj;
+}
+
+/**
+ * Store the capabilities received from the peer and answer them with ours.
+ */
+void UAVTalk::receiveCapabilities(quint16 caps)
+{
+    if (!(caps & CAP_REPLY)) {
+        transmitSingleObject(TYPE_OBJ_REQ, CAPS_OBJID, CAPS | CAP_REPLY, NULL);
+    }
+    // A new peer has none of the data sent before
+    peerCaps = caps & ~CAP_REPLY;
+    deltaBases.clear();
+}
+
+/**
+ * Receive the records of a bundle, each as the packet it stands for: its type, with
+ * BUNDLE_INSTID set when the instance ID is not zero, the object ID, the instance ID
+ * if set, the data length and the data.
+ * \return Success (true), Failure (false) of any of the records
+ */
+bool UAVTalk::receiveBundle(quint8 *data, qint32 length)
+{
+    quint8 *end  = data + length;
+    bool success = true;
+    int records  = 0;
+
+    while (data < end) {
+        if (end - data < BUNDLE_RECORD_LENGTH) {
+            return false;
+        }
+        quint8 type    = *data++;
+        quint32 objId  = qFromLittleEndian<quint32>(data);
+        quint16 instId = 0;
+        data += 4;
+        if (type & BUNDLE_INSTID) {
+            if (end - data < 3) {
+                return false;
+            }
+            instId = qFromLittleEndian<quint16>(data);
+            data  += 2;
+            type  &= ~BUNDLE_INSTID;
+        }
+        quint8 recordLength = *data++;
+        if (end - data < recordLength) {
+            return false;
+        }
+
+        UAVObject *obj = objMngr->getObject(objId);
+        if ((type == TYPE_OBJ && obj && obj->getNumBytes() == recordLength) || type == TYPE_OBJ_DELTA) {
+            success &= receiveObject(type, objId, instId, data, recordLength);
+        } else {
+            success = false;
+        }
+        data += recordLength;
+        records++;
+    }
+
+    // The frame itself is counted as one object
+    if (records > 1) {
+        stats.rxObjects += records - 1;
+    }
+    return success;
+}
+
+/**
+ * The offset of each field in the packed data of an object, followed by the packed size
+ */
+const QVector<quint16> &UAVTalk::fieldLayout(UAVObject *obj)
+{
+    QHash<quint32, QVector<quint16> >::iterator it = fieldLayouts.find(obj->getObjID());
+
+    if (it == fieldLayouts.end()) {
+        QVector<quint16> layout;
+        quint16 offset = 0;
+        foreach(UAVObjectField * field, obj->getFields()) {
+            layout.append(offset);
+            offset += field->getNumBytes();
+        }
+        layout.append(offset);
+        it = fieldLayouts.insert(obj->getObjID(), layout);
+    }
+    return it.value();
+}
+
+/**
+ * Turn packed object data into a delta against the data last sent, in place:
+ * a bitmask of the fields that changed, field n in bit n % 8 of byte n / 8,
+ * followed by these fields. The data is left whole when it is to be sent in full,
+ * as a keyframe or because the delta would not be any smaller.
+ * \return The payload length, length when sent in full
+ */
+qint32 UAVTalk::packDelta(quint32 objId, quint16 instId, UAVObject *obj, quint8 *data, qint32 length)
+{
+    const QVector<quint16> &layout = fieldLayout(obj);
+    int numFields  = layout.size() - 1;
+    int maskLength = (numFields + 7) / 8;
+    DeltaBase &base = deltaBases[((quint64)objId << 16) | instId];
+
+    if (base.data.size() != length || base.deltas >= DELTA_KEYFRAME) {
+        base.data   = QByteArray((const char *)data, length);
+        base.deltas = 0;
+        return length;
+    }
+
+    // Move the changed fields to the front, behind the ones already moved
+    QByteArray mask(maskLength, 0);
+    quint8 *last = (quint8 *)base.data.data();
+    quint8 *pos  = data;
+    for (int n = 0; n < numFields; ++n) {
+        int offset = layout[n];
+        int size   = layout[n + 1] - offset;
+        if (memcmp(&data[offset], &last[offset], size) != 0) {
+            mask[n / 8] = mask[n / 8] | (1 << (n % 8));
+            memcpy(&last[offset], &data[offset], size);
+            memmove(pos, &data[offset], size);
+            pos += size;
+        }
+    }
+
+    qint32 deltaLength = maskLength + (pos - data);
+    if (deltaLength >= length) {
+        // The base holds all of the new data by now
+        memcpy(data, last, length);
+        base.deltas = 0;
+        return length;
+    }
+
+    memmove(&data[maskLength], data, pos - data);
+    memcpy(data, mask.constData(), maskLength);
+    base.deltas++;
+    return deltaLength;
+}
+
+/**
+ * Drop the data last sent of an instance, or of all instances, so that it is sent in full next.
+ */
+void UAVTalk::forgetDeltaBase(quint32 objId, quint16 instId)
+{
+    if (deltaBases.isEmpty()) {
+        return;
+    }
+    if (instId != ALL_INSTANCES) {
+        deltaBases.remove(((quint64)objId << 16) | instId);
+        return;
+    }
+    QHash<quint64, DeltaBase>::iterator it = deltaBases.begin();
+    while (it != deltaBases.end()) {
+        if ((it.key() >> 16) == objId) {
+            it = deltaBases.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 /**
  * Check if a transaction is pending and if yes complete it.
  */
@@ -771,12 +1156,25 @@ bool UAVTalk::transmitSingleObject(quint8 type, quint32 objId, quint16 instId, U
     }
 
     // Copy data (if any)
+    bool delta = false;
     if (length > 0) {
         if (!obj->pack(&txBuffer[HEADER_LENGTH])) {
             qWarning() << "UAVTalk - error transmitting : failed to pack object" << obj->toStringBrief();
             ++stats.txErrors;
             return false;
         }
+
+        // Instances the peer already has are sent as the fields that changed since
+        if ((type == TYPE_OBJ || type == TYPE_OBJ_ACK) && (peerCaps & CAP_DELTA) && length >= DELTA_MIN_LENGTH) {
+            qint32 deltaLength = packDelta(objId, instId, obj, &txBuffer[HEADER_LENGTH], length);
+            if (deltaLength < length) {
+                txBuffer[1] = (type == TYPE_OBJ) ? TYPE_OBJ_DELTA : TYPE_OBJ_ACK_DELTA;
+                length = deltaLength;
+                delta  = true;
+            }
+        } else {
+            forgetDeltaBase(objId, instId);
+        }
     }
 
     // Store the packet length
@@ -787,10 +1185,17 @@ bool UAVTalk::transmitSingleObject(quint8 type, quint32 objId, quint16 instId, U
 
     // Send buffer, check that the transmit backlog does not grow above limit
     if (!io.isNull() && io->isWritable()) {
-        if (io->bytesToWrite() < TX_BUFFER_SIZE) {
-            io->write((const char *)txBuffer, HEADER_LENGTH + length + CHECKSUM_LENGTH);
-            if (useUDPMirror) {
-                udpSocketRx->writeDatagram((const char *)txBuffer, HEADER_LENGTH + length + CHECKSUM_LENGTH, QHostAddress::LocalHost, udpSocketTx->localPort());
+        // A batch is at most one transmit backlog long
+        if (txBatch.size() + HEADER_LENGTH + length + CHECKSUM_LENGTH > TX_BUFFER_SIZE) {
+            writeToDevice(txBatch.constData(), txBatch.size());
+            txBatch.clear();
+        }
+        // The packets held back in the batch count towards the backlog too
+        if (io->bytesToWrite() + txBatch.size() < TX_BUFFER_SIZE) {
+            if (txBatchDepth > 0) {
+                txBatch.append((const char *)txBuffer, HEADER_LENGTH + length + CHECKSUM_LENGTH);
+            } else {
+                writeToDevice((const char *)txBuffer, HEADER_LENGTH + length + CHECKSUM_LENGTH);
             }
         } else {
             qWarning() << "UAVTalk - error transmitting : io device full";
@@ -805,6 +1210,7 @@ bool UAVTalk::transmitSingleObject(quint8 type, quint32 objId, quint16 instId, U
 
     // Update stats
     ++stats.txObjects;
+    stats.txDeltas += delta ? 1 : 0;
     stats.txObjectBytes += length;
     stats.txBytes += HEADER_LENGTH + length + CHECKSUM_LENGTH;
 
@@ -812,6 +1218,39 @@ bool UAVTalk::transmitSingleObject(quint8 type, quint32 objId, quint16 instId, U
     return true;
 }
 
+void UAVTalk::writeToDevice(const char *data, qint64 size)
+{
+    io->write(data, size);
+    if (useUDPMirror) {
+        udpSocketRx->writeDatagram(data, size, QHostAddress::LocalHost, udpSocketTx->localPort());
+    }
+}
+
+/**
+ * Hold back the packets sent from now on until the matching endBatch(), so
+ * that objects sent together reach the device in a single write.
+ * Batches can be nested, the packets are written when the outermost one ends.
+ */
+void UAVTalk::beginBatch()
+{
+    QMutexLocker locker(&mutex);
+
+    ++txBatchDepth;
+}
+
+void UAVTalk::endBatch()
+{
+    QMutexLocker locker(&mutex);
+
+    if (txBatchDepth == 0 || --txBatchDepth > 0) {
+        return;
+    }
+    if (!txBatch.isEmpty() && !io.isNull() && io->isWritable()) {
+        writeToDevice(txBatch.constData(), txBatch.size());
+    }
+    txBatch.clear();
+}
+
 UAVTalk::Transaction *UAVTalk::findTransaction(quint32 objId, quint16 instId)
 {
     // Lookup the transaction in the transaction map
@@ -896,6 +1335,21 @@ const char *UAVTalk::typeToString(quint8 type)
     case TYPE_NACK:
         return "nack";
 
+        break;
+
+    case TYPE_OBJ_DELTA:
+        return "object delta";
+
+        break;
+
+    case TYPE_OBJ_ACK_DELTA:
+        return "object delta (acked)";
+
+        break;
+
+    case TYPE_BUNDLE:
+        return "bundle";
+
         break;
     }
     return "<error>";
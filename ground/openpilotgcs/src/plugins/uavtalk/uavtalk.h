@@ -51,6 +51,7 @@ public:
         quint32 txObjectBytes;
         quint32 txObjects;
         quint32 txErrors;
+        quint32 txDeltas;
 
         quint32 rxBytes;
         quint32 rxObjectBytes;
@@ -70,6 +71,14 @@ public:
     bool sendObjectRequest(UAVObject *obj, bool allInstances);
     void cancelTransaction(UAVObject *obj);
 
+    // Offer the peer to send objects as deltas, and forget what it accepted when the link is lost
+    void sendCapabilities();
+    void resetCapabilities();
+
+    // Packets sent between the two are written to the device in one go
+    void beginBatch();
+    void endBatch();
+
 signals:
     void transactionCompleted(UAVObject *obj, bool success);
 
@@ -85,6 +94,11 @@ private:
         quint16 respInstId;
     } Transaction;
 
+    typedef struct {
+        QByteArray data;
+        int deltas; // sent since the data was last sent in full
+    } DeltaBase;
+
     // Constants
     static const int TYPE_MASK     = 0xF8;
     static const int TYPE_VER      = 0x20;
@@ -93,6 +107,29 @@ private:
     static const int TYPE_OBJ_ACK  = (TYPE_VER | 0x02);
     static const int TYPE_ACK      = (TYPE_VER | 0x03);
     static const int TYPE_NACK     = (TYPE_VER | 0x04);
+    static const int TYPE_OBJ_DELTA     = (TYPE_VER | 0x05);
+    static const int TYPE_OBJ_ACK_DELTA = (TYPE_VER | 0x06);
+    static const int TYPE_BUNDLE        = (TYPE_VER | 0x07);
+
+    // Capabilities are exchanged as a request of this reserved object ID with the
+    // flags as instance ID, peers without them answer with a NACK
+    static const quint32 CAPS_OBJID = 0xFFFFFFFE;
+    static const quint16 CAP_DELTA  = 0x0001; // OBJ_DELTA and OBJ_ACK_DELTA packets are understood
+    static const quint16 CAP_BUNDLE = 0x0002; // BUNDLE packets are understood
+    static const quint16 CAP_REPLY  = 0x8000; // answer to the capabilities of the peer
+    static const quint16 CAPS = CAP_DELTA | CAP_BUNDLE;
+
+    // A bundle carries several OBJ or OBJ_DELTA packets of this reserved object ID
+    // as records, with the number of records as instance ID
+    static const quint32 BUNDLE_OBJID  = 0xFFFFFFFD;
+    static const quint8 BUNDLE_INSTID  = 0x80; // record type flag, the instance ID follows the object ID
+    // record header : type(1), object ID(4), instance ID(2) if not zero, length(1)
+    static const int BUNDLE_RECORD_LENGTH = 6;
+
+    // After this many deltas an instance is sent in full again, to recover from lost packets
+    static const int DELTA_KEYFRAME   = 16;
+    // Smaller objects are always sent in full
+    static const int DELTA_MIN_LENGTH = 16;
 
     // header : sync(1), type (1), size(2), object ID(4), instance ID(2)
     static const int HEADER_LENGTH = 10;
@@ -105,6 +142,8 @@ private:
 
     static const int TX_BUFFER_SIZE     = 2 * 1024;
 
+    static const int RX_BUFFER_SIZE     = 4 * 1024;
+
     // Types
     typedef enum {
         STATE_SYNC, STATE_TYPE, STATE_SIZE, STATE_OBJID, STATE_INSTID, STATE_DATA, STATE_CS, STATE_COMPLETE, STATE_ERROR
@@ -121,10 +160,24 @@ private:
 
     QMap<quint32, QMap<quint32, Transaction *> *> transMap;
 
+    // Capabilities of the peer, the data last sent of each instance and the field layout of each object
+    quint16 peerCaps;
+    QHash<quint64, DeltaBase> deltaBases;
+    QHash<quint32, QVector<quint16> > fieldLayouts;
+
     quint8 rxBuffer[MAX_PACKET_LENGTH];
 
     quint8 txBuffer[MAX_PACKET_LENGTH];
 
+    // Packets held back until endBatch(), and how many batches are open
+    QByteArray txBatch;
+    int txBatchDepth;
+
+    // Bytes read from the device in one go, and how far they have been parsed
+    quint8 rxReadBuffer[RX_BUFFER_SIZE];
+    qint64 rxReadPos;
+    qint64 rxReadLength;
+
     // Variables used by the receive state machine
     // state machine variables
     qint32 rxCount;
@@ -148,12 +201,23 @@ private:
     // Methods
     bool objectTransaction(quint8 type, quint32 objId, quint16 instId, UAVObject *obj);
     bool processInputByte(quint8 rxbyte);
+    void processInputBuffer();
+    int processHeader(const quint8 *header);
+    void startPayload();
+    void receivePacket();
     bool receiveObject(quint8 type, quint32 objId, quint16 instId, quint8 *data, qint32 length);
     UAVObject *updateObject(quint32 objId, quint16 instId, quint8 *data);
+    UAVObject *updateObjectDelta(quint32 objId, quint16 instId, const quint8 *data, qint32 length);
+    void receiveCapabilities(quint16 caps);
+    bool receiveBundle(quint8 *data, qint32 length);
+    const QVector<quint16> &fieldLayout(UAVObject *obj);
+    qint32 packDelta(quint32 objId, quint16 instId, UAVObject *obj, quint8 *data, qint32 length);
+    void forgetDeltaBase(quint32 objId, quint16 instId);
     void updateAck(quint8 type, quint32 objId, quint16 instId, UAVObject *obj);
     void updateNack(quint32 objId, quint16 instId, UAVObject *obj);
     bool transmitObject(quint8 type, quint32 objId, quint16 instId, UAVObject *obj);
     bool transmitSingleObject(quint8 type, quint32 objId, quint16 instId, UAVObject *obj);
+    void writeToDevice(const char *data, qint64 size);
 
     Transaction *findTransaction(quint32 objId, quint16 instId);
     void openTransaction(quint8 type, quint32 objId, quint16 instId);
@@ -0,0 +1,22 @@
+#
+# Qmake project for the OpenPilot GCS unit tests.
+# Copyright (c) 2014, The OpenPilot Team, http://www.openpilot.org
+#
+# Must be run in the GCS build directory: tst_uavtalk links against the
+# plugin libraries of the GCS build (see gcs_test in the top level Makefile).
+#
+
+TEMPLATE  = subdirs
+
+SUBDIRS = \
+    tst_logfile \
+    tst_uavobjectfield \
+    tst_uavobjectmanager \
+    tst_plotseriesdata \
+    tst_uavtalk
+
+tst_logfile.file          = src/libs/utils/tests/tst_logfile.pro
+tst_uavobjectfield.file   = src/plugins/uavobjects/tests/tst_uavobjectfield.pro
+tst_uavobjectmanager.file = src/plugins/uavobjects/tests/tst_uavobjectmanager.pro
+tst_plotseriesdata.file   = src/plugins/scope/tests/tst_plotseriesdata.pro
+tst_uavtalk.file          = src/plugins/uavtalk/tests/tst_uavtalk.pro
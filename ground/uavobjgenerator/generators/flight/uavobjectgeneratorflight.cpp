@@ -25,6 +25,7 @@
  */
 
 #include "uavobjectgeneratorflight.h"
+#include "uavobjectidhash.h"
 
 using namespace std;
 
@@ -65,9 +66,16 @@ bool UAVObjectGeneratorFlight::generate(UAVObjectParser *parser, QString templat
         }
     }
 
+    QString objIdHash = generate_id_hash(parser);
+    if (objIdHash.isNull()) {
+        cerr << "Error: Could not generate the object ID hash." << endl;
+        return false;
+    }
+
     // Write the flight object inialization files
     flightInitTemplate.replace(QString("$(OBJINC)"), objInc);
     flightInitTemplate.replace(QString("$(OBJINIT)"), flightObjInit);
+    flightInitTemplate.replace(QString("$(OBJIDHASH)"), objIdHash);
     bool res = writeFileIfDiffrent(flightOutputPath.absolutePath() + "/uavobjectsinit.c",
                                    flightInitTemplate);
     if (!res) {
@@ -98,6 +106,52 @@ bool UAVObjectGeneratorFlight::generate(UAVObjectParser *parser, QString templat
 }
 
 
+/**
+ * Emit the perfect hash of all object IDs (see uavobjectidhash.h) together with the
+ * handle and field layout tables indexed by it. Returns a null string on failure.
+ **/
+QString UAVObjectGeneratorFlight::generate_id_hash(UAVObjectParser *parser)
+{
+    int numObjects = parser->getNumObjects();
+    std::vector<uint32_t> ids;
+    UAVObjectIdHash hash;
+
+    for (int objidx = 0; objidx < numObjects; ++objidx) {
+        ids.push_back(parser->getObjectID(objidx));
+    }
+    if (!uavo_id_hash_build(ids, &hash)) {
+        return QString();
+    }
+
+    QString out = QString::fromStdString(uavo_id_hash_tables(hash));
+    out.append(QString("UAVObjHandle *const uavo_id_hash_handles[%1] = {\n").arg(numObjects));
+    for (int objidx = 0; objidx < numObjects; ++objidx) {
+        ObjectInfo *info = parser->getObjectByIndex(objidx);
+        out.append("#ifdef UAVOBJ_INIT_" + info->namelc + "\n");
+        out.append(QString("    [%1] = &%2HandleStorage,\n").arg(objidx).arg(info->name));
+        out.append("#endif\n");
+    }
+    out.append("};\n\n");
+
+    // Field layout of each object: number of fields, offset of each field and packed size
+    out.append(QString("const uint16_t *const uavo_id_hash_fields[%1] = {\n").arg(numObjects));
+    for (int objidx = 0; objidx < numObjects; ++objidx) {
+        ObjectInfo *info = parser->getObjectByIndex(objidx);
+        QString layout   = QString::number(info->fields.length());
+        int offset = 0;
+        for (int n = 0; n < info->fields.length(); ++n) {
+            layout.append(QString(", %1").arg(offset));
+            offset += info->fields[n]->numBytes * info->fields[n]->numElements;
+        }
+        layout.append(QString(", %1").arg(offset));
+        out.append("#ifdef UAVOBJ_INIT_" + info->namelc + "\n");
+        out.append(QString("    [%1] = (const uint16_t[]) { %2 },\n").arg(objidx).arg(layout));
+        out.append("#endif\n");
+    }
+    out.append("};\n");
+    return out;
+}
+
 /**
  * Generate the Flight object files
  **/
@@ -41,6 +41,7 @@ public:
 
 private:
     bool process_object(ObjectInfo *info);
+    QString generate_id_hash(UAVObjectParser *parser);
 };
 
 #endif
@@ -0,0 +1,177 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uavobjectidhash.h
+ * @author     The OpenPilot Team, http://www.openpilot.org Copyright (C) 2014.
+ * @brief      perfect hash of the object IDs for the flight object manager
+ *
+ *             Plain C++ without Qt so that the flight unit tests can build
+ *             their fixture tables with the same code as the generator.
+ *
+ * @see        The GNU Public License (GPL) Version 3
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef UAVOBJECTIDHASH_H
+#define UAVOBJECTIDHASH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Object ID hash constants, these must match the ones in flight/uavobjects/inc/uavobjectprivate.h
+#define UAVO_ID_HASH_BUCKET_MULT 0x9E3779B1
+#define UAVO_ID_HASH_DISP_MULT   0x85EBCA6B
+#define UAVO_ID_HASH_SLOT_MULT   0xC2B2AE35
+
+// The slot index is stored in a byte with 0 marking an empty slot
+#define UAVO_ID_HASH_MAX_OBJECTS 254
+
+struct UAVObjectIdHash {
+    int slotBits;
+    int bucketBits;
+    std::vector<int> disp; // displacement of each bucket
+    std::vector<int> index; // one plus the object index in each slot, 0 if empty
+};
+
+inline uint32_t uavo_id_hash_bucket(const UAVObjectIdHash &hash, uint32_t id)
+{
+    return (uint32_t)(id * UAVO_ID_HASH_BUCKET_MULT) >> (32 - hash.bucketBits);
+}
+
+inline uint32_t uavo_id_hash_slot(int slotBits, int disp, uint32_t id)
+{
+    return (uint32_t)((id ^ (uint32_t)(disp * UAVO_ID_HASH_DISP_MULT)) * UAVO_ID_HASH_SLOT_MULT) >> (32 - slotBits);
+}
+
+/**
+ * Look up an ID the way the flight object manager does.
+ * Returns one plus the object index or 0 if the ID is not in the hash.
+ **/
+inline int uavo_id_hash_lookup(const UAVObjectIdHash &hash, uint32_t id)
+{
+    return hash.index[uavo_id_hash_slot(hash.slotBits, hash.disp[uavo_id_hash_bucket(hash, id)], id)];
+}
+
+/**
+ * Build a perfect hash of all object IDs (hash and displace): the IDs are spread over
+ * buckets, then for every bucket (largest first) a displacement is searched that maps
+ * all its IDs to free slots. Returns false if there are too many objects or no
+ * displacement could be found.
+ **/
+inline bool uavo_id_hash_build(const std::vector<uint32_t> &ids, UAVObjectIdHash *hash)
+{
+    int numObjects = (int)ids.size();
+
+    if (numObjects > UAVO_ID_HASH_MAX_OBJECTS) {
+        return false;
+    }
+
+    int slotBits = 1;
+    while ((1 << slotBits) < numObjects) {
+        ++slotBits;
+    }
+
+    for (; slotBits <= 16; ++slotBits) {
+        hash->slotBits   = slotBits;
+        hash->bucketBits = std::max(slotBits - 2, 1);
+        std::vector<std::vector<int> > buckets(1 << hash->bucketBits);
+        for (int objidx = 0; objidx < numObjects; ++objidx) {
+            buckets[uavo_id_hash_bucket(*hash, ids[objidx])].push_back(objidx);
+        }
+
+        // Place the largest buckets first
+        std::vector<std::pair<int, int> > order;
+        for (int b = 0; b < (int)buckets.size(); ++b) {
+            order.push_back(std::make_pair(-(int)buckets[b].size(), b));
+        }
+        std::sort(order.begin(), order.end());
+
+        std::vector<int> slots(1 << slotBits, -1);
+        hash->disp.assign(1 << hash->bucketBits, 0);
+        bool ok = true;
+        for (int n = 0; n < (int)order.size() && ok; ++n) {
+            int b = order[n].second;
+            if (buckets[b].empty()) {
+                continue;
+            }
+            bool placed = false;
+            for (int d = 0; d < 256 && !placed; ++d) {
+                std::vector<int> candidate;
+                for (int m = 0; m < (int)buckets[b].size(); ++m) {
+                    int slot = uavo_id_hash_slot(slotBits, d, ids[buckets[b][m]]);
+                    if (slots[slot] != -1 || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                        break;
+                    }
+                    candidate.push_back(slot);
+                }
+                if (candidate.size() == buckets[b].size()) {
+                    for (int m = 0; m < (int)candidate.size(); ++m) {
+                        slots[candidate[m]] = buckets[b][m];
+                    }
+                    hash->disp[b] = d;
+                    placed = true;
+                }
+            }
+            ok = placed;
+        }
+        if (ok) {
+            hash->index.resize(slots.size());
+            for (int n = 0; n < (int)slots.size(); ++n) {
+                hash->index[n] = slots[n] + 1;
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * The C definitions of the hash parameters and tables as uavobjectmanager.c expects them
+ **/
+inline std::string uavo_id_hash_tables(const UAVObjectIdHash &hash)
+{
+    std::string out;
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "const uint8_t uavo_id_hash_bits = %d;\n", hash.slotBits);
+    out.append(buf);
+    snprintf(buf, sizeof(buf), "const uint8_t uavo_id_hash_bucket_bits = %d;\n\n", hash.bucketBits);
+    out.append(buf);
+    snprintf(buf, sizeof(buf), "const uint8_t uavo_id_hash_disp[%d] = {", (int)hash.disp.size());
+    out.append(buf);
+    for (int b = 0; b < (int)hash.disp.size(); ++b) {
+        snprintf(buf, sizeof(buf), "%s%d,", (b % 16) ? " " : "\n    ", hash.disp[b]);
+        out.append(buf);
+    }
+    out.append("\n};\n\n");
+    snprintf(buf, sizeof(buf), "const uint8_t uavo_id_hash_index[%d] = {", (int)hash.index.size());
+    out.append(buf);
+    for (int n = 0; n < (int)hash.index.size(); ++n) {
+        snprintf(buf, sizeof(buf), "%s%d,", (n % 16) ? " " : "\n    ", hash.index[n]);
+        out.append(buf);
+    }
+    out.append("\n};\n\n");
+    return out;
+}
+
+#endif // UAVOBJECTIDHASH_H
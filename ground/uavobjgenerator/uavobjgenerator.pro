@@ -25,6 +25,7 @@ SOURCES += main.cpp \
 HEADERS += uavobjectparser.h \
     generators/generator_io.h \
     generators/java/uavobjectgeneratorjava.h \
+    generators/flight/uavobjectidhash.h \
     generators/gcs/uavobjectgeneratorgcs.h \
     generators/matlab/uavobjectgeneratormatlab.h \
     generators/python/uavobjectgeneratorpython.h \